@@ -0,0 +1,304 @@
+// ast-cache-test.cc
+// Tests for `ast-cache`.
+
+#include "ast-cache.h"                           // module under test
+
+#include "clang-ast.h"                           // ClangAST
+#include "clang-util.h"                          // GlobalClangUtilInstance
+#include "file-util.h"                           // writeFile
+#include "pca-command-line-options.h"            // PCACommandLineOptions
+#include "pca-process-tu.h"                      // processParsedTU
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "clang/AST/ASTContext.h"                // clang::ASTContext
+#include "clang/AST/Decl.h"                      // clang::{FunctionDecl, TranslationUnitDecl}
+
+#include "llvm/Support/Casting.h"                // llvm::dyn_cast
+#include "llvm/Support/Chrono.h"                 // llvm::sys::TimePoint
+#include "llvm/Support/FileSystem.h"             // llvm::sys::fs::{create_directories, remove_directories, etc.}
+#include "llvm/Support/Process.h"                // llvm::sys::Process
+
+#include <algorithm>                             // std::find
+#include <chrono>                                // std::chrono::{hours, system_clock}
+#include <cstddef>                               // std::size_t
+#include <memory>                                // std::unique_ptr
+#include <sstream>                               // std::ostringstream
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+void testSha1Hex()
+{
+  EXPECT_EQ(sha1Hex("abc"), "a9993e364706816aba3e25717850c26c9cd0d89d");
+  EXPECT_EQ(sha1Hex(""), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+}
+
+
+void testManifest()
+{
+  ASTCacheManifest manifest;
+  manifest.m_invocationKey = "k";
+  manifest.m_inputs.push_back({"a.cc", "h1"});
+  manifest.m_inputs.push_back({"dir with space/b.h", "h2"});
+
+  string text = manifest.toString();
+  EXPECT_EQ(text,
+    "pca-ast-cache-manifest 1\n"
+    "invocation k\n"
+    "input h1 a.cc\n"
+    "input h2 dir with space/b.h\n");
+
+  ASTCacheManifest parsed;
+  EXPECT_EQ(parsed.parse("m", text), "");
+  EXPECT_EQ(parsed.m_invocationKey, "k");
+  EXPECT_EQ(parsed.m_inputs.size(), (std::size_t)2);
+  EXPECT_EQ(parsed.m_inputs[1].m_name, "dir with space/b.h");
+  EXPECT_EQ(parsed.m_inputs[1].m_hash, "h2");
+  EXPECT_EQ(parsed.astFileName(), manifest.astFileName());
+
+  // The AST file name depends on the input hashes.
+  parsed.m_inputs[1].m_hash = "h3";
+  EXPECT_EQ(parsed.astFileName() == manifest.astFileName(), false);
+
+  EXPECT_EQ(parsed.parse("m", "something else\n"),
+            "\"m\": not an AST cache manifest");
+  EXPECT_EQ(parsed.parse("m", "pca-ast-cache-manifest 1\n"),
+            "\"m\":2: expected the invocation key");
+  EXPECT_EQ(parsed.parse("m",
+              "pca-ast-cache-manifest 1\ninvocation k\ninput h1\n"),
+            "\"m\":3: malformed input line");
+}
+
+
+// Parse 'fname' using 'cache', and return the `ClangAST`.
+std::unique_ptr<ClangAST> cachedParse(ASTCache &cache, string const &fname)
+{
+  std::unique_ptr<ClangAST> ast(new ClangAST);
+  EXPECT_EQ(ast->parseCommandLine({fname}), true);
+  EXPECT_EQ(cache.parseSourceCode(*ast), true);
+  return ast;
+}
+
+
+// True if the TU in 'ast' has a function called 'name'.
+bool hasFunction(ClangAST &ast, string const &name)
+{
+  for (clang::Decl const *decl :
+         ast.getASTContext().getTranslationUnitDecl()->decls()) {
+    if (auto fd = llvm::dyn_cast<clang::FunctionDecl>(decl)) {
+      if (fd->getNameAsString() == name) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+
+void testParseSourceCode()
+{
+  string dir = "out/ast-cache-test";
+  llvm::sys::fs::remove_directories(dir);
+  llvm::sys::fs::create_directories(dir);
+
+  string header = dir + "/a.h";
+  string source = dir + "/a.cc";
+  EXPECT_EQ(writeFile(header, "int fromHeader();\n"), "");
+  EXPECT_EQ(writeFile(source,
+                      "#include \"a.h\"\nint fromSource();\n"), "");
+  ClangAST::clearSharedFileSystemCache();
+
+  ASTCache cache(dir + "/cache");
+
+  // The first parse is a miss that records both files.
+  {
+    std::unique_ptr<ClangAST> ast = cachedParse(cache, source);
+    EXPECT_EQ(cache.m_misses, 1u);
+    EXPECT_EQ(cache.m_hits, 0u);
+
+    std::vector<string> inputs = ast->getInputFileNames();
+    EXPECT_EQ(std::find(inputs.begin(), inputs.end(), source) !=
+                inputs.end(), true);
+    EXPECT_EQ(std::find(inputs.begin(), inputs.end(), header) !=
+                inputs.end(), true);
+  }
+
+  // The second is a hit, and has the same declarations.
+  {
+    std::unique_ptr<ClangAST> ast = cachedParse(cache, source);
+    EXPECT_EQ(cache.m_hits, 1u);
+    EXPECT_EQ(hasFunction(*ast, "fromHeader"), true);
+    EXPECT_EQ(hasFunction(*ast, "fromSource"), true);
+  }
+
+  // Changing the header makes it a miss.
+  EXPECT_EQ(writeFile(header, "int fromChangedHeader();\n"), "");
+  ClangAST::clearSharedFileSystemCache();
+  {
+    std::unique_ptr<ClangAST> ast = cachedParse(cache, source);
+    EXPECT_EQ(cache.m_misses, 2u);
+    EXPECT_EQ(hasFunction(*ast, "fromChangedHeader"), true);
+  }
+
+  // Different options also make it a miss.
+  {
+    std::unique_ptr<ClangAST> ast(new ClangAST);
+    EXPECT_EQ(ast->parseCommandLine({source, "-DSOMETHING"}), true);
+    EXPECT_EQ(cache.parseSourceCode(*ast), true);
+    EXPECT_EQ(cache.m_misses, 3u);
+  }
+
+  // But then the changed header is found again.
+  {
+    std::unique_ptr<ClangAST> ast = cachedParse(cache, source);
+    EXPECT_EQ(cache.m_hits, 2u);
+    EXPECT_EQ(hasFunction(*ast, "fromChangedHeader"), true);
+  }
+}
+
+
+// Return what `processParsedTU` prints for 'ast' with 'options'.
+string processedOutput(ClangAST &ast, PCACommandLineOptions const &options)
+{
+  GlobalClangUtilInstance gcui(ast.getASTContext());
+  std::ostringstream oss;
+  EXPECT_EQ(processParsedTU(oss, options, ast), 0);
+  return oss.str();
+}
+
+
+// Check that a TU loaded from the cache prints the same as when it was
+// parsed, including template instantiations and implicit members, which
+// the loaded AST only has because they were serialized.
+void testProcessMissAndHit()
+{
+  string dir = "out/ast-cache-test";
+  llvm::sys::fs::remove_directories(dir);
+  llvm::sys::fs::create_directories(dir);
+
+  string source = dir + "/tmpl.cc";
+  EXPECT_EQ(writeFile(source,
+    "template <class T>\n"
+    "struct Box {\n"
+    "  T m_t;\n"
+    "  T get() const { return m_t; }\n"
+    "};\n"
+    "\n"
+    "struct S {\n"
+    "  Box<int> m_box;\n"
+    "};\n"
+    "\n"
+    "int f()\n"
+    "{\n"
+    "  S s1;\n"
+    "  S s2(s1);\n"
+    "  s2 = s1;\n"
+    "  return s2.m_box.get();\n"
+    "}\n"), "");
+  ClangAST::clearSharedFileSystemCache();
+
+  PCACommandLineOptions nodesOptions;
+  nodesOptions.m_printASTNodes = true;
+  nodesOptions.m_suppressAddresses = true;
+
+  PCACommandLineOptions visitorOptions;
+  visitorOptions.m_printerVisitor = true;
+
+  ASTCache cache(dir + "/cache");
+
+  string missNodes, missVisitor;
+  {
+    std::unique_ptr<ClangAST> ast = cachedParse(cache, source);
+    EXPECT_EQ(cache.m_misses, 1u);
+    missNodes = processedOutput(*ast, nodesOptions);
+    missVisitor = processedOutput(*ast, visitorOptions);
+  }
+
+  {
+    std::unique_ptr<ClangAST> ast = cachedParse(cache, source);
+    EXPECT_EQ(cache.m_hits, 1u);
+    EXPECT_EQ(processedOutput(*ast, nodesOptions), missNodes);
+    EXPECT_EQ(processedOutput(*ast, visitorOptions), missVisitor);
+  }
+
+  // Make sure the input exercised what it was meant to.
+  EXPECT_EQ(missNodes.find("ClassTemplateSpecializationDecl") !=
+              string::npos, true);
+  EXPECT_EQ(missNodes.find("CXXConstructorDecl") != string::npos, true);
+}
+
+
+// Set the modification time of 'fname' to an hour ago.
+void makeOld(string const &fname)
+{
+  int fd;
+  EXPECT_EQ((bool)llvm::sys::fs::openFileForWrite(fname, fd,
+                    llvm::sys::fs::CD_OpenExisting,
+                    llvm::sys::fs::OF_Append), false);
+
+  llvm::sys::TimePoint<> old =
+    std::chrono::system_clock::now() - std::chrono::hours(1);
+  EXPECT_EQ((bool)llvm::sys::fs::setLastAccessAndModificationTime(
+                    fd, old, old), false);
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+}
+
+
+void testInputStamps()
+{
+  string dir = "out/ast-cache-test";
+  llvm::sys::fs::create_directories(dir);
+  string fname = dir + "/stamped.h";
+  EXPECT_EQ(writeFile(fname, "int x;\n"), "");
+  ClangAST::clearSharedFileSystemCache();
+
+  ASTInputHashes inputs;
+  inputs.push_back({fname, sha1Hex("int x;\n")});
+
+  // A file modified just now is hashed, and its stamp is not trusted.
+  EXPECT_EQ(findChangedASTInputFile(inputs), "");
+  EXPECT_EQ(inputs[0].m_haveStamp, false);
+
+  // Once it has been left alone for a while, its stamp is recorded.
+  makeOld(fname);
+  ClangAST::clearSharedFileSystemCache();
+  EXPECT_EQ(findChangedASTInputFile(inputs), "");
+  EXPECT_EQ(inputs[0].m_haveStamp, true);
+
+  // After that, the contents are not read, as shown by a wrong hash
+  // going unnoticed.
+  inputs[0].m_hash = "wrong";
+  ClangAST::clearSharedFileSystemCache();
+  EXPECT_EQ(findChangedASTInputFile(inputs), "");
+
+  // A change of the same size still changes the stamp, so the file is
+  // hashed again.
+  inputs[0].m_hash = sha1Hex("int x;\n");
+  EXPECT_EQ(writeFile(fname, "int y;\n"), "");
+  ClangAST::clearSharedFileSystemCache();
+  EXPECT_EQ(findChangedASTInputFile(inputs), fname);
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void ast_cache_unit_tests()
+{
+  testSha1Hex();
+  testManifest();
+  testParseSourceCode();
+  testProcessMissAndHit();
+  testInputStamps();
+}
+
+
+// EOF
@@ -0,0 +1,380 @@
+// ast-cache.cc
+// Code for `ast-cache.h`.
+
+#include "ast-cache.h"                                     // this module
+
+#include "file-util.h"                                     // readFile
+
+#include "smbase/sm-trace.h"                               // INIT_TRACE
+#include "smbase/string-util.h"                            // doubleQuote
+#include "smbase/stringb.h"                                // stringb
+
+#include "clang/Basic/Version.h"                           // clang::getClangFullVersion
+
+#include "llvm/ADT/ArrayRef.h"                             // llvm::ArrayRef
+#include "llvm/ADT/SmallString.h"                          // llvm::SmallString
+#include "llvm/ADT/StringExtras.h"                         // llvm::toHex
+#include "llvm/Support/FileSystem.h"                       // llvm::sys::fs::{create_directories, createUniqueFile, current_path, rename}
+#include "llvm/Support/MemoryBuffer.h"                     // llvm::MemoryBuffer
+#include "llvm/Support/SHA1.h"                             // llvm::SHA1
+#include "llvm/Support/VirtualFileSystem.h"                // llvm::vfs::Status
+#include "llvm/Support/raw_ostream.h"                      // llvm::raw_fd_ostream
+
+#include <chrono>                                          // std::chrono::{seconds, system_clock}
+#include <cstdint>                                         // std::uint8_t
+#include <iostream>                                        // std::cerr
+#include <memory>                                          // std::unique_ptr
+#include <ostream>                                         // std::ostream
+#include <sstream>                                         // std::ostringstream
+#include <utility>                                         // std::{move, pair}
+
+using std::string;
+
+
+INIT_TRACE("ast-cache");
+
+
+// First line of a manifest file.
+static char const manifestHeader[] = "pca-ast-cache-manifest 1";
+
+
+// Remove the first line from 'text' and return it without its newline.
+static llvm::StringRef takeLine(llvm::StringRef /*INOUT*/ &text)
+{
+  std::pair<llvm::StringRef, llvm::StringRef> lineAndRest = text.split('\n');
+  text = lineAndRest.second;
+  return lineAndRest.first;
+}
+
+
+// Read 'fname' through the file system the parser uses, so in-memory
+// files are seen and files the parse read are not read again.  Return
+// false if it cannot be read.
+static bool readInputFile(string /*OUT*/ &contents, string const &fname)
+{
+  llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer =
+    ClangAST::getSharedFileSystem()->getBufferForFile(fname);
+  if (!buffer) {
+    return false;
+  }
+  contents = (*buffer)->getBuffer().str();
+  return true;
+}
+
+
+// Write 'contents' to a temporary file and rename it to 'fname', so a
+// concurrent reader sees either the old file or the new one.  Returns
+// "" or an error message.
+static string writeFileAtomically(string const &fname,
+                                  string const &contents)
+{
+  llvm::SmallString<256> tempName;
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(fname + "-%%%%%%%%", fd, tempName)) {
+    return stringb("cannot create a temporary file for " <<
+                   doubleQuote(fname));
+  }
+
+  bool ok;
+  {
+    llvm::raw_fd_ostream out(fd, true /*shouldClose*/);
+    out << contents;
+    out.close();
+    ok = !out.has_error();
+
+    // Otherwise the destructor treats the error as fatal.
+    out.clear_error();
+  }
+
+  if (!ok || llvm::sys::fs::rename(tempName, fname)) {
+    llvm::sys::fs::remove(tempName);
+    return stringb("error writing " << doubleQuote(fname));
+  }
+  return "";
+}
+
+
+std::string sha1Hex(llvm::StringRef data)
+{
+  auto digest = llvm::SHA1::hash(llvm::ArrayRef<std::uint8_t>(
+    reinterpret_cast<std::uint8_t const *>(data.data()), data.size()));
+  return llvm::toHex(digest, true /*lowerCase*/);
+}
+
+
+// Get the status of 'fname' through the shared file system.
+static llvm::ErrorOr<llvm::vfs::Status> getInputFileStatus(
+  string const &fname)
+{
+  return ClangAST::getSharedFileSystem()->status(fname);
+}
+
+
+// Set the stamp of 'input' from 'status', which the file had when it
+// had the contents 'input.m_hash' describes.
+static void setStamp(ASTInputFile &input, llvm::vfs::Status const &status)
+{
+  // A file modified very recently could be modified again without its
+  // size or (coarse-grained) modification time changing, so only trust
+  // the stamp of one that has been left alone for a while.
+  input.m_haveStamp =
+    status.getLastModificationTime() + std::chrono::seconds(2) <
+    std::chrono::system_clock::now();
+  input.m_size = status.getSize();
+  input.m_modificationTime = status.getLastModificationTime();
+}
+
+
+std::string hashASTInputFiles(
+  ASTInputHashes /*OUT*/ &inputs,
+  ClangAST const &ast)
+{
+  inputs.clear();
+  for (string const &fname : ast.getInputFileNames()) {
+    // Both come from the shared file system's cache, so normally they
+    // are what the parse saw.
+    llvm::ErrorOr<llvm::vfs::Status> status = getInputFileStatus(fname);
+    string contents;
+    if (!status || !readInputFile(contents, fname)) {
+      return stringb("cannot read " << doubleQuote(fname));
+    }
+
+    ASTInputFile input;
+    input.m_name = fname;
+    input.m_hash = sha1Hex(contents);
+    setStamp(input, *status);
+    inputs.push_back(std::move(input));
+  }
+  return "";
+}
+
+
+std::string findChangedASTInputFile(ASTInputHashes /*INOUT*/ &inputs)
+{
+  for (ASTInputFile &input : inputs) {
+    llvm::ErrorOr<llvm::vfs::Status> status =
+      getInputFileStatus(input.m_name);
+    if (!status) {
+      return input.m_name;
+    }
+    if (input.m_haveStamp &&
+        status->getSize() == input.m_size &&
+        status->getLastModificationTime() == input.m_modificationTime) {
+      continue;
+    }
+
+    string contents;
+    if (!readInputFile(contents, input.m_name) ||
+        sha1Hex(contents) != input.m_hash) {
+      return input.m_name;
+    }
+    setStamp(input, *status);
+  }
+  return "";
+}
+
+
+// -------------------------- ASTCacheManifest --------------------------
+void ASTCacheManifest::write(std::ostream &os) const
+{
+  os << manifestHeader << "\n";
+  os << "invocation " << m_invocationKey << "\n";
+  for (ASTInputFile const &input : m_inputs) {
+    os << "input " << input.m_hash << " " << input.m_name << "\n";
+  }
+}
+
+
+std::string ASTCacheManifest::toString() const
+{
+  std::ostringstream oss;
+  write(oss);
+  return oss.str();
+}
+
+
+std::string ASTCacheManifest::parse(
+  std::string const &fname,
+  llvm::StringRef text)
+{
+  m_invocationKey.clear();
+  m_inputs.clear();
+
+  if (takeLine(text) != manifestHeader) {
+    return stringb(doubleQuote(fname) << ": not an AST cache manifest");
+  }
+
+  llvm::StringRef line = takeLine(text);
+  if (!line.consume_front("invocation ") || line.empty()) {
+    return stringb(doubleQuote(fname) <<
+                   ":2: expected the invocation key");
+  }
+  m_invocationKey = line.str();
+
+  int lineNumber = 2;
+  while (!text.empty()) {
+    line = takeLine(text);
+    ++lineNumber;
+
+    // "input <hash> <name>", where the name runs to the end of the
+    // line and so can contain spaces.
+    std::pair<llvm::StringRef, llvm::StringRef> hashAndName;
+    if (line.consume_front("input ")) {
+      hashAndName = line.split(' ');
+    }
+    if (hashAndName.first.empty() || hashAndName.second.empty()) {
+      return stringb(doubleQuote(fname) << ":" << lineNumber <<
+                     ": malformed input line");
+    }
+
+    ASTInputFile input;
+    input.m_name = hashAndName.second.str();
+    input.m_hash = hashAndName.first.str();
+    m_inputs.push_back(std::move(input));
+  }
+
+  return "";
+}
+
+
+std::string ASTCacheManifest::astFileName() const
+{
+  return sha1Hex(toString()) + ".ast";
+}
+
+
+// ------------------------------ ASTCache ------------------------------
+ASTCache::ASTCache(std::string const &dir)
+  : m_dir(dir),
+    m_hits(0),
+    m_misses(0)
+{}
+
+
+/*static*/ std::string ASTCache::invocationKey(ClangAST const &ast)
+{
+  string primary;
+  if (!readInputFile(primary, ast.m_primarySourceFileName)) {
+    return "";
+  }
+
+  // Relative file names in the command line, and the files that the
+  // manifest lists, are interpreted relative to this.
+  llvm::SmallString<256> cwd;
+  llvm::sys::fs::current_path(cwd);
+
+  std::ostringstream oss;
+  oss << "clang " << clang::getClangFullVersion() << "\n";
+  oss << "cwd " << cwd.str().str() << "\n";
+  for (string const &arg : ast.getCC1CommandLine()) {
+    oss << "arg " << arg << "\n";
+  }
+  oss << "primary " << sha1Hex(primary) << "\n";
+
+  return sha1Hex(oss.str());
+}
+
+
+// If the manifest for 'key' in 'dir' exists and the inputs it lists are
+// unchanged, load the AST it describes into 'ast' and return true.
+static bool loadCachedAST(
+  ClangAST &ast,
+  string const &dir,
+  string const &key,
+  string const &manifestFname)
+{
+  string text;
+  if (!readFile(text, manifestFname).empty()) {
+    TRACE1("no manifest: " << manifestFname);
+    return false;
+  }
+
+  ASTCacheManifest manifest;
+  string err = manifest.parse(manifestFname, text);
+  if (!err.empty()) {
+    TRACE1(err);
+    return false;
+  }
+  if (manifest.m_invocationKey != key) {
+    TRACE1("manifest is for a different invocation: " << manifestFname);
+    return false;
+  }
+
+  string changed = findChangedASTInputFile(manifest.m_inputs);
+  if (!changed.empty()) {
+    TRACE1("input changed: " << changed);
+    return false;
+  }
+
+  string astFname = dir + "/" + manifest.astFileName();
+  if (!ast.loadASTFile(astFname)) {
+    TRACE1("cannot load " << astFname);
+    return false;
+  }
+
+  TRACE1("loaded " << astFname);
+  return true;
+}
+
+
+// Save the newly parsed 'ast' in 'dir', along with a manifest of its
+// inputs.  Returns "" or an error message.
+static string saveCachedAST(
+  ClangAST &ast,
+  string const &dir,
+  string const &key,
+  string const &manifestFname)
+{
+  ASTCacheManifest manifest;
+  manifest.m_invocationKey = key;
+  string err = hashASTInputFiles(manifest.m_inputs, ast);
+  if (!err.empty()) {
+    return err;
+  }
+
+  if (llvm::sys::fs::create_directories(dir)) {
+    return stringb("cannot create " << doubleQuote(dir));
+  }
+
+  // The AST goes first so that a manifest never names an AST file that
+  // has not been written.
+  string astFname = dir + "/" + manifest.astFileName();
+  if (!ast.saveASTFile(astFname)) {
+    return stringb("cannot write " << doubleQuote(astFname));
+  }
+  TRACE1("saved " << astFname);
+
+  return writeFileAtomically(manifestFname, manifest.toString());
+}
+
+
+bool ASTCache::parseSourceCode(ClangAST &ast)
+{
+  string key = invocationKey(ast);
+  if (key.empty()) {
+    // Let the parser report the problem with the primary source file.
+    ++m_misses;
+    return ast.parseSourceCode();
+  }
+  string manifestFname = m_dir + "/" + key + ".manifest";
+
+  if (loadCachedAST(ast, m_dir, key, manifestFname)) {
+    ++m_hits;
+    return true;
+  }
+
+  ++m_misses;
+  if (!ast.parseSourceCode()) {
+    return false;
+  }
+
+  string err = saveCachedAST(ast, m_dir, key, manifestFname);
+  if (!err.empty()) {
+    std::cerr << "warning: " << err << "\n";
+  }
+
+  return true;
+}
+
+
+// EOF
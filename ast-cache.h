@@ -0,0 +1,157 @@
+// ast-cache.h
+// `ASTCache`, an on-disk cache of serialized ASTs.
+
+#ifndef PCA_AST_CACHE_H
+#define PCA_AST_CACHE_H
+
+#include "clang-ast.h"                           // ClangAST
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+#include "llvm/Support/Chrono.h"                 // llvm::sys::TimePoint
+
+#include <cstdint>                               // std::uint64_t
+#include <iosfwd>                                // std::ostream
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+/*
+  The cache is a directory holding two kinds of files:
+
+    <invocation key>.manifest
+    <AST key>.ast
+
+  The invocation key is a hash of the Clang version, the current
+  directory, the normalized "-cc1" command line, and the contents of the
+  primary source file.  It can be computed before parsing.
+
+  The files a TU includes are only known after it has been parsed, so
+  the manifest for an invocation key lists them, along with a hash of
+  the contents each had when the AST was saved.  If they all still have
+  those contents, the AST file named by the hash of the manifest text
+  is loaded instead of parsing.
+
+  Thus, the AST files are content-addressed: a given name always refers
+  to an AST made from the same inputs, and files are only ever replaced
+  by equivalent ones, so concurrent writers (as with --batch-jobs) do
+  not interfere.  Stale files are not removed.
+
+  Only files the parse read are recorded, not the places it looked
+  without finding one.  So if a header is created in an include
+  directory searched before the one where the parse found that header,
+  the cached AST is still used, although a new parse would read the new
+  header.  Changing the primary source file, or removing the cache
+  directory, forces a new parse.
+*/
+
+
+// Return the SHA1 of 'data' as 40 lowercase hex digits.
+std::string sha1Hex(llvm::StringRef data);
+
+// What is recorded about one file read to make an AST.
+class ASTInputFile {
+public:      // data
+  // Name of the file.
+  std::string m_name;
+
+  // `sha1Hex` of its contents.
+  std::string m_hash;
+
+  // True if the file had 'm_size' and 'm_modificationTime' when it
+  // had the contents 'm_hash' describes, and was last modified long
+  // enough before that for a later change to alter one of them.  Then,
+  // while it still has both, its contents need not be hashed again.
+  // These are not saved in a manifest.
+  bool m_haveStamp = false;
+  std::uint64_t m_size = 0;
+  llvm::sys::TimePoint<> m_modificationTime;
+};
+
+// Each file read to make an AST.
+typedef std::vector<ASTInputFile> ASTInputHashes;
+
+// Set 'inputs' for the files read to make 'ast', which has been parsed.
+// The files are read through the shared file system, so unless its
+// cache has been cleared since, this yields what the parser saw.
+// Returns "" or an error message.
+std::string hashASTInputFiles(
+  ASTInputHashes /*OUT*/ &inputs,
+  ClangAST const &ast);
+
+// Return "" if every file in 'inputs' still has the recorded contents,
+// or else the name of the first one that does not.  A file whose size
+// and modification time match its stamp is taken to be unchanged
+// without reading it.  Stamps are added or updated for files whose
+// contents are found unchanged.
+std::string findChangedASTInputFile(ASTInputHashes /*INOUT*/ &inputs);
+
+
+// Contents of one "<invocation key>.manifest" file.
+class ASTCacheManifest {
+public:      // data
+  // Invocation key of the parse this describes.
+  std::string m_invocationKey;
+
+  // Each file read by the parse.
+  ASTInputHashes m_inputs;
+
+public:      // methods
+  // Write in the format read by `parse`.
+  void write(std::ostream &os) const;
+
+  // Same, as a string.
+  std::string toString() const;
+
+  // Replace the contents of this object with those of 'text', read from
+  // 'fname'.  Returns "" or an error message.
+  std::string parse(std::string const &fname, llvm::StringRef text);
+
+  // Name of the AST file, within the cache directory, that this
+  // manifest describes.
+  std::string astFileName() const;
+};
+
+
+// Parses TUs, saving the results in the cache directory and reusing
+// them when the inputs have not changed.
+class ASTCache {
+  NO_OBJECT_COPIES(ASTCache);
+
+public:      // data
+  // Directory holding the cache files.  It is created if needed.
+  std::string m_dir;
+
+  // Number of `parseSourceCode` calls that loaded an AST file, and that
+  // had to parse.
+  unsigned m_hits;
+  unsigned m_misses;
+
+public:      // methods
+  explicit ASTCache(std::string const &dir);
+
+  // Compute the invocation key for 'ast', on which `parseCommandLine`
+  // has been called.  Returns "" if the primary source file cannot be
+  // read.
+  static std::string invocationKey(ClangAST const &ast);
+
+  // Set the `m_ast` of 'ast', on which `parseCommandLine` has been
+  // called, either by loading a cached AST file or by calling
+  // `parseSourceCode` and then adding the result to the cache.
+  //
+  // Return true on success.  On failure, return false after printing
+  // error messages to stderr.  Failing to write the cache is reported
+  // but does not count as failure.
+  //
+  // On a cache hit, the warnings printed by the original parse are not
+  // printed again.
+  bool parseSourceCode(ClangAST &ast);
+};
+
+
+// Unit tests, defined in ast-cache-test.cc.
+void ast_cache_unit_tests();
+
+
+#endif // PCA_AST_CACHE_H
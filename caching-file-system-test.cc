@@ -0,0 +1,247 @@
+// caching-file-system-test.cc
+// Tests for `caching-file-system`.
+
+#include "caching-file-system.h"                 // module under test
+
+#include "file-util.h"                          // writeFile
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "llvm/Support/FileSystem.h"             // llvm::sys::fs::create_directories
+#include "llvm/Support/MemoryBuffer.h"           // llvm::MemoryBuffer
+#include "llvm/Support/VirtualFileSystem.h"      // llvm::vfs::{InMemoryFileSystem, OverlayFileSystem}
+
+#include <memory>                                // std::unique_ptr
+#include <string>                                // std::string
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Add 'contents' as 'fname' to 'fs'.
+void addFile(
+  llvm::vfs::InMemoryFileSystem &fs,
+  char const *fname,
+  char const *contents)
+{
+  fs.addFile(fname, 0 /*modificationTime*/,
+             llvm::MemoryBuffer::getMemBufferCopy(contents));
+}
+
+
+// Read all of 'fname' through 'fs'.
+string readContents(llvm::vfs::FileSystem &fs, char const *fname)
+{
+  auto file = fs.openFileForRead(fname);
+  EXPECT_EQ((bool)file, true);
+
+  auto buffer = (*file)->getBuffer(fname);
+  EXPECT_EQ((bool)buffer, true);
+
+  return (*buffer)->getBuffer().str();
+}
+
+
+void testStatus()
+{
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> mem(
+    new llvm::vfs::InMemoryFileSystem);
+  addFile(*mem, "/d/a.h", "A");
+
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> cfs(
+    new CachingFileSystem(mem));
+
+  EXPECT_EQ((bool)cfs->status("/d/a.h"), true);
+  EXPECT_EQ(cfs->getMisses(), 1u);
+  EXPECT_EQ(cfs->getHits(), 0u);
+
+  // The name in the status is the one requested.
+  auto st = cfs->status("/d/a.h");
+  EXPECT_EQ(st->getName().str(), "/d/a.h");
+  EXPECT_EQ(cfs->getHits(), 1u);
+
+  // Relative names share entries with the absolute ones.
+  EXPECT_EQ((bool)cfs->setCurrentWorkingDirectory("/d"), false);
+  st = cfs->status("a.h");
+  EXPECT_EQ((bool)st, true);
+  EXPECT_EQ(st->getName().str(), "a.h");
+  EXPECT_EQ(cfs->getHits(), 2u);
+
+  // Failures are remembered too.
+  EXPECT_EQ((bool)cfs->status("/d/b.h"), false);
+  addFile(*mem, "/d/b.h", "B");
+  EXPECT_EQ((bool)cfs->status("/d/b.h"), false);
+
+  // Until the cache is cleared.
+  cfs->clear();
+  EXPECT_EQ((bool)cfs->status("/d/b.h"), true);
+
+  // Clearing drops entries that only hold a status, such as the
+  // failures of include path searches.
+  EXPECT_EQ((bool)cfs->status("/d/none1.h"), false);
+  EXPECT_EQ((bool)cfs->status("/d/none2.h"), false);
+  EXPECT_EQ(cfs->getNumEntries(), 3u);
+  cfs->clear();
+  EXPECT_EQ(cfs->getNumEntries(), 0u);
+}
+
+
+void testContents()
+{
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> mem(
+    new llvm::vfs::InMemoryFileSystem);
+  addFile(*mem, "/d/a.h", "int a;\n");
+
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> cfs(
+    new CachingFileSystem(mem));
+
+  EXPECT_EQ(readContents(*cfs, "/d/a.h"), "int a;\n");
+  EXPECT_EQ(cfs->getMisses(), 1u);
+
+  EXPECT_EQ(readContents(*cfs, "/d/a.h"), "int a;\n");
+  EXPECT_EQ(cfs->getHits(), 1u);
+
+  // Both opens see the same memory.
+  auto f1 = cfs->openFileForRead("/d/a.h");
+  auto f2 = cfs->openFileForRead("/d/a.h");
+  auto b1 = (*f1)->getBuffer("x");
+  auto b2 = (*f2)->getBuffer("y");
+  EXPECT_EQ((*b1)->getBufferStart() == (*b2)->getBufferStart(), true);
+  EXPECT_EQ((*b1)->getBufferIdentifier().str(), "x");
+
+  // Having opened the file, its status is known.
+  unsigned misses = cfs->getMisses();
+  EXPECT_EQ(cfs->status("/d/a.h")->getSize(), (uint64_t)7);
+  EXPECT_EQ(cfs->getMisses(), misses);
+
+  // After clearing, an unchanged file reuses the same buffer.
+  cfs->clear();
+  auto f3 = cfs->openFileForRead("/d/a.h");
+  auto b3 = (*f3)->getBuffer("z");
+  EXPECT_EQ((*b1)->getBufferStart() == (*b3)->getBufferStart(), true);
+
+  // Missing files are reported as such.
+  EXPECT_EQ((bool)cfs->openFileForRead("/d/none.h"), false);
+}
+
+
+void testChangedContents()
+{
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> mem(
+    new llvm::vfs::InMemoryFileSystem);
+  addFile(*mem, "/d/a.h", "old");
+  llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> overlay(
+    new llvm::vfs::OverlayFileSystem(mem));
+
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> cfs(
+    new CachingFileSystem(overlay));
+
+  auto f1 = cfs->openFileForRead("/d/a.h");
+  auto b1 = (*f1)->getBuffer("a.h");
+
+  // Change the file by covering it with another.
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> mem2(
+    new llvm::vfs::InMemoryFileSystem);
+  addFile(*mem2, "/d/a.h", "new!");
+  overlay->pushOverlay(mem2);
+
+  // Without a `clear`, the cached contents are used.
+  EXPECT_EQ(readContents(*cfs, "/d/a.h"), "old");
+
+  cfs->clear();
+  EXPECT_EQ(readContents(*cfs, "/d/a.h"), "new!");
+
+  // Only the current contents count as cached.
+  EXPECT_EQ(cfs->getContentsSize(), (uint64_t)4);
+
+  // The buffer handed out earlier still has the old contents, even
+  // after the caching file system is gone.  ('InMemoryFileSystem'
+  // hands out views of its own storage, so 'mem' must stay.)
+  cfs = nullptr;
+  EXPECT_EQ((*b1)->getBuffer().str(), "old");
+  EXPECT_EQ((*b1)->getBufferIdentifier().str(), "a.h");
+}
+
+
+// Edit a real file in place while a buffer of its old contents is still
+// held.  The buffer must keep the old contents, which would not be the
+// case if it were a mapping of the file.
+void testEditedInPlace()
+{
+  string dir = "out/caching-file-system-test";
+  llvm::sys::fs::create_directories(dir);
+  string fname = dir + "/big.h";
+
+  // Large enough that LLVM would map it if allowed, and not a multiple
+  // of the page size, since the terminating NUL must follow the data.
+  string oldContents((1 << 16) + 1, 'a');
+  EXPECT_EQ(writeFile(fname, oldContents), "");
+
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> cfs(
+    new CachingFileSystem(llvm::vfs::getRealFileSystem()));
+  auto f = cfs->openFileForRead(fname);
+  auto b = (*f)->getBuffer(fname);
+
+  string newContents((1 << 16) + 1, 'b');
+  EXPECT_EQ(writeFile(fname, newContents), "");
+  EXPECT_EQ((*b)->getBuffer() == oldContents, true);
+
+  cfs->clear();
+  EXPECT_EQ(readContents(*cfs, fname.c_str()) == newContents, true);
+  EXPECT_EQ((*b)->getBuffer() == oldContents, true);
+}
+
+
+void testReleaseUnusedContents()
+{
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> mem(
+    new llvm::vfs::InMemoryFileSystem);
+  addFile(*mem, "/d/a.h", "int a;\n");
+  addFile(*mem, "/d/b.h", "int b;\n");
+
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> cfs(
+    new CachingFileSystem(mem));
+
+  {
+    auto f = cfs->openFileForRead("/d/a.h");
+    auto b = (*f)->getBuffer("a.h");
+    EXPECT_EQ(readContents(*cfs, "/d/b.h"), "int b;\n");
+    EXPECT_EQ(cfs->getContentsSize(), (uint64_t)14);
+
+    // 'b' still uses a.h, but nothing uses b.h.
+    cfs->releaseUnusedContents();
+    EXPECT_EQ(cfs->getContentsSize(), (uint64_t)7);
+    EXPECT_EQ((*b)->getBuffer().str(), "int a;\n");
+
+    // Released contents are read again when needed.
+    unsigned misses = cfs->getMisses();
+    EXPECT_EQ(readContents(*cfs, "/d/b.h"), "int b;\n");
+    EXPECT_EQ(cfs->getMisses(), misses + 1);
+    EXPECT_EQ(cfs->getContentsSize(), (uint64_t)14);
+  }
+
+  // Now nothing uses either.
+  cfs->releaseUnusedContents();
+  EXPECT_EQ(cfs->getContentsSize(), (uint64_t)0);
+  EXPECT_EQ(readContents(*cfs, "/d/a.h"), "int a;\n");
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void caching_file_system_unit_tests()
+{
+  testStatus();
+  testContents();
+  testChangedContents();
+  testEditedInPlace();
+  testReleaseUnusedContents();
+}
+
+
+// EOF
@@ -0,0 +1,246 @@
+// caching-file-system.cc
+// Code for `caching-file-system.h`.
+
+#include "caching-file-system.h"                 // this module
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+
+#include "llvm/ADT/SmallString.h"                // llvm::SmallString
+
+#include <memory>                                // std::{shared_ptr, unique_ptr}
+#include <string>                                // std::string
+#include <utility>                               // std::move
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// A view of a buffer held by a `CachingFileSystem` that keeps it alive
+// for as long as the view exists.
+class SharedBufferView : public llvm::MemoryBuffer {
+private:     // data
+  // The viewed buffer.
+  std::shared_ptr<llvm::MemoryBuffer const> m_shared;
+
+  // Name to report as the identifier.
+  std::string m_name;
+
+public:      // methods
+  SharedBufferView(std::shared_ptr<llvm::MemoryBuffer const> shared,
+                   std::string &&name,
+                   bool requiresNullTerminator)
+    : m_shared(std::move(shared)),
+      m_name(std::move(name))
+  {
+    init(m_shared->getBufferStart(), m_shared->getBufferEnd(),
+         requiresNullTerminator);
+  }
+
+  virtual llvm::StringRef getBufferIdentifier() const override
+  {
+    return m_name;
+  }
+
+  virtual BufferKind getBufferKind() const override
+  {
+    return m_shared->getBufferKind();
+  }
+};
+
+
+// A file whose status and contents are held by a `CachingFileSystem`.
+class CachedFile : public llvm::vfs::File {
+private:     // data
+  // Status, with the name under which the file was opened.
+  llvm::vfs::Status m_status;
+
+  // Contents, shared with the file system.
+  std::shared_ptr<llvm::MemoryBuffer const> m_contents;
+
+public:      // methods
+  CachedFile(llvm::vfs::Status const &status,
+             std::shared_ptr<llvm::MemoryBuffer const> const &contents)
+    : m_status(status),
+      m_contents(contents)
+  {}
+
+  virtual llvm::ErrorOr<llvm::vfs::Status> status() override
+  {
+    return m_status;
+  }
+
+  virtual llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> getBuffer(
+    llvm::Twine const &name,
+    int64_t fileSize,
+    bool requiresNullTerminator,
+    bool isVolatile) override
+  {
+    // Return a view of the cached buffer, which is always null
+    // terminated, rather than a copy.
+    return std::unique_ptr<llvm::MemoryBuffer>(new SharedBufferView(
+      m_contents, name.str(), requiresNullTerminator));
+  }
+
+  virtual std::error_code close() override
+  {
+    return std::error_code();
+  }
+};
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+CachingFileSystem::~CachingFileSystem()
+{}
+
+
+CachingFileSystem::CachingFileSystem(
+  llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> underlying)
+  : llvm::vfs::ProxyFileSystem(std::move(underlying)),
+    m_entries(),
+    m_contentsSize(0),
+    m_hits(0),
+    m_misses(0)
+{}
+
+
+void CachingFileSystem::clear()
+{
+  for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+    auto cur = it++;
+    Entry &entry = cur->second;
+    if (entry.m_contents) {
+      entry.m_haveStatus = false;
+      entry.m_contentsStale = true;
+    }
+    else {
+      // Only a status, which is now forgotten.  Most such entries are
+      // failed lookups along include paths, so keeping them would let
+      // the map grow for the life of the process.
+      m_entries.erase(cur);
+    }
+  }
+}
+
+
+void CachingFileSystem::releaseUnusedContents()
+{
+  for (auto &kv : m_entries) {
+    Entry &entry = kv.second;
+    if (entry.m_contents && entry.m_contents.use_count() == 1) {
+      m_contentsSize -= entry.m_contents->getBufferSize();
+      entry.m_contents.reset();
+      entry.m_contentsStale = false;
+    }
+  }
+}
+
+
+llvm::ErrorOr<std::string> CachingFileSystem::getKey(
+  llvm::Twine const &path) const
+{
+  llvm::SmallString<256> absPath;
+  path.toVector(absPath);
+
+  // This uses the underlying file system's working directory, so the
+  // same relative path names different entries after a directory
+  // change.
+  if (std::error_code ec = makeAbsolute(absPath)) {
+    return ec;
+  }
+  return absPath.str().str();
+}
+
+
+llvm::ErrorOr<llvm::vfs::Status> CachingFileSystem::status(
+  llvm::Twine const &path)
+{
+  llvm::ErrorOr<std::string> key = getKey(path);
+  if (!key) {
+    return ProxyFileSystem::status(path);
+  }
+
+  Entry &entry = m_entries[*key];
+  if (!entry.m_haveStatus) {
+    ++m_misses;
+    entry.m_status = ProxyFileSystem::status(*key);
+    entry.m_haveStatus = true;
+  }
+  else {
+    ++m_hits;
+  }
+
+  if (!entry.m_status) {
+    return entry.m_status.getError();
+  }
+  return llvm::vfs::Status::copyWithNewName(*entry.m_status, path);
+}
+
+
+llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>>
+CachingFileSystem::openFileForRead(llvm::Twine const &path)
+{
+  llvm::ErrorOr<std::string> key = getKey(path);
+  if (!key) {
+    return ProxyFileSystem::openFileForRead(path);
+  }
+
+  Entry &entry = m_entries[*key];
+  if (entry.m_contents && !entry.m_contentsStale) {
+    ++m_hits;
+  }
+  else {
+    ++m_misses;
+
+    llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> file =
+      ProxyFileSystem::openFileForRead(*key);
+    if (!file) {
+      // Do not remember this, since the failure could be transient
+      // (like running out of file descriptors).
+      return file.getError();
+    }
+
+    llvm::ErrorOr<llvm::vfs::Status> status = (*file)->status();
+    if (!status) {
+      return status.getError();
+    }
+
+    // Treat the file as volatile so its contents are copied rather
+    // than memory-mapped.  A mapping would change, or fault, if the file
+    // were edited or truncated in place, but the buffer is kept, and
+    // compared against after a `clear`, long after this.
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> contents =
+      (*file)->getBuffer(*key, status->getSize(),
+                         true /*requiresNullTerminator*/,
+                         true /*isVolatile*/);
+    if (!contents) {
+      return contents.getError();
+    }
+
+    entry.m_haveStatus = true;
+    entry.m_status = *status;
+
+    if (entry.m_contents &&
+        entry.m_contents->getBuffer() == (*contents)->getBuffer()) {
+      // Unchanged since before the `clear`; keep using the old buffer
+      // so that repeatedly clearing does not accumulate copies.
+    }
+    else {
+      // Any buffers handed out for the old contents keep them alive.
+      if (entry.m_contents) {
+        m_contentsSize -= entry.m_contents->getBufferSize();
+      }
+      entry.m_contents = std::move(*contents);
+      m_contentsSize += entry.m_contents->getBufferSize();
+    }
+    entry.m_contentsStale = false;
+  }
+
+  return std::unique_ptr<llvm::vfs::File>(new CachedFile(
+    llvm::vfs::Status::copyWithNewName(*entry.m_status, path),
+    entry.m_contents));
+}
+
+
+// EOF
@@ -0,0 +1,127 @@
+// caching-file-system.h
+// `CachingFileSystem`, a VFS layer that remembers what it has read.
+
+#ifndef PCA_CACHING_FILE_SYSTEM_H
+#define PCA_CACHING_FILE_SYSTEM_H
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"         // llvm::IntrusiveRefCntPtr
+#include "llvm/ADT/StringMap.h"                  // llvm::StringMap
+#include "llvm/Support/MemoryBuffer.h"           // llvm::MemoryBuffer
+#include "llvm/Support/VirtualFileSystem.h"      // llvm::vfs::{FileSystem, ProxyFileSystem, Status}
+
+#include <cstdint>                               // std::uint64_t
+#include <memory>                                // std::{shared_ptr, unique_ptr}
+#include <string>                                // std::string
+#include <system_error>                          // std::error_code
+
+
+/*
+  A file system that passes requests through to an underlying one, but
+  remembers the result of each 'status' query (including failures) and
+  the contents of each file opened, keyed by absolute path.  Later
+  requests for the same path are answered from memory.
+
+  The point is that when many TUs are parsed in one process, the same
+  headers are looked up along the same include paths and read again for
+  each TU.  Clang's `FileManager` caches these too, but only for the
+  life of one `ASTUnit`, whereas an instance of this class can be shared
+  by all of them.
+
+  The cache is never invalidated automatically, so changes made to the
+  underlying files after they are first read are not seen until
+  `clear` is called.  The buffers handed out share ownership of the
+  cached contents, so when a file changes, its old contents stay alive
+  only until the last AST parsed from them (more precisely, its
+  `SourceManager`) goes away, typically when the next re-parse
+  completes.  The current contents of a file stay cached even when no
+  AST uses them, until `releaseUnusedContents` is called.
+
+  This class is not thread-safe.
+*/
+class CachingFileSystem : public llvm::vfs::ProxyFileSystem {
+  NO_OBJECT_COPIES(CachingFileSystem);
+
+private:     // types
+  // What is known about one path.
+  struct Entry {
+    // True once 'm_status' has been set.
+    bool m_haveStatus;
+
+    // The result of 'status', or an error code if it failed.
+    llvm::ErrorOr<llvm::vfs::Status> m_status;
+
+    // The contents, or nullptr if the file has not been opened.  This
+    // is shared with the buffers returned by the files opened.
+    std::shared_ptr<llvm::MemoryBuffer const> m_contents;
+
+    // True if 'm_contents' was read before the last `clear`, and so
+    // must be checked against the file before being used again.
+    bool m_contentsStale;
+
+    Entry()
+      : m_haveStatus(false),
+        m_status(llvm::vfs::Status()),
+        m_contents(),
+        m_contentsStale(false)
+    {}
+  };
+
+private:     // data
+  // Map from absolute path to what we know about it.
+  llvm::StringMap<Entry> m_entries;
+
+  // Sum of the sizes of the 'm_contents' in 'm_entries'.
+  std::uint64_t m_contentsSize;
+
+  // Number of requests answered from, and added to, 'm_entries'.
+  unsigned m_hits;
+  unsigned m_misses;
+
+private:     // methods
+  // Get the key to use for 'path', or an error if it cannot be made
+  // absolute.
+  llvm::ErrorOr<std::string> getKey(llvm::Twine const &path) const;
+
+public:      // methods
+  ~CachingFileSystem();
+
+  explicit CachingFileSystem(
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> underlying);
+
+  // Forget the cached status of every file, and arrange for the
+  // cached contents to be checked against the file when next opened.
+  // If the contents have not changed, the existing buffer is reused.
+  // Entries holding only a status, including failed lookups, are
+  // removed.
+  void clear();
+
+  // Number of bytes of file contents held in the cache, whether or not
+  // any buffer handed out still uses them.
+  std::uint64_t getContentsSize() const { return m_contentsSize; }
+
+  // Forget the contents of every file that no buffer handed out still
+  // uses, so they are read again if the file is next opened.
+  void releaseUnusedContents();
+
+  // Number of paths about which something is cached.
+  unsigned getNumEntries() const { return m_entries.size(); }
+
+  // Number of requests answered from the cache, and not.
+  unsigned getHits() const { return m_hits; }
+  unsigned getMisses() const { return m_misses; }
+
+  // llvm::vfs::FileSystem methods.
+  virtual llvm::ErrorOr<llvm::vfs::Status> status(
+    llvm::Twine const &path) override;
+  virtual llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(
+    llvm::Twine const &path) override;
+};
+
+
+// Unit tests, defined in caching-file-system-test.cc.
+void caching_file_system_unit_tests();
+
+
+#endif // PCA_CACHING_FILE_SYSTEM_H
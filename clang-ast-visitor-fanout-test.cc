@@ -0,0 +1,76 @@
+// clang-ast-visitor-fanout-test.cc
+// Tests for `clang-ast-visitor-fanout`.
+
+#include "clang-ast-visitor-fanout.h"  // module under test
+
+#include "clang-ast.h"                 // ClangASTUtil
+#include "print-method-comments.h"     // printMethodComments, makeMethodCommentsSink
+#include "printer-visitor.h"           // PrinterVisitor, PrinterVisitorSink
+
+#include "smbase/sm-macros.h"          // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"            // EXPECT_EQ
+
+#include <memory>                      // std::unique_ptr
+#include <sstream>                     // std::ostringstream
+#include <string>                      // std::string
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Print 'fname' with `PrinterVisitor` using 'flags', and print its
+// method comments, first with a traversal for each and then with one
+// shared traversal, and check that the results are the same.
+void compareSharedTraversal(
+  char const *fname,
+  PrinterVisitor::Flags flags)
+{
+  ClangASTUtil ast({fname});
+  clang::ASTContext &astContext = ast.getASTContext();
+
+  std::ostringstream expectPrinted;
+  printerVisitorTU(expectPrinted, astContext, flags);
+
+  std::ostringstream expectComments;
+  printMethodComments(expectComments, astContext);
+
+  std::ostringstream actualPrinted;
+  std::ostringstream actualComments;
+  {
+    PrinterVisitorSink printerSink(actualPrinted, astContext);
+    printerSink.m_printer.m_flags = flags;
+
+    std::unique_ptr<ClangASTVisitorSink> pmcSink =
+      makeMethodCommentsSink(actualComments, astContext);
+
+    ClangASTVisitorFanOut fanOut;
+    fanOut.addSink(&printerSink);
+    fanOut.addSink(pmcSink.get());
+    fanOut.scanTU(astContext);
+  }
+
+  EXPECT_EQ(actualPrinted.str(), expectPrinted.str());
+  EXPECT_EQ(actualComments.str(), expectComments.str());
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void clang_ast_visitor_fanout_unit_tests()
+{
+  compareSharedTraversal("in/src/method-comments.cc",
+                         PrinterVisitor::F_NONE);
+  compareSharedTraversal("in/src/ct-cont-ft-inst.cc",
+                         PrinterVisitor::F_NONE);
+  compareSharedTraversal("in/src/ct-cont-ft-inst.cc",
+                         PrinterVisitor::F_ALL);
+  compareSharedTraversal("in/src/default-args.cc",
+                         PrinterVisitor::F_ALL);
+}
+
+
+// EOF
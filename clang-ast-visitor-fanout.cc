@@ -0,0 +1,170 @@
+// clang-ast-visitor-fanout.cc
+// Code for clang-ast-visitor-fanout.h.
+
+#include "clang-ast-visitor-fanout.h"            // this module
+
+#include "clang/AST/NestedNameSpecifier.h"       // clang::NestedNameSpecifierLoc
+#include "clang/AST/TemplateBase.h"              // clang::TemplateArgumentLoc
+#include "clang/AST/Type.h"                      // clang::QualType
+#include "clang/AST/TypeLoc.h"                   // clang::TypeLoc
+
+#include <cstddef>                               // std::size_t
+#include <vector>                                // std::vector
+
+
+// ------------------------- ClangASTVisitorSink --------------------------
+ClangASTVisitorSink::~ClangASTVisitorSink()
+{}
+
+
+void ClangASTVisitorSink::preVisitDecl(
+  VisitDeclContext, clang::Decl const *)
+{}
+
+void ClangASTVisitorSink::postVisitDecl(
+  VisitDeclContext, clang::Decl const *)
+{}
+
+
+void ClangASTVisitorSink::preVisitStmt(
+  VisitStmtContext, clang::Stmt const *)
+{}
+
+void ClangASTVisitorSink::postVisitStmt(
+  VisitStmtContext, clang::Stmt const *)
+{}
+
+
+void ClangASTVisitorSink::preVisitTypeLoc(
+  VisitTypeContext, clang::TypeLoc)
+{}
+
+void ClangASTVisitorSink::postVisitTypeLoc(
+  VisitTypeContext, clang::TypeLoc)
+{}
+
+
+void ClangASTVisitorSink::preVisitTemplateArgumentLoc(
+  VisitTemplateArgumentContext, clang::TemplateArgumentLoc)
+{}
+
+void ClangASTVisitorSink::postVisitTemplateArgumentLoc(
+  VisitTemplateArgumentContext, clang::TemplateArgumentLoc)
+{}
+
+
+void ClangASTVisitorSink::preVisitNestedNameSpecifierLoc(
+  VisitNestedNameSpecifierContext, clang::NestedNameSpecifierLoc)
+{}
+
+void ClangASTVisitorSink::postVisitNestedNameSpecifierLoc(
+  VisitNestedNameSpecifierContext, clang::NestedNameSpecifierLoc)
+{}
+
+
+void ClangASTVisitorSink::visitImplicitQualType(
+  VisitTypeContext, clang::QualType)
+{}
+
+
+bool ClangASTVisitorSink::wantCXXDefaultInitExprChildren(
+  clang::CXXDefaultInitExpr const *)
+{
+  return true;
+}
+
+
+// ------------------------ ClangASTVisitorFanOut -------------------------
+ClangASTVisitorFanOut::ClangASTVisitorFanOut()
+  : ClangASTVisitor(),
+    m_sinks()
+{}
+
+
+void ClangASTVisitorFanOut::addSink(ClangASTVisitorSink *sink)
+{
+  m_sinks.push_back(SinkEntry{sink, 0});
+}
+
+
+// Call 'method' on each listening sink, first to last.
+#define FAN_OUT_FORWARD(method, ...)                          \
+  for (SinkEntry &entry : m_sinks) {                          \
+    if (entry.m_mutedDepth == 0) {                            \
+      entry.m_sink->method(__VA_ARGS__);                      \
+    }                                                         \
+  }
+
+// Call 'method' on each listening sink, last to first.
+#define FAN_OUT_REVERSE(method, ...)                          \
+  for (auto it = m_sinks.rbegin(); it != m_sinks.rend(); ++it) { \
+    if (it->m_mutedDepth == 0) {                              \
+      it->m_sink->method(__VA_ARGS__);                        \
+    }                                                         \
+  }
+
+// Define the override of 'visit##Node' that surrounds the traversal of
+// the children with the pre- and post-visit callbacks.
+#define FAN_OUT_CORE_VISITOR(Node, ContextType, NodeType, node) \
+  void ClangASTVisitorFanOut::visit##Node(                    \
+    ContextType context,                                      \
+    NodeType node)                                            \
+  {                                                           \
+    FAN_OUT_FORWARD(preVisit##Node, context, node);           \
+    ClangASTVisitor::visit##Node(context, node);              \
+    FAN_OUT_REVERSE(postVisit##Node, context, node);          \
+  }
+
+FAN_OUT_CORE_VISITOR(Decl, VisitDeclContext,
+                     clang::Decl const *, decl)
+FAN_OUT_CORE_VISITOR(Stmt, VisitStmtContext,
+                     clang::Stmt const *, stmt)
+FAN_OUT_CORE_VISITOR(TypeLoc, VisitTypeContext,
+                     clang::TypeLoc, typeLoc)
+FAN_OUT_CORE_VISITOR(TemplateArgumentLoc, VisitTemplateArgumentContext,
+                     clang::TemplateArgumentLoc, tal)
+FAN_OUT_CORE_VISITOR(NestedNameSpecifierLoc, VisitNestedNameSpecifierContext,
+                     clang::NestedNameSpecifierLoc, nnsl)
+
+#undef FAN_OUT_CORE_VISITOR
+
+
+void ClangASTVisitorFanOut::visitCXXDefaultInitExpr(
+  clang::CXXDefaultInitExpr const *cdie)
+{
+  // Mute the sinks that do not want the children.  This is balanced
+  // below, so a sink's muted state is the same before and after any
+  // node, and it gets either both callbacks for a node or neither.
+  std::vector<bool> muted(m_sinks.size(), false);
+  for (std::size_t i=0; i < m_sinks.size(); ++i) {
+    SinkEntry &entry = m_sinks[i];
+    if (entry.m_mutedDepth == 0 &&
+        !entry.m_sink->wantCXXDefaultInitExprChildren(cdie)) {
+      muted[i] = true;
+      ++entry.m_mutedDepth;
+    }
+  }
+
+  ClangASTVisitor::visitCXXDefaultInitExpr(cdie);
+
+  for (std::size_t i=0; i < m_sinks.size(); ++i) {
+    if (muted[i]) {
+      --m_sinks[i].m_mutedDepth;
+    }
+  }
+}
+
+
+void ClangASTVisitorFanOut::visitImplicitQualType(
+  VisitTypeContext context,
+  clang::QualType qualType)
+{
+  FAN_OUT_FORWARD(visitImplicitQualType, context, qualType);
+}
+
+
+#undef FAN_OUT_FORWARD
+#undef FAN_OUT_REVERSE
+
+
+// EOF
@@ -0,0 +1,136 @@
+// clang-ast-visitor-fanout.h
+// `ClangASTVisitorFanOut`, which makes one traversal and reports each
+// node to several `ClangASTVisitorSink`s.
+
+#ifndef CLANG_AST_VISITOR_FANOUT_H
+#define CLANG_AST_VISITOR_FANOUT_H
+
+#include "clang-ast-visitor.h"                   // ClangASTVisitor
+#include "clang-nested-name-specifier-fwd.h"     // clang::NestedNameSpecifierLoc [n]
+#include "clang-template-base-fwd.h"             // clang::TemplateArgumentLoc [n]
+#include "clang-type-fwd.h"                      // clang::QualType [n]
+#include "clang-type-loc-fwd.h"                  // clang::TypeLoc [n]
+
+#include "clang/AST/ASTFwd.h"                    // clang::{Decl, Stmt, CXXDefaultInitExpr} [n]
+
+#include <vector>                                // std::vector
+
+
+// Receiver of the nodes found by a `ClangASTVisitorFanOut`.
+//
+// Where a `ClangASTVisitor` subclass does something and then calls the
+// base class method to visit the children, a sink does the first part
+// in `preVisitXXX` and anything it does after the children in
+// `postVisitXXX`.  A sink cannot change the traversal, only see it.
+//
+// The default implementations do nothing.
+class ClangASTVisitorSink {
+public:      // methods
+  virtual ~ClangASTVisitorSink();
+
+  // Core nodes, before and after their children.
+  virtual void preVisitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl);
+  virtual void postVisitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl);
+
+  virtual void preVisitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt);
+  virtual void postVisitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt);
+
+  virtual void preVisitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc);
+  virtual void postVisitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc);
+
+  virtual void preVisitTemplateArgumentLoc(
+    VisitTemplateArgumentContext context,
+    clang::TemplateArgumentLoc tal);
+  virtual void postVisitTemplateArgumentLoc(
+    VisitTemplateArgumentContext context,
+    clang::TemplateArgumentLoc tal);
+
+  virtual void preVisitNestedNameSpecifierLoc(
+    VisitNestedNameSpecifierContext context,
+    clang::NestedNameSpecifierLoc nnsl);
+  virtual void postVisitNestedNameSpecifierLoc(
+    VisitNestedNameSpecifierContext context,
+    clang::NestedNameSpecifierLoc nnsl);
+
+  // Leaf nodes.
+  virtual void visitImplicitQualType(
+    VisitTypeContext context,
+    clang::QualType qualType);
+
+  // Return false to not be told about the nodes inside 'cdie', which
+  // corresponds to a `ClangASTVisitor` that overrides
+  // `visitCXXDefaultInitExpr` to do nothing.  The default returns true.
+  virtual bool wantCXXDefaultInitExprChildren(
+    clang::CXXDefaultInitExpr const *cdie);
+};
+
+
+// Visitor that traverses the AST once on behalf of several sinks.
+//
+// This lets several analyses that would each make their own full
+// traversal share one instead.  The sinks see the nodes in the same
+// order that the equivalent `ClangASTVisitor` would, and each sink's
+// callbacks for a node happen in the order the sinks were added (and
+// in reverse for the `postVisitXXX` callbacks).
+//
+// The traversal visits everything, so a sink that would have narrowed
+// `m_visitInterest` must ignore the parts it does not need itself.
+class ClangASTVisitorFanOut : public ClangASTVisitor {
+private:     // types
+  // A sink and whether it is currently listening.
+  struct SinkEntry {
+    // The sink.  Not owned.
+    ClangASTVisitorSink *m_sink;
+
+    // Number of enclosing `CXXDefaultInitExpr`s whose children the
+    // sink declined.  Only a sink with a count of 0 gets callbacks.
+    int m_mutedDepth;
+  };
+
+private:     // data
+  // Sinks, in the order added.
+  std::vector<SinkEntry> m_sinks;
+
+public:      // methods
+  ClangASTVisitorFanOut();
+
+  // Add 'sink', which must outlive the traversal.
+  void addSink(ClangASTVisitorSink *sink);
+
+  // ClangASTVisitor methods.
+  virtual void visitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl) override;
+  virtual void visitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt) override;
+  virtual void visitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc) override;
+  virtual void visitTemplateArgumentLoc(
+    VisitTemplateArgumentContext context,
+    clang::TemplateArgumentLoc tal) override;
+  virtual void visitNestedNameSpecifierLoc(
+    VisitNestedNameSpecifierContext context,
+    clang::NestedNameSpecifierLoc nnsl) override;
+  virtual void visitCXXDefaultInitExpr(
+    clang::CXXDefaultInitExpr const *cdie) override;
+  virtual void visitImplicitQualType(
+    VisitTypeContext context,
+    clang::QualType qualType) override;
+};
+
+
+#endif // CLANG_AST_VISITOR_FANOUT_H
@@ -0,0 +1,117 @@
+// clang-ast-visitor-parallel-test.cc
+// Tests for `clang-ast-visitor-parallel` module.
+
+#include "clang-ast-visitor-parallel.h"          // module under test
+
+#include "clang-ast.h"                           // ClangASTUtil, ClangASTUtilTempFile
+#include "printer-visitor.h"                     // printerVisitorTU
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "clang/AST/Decl.h"                      // clang::NamedDecl
+
+#include <sstream>                               // std::ostringstream
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+using clang::dyn_cast;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Return the names of the named declarations among 'units', separated
+// by spaces.
+std::string unitNames(std::vector<ScanTUUnit> const &units)
+{
+  std::ostringstream oss;
+  for (ScanTUUnit const &unit : units) {
+    if (auto nd = dyn_cast<clang::NamedDecl>(unit.m_decl)) {
+      oss << nd->getQualifiedNameAsString() << " ";
+    }
+  }
+  return oss.str();
+}
+
+
+void testGetScanTUUnits()
+{
+  ClangASTUtilTempFile ast(R"(
+    int a;
+    namespace Small {
+      int b;
+    }
+    namespace Big {
+      int c;
+      int d;
+      auto lambda = []() {};
+    }
+    int e;
+  )");
+
+  // Skip the implicit declarations at the start.
+  auto named = [](std::vector<ScanTUUnit> const &units) {
+    std::string names = " " + unitNames(units);
+    return names.substr(names.find(" a ") + 1);
+  };
+
+  EXPECT_EQ(named(getScanTUUnits(ast.getASTContext())),
+    "a Small Big e ");
+
+  // The lambda's class is skipped, like in a serial traversal.
+  std::vector<ScanTUUnit> units = getScanTUUnits(ast.getASTContext(), 3);
+  EXPECT_EQ(named(units),
+    "a Small Big::c Big::d Big::lambda e ");
+  EXPECT_EQ(units.back().m_context, VDC_TRANSLATION_UNIT_DECL);
+  EXPECT_EQ(units[units.size()-2].m_context, VDC_NAMESPACE_DECL);
+}
+
+
+void testMergeOrder()
+{
+  ClangASTUtil ast({"in/src/ct-cont-ft-inst.cc"});
+
+  std::string serial = unitNames(getScanTUUnits(ast.getASTContext()));
+
+  for (int jobs : {1, 2, 3, 100}) {
+    std::string merged;
+    scanTUParallel(ast.getASTContext(), jobs,
+      unitNames,
+      [&merged](std::string const &result) {
+        merged += result;
+      });
+    EXPECT_EQ(merged, serial);
+  }
+}
+
+
+void testPrinterVisitor()
+{
+  ClangASTUtil ast({"in/src/ct-cont-ft-inst.cc"});
+
+  std::ostringstream serial;
+  printerVisitorTU(serial, ast.getASTContext(),
+                   PrinterVisitor::F_PRINT_VISIT_CONTEXT);
+
+  std::ostringstream parallel;
+  printerVisitorTU(parallel, ast.getASTContext(),
+                   PrinterVisitor::F_PRINT_VISIT_CONTEXT, 3 /*jobs*/);
+
+  EXPECT_EQ(parallel.str(), serial.str());
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void clang_ast_visitor_parallel_unit_tests()
+{
+  testGetScanTUUnits();
+  testMergeOrder();
+  testPrinterVisitor();
+}
+
+
+// EOF
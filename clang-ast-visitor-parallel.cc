@@ -0,0 +1,231 @@
+// clang-ast-visitor-parallel.cc
+// Code for clang-ast-visitor-parallel.h.
+
+#include "clang-ast-visitor-parallel.h"          // this module
+
+#include "pca-util.h"                            // PCA_HAVE_FORK, writeAllToFD, readAllFromFD
+
+#include "smbase/exc.h"                          // smbase::xmessage
+#include "smbase/sm-trace.h"                     // INIT_TRACE
+#include "smbase/stringb.h"                      // stringb
+
+#include "clang/AST/ASTContext.h"                // clang::ASTContext
+#include "clang/AST/Decl.h"                      // clang::{TranslationUnitDecl, NamespaceDecl}
+#include "clang/AST/DeclCXX.h"                   // clang::CXXRecordDecl
+#include "clang/Basic/SourceManager.h"           // clang::SourceManager
+
+#include <algorithm>                             // std::{min, max}
+#include <exception>                             // std::exception
+#include <iostream>                              // std::cerr
+#include <iterator>                              // std::distance
+
+#if PCA_HAVE_FORK
+  #include <sys/wait.h>                          // waitpid
+  #include <unistd.h>                            // fork, pipe, close, _exit
+#endif
+
+using clang::dyn_cast;
+
+
+INIT_TRACE("clang-ast-visitor-parallel");
+
+
+// Append to 'units' the members of 'dc', visited in 'context'.
+static void addScanTUUnits(
+  std::vector<ScanTUUnit> &units,
+  VisitDeclContext context,
+  clang::DeclContext const *dc,
+  std::size_t splitNamespaceMinDecls)
+{
+  for (clang::Decl const *decl : dc->decls()) {
+    if (auto crd = dyn_cast<clang::CXXRecordDecl>(decl)) {
+      if (crd->isLambda()) {
+        // Skipped, as in `visitNonFunctionDeclContext`.
+        continue;
+      }
+    }
+
+    if (auto nsd = dyn_cast<clang::NamespaceDecl>(decl)) {
+      if (splitNamespaceMinDecls != 0 &&
+          (std::size_t)std::distance(nsd->decls_begin(), nsd->decls_end())
+            >= splitNamespaceMinDecls) {
+        addScanTUUnits(units, VDC_NAMESPACE_DECL, nsd,
+                       splitNamespaceMinDecls);
+        continue;
+      }
+    }
+
+    units.push_back(ScanTUUnit{context, decl});
+  }
+}
+
+
+std::vector<ScanTUUnit> getScanTUUnits(
+  clang::ASTContext &astContext,
+  std::size_t splitNamespaceMinDecls)
+{
+  std::vector<ScanTUUnit> units;
+  addScanTUUnits(units, VDC_TRANSLATION_UNIT_DECL,
+                 astContext.getTranslationUnitDecl(),
+                 splitNamespaceMinDecls);
+  return units;
+}
+
+
+#if PCA_HAVE_FORK
+// Estimate the cost of visiting 'decl' as the number of characters in
+// its source range, or 1 if that cannot be determined.
+static std::size_t unitCost(
+  clang::SourceManager const &srcMgr,
+  clang::Decl const *decl)
+{
+  clang::SourceRange range = decl->getSourceRange();
+  if (range.isValid()) {
+    auto begin = srcMgr.getDecomposedExpansionLoc(range.getBegin());
+    auto end = srcMgr.getDecomposedExpansionLoc(range.getEnd());
+    if (begin.first == end.first && begin.second <= end.second) {
+      return 1 + (end.second - begin.second);
+    }
+  }
+  return 1;
+}
+
+
+// Divide 'units' into at most 'maxPartitions' contiguous, non-empty
+// partitions of roughly equal cost.
+static std::vector<std::vector<ScanTUUnit>> partitionScanTUUnits(
+  clang::SourceManager const &srcMgr,
+  std::vector<ScanTUUnit> const &units,
+  std::size_t maxPartitions)
+{
+  std::vector<std::size_t> costs;
+  std::size_t totalCost = 0;
+  for (ScanTUUnit const &unit : units) {
+    costs.push_back(unitCost(srcMgr, unit.m_decl));
+    totalCost += costs.back();
+  }
+
+  std::size_t const numPartitions =
+    std::max<std::size_t>(1, std::min(maxPartitions, units.size()));
+
+  std::vector<std::vector<ScanTUUnit>> partitions(1);
+  std::size_t cost = 0;
+  for (std::size_t i=0; i < units.size(); ++i) {
+    partitions.back().push_back(units[i]);
+    cost += costs[i];
+
+    // Start a new partition once this one has its share.
+    if (partitions.size() < numPartitions &&
+        i+1 < units.size() &&
+        cost * numPartitions >= totalCost * partitions.size()) {
+      partitions.emplace_back();
+    }
+  }
+
+  return partitions;
+}
+#endif // PCA_HAVE_FORK
+
+
+void scanTUParallel(
+  clang::ASTContext &astContext,
+  int jobs,
+  std::function<std::string (std::vector<ScanTUUnit> const &units)>
+    scanPartition,
+  std::function<void (std::string const &result)> mergePartition,
+  std::size_t splitNamespaceMinDecls)
+{
+  std::vector<ScanTUUnit> units =
+    getScanTUUnits(astContext, splitNamespaceMinDecls);
+
+  if (jobs < 2 || !PCA_HAVE_FORK) {
+    mergePartition(scanPartition(units));
+    return;
+  }
+
+#if PCA_HAVE_FORK
+  std::vector<std::vector<ScanTUUnit>> partitions =
+    partitionScanTUUnits(astContext.getSourceManager(), units, jobs);
+  TRACE1("scanTUParallel: units=" << units.size() <<
+         " partitions=" << partitions.size());
+
+  // Worker process for each partition, or -1 if it could not be
+  // started, and the read end of the pipe carrying its result.
+  struct Worker {
+    pid_t m_pid;
+    int m_readFD;
+  };
+
+  // Start the workers.
+  std::vector<Worker> workers;
+  for (std::vector<ScanTUUnit> const &partition : partitions) {
+    Worker worker{-1, -1};
+
+    int fds[2];
+    if (::pipe(fds) == 0) {
+      worker.m_pid = ::fork();
+      if (worker.m_pid == 0) {
+        // Worker.
+        ::close(fds[0]);
+        bool ok = false;
+        try {
+          std::string result = scanPartition(partition);
+          ok = writeAllToFD(fds[1], result.data(), result.size());
+        }
+        catch (std::exception &x) {
+          std::cerr << x.what() << "\n";
+        }
+        ::_exit(ok? 0 : 1);
+      }
+
+      ::close(fds[1]);
+      if (worker.m_pid > 0) {
+        worker.m_readFD = fds[0];
+      }
+      else {
+        ::close(fds[0]);
+      }
+    }
+
+    if (worker.m_pid < 0) {
+      TRACE1("could not start worker, will scan serially");
+    }
+    workers.push_back(worker);
+  }
+
+  // Merge the results in partition order.
+  std::string errors;
+  for (std::size_t i=0; i < partitions.size(); ++i) {
+    Worker const &worker = workers[i];
+    if (worker.m_pid < 0) {
+      mergePartition(scanPartition(partitions[i]));
+      continue;
+    }
+
+    std::string result;
+    bool ok = readAllFromFD(result, worker.m_readFD);
+    ::close(worker.m_readFD);
+
+    int status = 0;
+    if (::waitpid(worker.m_pid, &status, 0) != worker.m_pid ||
+        !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      ok = false;
+    }
+
+    if (ok) {
+      mergePartition(result);
+    }
+    else {
+      errors += stringb("worker " << worker.m_pid << " failed; ");
+    }
+  }
+
+  if (!errors.empty()) {
+    smbase::xmessage(stringb("scanTUParallel: " << errors));
+  }
+#endif // PCA_HAVE_FORK
+}
+
+
+// EOF
@@ -0,0 +1,82 @@
+// clang-ast-visitor-parallel.h
+// scanTUParallel, visiting the top-level declarations of a TU in
+// parallel.
+
+#ifndef CLANG_AST_VISITOR_PARALLEL_H
+#define CLANG_AST_VISITOR_PARALLEL_H
+
+#include "clang-ast-visitor.h"                   // VisitDeclContext
+
+#include "clang/AST/ASTContext.h"                // clang::ASTContext [n]
+#include "clang/AST/ASTFwd.h"                    // clang::Decl [n]
+
+#include <cstddef>                               // std::size_t
+#include <functional>                            // std::function
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+// One unit of work for `scanTUParallel`: a declaration, and the context
+// in which a full traversal would have visited it.
+struct ScanTUUnit {
+  VisitDeclContext m_context;
+  clang::Decl const *m_decl;
+};
+
+
+// Return the units that together make up the TU in 'astContext', in
+// traversal order.  These are the declarations that `scanTU` visits as
+// children of the TranslationUnitDecl.
+//
+// If 'splitNamespaceMinDecls' is not zero, then a namespace at the top
+// level with at least that many members is replaced by its members
+// (recursively), so that one large namespace can be spread across
+// workers.  The NamespaceDecl itself is then not among the units.
+std::vector<ScanTUUnit> getScanTUUnits(
+  clang::ASTContext &astContext,
+  std::size_t splitNamespaceMinDecls = 0);
+
+
+// Call `visitDecl` for each of 'units' on 'visitor'.
+template <class Visitor>
+void visitScanTUUnits(
+  Visitor &visitor,
+  std::vector<ScanTUUnit> const &units)
+{
+  for (ScanTUUnit const &unit : units) {
+    visitor.visitDecl(unit.m_context, unit.m_decl);
+  }
+}
+
+
+// Visit the TU in 'astContext' using up to 'jobs' workers.
+//
+// The units from `getScanTUUnits` are divided into contiguous
+// partitions of roughly equal source size.  For each partition,
+// 'scanPartition' is called with its units, and is expected to create
+// its own visitor, visit them (e.g., with `visitScanTUUnits`), and
+// return the results encoded as a string.  Then 'mergePartition' is
+// called with each of those strings, in partition order, which is the
+// order a serial traversal would produce them.
+//
+// The workers are forked processes, not threads, for the same reason
+// as in `printClangASTNodes`: Clang updates some caches without
+// synchronization even when the AST is only being read.  Consequently,
+// 'scanPartition' cannot communicate with the caller except through
+// its return value.  A worker exits with `_exit`, so output buffered in
+// the parent is not written twice.
+//
+// If 'jobs' is less than 2, or the platform lacks `fork`, or a worker
+// cannot be started, the affected partitions are scanned serially in
+// the calling process, with the same result.  Throws `XMessage` if a
+// worker fails.
+void scanTUParallel(
+  clang::ASTContext &astContext,
+  int jobs,
+  std::function<std::string (std::vector<ScanTUUnit> const &units)>
+    scanPartition,
+  std::function<void (std::string const &result)> mergePartition,
+  std::size_t splitNamespaceMinDecls = 0);
+
+
+#endif // CLANG_AST_VISITOR_PARALLEL_H
@@ -0,0 +1,243 @@
+// clang-ast-visitor-t-test.cc
+// Tests for `ClangASTVisitorT`, the static-dispatch flavor of
+// `ClangASTVisitor`.
+
+#include "clang-ast-visitor.h"         // module under test
+#include "clang-ast-visitor-impl.h"    // ClangASTVisitorT method definitions
+
+#include "clang-ast.h"                 // ClangASTUtil, ClangASTUtilTempFile
+#include "clang-util.h"                // getRunOnFreshStackCount
+
+// Must come before sm-test.h.
+#include "smbase/vector-util.h"        // operator<<(std::vector)
+
+#include "smbase/sm-macros.h"          // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"            // EXPECT_EQ
+
+#include "clang/AST/Decl.h"            // clang::ParmVarDecl
+#include "clang/AST/TypeLoc.h"         // clang::TypeLoc
+#include "clang/Basic/Stack.h"         // clang::isStackNearlyExhausted
+
+#include "llvm/ADT/STLFunctionalExtras.h"  // llvm::function_ref
+
+#include <set>                         // std::set
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Record the nodes visited by `ClangASTVisitor`.
+class RecordVisitedNodesVirtual : public ClangASTVisitor {
+public:      // data
+  // Every visited Decl, Stmt, and TypeLoc, in order.
+  std::vector<void const *> m_nodes;
+
+public:
+  // ClangASTVisitor methods.
+  virtual void visitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl) override
+  {
+    m_nodes.push_back(decl);
+    ClangASTVisitor::visitDecl(context, decl);
+  }
+
+  virtual void visitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt) override
+  {
+    m_nodes.push_back(stmt);
+    ClangASTVisitor::visitStmt(context, stmt);
+  }
+
+  virtual void visitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc) override
+  {
+    m_nodes.push_back(typeLoc.getOpaqueData());
+    ClangASTVisitor::visitTypeLoc(context, typeLoc);
+  }
+};
+
+
+// Record the same nodes using `ClangASTVisitorT`.
+class RecordVisitedNodesStatic
+  : public ClangASTVisitorT<RecordVisitedNodesStatic> {
+public:      // data
+  // Every visited Decl, Stmt, and TypeLoc, in order.
+  std::vector<void const *> m_nodes;
+
+  // The visited parameters.
+  std::set<clang::Decl const *> m_params;
+
+  // Number of visited Stmts and TypeLocs.
+  int m_numStmts = 0;
+  int m_numTypeLocs = 0;
+
+public:
+  // ClangASTVisitorT methods.
+  void visitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl)
+  {
+    m_nodes.push_back(decl);
+    if (clang::isa<clang::ParmVarDecl>(decl)) {
+      m_params.insert(decl);
+    }
+    ClangASTVisitorT::visitDecl(context, decl);
+  }
+
+  void visitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt)
+  {
+    m_nodes.push_back(stmt);
+    ++m_numStmts;
+    ClangASTVisitorT::visitStmt(context, stmt);
+  }
+
+  void visitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc)
+  {
+    m_nodes.push_back(typeLoc.getOpaqueData());
+    ++m_numTypeLocs;
+    ClangASTVisitorT::visitTypeLoc(context, typeLoc);
+  }
+};
+
+
+void compareToVirtual()
+{
+  // Just some file to test with.
+  ClangASTUtil ast({"in/src/ct-cont-ft-inst.cc"});
+
+  RecordVisitedNodesVirtual visitorV;
+  RecordVisitedNodesStatic visitorS;
+  visitorV.scanTU(ast.getASTContext());
+  visitorS.scanTU(ast.getASTContext());
+
+  // The traversal is the same, so they should agree.
+  EXPECT_EQ(visitorS.m_nodes, visitorV.m_nodes);
+}
+
+
+// Check that clearing flags in `m_visitInterest` skips those parts.
+void testVisitInterest()
+{
+  ClangASTUtilTempFile ast(R"(
+    int g = 1;
+    struct S {
+      int m : 3;
+      S(int x) : m(x) {}
+      int f(int a, int b = 2) { return a + b; }
+    };
+    template <class T>
+    T id(T t) { return t; }
+    int h() { return id(4); }
+  )");
+
+  RecordVisitedNodesStatic all;
+  all.scanTU(ast.getASTContext());
+  EXPECT_EQ(all.m_numStmts > 0, true);
+  EXPECT_EQ(all.m_numTypeLocs > 0, true);
+
+  // Declarations only.
+  RecordVisitedNodesStatic declsOnly;
+  declsOnly.m_visitInterest = VI_TEMPLATE_INSTANTIATIONS;
+  declsOnly.scanTU(ast.getASTContext());
+  EXPECT_EQ(declsOnly.m_numStmts, 0);
+  EXPECT_EQ(declsOnly.m_numTypeLocs, 0);
+
+  // The parameters are still visited, just not via their TypeLocs.
+  EXPECT_EQ(declsOnly.m_params == all.m_params, true);
+
+  // Without instantiations, the parameter of `id<int>` is missing.
+  RecordVisitedNodesStatic noInst;
+  noInst.m_visitInterest = VI_ALL & ~VI_TEMPLATE_INSTANTIATIONS;
+  noInst.scanTU(ast.getASTContext());
+  EXPECT_EQ(noInst.m_params.size() + 1, all.m_params.size());
+
+  // Bodies but not declaration expressions.  The default argument is
+  // gone, but the body statements remain.
+  RecordVisitedNodesStatic noDeclExprs;
+  noDeclExprs.m_visitInterest = VI_ALL & ~VI_DECL_EXPRS;
+  noDeclExprs.scanTU(ast.getASTContext());
+  EXPECT_EQ(noDeclExprs.m_numStmts > 0, true);
+  EXPECT_EQ(noDeclExprs.m_numStmts < all.m_numStmts, true);
+}
+
+
+// Recurse until `clang::isStackNearlyExhausted` says the stack is
+// nearly used up, then call 'fn', so it starts with no more stack than
+// a very deep traversal would have left.  Like the traversal itself,
+// this relies on `main` having called `clang::noteBottomOfStack`, and
+// on the stack being as large as Clang assumes.
+void callWithStackNearlyExhausted(llvm::function_ref<void ()> fn)
+{
+  // Use a good amount of stack in each frame to limit the recursion.
+  volatile char buffer[0x4000];
+  buffer[0] = 0;
+
+  if (clang::isStackNearlyExhausted()) {
+    fn();
+  }
+  else {
+    callWithStackNearlyExhausted(fn);
+  }
+
+  // Using the buffer after the call prevents it from being made a
+  // tail call, which would reuse this frame.
+  buffer[1] = buffer[0];
+}
+
+
+// Traverse an expression nested far more deeply than the native stack
+// could accommodate if each level used a new frame on it.
+void testDeepNesting()
+{
+  int const numTerms = 20000;
+
+  std::string source = "int f(int a) { return a";
+  for (int i=1; i < numTerms; ++i) {
+    source += " + a";
+  }
+  source += "; }\n";
+  ClangASTUtilTempFile ast(source);
+
+  // CompoundStmt, ReturnStmt, the BinaryOperators, and then an
+  // ImplicitCastExpr and DeclRefExpr for each term.
+  int const expectStmts = 2 + (numTerms-1) + 2*numTerms;
+
+  RecordVisitedNodesStatic visitor;
+  visitor.scanTU(ast.getASTContext());
+  EXPECT_EQ(visitor.m_numStmts, expectStmts);
+
+  // Whether that needed a new stack depends on the size of the frames.
+  // Starting with the stack nearly exhausted makes sure it does, and
+  // that the traversal carries on correctly there.
+  unsigned const origCount = getRunOnFreshStackCount();
+  RecordVisitedNodesStatic lowStackVisitor;
+  callWithStackNearlyExhausted([&] {
+    lowStackVisitor.scanTU(ast.getASTContext());
+  });
+  EXPECT_EQ(getRunOnFreshStackCount() > origCount, true);
+  EXPECT_EQ(lowStackVisitor.m_numStmts, expectStmts);
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void clang_ast_visitor_t_unit_tests()
+{
+  compareToVirtual();
+  testVisitInterest();
+  testDeepNesting();
+}
+
+
+// EOF
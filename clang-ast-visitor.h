@@ -61,7 +61,11 @@
      client with enough information to filter locally as needed.
 
   One disadvantage is possibly slower run-time speed due to using
-  virtual function calls instead of CRTP static overriding.
+  virtual function calls instead of CRTP static overriding.  For
+  clients where that matters, the traversal is actually implemented by
+  the `ClangASTVisitorT` template, which calls the overridable methods
+  of its `Derived` class directly; `ClangASTVisitor` is the
+  instantiation of it that relays those calls to virtual methods.
 
   Another possible comparison is to ASTNodeTraverser
   (clang/AST/ASTNodeTraverser.h).  My impression is that the clang
@@ -80,6 +84,11 @@
   consequential benefit, when recursion is not desired, or should happen
   at a specific point, the client has direct control over that.
 
+  A client that never looks at entire parts of the AST, such as
+  function bodies, can say so up front in `m_visitInterest` (see
+  `VisitInterest`), and then the traversal skips those parts without
+  the client having to override anything.
+
   In most cases, a client will want to inherit `ClangUtilASTVisitor`
   (declared in `clang-util-ast-visitor.h`) instead of `ClangASTVisitor`
   alone, since the former has a lot of additional utility methods and
@@ -115,7 +124,7 @@
 
 // smbase
 #include "smbase/gdvalue-fwd.h"                  // gdv::GDValue
-#include "smbase/sm-macros.h"                    // NULLABLE
+#include "smbase/sm-macros.h"                    // NULLABLE, ENUM_BITWISE_OPS
 
 // clang
 #include "clang/AST/ASTFwd.h"                    // clang::{Stmt, Decl, ...} [n]
@@ -470,10 +479,78 @@ char const *toString(VisitDeclarationNameContext vdnc);
 gdv::GDValue toGDValue(VisitDeclarationNameContext vdnc);
 
 
+// Parts of the AST a client of `ClangASTVisitorT` wants to traverse.
+//
+// By default, the visitor traverses everything.  A client that only
+// needs some of the AST, for example one that only looks at
+// declarations, can clear the flags for the parts it does not need in
+// `m_visitInterest`, and the traversal then does not descend into them
+// at all.  Nothing inside a skipped part is visited, even if it is of a
+// kind the client otherwise sees.
+enum VisitInterest {
+  // Nothing beyond the declarations themselves.
+  VI_NONE                                        = 0x00,
+
+  // Function bodies and constructor member initializers.
+  VI_FUNCTION_BODIES                             = 0x01,
+
+  // Expressions that are part of a declaration: variable and field
+  // initializers (including default arguments), bit widths, enumerator
+  // values, non-type template parameter defaults, and requires clauses.
+  // This applies to declarations inside function bodies too.
+  VI_DECL_EXPRS                                  = 0x02,
+
+  // TypeLocs, and implicit QualTypes where there is no TypeLoc.  When
+  // this is clear, the parameters of a function with a written type,
+  // which are otherwise reached through its FunctionTypeLoc, are
+  // visited directly from the function declaration, still with context
+  // `VDC_FUNCTION_TYPE_PARAMETER`.
+  VI_TYPE_LOCS                                   = 0x04,
+
+  // NestedNameSpecifierLocs.
+  VI_NESTED_NAME_SPECIFIER_LOCS                  = 0x08,
+
+  // Instantiations of templates, reached from their templates.
+  VI_TEMPLATE_INSTANTIATIONS                     = 0x10,
+
+  // Everything.
+  VI_ALL                                         = 0x1F
+};
+
+ENUM_BITWISE_OPS(VisitInterest, VI_ALL)
+
+
 // Visitor for the Clang AST.  See the comments at the top of the file.
-class ClangASTVisitor {
+//
+// This template contains the traversal, and is parameterized by the
+// class that inherits it, `Derived`.  Whenever the traversal invokes
+// one of the methods meant to be overridden, it does so on `Derived`,
+// so a method there with the same name and signature takes its place
+// without any virtual dispatch.  As with `ClangASTVisitor`, the
+// replacement calls the method here when it wants the default behavior.
+//
+// The method definitions are in `clang-ast-visitor-impl.h`, which a
+// client that inherits this template directly must include in the
+// translation unit that instantiates `ClangASTVisitorT<Derived>`.
+//
+template <class Derived>
+class ClangASTVisitorT {
+public:      // data
+  // Parts of the AST to traverse.  Initially `VI_ALL`.
+  VisitInterest m_visitInterest;
+
+protected:   // methods
+  // This object as its most-derived type.
+  Derived &derived() { return *static_cast<Derived*>(this); }
+
 public:      // methods
-  ClangASTVisitor();
+  ClangASTVisitorT()
+    : m_visitInterest(VI_ALL)
+  {}
+
+  // True if 'm_visitInterest' includes all of 'vi'.
+  bool interestedIn(VisitInterest vi) const
+    { return (m_visitInterest & vi) == vi; }
 
   // Scan the entire TU in 'astContext'.
   //
@@ -493,7 +570,7 @@ public:      // methods
   //
   // Precondition: decl != nullptr.
   //
-  virtual void visitDecl(
+  void visitDecl(
     VisitDeclContext context,
     clang::Decl const *decl);
 
@@ -504,7 +581,7 @@ public:      // methods
   //
   // Precondition: stmt != nullptr.
   //
-  virtual void visitStmt(
+  void visitStmt(
     VisitStmtContext context,
     clang::Stmt const *stmt);
 
@@ -523,7 +600,7 @@ public:      // methods
   //
   // Precondition: !typeLoc.isNull()
   //
-  virtual void visitTypeLoc(
+  void visitTypeLoc(
     VisitTypeContext context,
     clang::TypeLoc typeLoc);
 
@@ -533,7 +610,7 @@ public:      // methods
   //
   // Precondition: !tal.getArgument().isNull()
   //
-  virtual void visitTemplateArgumentLoc(
+  void visitTemplateArgumentLoc(
     VisitTemplateArgumentContext context,
     clang::TemplateArgumentLoc tal);
 
@@ -542,12 +619,12 @@ public:      // methods
   //
   // Precondition: nnsl.hasQualifier()
   //
-  virtual void visitNestedNameSpecifierLoc(
+  void visitNestedNameSpecifierLoc(
     VisitNestedNameSpecifierContext context,
     clang::NestedNameSpecifierLoc nnsl);
 
   // Default: If 'dni' is a type name, visit it.  Otherwise do nothing.
-  virtual void visitDeclarationNameInfo(
+  void visitDeclarationNameInfo(
     VisitDeclarationNameContext context,
     clang::DeclarationNameInfo dni);
 
@@ -555,7 +632,7 @@ public:      // methods
   //
   // There is no 'context' parameter because, so far, there is only one
   // possible context, a RequiresExpr.
-  virtual void visitConceptsRequirement(
+  void visitConceptsRequirement(
     clang::concepts::Requirement const *req);
 
   // -------- Auxiliary visitors --------
@@ -570,7 +647,7 @@ public:      // methods
   // precondition.
   //
   // Default: Call 'visitDecl' on each instantiation.
-  virtual void visitFunctionTemplateInstantiations(
+  void visitFunctionTemplateInstantiations(
     clang::FunctionTemplateDecl const *ftd);
 
   // Visit the instantiations of `ctd`.
@@ -578,7 +655,7 @@ public:      // methods
   // The default visitor will only call this when `ctd` is canonical.
   //
   // Default: Call `visitDecl` on each relevant instantiation.
-  virtual void visitClassTemplateInstantiations(
+  void visitClassTemplateInstantiations(
     clang::ClassTemplateDecl const *ctd);
 
   // Visit the instantiations of 'vtd'.
@@ -586,7 +663,7 @@ public:      // methods
   // The default visitor will only call this when 'vtd' is canonical.
   //
   // Default: Call 'visitDecl' on each instantiation.
-  virtual void visitVarTemplateInstantiations(
+  void visitVarTemplateInstantiations(
     clang::VarTemplateDecl const *vtd);
 
   // TODO: Instantiations of variable templates and type alias
@@ -599,23 +676,23 @@ public:      // methods
   // This method is among the overrideable visitors because the client
   // may want to check 'init->isWritten()' to filter out implicit
   // initializers.
-  virtual void visitCXXCtorInitializer(
+  void visitCXXCtorInitializer(
     clang::CXXCtorInitializer const *init);
 
   // Default: Visit the children of `cdie`.
   //
   // The children are implicit code, so a client might want to override
   // this to be a no-op.
-  virtual void visitCXXDefaultInitExpr(
+  void visitCXXDefaultInitExpr(
     clang::CXXDefaultInitExpr const *cdie);
 
   // Default: If 'capture' is an "initialization capture", then visit
   // the variable it contains.  Otherwise, visit 'init'.
   //
-  // This method is 'virtual' in part because I do not know whether what
-  // it does is sufficiently general, so I'm leaving the door open for
+  // This method is overridable in part because I do not know whether
+  // what it does is sufficiently general, so I'm leaving the door open for
   // clients to intercept it.
-  virtual void visitLambdaExprCapture(
+  void visitLambdaExprCapture(
     clang::LambdaExpr const *lambdaExpr,
     clang::LambdaCapture const *capture,
     clang::Expr const *init);
@@ -630,14 +707,14 @@ public:      // methods
   // of the opposite kind.
   //
   // Default: Call `visitInitListExprInits(ile)`.
-  virtual void visitSemanticInitListExpr(
+  void visitSemanticInitListExpr(
     clang::InitListExpr const *ile);
 
   // Visit the "syntactic" form of `ile`, which may be the same as its
   // semantic form.
   //
   // Default: Call `visitInitListExprInits(ile)`.
-  virtual void visitSyntacticInitListExpr(
+  void visitSyntacticInitListExpr(
     clang::InitListExpr const *ile);
 
   // -------- Leaf visitors --------
@@ -653,8 +730,8 @@ public:      // methods
   // there is no TypeLoc.
   //
   // Default: Do nothing.
-  virtual void visitImplicitQualType(VisitTypeContext context,
-                                     clang::QualType qualType);
+  void visitImplicitQualType(VisitTypeContext context,
+                             clang::QualType qualType);
 
   // -------- Helpers --------
   //
@@ -666,14 +743,14 @@ public:      // methods
   // underlying visitor already does.
   //
   // They are public to facilitate reuse, but are not meant to be
-  // overridden by clients, hence not 'virtual'.
+  // overridden by clients, hence not 'virtual' in `ClangASTVisitor`.
 
   // Visit a nullable Decl.
   void visitDeclOpt(VisitDeclContext context,
                     clang::Decl const * NULLABLE decl)
   {
     if (decl) {
-      visitDecl(context, decl);
+      derived().visitDecl(context, decl);
     }
   }
 
@@ -682,7 +759,7 @@ public:      // methods
                     clang::Stmt const * NULLABLE stmt)
   {
     if (stmt) {
-      visitStmt(context, stmt);
+      derived().visitStmt(context, stmt);
     }
   }
 
@@ -794,7 +871,7 @@ public:      // methods
      then visit its instantiations.
 
      For now, I choose not to make the "if canonical" variants be the
-     "auxiliary visitors" (with 'virtual' specifier) because I see the
+     "auxiliary visitors" (overridable by clients) because I see the
      logic inside them as an implementation detail, even though I think
      it is ok for clients to call them.
   */
@@ -860,6 +937,80 @@ public:      // methods
 };
 
 
+// Visitor for the Clang AST that dispatches to its overridable methods
+// dynamically.  See the comments at the top of the file, and those on
+// `ClangASTVisitorT` for the meaning of each method.
+class ClangASTVisitor : public ClangASTVisitorT<ClangASTVisitor> {
+public:      // methods
+  ClangASTVisitor();
+
+  // Default: Call the `ClangASTVisitorT` method of the same name.
+
+  // Core visitors.
+  virtual void visitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl);
+
+  virtual void visitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt);
+
+  virtual void visitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc);
+
+  virtual void visitTemplateArgumentLoc(
+    VisitTemplateArgumentContext context,
+    clang::TemplateArgumentLoc tal);
+
+  virtual void visitNestedNameSpecifierLoc(
+    VisitNestedNameSpecifierContext context,
+    clang::NestedNameSpecifierLoc nnsl);
+
+  virtual void visitDeclarationNameInfo(
+    VisitDeclarationNameContext context,
+    clang::DeclarationNameInfo dni);
+
+  virtual void visitConceptsRequirement(
+    clang::concepts::Requirement const *req);
+
+  // Auxiliary visitors.
+  virtual void visitFunctionTemplateInstantiations(
+    clang::FunctionTemplateDecl const *ftd);
+
+  virtual void visitClassTemplateInstantiations(
+    clang::ClassTemplateDecl const *ctd);
+
+  virtual void visitVarTemplateInstantiations(
+    clang::VarTemplateDecl const *vtd);
+
+  virtual void visitCXXCtorInitializer(
+    clang::CXXCtorInitializer const *init);
+
+  virtual void visitCXXDefaultInitExpr(
+    clang::CXXDefaultInitExpr const *cdie);
+
+  virtual void visitLambdaExprCapture(
+    clang::LambdaExpr const *lambdaExpr,
+    clang::LambdaCapture const *capture,
+    clang::Expr const *init);
+
+  virtual void visitSemanticInitListExpr(
+    clang::InitListExpr const *ile);
+
+  virtual void visitSyntacticInitListExpr(
+    clang::InitListExpr const *ile);
+
+  // Leaf visitors.
+  virtual void visitImplicitQualType(VisitTypeContext context,
+                                     clang::QualType qualType);
+};
+
+
+// The instantiation is in clang-ast-visitor.cc.
+extern template class ClangASTVisitorT<ClangASTVisitor>;
+
+
 // Run visitor tests on the given TU.
 //
 // Unlike most other modules, the tests for this one are meant to be
@@ -3,19 +3,77 @@
 
 #include "clang-ast.h"                                     // this module
 
-#include "clang/Basic/Diagnostic.h"                        // clang::DiagnosticsEngine
+#include "caching-file-system.h"                           // CachingFileSystem
+
+#include "clang/AST/ASTContext.h"                          // clang::ASTContext
+#include "clang/Basic/Diagnostic.h"                        // clang::{DiagnosticsEngine, IgnoringDiagConsumer}
 #include "clang/Basic/DiagnosticOptions.h"                 // clang::DiagnosticOptions
+#include "clang/Basic/FileManager.h"                       // clang::FileManager
+#include "clang/Basic/SourceLocation.h"                    // clang::{FileID, SourceLocation}
+#include "clang/Basic/SourceManager.h"                     // clang::{SourceManager, SrcMgr::SLocEntry}
 #include "clang/Basic/Version.h"                           // CLANG_VERSION_MAJOR
 #include "clang/Frontend/ASTUnit.h"                        // clang::ASTUnit
 #include "clang/Frontend/CompilerInstance.h"               // clang::CompilerInstance
-#include "clang/Frontend/Utils.h"                          // clang::createInvocationFromCommandLine
+#include "clang/Frontend/Utils.h"                          // clang::{createInvocation, CreateInvocationOptions}
+#include "clang/Lex/HeaderSearchOptions.h"                 // clang::HeaderSearchOptions
+#include "clang/Lex/Preprocessor.h"                        // clang::Preprocessor
 #include "clang/Serialization/PCHContainerOperations.h"    // clang::PCHContainerOperations
 
+#include "llvm/ADT/SmallVector.h"                          // llvm::SmallVector
+#include "llvm/ADT/Twine.h"                                // llvm::Twine
+#include "llvm/Support/Allocator.h"                        // llvm::BumpPtrAllocator
+#include "llvm/Support/MemoryBuffer.h"                     // llvm::MemoryBuffer
+#include "llvm/Support/StringSaver.h"                      // llvm::StringSaver
+#include "llvm/Support/VirtualFileSystem.h"                // llvm::vfs::{InMemoryFileSystem, OverlayFileSystem}
+
 #include "smbase/exc.h"                                    // smbase::xmessage
+#include "smbase/stringb.h"                                // stringb
+
+#include <cassert>                                         // assert
+#include <cstdint>                                         // std::uint64_t
+#include <memory>                                          // std::{make_shared, unique_ptr}
+#include <set>                                             // std::set
+#include <utility>                                         // std::move
 
 using namespace smbase;
 
 
+// ------------------------ Shared file system -------------------------
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// The layers of `ClangAST::getSharedFileSystem`.
+struct SharedFileSystem {
+  // Cache over the real file system.
+  llvm::IntrusiveRefCntPtr<CachingFileSystem> m_caching;
+
+  // Files that exist only in memory.
+  llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> m_inMemory;
+
+  // The combination, with 'm_inMemory' on top.
+  llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> m_overlay;
+
+  SharedFileSystem()
+    : m_caching(new CachingFileSystem(llvm::vfs::getRealFileSystem())),
+      m_inMemory(new llvm::vfs::InMemoryFileSystem),
+      m_overlay(new llvm::vfs::OverlayFileSystem(m_caching))
+  {
+    m_overlay->pushOverlay(m_inMemory);
+  }
+};
+
+
+// Get the process-wide instance, creating it on first use.
+SharedFileSystem &getSharedFS()
+{
+  static SharedFileSystem *instance = new SharedFileSystem;
+  return *instance;
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
 // ----------------------------- ClangAST ------------------------------
 ClangAST::~ClangAST()
 {}
@@ -24,7 +82,9 @@ ClangAST::~ClangAST()
 ClangAST::ClangAST()
   : m_compilerInvocation(),
     m_primarySourceFileName(),
-    m_ast()
+    m_pchContainerOps(),
+    m_ast(),
+    m_precompilePreambleAfterNParses(0)
 {}
 
 
@@ -57,12 +117,19 @@ bool ClangAST::parseCommandLine(
     }
   }
 
-  // Parse the command line options.
-  m_compilerInvocation =
+  // Parse the command line options.  The driver checks that the inputs
+  // exist, so it needs the file system that can see in-memory files.
 #if CLANG_VERSION_MAJOR <= 14
-    clang::createInvocationFromCommandLine(llvm::makeArrayRef(commandLine));
+  m_compilerInvocation =
+    clang::createInvocationFromCommandLine(
+      llvm::makeArrayRef(commandLine),
+      clang::IntrusiveRefCntPtr<clang::DiagnosticsEngine>(),
+      getSharedFileSystem());
 #else
-    clang::createInvocation(llvm::ArrayRef(commandLine));
+  clang::CreateInvocationOptions ciOpts;
+  ciOpts.VFS = getSharedFileSystem();
+  m_compilerInvocation =
+    clang::createInvocation(llvm::ArrayRef(commandLine), ciOpts);
 #endif
   if (!m_compilerInvocation) {
     // Command line parsing errors have already been printed.
@@ -107,12 +174,38 @@ bool ClangAST::parseSourceCode(clang::FrontendAction *feAction)
       diagnosticOptions));
 
   // Run the Clang parser to produce an AST.
-  m_ast.reset(
-    clang::ASTUnit::LoadFromCompilerInvocationAction(
-      m_compilerInvocation,
-      pchContainerOps,
-      diagnosticsEngine,
-      feAction));
+  if (feAction) {
+    // This entry point always builds its own file manager on the real
+    // file system.
+    m_ast.reset(
+      clang::ASTUnit::LoadFromCompilerInvocationAction(
+        m_compilerInvocation,
+        pchContainerOps,
+        diagnosticsEngine,
+        feAction));
+  }
+  else {
+    // Each TU gets its own `FileManager`, since that caches by the name
+    // used to access a file, and the meaning of a relative name depends
+    // on the invocation's working directory.  But underneath, they all
+    // share one file system, which caches by absolute path.
+    llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> vfs =
+      clang::createVFSFromCompilerInvocation(
+        *m_compilerInvocation, *diagnosticsEngine, getSharedFileSystem());
+    llvm::IntrusiveRefCntPtr<clang::FileManager> fileManager(
+      new clang::FileManager(m_compilerInvocation->getFileSystemOpts(),
+                             vfs));
+
+    m_ast =
+      clang::ASTUnit::LoadFromCompilerInvocation(
+        m_compilerInvocation,
+        pchContainerOps,
+        diagnosticsEngine,
+        fileManager.get(),
+        false /*onlyLocalDecls*/,
+        clang::CaptureDiagsKind::None,
+        m_precompilePreambleAfterNParses);
+  }
 
   if (m_ast == nullptr) {
     // Error messages should already have been printed.
@@ -128,6 +221,151 @@ bool ClangAST::parseSourceCode(clang::FrontendAction *feAction)
 }
 
 
+bool ClangAST::reparse(
+  std::vector<std::pair<std::string, std::string>> const &remappedFiles)
+{
+  assert(m_ast);
+
+  // `Reparse` takes ownership of the buffers.
+  std::vector<clang::ASTUnit::RemappedFile> remappedBuffers;
+  for (auto const &fnameAndContents : remappedFiles) {
+    remappedBuffers.push_back(clang::ASTUnit::RemappedFile(
+      fnameAndContents.first,
+      llvm::MemoryBuffer::getMemBufferCopy(
+        fnameAndContents.second, fnameAndContents.first).release()));
+  }
+
+  std::shared_ptr<clang::PCHContainerOperations> pchContainerOps(
+    new clang::PCHContainerOperations());
+
+  // This resets the diagnostic counts before parsing, and uses the same
+  // file system as the original parse.
+  if (m_ast->Reparse(pchContainerOps, remappedBuffers)) {
+    // Error messages should already have been printed.
+    return false;
+  }
+
+  if (m_ast->getDiagnostics().getNumErrors() > 0) {
+    // The errors should have been printed already.
+    return false;
+  }
+
+  return true;
+}
+
+
+std::vector<std::string> ClangAST::getCC1CommandLine() const
+{
+  // The generator wants somewhere to keep the strings it makes.
+  llvm::BumpPtrAllocator alloc;
+  llvm::StringSaver saver(alloc);
+
+  llvm::SmallVector<char const *, 64> args;
+  m_compilerInvocation->generateCC1CommandLine(args,
+    [&saver](llvm::Twine const &arg) -> char const * {
+      return saver.save(arg).data();
+    });
+
+  return std::vector<std::string>(args.begin(), args.end());
+}
+
+
+std::vector<std::string> ClangAST::getInputFileNames() const
+{
+  clang::SourceManager &srcMgr = m_ast->getSourceManager();
+
+  std::set<std::string> names;
+
+  // Entry 0 is a sentinel.  A file included more than once has an
+  // entry for each inclusion.
+  for (unsigned i=1; i < srcMgr.local_sloc_entry_size(); ++i) {
+    clang::SrcMgr::SLocEntry const &entry = srcMgr.getLocalSLocEntry(i);
+    if (!entry.isFile()) {
+      continue;
+    }
+
+    // The raw encoding of a file location is its offset.
+    clang::FileID fileID = srcMgr.getFileID(
+      clang::SourceLocation::getFromRawEncoding(entry.getOffset()));
+
+    // Things like the predefines buffer have no file entry.
+    if (auto entryRef = srcMgr.getFileEntryRefForID(fileID)) {
+      names.insert(entryRef->getName().str());
+    }
+  }
+
+  return std::vector<std::string>(names.begin(), names.end());
+}
+
+
+std::uint64_t ClangAST::getMemoryUsage() const
+{
+  // These are the main allocations that libclang's
+  // `clang_getCXTUResourceUsage` reports.
+  clang::ASTContext &astContext = m_ast->getASTContext();
+  clang::SourceManager &srcMgr = m_ast->getSourceManager();
+  return astContext.getASTAllocatedMemory() +
+         astContext.getSideTableAllocatedMemory() +
+         astContext.Idents.getAllocator().getTotalMemory() +
+         srcMgr.getContentCacheSize() +
+         srcMgr.getDataStructureSizes() +
+         m_ast->getPreprocessor().getTotalMemory();
+}
+
+
+bool ClangAST::saveASTFile(std::string const &fname)
+{
+  assert(m_ast);
+
+  // `Save` returns true on error.  It writes to a temporary file and
+  // then renames it, so a reader never sees a partial file.
+  return !m_ast->Save(fname);
+}
+
+
+bool ClangAST::loadASTFile(std::string const &fname)
+{
+  if (!m_pchContainerOps) {
+    m_pchContainerOps.reset(new clang::PCHContainerOperations());
+  }
+
+  // A file that cannot be used, for example because it was written by
+  // a different version of Clang, is not an error from the caller's
+  // point of view, so discard the diagnostics.
+  clang::IntrusiveRefCntPtr<clang::DiagnosticsEngine> diagnosticsEngine(
+    clang::CompilerInstance::createDiagnostics(
+      &(m_compilerInvocation->getDiagnosticOpts()),
+      new clang::IgnoringDiagConsumer,
+      true /*shouldOwnClient*/));
+
+  std::unique_ptr<clang::ASTUnit> unit =
+    clang::ASTUnit::LoadFromASTFile(
+      fname,
+      m_pchContainerOps->getRawReader(),
+      clang::ASTUnit::LoadEverything,
+      diagnosticsEngine,
+      m_compilerInvocation->getFileSystemOpts(),
+#if CLANG_VERSION_MAJOR >= 18
+      // Clang 18 replaced 'useDebugInfo' with this.
+      std::make_shared<clang::HeaderSearchOptions>(
+        m_compilerInvocation->getHeaderSearchOpts()),
+#else
+      false /*useDebugInfo*/,
+#endif
+      false /*onlyLocalDecls*/,
+      clang::CaptureDiagsKind::None,
+      false /*allowASTWithCompilerErrors*/,
+      false /*userFilesAreVolatile*/,
+      getSharedFileSystem());
+  if (!unit) {
+    return false;
+  }
+
+  m_ast = std::move(unit);
+  return true;
+}
+
+
 clang::ASTUnit *ClangAST::getASTUnit()
 {
   return m_ast.get();
@@ -140,6 +378,42 @@ clang::ASTContext &ClangAST::getASTContext()
 }
 
 
+/*static*/ llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>
+ClangAST::getSharedFileSystem()
+{
+  return getSharedFS().m_overlay;
+}
+
+
+/*static*/ bool ClangAST::addInMemoryFile(
+  std::string const &fname,
+  std::string const &contents)
+{
+  return getSharedFS().m_inMemory->addFile(
+    fname,
+    0 /*modificationTime*/,
+    llvm::MemoryBuffer::getMemBufferCopy(contents, fname));
+}
+
+
+/*static*/ void ClangAST::clearSharedFileSystemCache()
+{
+  getSharedFS().m_caching->clear();
+}
+
+
+/*static*/ std::uint64_t ClangAST::getSharedFileSystemContentsSize()
+{
+  return getSharedFS().m_caching->getContentsSize();
+}
+
+
+/*static*/ void ClangAST::releaseUnusedSharedFileSystemContents()
+{
+  getSharedFS().m_caching->releaseUnusedContents();
+}
+
+
 // --------------------------- ClangASTUtil ----------------------------
 ClangASTUtil::~ClangASTUtil()
 {}
@@ -156,13 +430,25 @@ ClangASTUtilTempFile::~ClangASTUtilTempFile()
 {}
 
 
-// Clang has a virtual file system that could be used to avoid actually
-// hitting the disk here, but after a quick look, I decided it appeared
-// to be more trouble than I wanted to deal with.
 ClangASTUtilTempFile::ClangASTUtilTempFile(std::string const &source)
-  : TemporaryFile("cautf", "cc", source),
-    ClangASTUtil({TemporaryFile::getFname()})
+  : ClangASTUtil({makeInMemoryFile(source)})
 {}
 
 
+/*static*/ std::string ClangASTUtilTempFile::makeInMemoryFile(
+  std::string const &source)
+{
+  static int counter = 0;
+
+  // The name has to be absolute so it does not depend on the current
+  // directory, and end in ".cc" so the driver treats it as C++.
+  while (true) {
+    std::string fname = stringb("/pca-in-memory/cautf" << ++counter << ".cc");
+    if (ClangAST::addInMemoryFile(fname, source)) {
+      return fname;
+    }
+  }
+}
+
+
 // EOF
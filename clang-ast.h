@@ -9,12 +9,17 @@
 
 #include "clang/Frontend/ASTUnit.h"              // clang::ASTUnit
 #include "clang/Frontend/CompilerInvocation.h"   // clang::CompilerInvocation
+#include "clang/Serialization/PCHContainerOperations.h"  // clang::PCHContainerOperations
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"         // llvm::IntrusiveRefCntPtr
+#include "llvm/Support/VirtualFileSystem.h"      // llvm::vfs::FileSystem
 
 #include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES
-#include "smbase/temporary-file.h"               // smbase::TemporaryFile
 
+#include <cstdint>                               // std::uint64_t
 #include <memory>                                // std::{shared_ptr, unique_ptr}
 #include <string>                                // std::string
+#include <utility>                               // std::pair
 #include <vector>                                // std::vector
 
 
@@ -22,6 +27,10 @@
 //
 // This object is only meant for one-shot, parse and discard usage.  If
 // another TU is to be parsed, make another object.
+//
+// All objects in a process read files through one shared file system
+// (see `getSharedFileSystem`), so the cost of finding and reading
+// headers is paid once per process rather than once per TU.
 class ClangAST {
   NO_OBJECT_COPIES(ClangAST);
 
@@ -36,9 +45,25 @@ public:      // data
   // `parseCommandLine`.
   std::string m_primarySourceFileName;
 
+  // Container operations for an AST made by `loadASTFile`.  Such an
+  // `ASTUnit` refers to these without owning them, so they are kept
+  // here, ahead of 'm_ast' so they are destroyed after it.
+  std::shared_ptr<clang::PCHContainerOperations> m_pchContainerOps;
+
   // Result of parsing the source code.
   std::unique_ptr<clang::ASTUnit> m_ast;
 
+  // If nonzero, `parseSourceCode` asks Clang to build a precompiled
+  // preamble (the leading run of #includes and such) once the file has
+  // been parsed this many times, counting the first parse and each
+  // `reparse`.  The preamble is then reused by `reparse` as long as
+  // the preamble region and the files it includes are unchanged.
+  // Ignored when `parseSourceCode` is given a `FrontendAction`.
+  //
+  // Nodes that come from a preamble are deserialized from it, so some
+  // details of how they are printed can differ from a plain parse.
+  unsigned m_precompilePreambleAfterNParses;
+
 public:      // methods
   ~ClangAST();
 
@@ -65,11 +90,84 @@ public:      // methods
   // error messages to stderr.
   bool parseSourceCode(clang::FrontendAction *feAction = nullptr);
 
+  // After a successful `parseSourceCode`, parse the same TU again,
+  // replacing `m_ast`'s contents.  Each element of 'remappedFiles' is a
+  // file name and contents to use instead of what is in the file
+  // system.  Files not remapped are read again through the shared file
+  // system, so call `clearSharedFileSystemCache` first in order to see
+  // changes made on disk.
+  //
+  // Any `ASTContext` reference obtained before this call is invalid
+  // afterward.
+  //
+  // Return true on success.  On failure, return false after printing
+  // error messages to stderr.
+  bool reparse(
+    std::vector<std::pair<std::string, std::string>> const &remappedFiles);
+
+  // Return the invocation made by `parseCommandLine` in normalized
+  // form, as the "-cc1" arguments that would recreate it.
+  std::vector<std::string> getCC1CommandLine() const;
+
+  // After a successful `parseSourceCode`, return the names of the files
+  // read to make the AST, including the primary source file, without
+  // duplicates, in sorted order.
+  std::vector<std::string> getInputFileNames() const;
+
+  // After a successful parse, estimate the number of bytes of memory
+  // used by `m_ast`, not counting the file contents, which belong to
+  // the shared file system; see `getSharedFileSystemContentsSize`.
+  std::uint64_t getMemoryUsage() const;
+
+  // After a successful `parseSourceCode`, write `m_ast` to 'fname' in
+  // Clang's serialized AST format.  Return true on success.
+  bool saveASTFile(std::string const &fname);
+
+  // Instead of `parseSourceCode`, set `m_ast` by loading 'fname', as
+  // written by `saveASTFile` using the same invocation.  Declarations
+  // are then deserialized as they are used.
+  //
+  // Return true on success.  On failure, return false without printing
+  // anything, since the caller is expected to parse instead.
+  //
+  // The resulting AST has no `Sema`, so it cannot be used with
+  // `reparse` or `declareImplicitThings`.
+  bool loadASTFile(std::string const &fname);
+
   // Get the `ASTUnit` after a successful parse.
   clang::ASTUnit *getASTUnit();
 
   // Get the `ASTContext` after a successful parse.
   clang::ASTContext &getASTContext();
+
+  // Get the file system used to parse command lines and source code.
+  // It consists of an in-memory layer, populated by `addInMemoryFile`,
+  // on top of a `CachingFileSystem` over the real file system.
+  //
+  // The exception is that when `parseSourceCode` is passed a
+  // `FrontendAction`, Clang insists on making its own file system.
+  static llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem>
+    getSharedFileSystem();
+
+  // Add a file called 'fname', which should be absolute, containing
+  // 'contents', to the in-memory layer of the shared file system.  It
+  // then hides any real file of the same name.  Return false, and do
+  // nothing, if an in-memory file with that name already exists.
+  static bool addInMemoryFile(std::string const &fname,
+                              std::string const &contents);
+
+  // Discard what the shared file system has cached from the real file
+  // system, so changes made since are seen by the next parse.  Files
+  // whose contents did not change keep their existing buffers.
+  static void clearSharedFileSystemCache();
+
+  // Number of bytes of file contents the shared file system holds.
+  // ASTs parsed from them share them rather than holding copies.
+  static std::uint64_t getSharedFileSystemContentsSize();
+
+  // Discard the file contents the shared file system holds that no
+  // AST uses any more.
+  static void releaseUnusedSharedFileSystemContents();
 };
 
 
@@ -87,14 +185,22 @@ public:      // methods
 };
 
 
-// Parse in-memory source code using a temporary file.
-class ClangASTUtilTempFile : public smbase::TemporaryFile,
-                             public ClangASTUtil {
+// Parse in-memory source code.
+//
+// Despite the name, this no longer writes a temporary file.  Instead,
+// 'source' is added to the in-memory layer of the shared file system
+// under a new, unique name.  That file is never removed, but it only
+// occupies memory.
+class ClangASTUtilTempFile : public ClangASTUtil {
 public:      // methods
   ~ClangASTUtilTempFile();
 
   // Parse 'source'.
   ClangASTUtilTempFile(std::string const &source);
+
+  // Make a new unique in-memory file containing 'source' and return
+  // its name.
+  static std::string makeInMemoryFile(std::string const &source);
 };
 
 
@@ -5,6 +5,7 @@
 
 // this dir
 #include "enum-util.h"                 // ENUM_TABLE_LOOKUP, BITFLAGS_TABLE_LOOKUP
+#include "source-location-cache.h"     // SourceLocationCache
 
 // smbase
 #include "smbase/compare-util.h"       // compare
@@ -20,6 +21,7 @@
 #include "clang/AST/DeclCXX.h"         // clang::{CXXMethodDecl::getParent, CXXDeductionGuideDecl}
 #include "clang/AST/ExprConcepts.h"    // clang::concepts::Requirement
 #include "clang/AST/Type.h"            // clang::FunctionProtoType
+#include "clang/Basic/Stack.h"         // clang::runWithSufficientStackSpaceSlow
 #include "clang/Basic/Version.h"       // CLANG_VERSION_MAJOR
 #include "clang/Lex/Lexer.h"           // clang::Lexer
 
@@ -27,6 +29,10 @@
 #include "llvm/ADT/APSInt.h"           // llvm::APSint::toString
 #include "llvm/Support/raw_ostream.h"  // llvm::raw_string_ostream
 
+// libc++
+#include <atomic>                      // std::atomic
+#include <exception>                   // std::{exception_ptr, current_exception, rethrow_exception}
+
 using namespace smbase;
 
 
@@ -48,7 +54,8 @@ ClangUtil::ClangUtil(clang::ASTContext &astContext)
     m_srcMgr(m_astContext.getSourceManager()),
     m_mainFileID(m_srcMgr.getMainFileID()),
     m_mainFileName(getFnameForFileID(m_mainFileID)),
-    m_printingPolicy(getLangOptions())
+    m_printingPolicy(getLangOptions()),
+    m_locCache(std::make_shared<SourceLocationCache>(m_srcMgr))
 {
   m_printingPolicy.Indentation = 2;
   m_printingPolicy.Bool = true;
@@ -85,27 +92,34 @@ clang::ExternalASTSource * NULLABLE ClangUtil::getExternalSource() const
 // -------------------------- SourceLocation ---------------------------
 string ClangUtil::locStr(SourceLocation loc) const
 {
-  return loc.printToString(m_srcMgr);
+  // Same as `loc.printToString(m_srcMgr)`.
+  return m_locCache->locStr(loc);
 }
 
 
 string ClangUtil::locLineColStr(clang::SourceLocation loc) const
 {
-  return stringb(locLine(loc) << ":" << locCol(loc));
+  unsigned line, col;
+  m_locCache->locLineCol(loc, line, col);
+  return stringb(line << ":" << col);
 }
 
 
 unsigned ClangUtil::locLine(clang::SourceLocation loc) const
 {
   // I think "presumed" means after taking #line directives into
-  // account.
-  return m_srcMgr.getPresumedLineNumber(loc);
+  // account.  The cache yields the same as `getPresumedLineNumber`.
+  unsigned line, col;
+  m_locCache->locLineCol(loc, line, col);
+  return line;
 }
 
 
 unsigned ClangUtil::locCol(clang::SourceLocation loc) const
 {
-  return m_srcMgr.getPresumedColumnNumber(loc);
+  unsigned line, col;
+  m_locCache->locLineCol(loc, line, col);
+  return col;
 }
 
 
@@ -2518,19 +2532,22 @@ STATICDEF bool ClangUtil::isPrivateHeaderEntryRef(
 }
 
 
-string ClangUtil::getTopLevelIncludeForLoc(
-  clang::SourceLocation loc) const
+// Compute `ClangUtil::getTopLevelIncludeForLoc` by walking the include
+// chain.
+static string computeTopLevelIncludeForLoc(
+  clang::SourceManager const &srcMgr,
+  clang::SourceLocation loc)
 {
   // This is initially invalid.
   clang::PresumedLoc prevPresumedLoc;
 
   if (loc.isValid()) {
-    clang::PresumedLoc presumedLoc = m_srcMgr.getPresumedLoc(loc);
+    clang::PresumedLoc presumedLoc = srcMgr.getPresumedLoc(loc);
     assert(presumedLoc.isValid());
 
     while (presumedLoc.getIncludeLoc().isValid()) {
       prevPresumedLoc = presumedLoc;
-      presumedLoc = m_srcMgr.getPresumedLoc(presumedLoc.getIncludeLoc());
+      presumedLoc = srcMgr.getPresumedLoc(presumedLoc.getIncludeLoc());
     }
   }
 
@@ -2549,6 +2566,16 @@ string ClangUtil::getTopLevelIncludeForLoc(
 }
 
 
+string ClangUtil::getTopLevelIncludeForLoc(
+  clang::SourceLocation loc) const
+{
+  return m_locCache->topLevelIncludeForLoc(loc,
+    [this](clang::SourceLocation l) {
+      return computeTopLevelIncludeForLoc(m_srcMgr, l);
+    });
+}
+
+
 string ClangUtil::publicPresumedFname(SourceLocation loc)
 {
   // Get the location as influenced by #line directives.
@@ -2807,6 +2834,43 @@ std::string getDeclContextClassName(clang::DeclContext const *dc)
 }
 
 
+// Number of calls to `runOnFreshStack`.  It is atomic because
+// traversals can run on several threads.
+static std::atomic<unsigned> s_runOnFreshStackCount(0);
+
+
+void runOnFreshStack(llvm::function_ref<void ()> fn)
+{
+  s_runOnFreshStackCount.fetch_add(1, std::memory_order_relaxed);
+
+  // An exception cannot propagate out of the thread, so carry it over.
+  std::exception_ptr exn;
+
+  // This also notes the bottom of the new stack, so a traversal that
+  // is deep enough to exhaust that one too will move again.
+  clang::runWithSufficientStackSpaceSlow(
+    [] {},
+    [&] {
+      try {
+        fn();
+      }
+      catch (...) {
+        exn = std::current_exception();
+      }
+    });
+
+  if (exn) {
+    std::rethrow_exception(exn);
+  }
+}
+
+
+unsigned getRunOnFreshStackCount()
+{
+  return s_runOnFreshStackCount.load(std::memory_order_relaxed);
+}
+
+
 void assert_dyn_cast_null(
   char const *destTypeName,
   char const *sourceFile,
@@ -30,11 +30,13 @@
 #include "smbase/sm-macros.h"                              // NULLABLE
 
 // llvm
+#include "llvm/ADT/STLFunctionalExtras.h"                  // llvm::function_ref
 #include "llvm/ADT/StringRef.h"                            // llvm::StringRef [n]
 #include "llvm/Support/Casting.h"                          // llvm::dyn_cast
 
 // libc++
 #include <list>                                            // std::list
+#include <memory>                                          // std::shared_ptr
 #include <string>                                          // std::string
 #include <vector>                                          // std::vector
 
@@ -50,6 +52,9 @@
 // basic pattern is I insert IF_CLANG_17 when I am using Clang-17 and
 // ran into a compatibility issue.
 
+class SourceLocationCache;
+
+
 #if CLANG_VERSION_MAJOR >= 18
   #define IF_CLANG_18(thenCode, elseCode) thenCode
 #else
@@ -105,6 +110,11 @@ public:      // instance data
   // Default printing policy.
   clang::PrintingPolicy m_printingPolicy;
 
+  // Memoized decoding of locations, used by `locStr` and friends.  It
+  // is shared by copies of this object, which decode the same TU's
+  // locations, and is not `const` even when this object is.
+  std::shared_ptr<SourceLocationCache> m_locCache;
+
 public:      // methods
   explicit ClangUtil(clang::ASTContext &astContext);
 
@@ -851,6 +861,18 @@ inline std::string outerGetDynamicTypeClassName(clang::DeclContext const *src)
 }
 
 
+// Run 'fn' on a new thread with a fresh native stack, wait for it to
+// finish, and rethrow any exception it throws.  This is meant to be
+// used when `clang::isStackNearlyExhausted()` says that deep recursion
+// is about to overflow the current stack, which requires that `main`
+// has called `clang::noteBottomOfStack()`.
+void runOnFreshStack(llvm::function_ref<void ()> fn);
+
+// Number of times `runOnFreshStack` has been called, so tests can tell
+// whether a traversal actually moved to a new stack.
+unsigned getRunOnFreshStackCount();
+
+
 // Report an attempt to dyn_cast a null pointer.
 void assert_dyn_cast_null(
   char const *destTypeName,
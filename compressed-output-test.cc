@@ -0,0 +1,224 @@
+// compressed-output-test.cc
+// Tests for `compressed-output`.
+
+#include "compressed-output.h"                   // module under test
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "llvm/ADT/SmallVector.h"                // llvm::SmallVector
+#include "llvm/ADT/StringExtras.h"               // llvm::arrayRefFromStringRef
+#include "llvm/Config/llvm-config.h"             // LLVM_VERSION_MAJOR
+#include "llvm/Support/CRC.h"                    // llvm::crc32
+#include "llvm/Support/Compression.h"            // llvm::compression
+#include "llvm/Support/Error.h"                  // llvm::{Error, toString}
+
+#include <cstdint>                               // std::uint32_t, etc.
+#include <ostream>                               // std::ostream
+#include <sstream>                               // std::ostringstream
+#include <string>                                // std::string
+#include <utility>                               // std::move
+#include <vector>                                // std::vector
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+void testParseFormat()
+{
+  CompressionFormat format = CF_GZIP;
+  EXPECT_EQ(parseCompressionFormat(format, ""), "");
+  EXPECT_EQ(format, CF_NONE);
+  EXPECT_EQ(parseCompressionFormat(format, "zstd"), "");
+  EXPECT_EQ(format, CF_ZSTD);
+  EXPECT_EQ(parseCompressionFormat(format, "gzip"), "");
+  EXPECT_EQ(format, CF_GZIP);
+  EXPECT_EQ(parseCompressionFormat(format, "lz4"),
+    "unknown compression format \"lz4\"; expected \"gzip\" or \"zstd\"");
+
+  EXPECT_EQ(string(compressionFormatExtension(CF_GZIP)), ".gz");
+  EXPECT_EQ(string(compressionFormatExtension(CF_NONE)), "");
+}
+
+
+// Return true if this build can compress with 'format'.
+bool canCompress(CompressionFormat format)
+{
+  string dummy;
+  return compressFrame(dummy, format, "x").empty();
+}
+
+
+// Adler-32 (RFC 1950) of 'data'.
+std::uint32_t adler32(llvm::StringRef data)
+{
+  std::uint32_t a = 1, b = 0;
+  for (char c : data) {
+    a = (a + (std::uint8_t)c) % 65521;
+    b = (b + a) % 65521;
+  }
+  return (b << 16) | a;
+}
+
+
+// Read 4 little-endian bytes at 'p'.
+std::uint32_t readLE32(char const *p)
+{
+  std::uint32_t value = 0;
+  for (int i=0; i < 4; ++i) {
+    value |= (std::uint32_t)(std::uint8_t)p[i] << (8*i);
+  }
+  return value;
+}
+
+
+// Decompress the gzip member 'frame', whose contents should be
+// 'expect'.  LLVM only reads the zlib format, which needs the Adler-32
+// of the contents, so this relies on knowing them.
+string gunzipFrame(llvm::StringRef frame, llvm::StringRef expect)
+{
+  EXPECT_EQ(frame.size() >= 18, true);
+  EXPECT_EQ(frame.substr(0, 3).str(), "\x1f\x8b\x08");
+
+  llvm::StringRef trailer = frame.take_back(8);
+  EXPECT_EQ(readLE32(trailer.data()),
+            llvm::crc32(llvm::arrayRefFromStringRef(expect)));
+  EXPECT_EQ(readLE32(trailer.data() + 4), (std::uint32_t)expect.size());
+
+  string zlibData("\x78\x9c", 2);
+  zlibData += frame.drop_front(10).drop_back(8).str();
+  std::uint32_t adler = adler32(expect);
+  for (int i=3; i >= 0; --i) {
+    zlibData.push_back((char)(adler >> (8*i)));
+  }
+
+#if LLVM_VERSION_MAJOR >= 15
+  llvm::SmallVector<uint8_t, 0> out;
+  llvm::Error err = llvm::compression::zlib::decompress(
+    llvm::arrayRefFromStringRef(zlibData), out, expect.size());
+#else
+  llvm::SmallVector<char, 0> out;
+  llvm::Error err = llvm::zlib::uncompress(zlibData, out, expect.size());
+#endif
+  EXPECT_EQ(llvm::toString(std::move(err)), "");
+  return string(out.begin(), out.end());
+}
+
+
+// Decompress the zstd frame 'frame' of 'size' bytes.
+string unzstdFrame(llvm::StringRef frame, std::size_t size)
+{
+#if LLVM_VERSION_MAJOR >= 16
+  llvm::SmallVector<uint8_t, 0> out;
+  llvm::Error err = llvm::compression::zstd::decompress(
+    llvm::arrayRefFromStringRef(frame), out, size);
+  EXPECT_EQ(llvm::toString(std::move(err)), "");
+  return string(out.begin(), out.end());
+#else
+  (void)frame;
+  (void)size;
+  return "";
+#endif
+}
+
+
+// Write enough through a `CompressingStreamBuf` to make several frames,
+// then check that each frame decompresses to its part of the input.
+void testFrames(CompressionFormat format)
+{
+  if (!canCompress(format)) {
+    return;
+  }
+
+  string input;
+  for (int i=0; i < 1000; ++i) {
+    input += "\"Decl::Loc\": \"line " + std::to_string(i) + "\",\n";
+  }
+
+  std::size_t const frameSize = 4096;
+  std::ostringstream compressed;
+  std::vector<CompressedFrame> frames;
+  {
+    CompressingStreamBuf buf(compressed, format, frameSize);
+    std::ostream os(&buf);
+    EXPECT_EQ((std::uint64_t)os.tellp(), (std::uint64_t)0);
+
+    // The position counts uncompressed bytes, whether they are in a
+    // submitted frame or the current one.
+    std::size_t half = input.size() / 2;
+    os << input.substr(0, half);
+    EXPECT_EQ((std::uint64_t)os.tellp(), (std::uint64_t)half);
+    os << input.substr(half);
+    os.flush();
+    EXPECT_EQ((std::uint64_t)os.tellp(), (std::uint64_t)input.size());
+    EXPECT_EQ(buf.finish(), "");
+    frames = buf.frames();
+  }
+
+  std::size_t expectFrames = (input.size() + frameSize - 1) / frameSize;
+  EXPECT_EQ(frames.size(), expectFrames);
+
+  string output = compressed.str();
+  std::uint64_t uncompressedOffset = 0;
+  std::uint64_t compressedOffset = 0;
+  for (CompressedFrame const &frame : frames) {
+    EXPECT_EQ(frame.m_uncompressedOffset, uncompressedOffset);
+    EXPECT_EQ(frame.m_compressedOffset, compressedOffset);
+
+    llvm::StringRef expect = llvm::StringRef(input).substr(
+      frame.m_uncompressedOffset, frame.m_uncompressedSize);
+    llvm::StringRef data = llvm::StringRef(output).substr(
+      frame.m_compressedOffset, frame.m_compressedSize);
+    if (format == CF_GZIP) {
+      EXPECT_EQ(gunzipFrame(data, expect), expect.str());
+    }
+    else {
+      EXPECT_EQ(unzstdFrame(data, expect.size()), expect.str());
+    }
+
+    uncompressedOffset += frame.m_uncompressedSize;
+    compressedOffset += frame.m_compressedSize;
+  }
+  EXPECT_EQ(uncompressedOffset, (std::uint64_t)input.size());
+  EXPECT_EQ(compressedOffset, (std::uint64_t)output.size());
+
+  // The repetitive input should compress well.
+  EXPECT_EQ(output.size() * 4 < input.size(), true);
+}
+
+
+void testFrameIndex()
+{
+  std::vector<CompressedFrame> frames(2);
+  frames[0].m_uncompressedSize = 100;
+  frames[0].m_compressedSize = 30;
+  frames[1].m_uncompressedOffset = 100;
+  frames[1].m_uncompressedSize = 50;
+  frames[1].m_compressedOffset = 30;
+  frames[1].m_compressedSize = 20;
+
+  std::ostringstream oss;
+  writeCompressedFrameIndex(oss, frames);
+  EXPECT_EQ(oss.str(),
+    "pca-frame-index 1\n"
+    "0 100 0 30\n"
+    "100 50 30 20\n");
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void compressed_output_unit_tests()
+{
+  testParseFormat();
+  testFrames(CF_GZIP);
+  testFrames(CF_ZSTD);
+  testFrameIndex();
+}
+
+
+// EOF
@@ -0,0 +1,347 @@
+// compressed-output.cc
+// Code for `compressed-output.h`.
+
+#include "compressed-output.h"                   // this module
+
+#include "smbase/string-util.h"                  // doubleQuote
+#include "smbase/stringb.h"                      // stringb
+
+#include "llvm/ADT/ArrayRef.h"                   // llvm::ArrayRef
+#include "llvm/ADT/SmallVector.h"                // llvm::SmallVector
+#include "llvm/ADT/StringExtras.h"               // llvm::{arrayRefFromStringRef, toStringRef}
+#include "llvm/Config/llvm-config.h"             // LLVM_VERSION_MAJOR
+#include "llvm/Support/CRC.h"                    // llvm::crc32
+#include "llvm/Support/Compression.h"            // llvm::compression
+#include "llvm/Support/Error.h"                  // llvm::{Error, toString}
+
+#include <ostream>                               // std::ostream
+#include <utility>                               // std::move
+
+
+// Number of full frames that may wait for the background thread.
+static std::size_t const maxPendingFrames = 4;
+
+
+std::string parseCompressionFormat(
+  CompressionFormat /*OUT*/ &format,
+  std::string const &name)
+{
+  if (name.empty()) {
+    format = CF_NONE;
+  }
+  else if (name == "gzip") {
+    format = CF_GZIP;
+  }
+  else if (name == "zstd") {
+    format = CF_ZSTD;
+  }
+  else {
+    return stringb("unknown compression format " << doubleQuote(name) <<
+                   "; expected \"gzip\" or \"zstd\"");
+  }
+  return "";
+}
+
+
+char const *compressionFormatExtension(CompressionFormat format)
+{
+  switch (format) {
+    case CF_GZIP: return ".gz";
+    case CF_ZSTD: return ".zst";
+    default:      return "";
+  }
+}
+
+
+// ---------------------------- zlib and gzip ----------------------------
+// Compress 'data' in the zlib format (RFC 1950).
+static std::string zlibCompress(
+  llvm::SmallVectorImpl<uint8_t> /*OUT*/ &out,
+  llvm::StringRef data)
+{
+#if LLVM_VERSION_MAJOR >= 15
+  if (!llvm::compression::zlib::isAvailable()) {
+    return "this build of LLVM does not support zlib";
+  }
+  llvm::compression::zlib::compress(llvm::arrayRefFromStringRef(data),
+                                    out);
+#else
+  if (!llvm::zlib::isAvailable()) {
+    return "this build of LLVM does not support zlib";
+  }
+  llvm::SmallVector<char, 0> compressed;
+  if (llvm::Error err = llvm::zlib::compress(data, compressed)) {
+    return llvm::toString(std::move(err));
+  }
+  out.assign(compressed.begin(), compressed.end());
+#endif
+  return "";
+}
+
+
+// Append 'value' to 'dest' as 4 little-endian bytes.
+static void appendLE32(std::string &dest, std::uint32_t value)
+{
+  for (int i=0; i < 4; ++i) {
+    dest.push_back((char)(value >> (8*i)));
+  }
+}
+
+
+// Fixed header of the gzip members we write (RFC 1952): magic, deflate,
+// no flags, no time stamp, no extra flags, unknown OS.
+static char const gzipHeader[10] = {
+  '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'
+};
+
+// Size of the zlib header and of its Adler-32 trailer.
+static std::size_t const zlibHeaderSize = 2;
+static std::size_t const zlibTrailerSize = 4;
+
+
+// LLVM only offers the zlib wrapping, so the gzip member is made by
+// replacing the zlib header and trailer around the deflate data.
+static std::string gzipCompressFrame(
+  std::string /*INOUT*/ &dest,
+  llvm::StringRef data)
+{
+  llvm::SmallVector<uint8_t, 0> zlibData;
+  std::string err = zlibCompress(zlibData, data);
+  if (!err.empty()) {
+    return err;
+  }
+  if (zlibData.size() < zlibHeaderSize + zlibTrailerSize) {
+    return "zlib output is too short";
+  }
+
+  dest.append(gzipHeader, sizeof(gzipHeader));
+  dest.append(zlibData.begin() + zlibHeaderSize,
+              zlibData.end() - zlibTrailerSize);
+  appendLE32(dest, llvm::crc32(llvm::arrayRefFromStringRef(data)));
+  appendLE32(dest, (std::uint32_t)data.size());
+  return "";
+}
+
+
+
+// --------------------------------- zstd ---------------------------------
+static std::string zstdCompressFrame(
+  std::string /*INOUT*/ &dest,
+  llvm::StringRef data)
+{
+#if LLVM_VERSION_MAJOR >= 16
+  if (!llvm::compression::zstd::isAvailable()) {
+    return "this build of LLVM does not support zstd";
+  }
+  llvm::SmallVector<uint8_t, 0> out;
+  llvm::compression::zstd::compress(llvm::arrayRefFromStringRef(data), out);
+  dest.append(out.begin(), out.end());
+  return "";
+#else
+  (void)dest;
+  (void)data;
+  return "zstd compression requires LLVM 16 or later";
+#endif
+}
+
+
+// ----------------------------- frame format -----------------------------
+std::string compressFrame(
+  std::string /*INOUT*/ &dest,
+  CompressionFormat format,
+  llvm::StringRef data)
+{
+  switch (format) {
+    case CF_GZIP: return gzipCompressFrame(dest, data);
+    case CF_ZSTD: return zstdCompressFrame(dest, data);
+    default:      return "no compression format";
+  }
+}
+
+
+void writeCompressedFrameIndex(
+  std::ostream &os,
+  std::vector<CompressedFrame> const &frames)
+{
+  os << "pca-frame-index 1\n";
+  for (CompressedFrame const &frame : frames) {
+    os << frame.m_uncompressedOffset << ' '
+       << frame.m_uncompressedSize << ' '
+       << frame.m_compressedOffset << ' '
+       << frame.m_compressedSize << "\n";
+  }
+}
+
+
+// ------------------------- CompressingStreamBuf -------------------------
+CompressingStreamBuf::CompressingStreamBuf(
+  std::ostream &dest,
+  CompressionFormat format,
+  std::size_t frameSize)
+  : m_dest(dest),
+    m_format(format),
+    m_frameSize(frameSize? frameSize : 1),
+    m_current(),
+    m_submittedBytes(0),
+    m_mutex(),
+    m_changed(),
+    m_pending(),
+    m_finishing(false),
+    m_error(),
+    m_frames(),
+    m_thread()
+{
+  m_current.resize(m_frameSize);
+  setp(&m_current[0], &m_current[0] + m_frameSize);
+
+  // Start the thread last so it sees fully constructed members.
+  m_thread = std::thread(&CompressingStreamBuf::compressLoop, this);
+}
+
+
+CompressingStreamBuf::~CompressingStreamBuf()
+{
+  if (m_thread.joinable()) {
+    (void)finish();
+  }
+}
+
+
+void CompressingStreamBuf::compressLoop()
+{
+  std::uint64_t uncompressedOffset = 0;
+  std::uint64_t compressedOffset = 0;
+  std::string compressed;
+
+  while (true) {
+    std::string frame;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_changed.wait(lock, [this] {
+        return !m_pending.empty() || m_finishing;
+      });
+      if (m_pending.empty()) {
+        return;
+      }
+      frame = std::move(m_pending.front());
+      m_pending.pop_front();
+    }
+
+    // There is now room in the queue.
+    m_changed.notify_all();
+
+    compressed.clear();
+    std::string err = compressFrame(compressed, m_format, frame);
+    if (err.empty()) {
+      m_dest.write(compressed.data(), compressed.size());
+      if (!m_dest) {
+        err = "error writing compressed output";
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!err.empty()) {
+      if (m_error.empty()) {
+        m_error = err;
+      }
+      continue;
+    }
+
+    CompressedFrame entry;
+    entry.m_uncompressedOffset = uncompressedOffset;
+    entry.m_uncompressedSize = frame.size();
+    entry.m_compressedOffset = compressedOffset;
+    entry.m_compressedSize = compressed.size();
+    m_frames.push_back(entry);
+
+    uncompressedOffset += frame.size();
+    compressedOffset += compressed.size();
+  }
+}
+
+
+void CompressingStreamBuf::submitCurrent()
+{
+  m_current.resize(pptr() - pbase());
+  m_submittedBytes += m_current.size();
+
+  if (!m_current.empty()) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] {
+      return m_pending.size() < maxPendingFrames;
+    });
+    m_pending.push_back(std::move(m_current));
+    lock.unlock();
+    m_changed.notify_all();
+  }
+
+  m_current.clear();
+  m_current.resize(m_frameSize);
+  setp(&m_current[0], &m_current[0] + m_frameSize);
+}
+
+
+CompressingStreamBuf::int_type CompressingStreamBuf::overflow(int_type c)
+{
+  if (!m_thread.joinable()) {
+    // Already finished.
+    return traits_type::eof();
+  }
+
+  submitCurrent();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+
+int CompressingStreamBuf::sync()
+{
+  // Deliberately does not end the frame; see the class comment.
+  return 0;
+}
+
+
+CompressingStreamBuf::pos_type CompressingStreamBuf::seekoff(
+  off_type off,
+  std::ios_base::seekdir dir,
+  std::ios_base::openmode which)
+{
+  // Only report the position; see the class comment.
+  if (off != 0 ||
+      dir != std::ios_base::cur ||
+      !(which & std::ios_base::out)) {
+    return pos_type(off_type(-1));
+  }
+  return pos_type(off_type(m_submittedBytes + (pptr() - pbase())));
+}
+
+
+std::string CompressingStreamBuf::finish()
+{
+  if (m_thread.joinable()) {
+    submitCurrent();
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_finishing = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+
+    // Nothing more may be written.
+    setp(nullptr, nullptr);
+
+    m_dest.flush();
+    if (!m_dest && m_error.empty()) {
+      m_error = "error writing compressed output";
+    }
+  }
+
+  return m_error;
+}
+
+
+// EOF
@@ -0,0 +1,171 @@
+// compressed-output.h
+// Compress an output stream in independent frames, on a background
+// thread.
+
+#ifndef PCA_COMPRESSED_OUTPUT_H
+#define PCA_COMPRESSED_OUTPUT_H
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <condition_variable>                    // std::condition_variable
+#include <cstddef>                               // std::size_t
+#include <cstdint>                               // std::uint64_t
+#include <deque>                                 // std::deque
+#include <iosfwd>                                // std::ostream
+#include <mutex>                                 // std::mutex
+#include <streambuf>                             // std::streambuf
+#include <string>                                // std::string
+#include <thread>                                // std::thread
+#include <vector>                                // std::vector
+
+
+// Supported ways to compress a frame.
+enum CompressionFormat {
+  // No compression.
+  CF_NONE,
+
+  // Each frame is a gzip member, so the concatenation is a valid gzip
+  // file.
+  CF_GZIP,
+
+  // Each frame is a zstd frame, so the concatenation is a valid zstd
+  // file.  Requires LLVM 16 or later, built with zstd.
+  CF_ZSTD,
+};
+
+// Set 'format' from its name, "gzip" or "zstd", or "" for CF_NONE.
+// Returns "" or an error message.
+std::string parseCompressionFormat(
+  CompressionFormat /*OUT*/ &format,
+  std::string const &name);
+
+// File name extension for 'format', like ".gz", or "" for CF_NONE.
+char const *compressionFormatExtension(CompressionFormat format);
+
+// Append to 'dest' the compression of 'data' as one self-contained
+// frame.  Returns "" or an error message, for example if LLVM was built
+// without support for 'format'.
+std::string compressFrame(
+  std::string /*INOUT*/ &dest,
+  CompressionFormat format,
+  llvm::StringRef data);
+
+// Where one frame is in the uncompressed and compressed streams.
+class CompressedFrame {
+public:      // data
+  std::uint64_t m_uncompressedOffset = 0;
+  std::uint64_t m_uncompressedSize = 0;
+  std::uint64_t m_compressedOffset = 0;
+  std::uint64_t m_compressedSize = 0;
+};
+
+// Write 'frames' to 'os' as a text index: a header line, then one line
+// per frame with its uncompressed offset and size followed by its
+// compressed offset and size.  With it, a reader can map an offset in
+// the uncompressed output, such as one from a node index, to the frame
+// that contains it, and decompress only that frame.
+void writeCompressedFrameIndex(
+  std::ostream &os,
+  std::vector<CompressedFrame> const &frames);
+
+
+/*
+  A `streambuf` that collects what is written into frames of a fixed
+  uncompressed size, and hands each full frame to a background thread
+  that compresses it and writes it to the destination.  Formatting the
+  output and compressing it thereby overlap.
+
+  Only the background thread writes to the destination, so nothing else
+  may write to it until `finish` returns.  `sync` does not end a frame,
+  since the printers flush often and small frames compress poorly.
+
+  The stream position, as `tellp` reports it, is the number of
+  uncompressed bytes written so far, which is the base the frame offsets
+  use.  Seeking is not supported.
+
+  At most a few frames wait to be compressed at any time; beyond that,
+  writing blocks until the background thread catches up, which bounds
+  the memory used.
+*/
+class CompressingStreamBuf : public std::streambuf {
+  NO_OBJECT_COPIES(CompressingStreamBuf);
+
+private:     // data
+  // Where compressed frames go.
+  std::ostream &m_dest;
+
+  // How to compress, and the uncompressed size of each frame.
+  CompressionFormat const m_format;
+  std::size_t const m_frameSize;
+
+  // Frame being filled, which is the put area.
+  std::string m_current;
+
+  // Number of uncompressed bytes in the frames before 'm_current'.
+  std::uint64_t m_submittedBytes;
+
+  // Protects the members below it.
+  std::mutex m_mutex;
+
+  // Signaled when 'm_pending' or 'm_finishing' changes.
+  std::condition_variable m_changed;
+
+  // Full frames waiting to be compressed, oldest first.
+  std::deque<std::string> m_pending;
+
+  // Set once no more frames will be added.
+  bool m_finishing;
+
+  // First error encountered by the background thread, or "".
+  std::string m_error;
+
+  // Location of each frame written.
+  std::vector<CompressedFrame> m_frames;
+
+  // Compresses and writes the frames in 'm_pending'.
+  std::thread m_thread;
+
+private:     // methods
+  // Body of 'm_thread'.
+  void compressLoop();
+
+  // Hand the filled part of the put area to the background thread and
+  // start a new frame.
+  void submitCurrent();
+
+public:      // methods
+  // Compress into 'dest' using 'format', which must not be CF_NONE,
+  // with frames of 'frameSize' uncompressed bytes.
+  CompressingStreamBuf(
+    std::ostream &dest,
+    CompressionFormat format,
+    std::size_t frameSize);
+
+  // Calls `finish` if it has not been called.
+  ~CompressingStreamBuf();
+
+  // Write the final partial frame, wait for all frames to be written,
+  // and flush the destination.  Returns "" or an error message.
+  std::string finish();
+
+  // After `finish`, the locations of the frames written.
+  std::vector<CompressedFrame> const &frames() const
+    { return m_frames; }
+
+  // std::streambuf methods.
+  virtual int_type overflow(int_type c) override;
+  virtual int sync() override;
+  virtual pos_type seekoff(
+    off_type off,
+    std::ios_base::seekdir dir,
+    std::ios_base::openmode which) override;
+};
+
+
+// Unit tests, defined in compressed-output-test.cc.
+void compressed_output_unit_tests();
+
+
+#endif // PCA_COMPRESSED_OUTPUT_H
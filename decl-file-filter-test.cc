@@ -0,0 +1,147 @@
+// decl-file-filter-test.cc
+// Tests for `decl-file-filter` module.
+
+#include "decl-file-filter.h"          // module under test
+
+#include "clang-ast.h"                 // ClangAST, ClangASTUtilTempFile
+
+#include "smbase/sm-macros.h"          // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"            // EXPECT_EQ
+
+#include "clang/AST/Decl.h"            // clang::NamedDecl
+#include "clang/AST/DeclBase.h"        // clang::DeclContext
+
+#include <map>                         // std::map
+#include <string>                      // std::string
+
+using clang::dyn_cast;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Map from qualified name to whether it is pruned.
+typedef std::map<std::string, bool> PrunedMap;
+
+
+// Add to 'results' the pruning status of every named declaration in
+// 'dc', recursively.
+void collectPruned(
+  PrunedMap &results,
+  DeclFileFilter &filter,
+  clang::DeclContext const *dc)
+{
+  for (clang::Decl const *decl : dc->decls()) {
+    if (decl->isImplicit()) {
+      continue;
+    }
+
+    if (auto namedDecl = dyn_cast<clang::NamedDecl>(decl)) {
+      results[namedDecl->getQualifiedNameAsString()] =
+        filter.isPrunedDecl(decl);
+    }
+
+    if (auto innerDC = dyn_cast<clang::DeclContext>(decl)) {
+      collectPruned(results, filter, innerDC);
+    }
+  }
+}
+
+
+void testIsPrunedDecl()
+{
+  ClangAST::addInMemoryFile("/pca-in-memory/dff-test/a.h", R"(
+    int inA;
+    namespace NA {
+      int inNA;
+      struct SA {
+        int m;
+      };
+    }
+  )");
+  ClangAST::addInMemoryFile("/pca-in-memory/dff-test/b.h", R"(
+    extern "C" {
+      int inB;
+    }
+  )");
+
+  ClangASTUtilTempFile ast(R"(
+    #include "/pca-in-memory/dff-test/a.h"
+    #include "/pca-in-memory/dff-test/b.h"
+    int inMain;
+    namespace NA {
+      int inMainNA;
+    }
+  )");
+  clang::TranslationUnitDecl const *tu =
+    ast.getASTContext().getTranslationUnitDecl();
+
+  // Only the primary source file.
+  {
+    DeclFileFilter filter(ast.getASTContext(), {});
+    PrunedMap actual;
+    collectPruned(actual, filter, tu);
+
+    EXPECT_EQ(actual.size(), (std::size_t)8);
+
+    // The map entry for "NA" is the one in the primary source file.
+    EXPECT_EQ(actual["NA"], false);
+
+    EXPECT_EQ(actual["NA::inNA"], true);
+    EXPECT_EQ(actual["NA::SA"], true);
+    EXPECT_EQ(actual["NA::inMainNA"], false);
+    EXPECT_EQ(actual["inA"], true);
+    EXPECT_EQ(actual["inMain"], false);
+
+    // The `extern "C"` context is transparent.
+    EXPECT_EQ(actual["inB"], true);
+
+    // Members go with their container.
+    EXPECT_EQ(actual["NA::SA::m"], false);
+  }
+
+  // Also "b.h", named by a suffix.
+  {
+    DeclFileFilter filter(ast.getASTContext(), {"dff-test/b.h"});
+    PrunedMap actual;
+    collectPruned(actual, filter, tu);
+
+    EXPECT_EQ(actual["inA"], true);
+    EXPECT_EQ(actual["inB"], false);
+    EXPECT_EQ(actual["inMain"], false);
+  }
+
+  // A suffix has to start at a directory separator.
+  {
+    DeclFileFilter filter(ast.getASTContext(), {"a.h", "est/b.h"});
+    EXPECT_EQ(filter.m_extraFileNames.size(), (std::size_t)2);
+    PrunedMap actual;
+    collectPruned(actual, filter, tu);
+
+    EXPECT_EQ(actual["inA"], false);
+    EXPECT_EQ(actual["inB"], true);
+  }
+
+  // Implicit declarations have no location, and are kept.
+  {
+    DeclFileFilter filter(ast.getASTContext(), {});
+    for (clang::Decl const *decl : tu->decls()) {
+      if (decl->isImplicit() && decl->getLocation().isInvalid()) {
+        EXPECT_EQ(filter.isPrunedDecl(decl), false);
+      }
+    }
+  }
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void decl_file_filter_unit_tests()
+{
+  testIsPrunedDecl();
+}
+
+
+// EOF
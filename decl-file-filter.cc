@@ -0,0 +1,108 @@
+// decl-file-filter.cc
+// Code for decl-file-filter.h.
+
+#include "decl-file-filter.h"                    // this module
+
+#include "clang/AST/Decl.h"                      // clang::{TranslationUnitDecl, NamespaceDecl}
+#include "clang/AST/DeclBase.h"                  // clang::{Decl, DeclContext}
+#include "clang/Basic/SourceManager.h"           // clang::SourceManager
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+#include "llvm/Support/Casting.h"                // llvm::isa
+
+#include "smbase/sm-macros.h"                    // STATICDEF
+
+
+using clang::isa;
+
+
+DeclFileFilter::DeclFileFilter(
+  clang::ASTContext &astContext,
+  std::vector<std::string> const &extraFileNames)
+  : ClangUtil(astContext),
+    m_extraFileNames(extraFileNames),
+    m_fileIsKept()
+{}
+
+
+DeclFileFilter::~DeclFileFilter()
+{}
+
+
+bool DeclFileFilter::computeFileIsKept(clang::FileID fileID) const
+{
+  if (fileID == m_mainFileID) {
+    return true;
+  }
+
+  if (m_extraFileNames.empty()) {
+    return false;
+  }
+
+  // Things like the predefines buffer have no file entry.
+  auto entry = m_srcMgr.getFileEntryRefForID(fileID);
+  if (!entry) {
+    return false;
+  }
+
+  std::string fname = fileEntryRefNameStr(*entry);
+  for (std::string const &extra : m_extraFileNames) {
+    if (fileNameMatches(fname, extra)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+STATICDEF bool DeclFileFilter::fileNameMatches(
+  llvm::StringRef fname,
+  llvm::StringRef pattern)
+{
+  return fname == pattern ||
+         (fname.endswith(pattern) &&
+          fname.drop_back(pattern.size()).endswith("/"));
+}
+
+
+bool DeclFileFilter::fileIsKept(clang::FileID fileID)
+{
+  auto it = m_fileIsKept.find(fileID);
+  if (it != m_fileIsKept.end()) {
+    return it->second;
+  }
+
+  bool kept = computeFileIsKept(fileID);
+  m_fileIsKept.insert({fileID, kept});
+  return kept;
+}
+
+
+STATICDEF bool DeclFileFilter::isPrunableContext(
+  clang::DeclContext const *dc)
+{
+  while (dc && dc->isTransparentContext()) {
+    dc = dc->getLexicalParent();
+  }
+  return dc &&
+         (isa<clang::TranslationUnitDecl>(dc) ||
+          isa<clang::NamespaceDecl>(dc));
+}
+
+
+bool DeclFileFilter::isPrunedDecl(clang::Decl const *decl)
+{
+  if (!isPrunableContext(decl->getLexicalDeclContext())) {
+    return false;
+  }
+
+  clang::SourceLocation loc = decl->getLocation();
+  if (loc.isInvalid()) {
+    return false;
+  }
+
+  return !fileIsKept(getExpansionFileID(loc));
+}
+
+
+// EOF
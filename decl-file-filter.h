@@ -0,0 +1,71 @@
+// decl-file-filter.h
+// DeclFileFilter, deciding which declarations belong to files of
+// interest.
+
+#ifndef DECL_FILE_FILTER_H
+#define DECL_FILE_FILTER_H
+
+#include "clang-util.h"                          // ClangUtil
+
+#include "clang/AST/ASTFwd.h"                    // clang::Decl [n]
+#include "clang/AST/DeclBase.h"                  // clang::DeclContext [n]
+#include "clang/Basic/SourceLocation.h"          // clang::FileID
+
+#include "llvm/ADT/DenseMap.h"                   // llvm::DenseMap
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+// Decide whether a top-level declaration comes from the primary source
+// file (PSF), or from one of a set of additional files of interest, so
+// that declarations from other files (typically, the headers it
+// #includes) can be left out of a traversal.
+//
+// Only declarations whose lexical context is the translation unit or a
+// namespace are ever pruned.  Anything nested inside them goes with its
+// container.
+class DeclFileFilter : public ClangUtil {
+public:      // data
+  // Names of files, other than the PSF, whose declarations are kept.
+  // A file matches if its name is equal to one of these or ends with
+  // "/" followed by one of these.
+  std::vector<std::string> m_extraFileNames;
+
+  // Map from a FileID to whether its declarations are kept.
+  llvm::DenseMap<clang::FileID, bool> m_fileIsKept;
+
+private:     // methods
+  // Return true if declarations in 'fileID' are kept.
+  bool computeFileIsKept(clang::FileID fileID) const;
+
+public:      // methods
+  DeclFileFilter(clang::ASTContext &astContext,
+                 std::vector<std::string> const &extraFileNames);
+
+  ~DeclFileFilter();
+
+  // True if 'fname' is equal to 'pattern' or ends with "/" followed by
+  // 'pattern'.  This is how 'm_extraFileNames' are matched.
+  static bool fileNameMatches(llvm::StringRef fname,
+                              llvm::StringRef pattern);
+
+  // True if declarations in 'fileID' are kept, using the cache.
+  bool fileIsKept(clang::FileID fileID);
+
+  // True if 'dc' is a context whose immediate members can be pruned,
+  // after skipping transparent contexts like `extern "C"`.
+  static bool isPrunableContext(clang::DeclContext const *dc);
+
+  // True if 'decl' should be left out: it is an immediate member of a
+  // prunable context, and its location, which must be valid, is outside
+  // the PSF and the extra files.
+  //
+  // Declarations without a valid location, such as implicit builtins,
+  // are never pruned.
+  bool isPrunedDecl(clang::Decl const *decl);
+};
+
+
+#endif // DECL_FILE_FILTER_H
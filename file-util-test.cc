@@ -43,6 +43,16 @@ void file_util_unit_tests()
       os << c;
     }
     assert(os.str() == "# print-clang-ast/Makefile");
+
+    // Write a copy and read it back.  The Makefile creates "out".
+    string copyFname = "out/file-util-test.txt";
+    err = writeFile(copyFname, contents);
+    assert(err.empty());
+    string copy;
+    err = readFile(copy /*OUT*/, copyFname);
+    assert(err.empty() && copy == contents);
+
+    assert(!writeFile("out/nonexistent-dir/x", "").empty());
   }
   else {
     // Print the entire thing and exit.
@@ -12,7 +12,7 @@
 
 // libc++
 #include <cstring>                               // std::strerror
-#include <fstream>                               // std::ifstream
+#include <fstream>                               // std::{ifstream, ofstream}
 #include <sstream>                               // std::ostringstream
 
 // libc
@@ -37,4 +37,21 @@ std::string readFile(std::string /*OUT*/ &contents,
 }
 
 
+std::string writeFile(std::string const &fname,
+                      std::string const &contents)
+{
+  std::ofstream outFile(fname.c_str(), std::ios::binary);
+  if (outFile) {
+    outFile << contents;
+    outFile.close();
+  }
+  if (!outFile) {
+    return stringb(doubleQuote(fname) << ": " <<
+                   std::strerror(errno));
+  }
+
+  return "";
+}
+
+
 // EOF
@@ -12,6 +12,11 @@
 std::string readFile(std::string /*OUT*/ &contents,
                      std::string const &fname);
 
+// Write 'contents' to 'fname', replacing whatever it held.  On error,
+// return an error message (otherwise "").
+std::string writeFile(std::string const &fname,
+                      std::string const &contents);
+
 // Unit tests, defined in file-util-test.cc.
 void file_util_unit_tests();
 
@@ -10,4 +10,7 @@ int f(int x)
   return x;                            // SYMLINE(returnLine)
 }
 
+// The expected output includes declarations from the header.
+// PRINT_CLANG_AST_OPTIONS: --full-tu
+
 // EOF
@@ -11,4 +11,7 @@ int MethodComments::foo()
 }
 
 
+// The expected output includes declarations from the header.
+// PRINT_CLANG_AST_OPTIONS: --full-tu
+
 // EOF
@@ -0,0 +1,124 @@
+// json-stream-writer-test.cc
+// Tests for `json-stream-writer`.
+
+#include "json-stream-writer.h"                  // module under test
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+#include "smbase/string-util.h"                  // doubleQuote
+
+#include <cstdint>                               // std::uint64_t
+#include <sstream>                               // std::ostringstream
+#include <string>                                // std::string
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Return what `writeQuoted` produces for 's'.
+string quoted(string const &s)
+{
+  std::ostringstream oss;
+  {
+    JSONStreamWriter writer(oss);
+    writer.writeQuoted(s);
+  }
+  return oss.str();
+}
+
+
+void testWriteQuoted()
+{
+  EXPECT_EQ(quoted(""), "\"\"");
+  EXPECT_EQ(quoted("hi there"), "\"hi there\"");
+  EXPECT_EQ(quoted("a\"b\\c"), "\"a\\\"b\\\\c\"");
+
+  // Must agree with `doubleQuote`, including when it takes over.
+  char const * const inputs[] = {
+    "", "x", "\"int\"", "a\\b", "tab\there", "nl\n", "\x01\x7f\xff",
+    "mixed \"q\" \x80 end",
+  };
+  for (char const *input : inputs) {
+    EXPECT_EQ(quoted(input), doubleQuote(input));
+  }
+}
+
+
+void testStreamsAndScratch()
+{
+  std::ostringstream oss;
+  JSONStreamWriter writer(oss);
+
+  writer.write("  ");
+  std::size_t mark = writer.scratchMark();
+  writer.scratch() << "Decl::" << "Loc";
+  writer.writeQuotedScratch(mark);
+  writer.write(": ");
+  writer.out() << 42;
+  writer.write(",\n");
+
+  // Nested use of the scratch buffer.
+  std::size_t outer = writer.scratchMark();
+  writer.scratch() << "outer";
+  {
+    std::size_t inner = writer.scratchMark();
+    writer.scratch() << "\"inner\"";
+    writer.writeQuotedScratch(inner);
+  }
+  writer.writeQuotedScratch(outer);
+
+  // Trimming.
+  mark = writer.scratchMark();
+  writer.scratch() << " a b ";
+  writer.writeQuotedScratch(mark, true /*trimWhitespace*/);
+  EXPECT_EQ(writer.scratchMark(), (std::size_t)0);
+
+  // Nothing reaches the destination until flushed.
+  EXPECT_EQ(oss.str(), "");
+
+  writer.out().flush();
+  EXPECT_EQ(oss.str(),
+    "  \"Decl::Loc\": 42,\n"
+    "\"\\\"inner\\\"\"\"outer\"\"a b\"");
+}
+
+
+void testFlushIfFull()
+{
+  std::ostringstream oss;
+  JSONStreamWriter writer(oss, 4 /*flushThreshold*/);
+
+  writer.write("abc");
+  writer.flushIfFull();
+  EXPECT_EQ(oss.str(), "");
+  EXPECT_EQ(writer.bytesWritten(), (std::uint64_t)3);
+
+  writer.write("d");
+  writer.flushIfFull();
+  EXPECT_EQ(oss.str(), "abcd");
+  EXPECT_EQ(writer.bytesWritten(), (std::uint64_t)4);
+
+  writer.write("e");
+  EXPECT_EQ(writer.writtenSince(4).str(), "e");
+  EXPECT_EQ(writer.writtenSince(5).str(), "");
+  writer.flush();
+  EXPECT_EQ(oss.str(), "abcde");
+  EXPECT_EQ(writer.bytesWritten(), (std::uint64_t)5);
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void json_stream_writer_unit_tests()
+{
+  testWriteQuoted();
+  testStreamsAndScratch();
+  testFlushIfFull();
+}
+
+
+// EOF
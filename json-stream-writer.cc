@@ -0,0 +1,137 @@
+// json-stream-writer.cc
+// Code for `json-stream-writer.h`.
+
+#include "json-stream-writer.h"                  // this module
+
+#include "smbase/string-util.h"                  // doubleQuote
+
+
+// ------------------------------ AppendBuf ------------------------------
+JSONStreamWriter::AppendBuf::AppendBuf(JSONStreamWriter *syncTarget)
+  : std::streambuf(),
+    m_str(),
+    m_syncTarget(syncTarget)
+{}
+
+
+JSONStreamWriter::AppendBuf::int_type
+JSONStreamWriter::AppendBuf::overflow(int_type c)
+{
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    m_str.push_back(traits_type::to_char_type(c));
+  }
+  return traits_type::not_eof(c);
+}
+
+
+std::streamsize JSONStreamWriter::AppendBuf::xsputn(
+  char const *s,
+  std::streamsize n)
+{
+  m_str.append(s, n);
+  return n;
+}
+
+
+int JSONStreamWriter::AppendBuf::sync()
+{
+  if (m_syncTarget) {
+    m_syncTarget->flush();
+  }
+  return 0;
+}
+
+
+// -------------------------- JSONStreamWriter ---------------------------
+JSONStreamWriter::JSONStreamWriter(
+  std::ostream &dest,
+  std::size_t flushThreshold)
+  : m_dest(dest),
+    m_flushThreshold(flushThreshold),
+    m_flushedBytes(0),
+    m_outBuf(this),
+    m_out(&m_outBuf),
+    m_scratchBuf(nullptr),
+    m_scratch(&m_scratchBuf)
+{
+  m_outBuf.m_str.reserve(flushThreshold + flushThreshold/4);
+}
+
+
+JSONStreamWriter::~JSONStreamWriter()
+{
+  flush();
+}
+
+
+// Return true if 'c' is written as itself inside a quoted string.
+static bool isPlainChar(char c)
+{
+  return 0x20 <= c && c <= 0x7E && c != '"' && c != '\\';
+}
+
+
+void JSONStreamWriter::writeQuoted(llvm::StringRef s)
+{
+  std::string &buf = m_outBuf.m_str;
+  std::size_t const start = buf.size();
+
+  buf.push_back('"');
+  for (char c : s) {
+    if (isPlainChar(c)) {
+      buf.push_back(c);
+    }
+    else if (c == '"' || c == '\\') {
+      buf.push_back('\\');
+      buf.push_back(c);
+    }
+    else {
+      // Anything else is rare enough to hand to `doubleQuote`, which
+      // then defines the escaping of the whole string.
+      buf.resize(start);
+      buf += doubleQuote(s.str());
+      return;
+    }
+  }
+  buf.push_back('"');
+}
+
+
+void JSONStreamWriter::writeQuotedScratch(
+  std::size_t mark,
+  bool trimWhitespace)
+{
+  std::string &scratch = m_scratchBuf.m_str;
+  llvm::StringRef s(scratch.data() + mark, scratch.size() - mark);
+
+  if (trimWhitespace) {
+    s = s.trim(" \t\n\v\f\r");
+  }
+  writeQuoted(s);
+
+  scratch.resize(mark);
+}
+
+
+void JSONStreamWriter::flushIfFull()
+{
+  if (m_outBuf.m_str.size() >= m_flushThreshold) {
+    m_dest.write(m_outBuf.m_str.data(), m_outBuf.m_str.size());
+    m_flushedBytes += m_outBuf.m_str.size();
+
+    // This keeps the capacity.
+    m_outBuf.m_str.clear();
+  }
+}
+
+
+void JSONStreamWriter::flush()
+{
+  m_dest.write(m_outBuf.m_str.data(), m_outBuf.m_str.size());
+  m_flushedBytes += m_outBuf.m_str.size();
+  m_outBuf.m_str.clear();
+  m_dest.flush();
+}
+
+
+// EOF
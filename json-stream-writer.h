@@ -0,0 +1,133 @@
+// json-stream-writer.h
+// `JSONStreamWriter`, a buffered writer for JSON-like output.
+
+#ifndef PCA_JSON_STREAM_WRITER_H
+#define PCA_JSON_STREAM_WRITER_H
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <cstddef>                               // std::size_t
+#include <cstdint>                               // std::uint64_t
+#include <ostream>                               // std::ostream
+#include <streambuf>                             // std::streambuf
+#include <string>                                // std::string
+
+
+/*
+  Accumulate output in a large buffer that is reused for the life of
+  the writer, and pass it to a destination stream in big chunks.
+
+  Quoted strings are escaped the same way as `doubleQuote`, but written
+  straight into the buffer, so printing an attribute does not need any
+  temporary strings once the buffers have grown to their working size.
+
+  Arbitrary values can be formatted with the `<<` operator onto
+  `out()`, which appends to the same buffer, or onto `scratch()`,
+  whose contents can then be moved into the output as a quoted string
+  with `writeQuotedScratch`.
+*/
+class JSONStreamWriter {
+  NO_OBJECT_COPIES(JSONStreamWriter);
+
+private:     // types
+  // A `streambuf` that appends everything to a string.
+  class AppendBuf : public std::streambuf {
+  public:      // data
+    // Accumulated characters.
+    std::string m_str;
+
+    // If not null, `sync` calls `flush` on this.
+    JSONStreamWriter *m_syncTarget;
+
+  public:      // methods
+    explicit AppendBuf(JSONStreamWriter *syncTarget);
+
+    // std::streambuf methods.
+    virtual int_type overflow(int_type c) override;
+    virtual std::streamsize xsputn(char const *s,
+                                   std::streamsize n) override;
+    virtual int sync() override;
+  };
+
+private:     // data
+  // Where the output ultimately goes.
+  std::ostream &m_dest;
+
+  // Once the buffer has at least this many bytes, `flushIfFull` passes
+  // it to 'm_dest'.
+  std::size_t m_flushThreshold;
+
+  // Number of bytes passed to 'm_dest' so far.
+  std::uint64_t m_flushedBytes;
+
+  // Output not yet written to 'm_dest', and a stream that appends to it.
+  AppendBuf m_outBuf;
+  std::ostream m_out;
+
+  // Scratch space, and a stream that appends to it.
+  AppendBuf m_scratchBuf;
+  std::ostream m_scratch;
+
+public:      // methods
+  // Write to 'dest'.  'flushThreshold' is the approximate size of the
+  // chunks passed to it.
+  explicit JSONStreamWriter(std::ostream &dest,
+                            std::size_t flushThreshold = 1 << 20);
+
+  // Flushes anything remaining.
+  ~JSONStreamWriter();
+
+  // Stream that appends to the output buffer.  Flushing it is the same
+  // as calling `flush`.
+  std::ostream &out() { return m_out; }
+
+  // Number of bytes written so far, whether or not they have been
+  // passed to the destination yet.
+  std::uint64_t bytesWritten() const
+    { return m_flushedBytes + m_outBuf.m_str.size(); }
+
+  // The output written since `bytesWritten` returned 'offset', which
+  // must not yet have been passed to the destination.  The result is
+  // invalidated by the next write.
+  llvm::StringRef writtenSince(std::uint64_t offset) const
+    { return llvm::StringRef(m_outBuf.m_str).substr(offset - m_flushedBytes); }
+
+  // Append 's' as-is.
+  void write(llvm::StringRef s)
+    { m_outBuf.m_str.append(s.data(), s.size()); }
+
+  // Append 's' surrounded by double quotes and escaped.
+  void writeQuoted(llvm::StringRef s);
+
+  // Stream that appends to the scratch buffer.
+  std::ostream &scratch() { return m_scratch; }
+
+  // Current size of the scratch buffer, to pass to
+  // `writeQuotedScratch`.
+  std::size_t scratchMark() const { return m_scratchBuf.m_str.size(); }
+
+  // Append, as with `writeQuoted`, what has been added to the scratch
+  // buffer since it had size 'mark', then remove that from the scratch
+  // buffer.  If 'trimWhitespace', first remove leading and trailing
+  // whitespace from it.
+  //
+  // Since each use only removes what it added, uses can nest, for
+  // example when computing a value requires quoting another.
+  void writeQuotedScratch(std::size_t mark, bool trimWhitespace = false);
+
+  // Pass the buffered output to the destination if it has reached the
+  // threshold size.
+  void flushIfFull();
+
+  // Pass the buffered output to the destination, and flush that.
+  void flush();
+};
+
+
+// Unit tests, defined in json-stream-writer-test.cc.
+void json_stream_writer_unit_tests();
+
+
+#endif // PCA_JSON_STREAM_WRITER_H
@@ -0,0 +1,458 @@
+// node-binary-dump-reader.h
+// Format of, and a reader for, the output of --print-ast-nodes-binary.
+
+// This header is meant to be copied into, or included by, tools that
+// consume the binary dump, so it only depends on the C++ and POSIX
+// libraries.
+
+#ifndef PCA_NODE_BINARY_DUMP_READER_H
+#define PCA_NODE_BINARY_DUMP_READER_H
+
+#include <cstddef>                               // std::size_t
+#include <cstdint>                               // std::uint32_t, etc.
+#include <cstring>                               // std::memcmp, std::strerror
+#include <string>                                // std::string
+#include <string_view>                           // std::string_view
+
+#include <errno.h>                               // errno
+#include <fcntl.h>                               // open
+#include <sys/mman.h>                            // mmap, munmap
+#include <sys/stat.h>                            // fstat
+#include <unistd.h>                              // close
+
+
+/*
+  The binary dump holds the same node records as --print-ast-nodes, laid
+  out so a consumer can map the file and index into it directly, with
+  no parsing step.
+
+  The file begins with a `NodeBinaryDumpHeader`.  Each section that
+  follows starts at the offset recorded for it in the header, which is
+  a multiple of 8.  All integers use the byte order of the machine that
+  wrote the file; `m_byteOrderMark` lets a reader detect a mismatch.
+
+  Strings are stored once, in the string table, and referred to
+  everywhere else by their index.  String 0 is the empty string.
+
+  Nodes are indexed by their NodeID, the number at the end of their ID
+  string (e.g., 17 for "CXXRecordDecl 17").  As with the numbering,
+  NodeID 0 is never used; the tables have entries for it so they can
+  be indexed directly, but it has no ID string, attributes, or edges.
+  Other IDs can also be absent if the output did not include them.
+
+  The attributes of node N are those with indices in
+  [nodeAttrStart[N], nodeAttrStart[N+1]), in the order they were
+  printed.  Each attribute is stored in columns: its key, its value
+  kind, a 64-bit value whose meaning depends on the kind, and, for
+  pointers, the preview string.
+
+  The edges of node N are the NodeIDs in [nodeEdgeStart[N],
+  nodeEdgeStart[N+1]) of the edge array.  They are the non-null
+  pointer attribute values of N, in order, repeated for convenience
+  when walking the graph.
+*/
+
+
+// First eight bytes of the file.
+#define NODE_BINARY_DUMP_MAGIC "PCANODES"
+
+// Increases whenever the layout changes incompatibly.
+#define NODE_BINARY_DUMP_VERSION 1
+
+// Value of `m_byteOrderMark` when reader and writer agree.
+#define NODE_BINARY_DUMP_BYTE_ORDER_MARK 0x01020304
+
+
+// How to interpret the value of an attribute.
+enum NodeBinaryValueKind : std::uint8_t {
+  // `null`.  The value is 0.
+  NBVK_NULL,
+
+  // `true` or `false`.  The value is 1 or 0.
+  NBVK_BOOL,
+
+  // An integer.  The value is its two's complement bit pattern.
+  NBVK_INT,
+
+  // A quoted string.  The value is the index of the unquoted string.
+  NBVK_STRING,
+
+  // A reference to another node, `{ "ptr": ... }`.  The value is the
+  // target NodeID, or 0 for "null".  The preview column has the
+  // "preview" string, if any.
+  NBVK_PTR,
+
+  // Anything else, such as a list.  The value is the index of the JSON
+  // text as printed, which can span several lines, but without the
+  // trailing commas of the printed form.
+  NBVK_JSON,
+
+  NUM_NODE_BINARY_VALUE_KINDS
+};
+
+
+// Fixed-size header at the start of the file.
+struct NodeBinaryDumpHeader {
+  // NODE_BINARY_DUMP_MAGIC, without a NUL terminator.
+  char m_magic[8];
+
+  // NODE_BINARY_DUMP_VERSION.
+  std::uint32_t m_version;
+
+  // NODE_BINARY_DUMP_BYTE_ORDER_MARK, in the writer's byte order.
+  std::uint32_t m_byteOrderMark;
+
+  // Size of the node tables, which is one more than the largest NodeID.
+  std::uint32_t m_numNodes;
+
+  // Total number of attributes, edges, and strings.
+  std::uint32_t m_numAttrs;
+  std::uint32_t m_numEdges;
+  std::uint32_t m_numStrings;
+
+  // Offsets of the sections, from the start of the file.
+
+  // uint64_t[m_numStrings+1]: start of each string in the string data.
+  // The last element is the size of the string data.
+  std::uint64_t m_stringOffsetsOffset;
+
+  // char[]: the strings, each followed by a NUL.
+  std::uint64_t m_stringDataOffset;
+
+  // uint32_t[m_numNodes]: string index of each node's ID string.
+  std::uint64_t m_nodeIDStringOffset;
+
+  // uint32_t[m_numNodes+1]: index of each node's first attribute.
+  std::uint64_t m_nodeAttrStartOffset;
+
+  // uint32_t[m_numNodes+1]: index of each node's first edge.
+  std::uint64_t m_nodeEdgeStartOffset;
+
+  // uint32_t[m_numAttrs]: string index of each attribute's key.
+  std::uint64_t m_attrKeyOffset;
+
+  // uint8_t[m_numAttrs]: `NodeBinaryValueKind` of each attribute.
+  std::uint64_t m_attrKindOffset;
+
+  // uint64_t[m_numAttrs]: value of each attribute.
+  std::uint64_t m_attrValueOffset;
+
+  // uint32_t[m_numAttrs]: string index of each attribute's preview.
+  std::uint64_t m_attrPreviewOffset;
+
+  // uint32_t[m_numEdges]: target NodeID of each edge.
+  std::uint64_t m_edgeOffset;
+
+  // Total size of the file.
+  std::uint64_t m_fileSize;
+};
+
+
+// Read-only view of a binary dump, either mapped from a file or
+// supplied by the caller as a block of memory.
+//
+// Accessors do not check their arguments beyond what is cheap; the
+// caller is expected to keep IDs below `numNodes()` and attribute
+// indices below `numNodeAttrs(id)`.
+class NodeBinaryDumpReader {
+public:      // types
+  // One attribute of a node.  The string views point into the dump.
+  struct Attr {
+    std::string_view m_key;
+    NodeBinaryValueKind m_kind;
+
+    // Raw value; see `NodeBinaryValueKind`.
+    std::uint64_t m_value;
+
+    // For NBVK_STRING and NBVK_JSON, the string that 'm_value' refers
+    // to.  Otherwise empty.
+    std::string_view m_string;
+
+    // For NBVK_PTR, the preview, possibly empty.  Otherwise empty.
+    std::string_view m_preview;
+
+    // Value as a signed integer, for NBVK_INT.
+    std::int64_t intValue() const
+      { return (std::int64_t)m_value; }
+  };
+
+  // A range of edge targets.
+  struct EdgeRange {
+    std::uint32_t const *m_begin;
+    std::uint32_t const *m_end;
+
+    std::uint32_t const *begin() const { return m_begin; }
+    std::uint32_t const *end() const { return m_end; }
+    std::size_t size() const { return m_end - m_begin; }
+  };
+
+private:     // data
+  // Start and size of the dump.
+  char const *m_data;
+  std::size_t m_size;
+
+  // True if 'm_data' was mapped by `openFile`, and must be unmapped.
+  bool m_mapped;
+
+  // Section pointers, computed from the header.
+  NodeBinaryDumpHeader const *m_header;
+  std::uint64_t const *m_stringOffsets;
+  char const *m_stringData;
+  std::uint32_t const *m_nodeIDString;
+  std::uint32_t const *m_nodeAttrStart;
+  std::uint32_t const *m_nodeEdgeStart;
+  std::uint32_t const *m_attrKey;
+  std::uint8_t const *m_attrKind;
+  std::uint64_t const *m_attrValue;
+  std::uint32_t const *m_attrPreview;
+  std::uint32_t const *m_edges;
+
+private:     // methods
+  // Return true if the section of 'count' elements of 'eltSize' bytes
+  // at 'offset' lies within the dump and is suitably aligned.
+  bool sectionFits(std::uint64_t offset, std::uint64_t count,
+                   std::uint64_t eltSize) const
+  {
+    return offset % 8 == 0 &&
+           offset <= m_size &&
+           count <= (m_size - offset) / eltSize;
+  }
+
+  template <class T>
+  T const *sectionAt(std::uint64_t offset) const
+    { return reinterpret_cast<T const *>(m_data + offset); }
+
+  // Check the header and compute the section pointers.  Return "" or
+  // an error message.
+  std::string setupSections()
+  {
+    if (m_size < sizeof(NodeBinaryDumpHeader)) {
+      return "too small to be a node dump";
+    }
+    m_header = sectionAt<NodeBinaryDumpHeader>(0);
+    NodeBinaryDumpHeader const &h = *m_header;
+
+    if (std::memcmp(h.m_magic, NODE_BINARY_DUMP_MAGIC, 8) != 0) {
+      return "not a node dump";
+    }
+    if (h.m_byteOrderMark != NODE_BINARY_DUMP_BYTE_ORDER_MARK) {
+      return "node dump was written with a different byte order";
+    }
+    if (h.m_version != NODE_BINARY_DUMP_VERSION) {
+      return "node dump has version " + std::to_string(h.m_version) +
+             " but this reader handles version " +
+             std::to_string(NODE_BINARY_DUMP_VERSION);
+    }
+    if (h.m_fileSize != m_size || h.m_numNodes == 0 ||
+        h.m_numStrings == 0) {
+      return "node dump header is inconsistent";
+    }
+
+    std::uint64_t const nodes1 = (std::uint64_t)h.m_numNodes + 1;
+    if (!( sectionFits(h.m_stringOffsetsOffset,
+                       (std::uint64_t)h.m_numStrings + 1, 8) &&
+           sectionFits(h.m_nodeIDStringOffset, h.m_numNodes, 4) &&
+           sectionFits(h.m_nodeAttrStartOffset, nodes1, 4) &&
+           sectionFits(h.m_nodeEdgeStartOffset, nodes1, 4) &&
+           sectionFits(h.m_attrKeyOffset, h.m_numAttrs, 4) &&
+           sectionFits(h.m_attrKindOffset, h.m_numAttrs, 1) &&
+           sectionFits(h.m_attrValueOffset, h.m_numAttrs, 8) &&
+           sectionFits(h.m_attrPreviewOffset, h.m_numAttrs, 4) &&
+           sectionFits(h.m_edgeOffset, h.m_numEdges, 4) )) {
+      return "node dump section lies outside the file";
+    }
+
+    m_stringOffsets = sectionAt<std::uint64_t>(h.m_stringOffsetsOffset);
+    m_stringData    = sectionAt<char>(h.m_stringDataOffset);
+    m_nodeIDString  = sectionAt<std::uint32_t>(h.m_nodeIDStringOffset);
+    m_nodeAttrStart = sectionAt<std::uint32_t>(h.m_nodeAttrStartOffset);
+    m_nodeEdgeStart = sectionAt<std::uint32_t>(h.m_nodeEdgeStartOffset);
+    m_attrKey       = sectionAt<std::uint32_t>(h.m_attrKeyOffset);
+    m_attrKind      = sectionAt<std::uint8_t>(h.m_attrKindOffset);
+    m_attrValue     = sectionAt<std::uint64_t>(h.m_attrValueOffset);
+    m_attrPreview   = sectionAt<std::uint32_t>(h.m_attrPreviewOffset);
+    m_edges         = sectionAt<std::uint32_t>(h.m_edgeOffset);
+
+    // The ends of the variable-length tables bound every index into
+    // them, given that the starts are nondecreasing, which the writer
+    // ensures.
+    if (!( sectionFits(h.m_stringDataOffset,
+                       m_stringOffsets[h.m_numStrings], 1) &&
+           m_nodeAttrStart[h.m_numNodes] == h.m_numAttrs &&
+           m_nodeEdgeStart[h.m_numNodes] == h.m_numEdges )) {
+      return "node dump tables are inconsistent";
+    }
+
+    return "";
+  }
+
+  void reset()
+  {
+    if (m_mapped) {
+      munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+    m_header = nullptr;
+  }
+
+public:      // methods
+  NodeBinaryDumpReader()
+    : m_data(nullptr),
+      m_size(0),
+      m_mapped(false),
+      m_header(nullptr)
+  {}
+
+  ~NodeBinaryDumpReader()
+    { reset(); }
+
+  NodeBinaryDumpReader(NodeBinaryDumpReader const &) = delete;
+  NodeBinaryDumpReader &operator=(NodeBinaryDumpReader const &) = delete;
+
+  // Map 'fname' and check its header.  Return "" or an error message.
+  std::string openFile(std::string const &fname)
+  {
+    reset();
+
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return fname + ": " + std::strerror(errno);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      std::string err = fname + ": " + std::strerror(errno);
+      ::close(fd);
+      return err;
+    }
+    if (st.st_size == 0) {
+      ::close(fd);
+      return fname + ": empty file";
+    }
+
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int mmapErrno = errno;
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      return fname + ": " + std::strerror(mmapErrno);
+    }
+
+    m_data = static_cast<char const *>(p);
+    m_size = st.st_size;
+    m_mapped = true;
+
+    std::string err = setupSections();
+    if (!err.empty()) {
+      reset();
+      return fname + ": " + err;
+    }
+    return "";
+  }
+
+  // Use the 'size' bytes at 'data', which must be 8-byte aligned and
+  // outlive this object.  Return "" or an error message.
+  std::string openMemory(void const *data, std::size_t size)
+  {
+    reset();
+    m_data = static_cast<char const *>(data);
+    m_size = size;
+
+    std::string err = setupSections();
+    if (!err.empty()) {
+      reset();
+    }
+    return err;
+  }
+
+  // True if a dump was opened successfully.
+  bool isOpen() const
+    { return m_header != nullptr; }
+
+  NodeBinaryDumpHeader const &header() const
+    { return *m_header; }
+
+  // ------------------------------ strings ------------------------------
+  std::uint32_t numStrings() const
+    { return m_header->m_numStrings; }
+
+  std::string_view getString(std::uint32_t index) const
+  {
+    if (index >= m_header->m_numStrings) {
+      return std::string_view();
+    }
+    std::uint64_t start = m_stringOffsets[index];
+    std::uint64_t end = m_stringOffsets[index+1];
+    std::uint64_t dataSize = m_stringOffsets[m_header->m_numStrings];
+    if (!( start < end && end <= dataSize &&
+           m_stringData[end-1] == '\0' )) {
+      return std::string_view();
+    }
+    // Exclude the NUL terminator.
+    return std::string_view(m_stringData + start, end - start - 1);
+  }
+
+  // ------------------------------- nodes -------------------------------
+  // One more than the largest NodeID.
+  std::uint32_t numNodes() const
+    { return m_header->m_numNodes; }
+
+  // True if 'id' names a node that is in the dump.
+  bool hasNode(std::uint32_t id) const
+    { return id != 0 && id < numNodes() && m_nodeIDString[id] != 0; }
+
+  // ID string, like "CXXRecordDecl 17", or "" if absent.
+  std::string_view nodeIDString(std::uint32_t id) const
+    { return getString(m_nodeIDString[id]); }
+
+  // ----------------------------- attributes ----------------------------
+  std::uint32_t numNodeAttrs(std::uint32_t id) const
+    { return m_nodeAttrStart[id+1] - m_nodeAttrStart[id]; }
+
+  // Get attribute 'i' of node 'id'.
+  Attr nodeAttr(std::uint32_t id, std::uint32_t i) const
+    { return attrAt(m_nodeAttrStart[id] + i); }
+
+  // Get the attribute with overall index 'index'.
+  Attr attrAt(std::uint32_t index) const
+  {
+    Attr attr;
+    attr.m_key = getString(m_attrKey[index]);
+    attr.m_kind = (NodeBinaryValueKind)m_attrKind[index];
+    attr.m_value = m_attrValue[index];
+    if (attr.m_kind == NBVK_STRING || attr.m_kind == NBVK_JSON) {
+      attr.m_string = getString((std::uint32_t)attr.m_value);
+    }
+    attr.m_preview = getString(m_attrPreview[index]);
+    return attr;
+  }
+
+  // Find the first attribute of 'id' whose key is 'key'.  Return true
+  // and set 'attr' if found.  This is a linear scan of the node's
+  // attributes.
+  bool findNodeAttr(Attr /*OUT*/ &attr, std::uint32_t id,
+                    std::string_view key) const
+  {
+    for (std::uint32_t index = m_nodeAttrStart[id];
+         index < m_nodeAttrStart[id+1];
+         ++index) {
+      if (getString(m_attrKey[index]) == key) {
+        attr = attrAt(index);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // ------------------------------- edges -------------------------------
+  // NodeIDs that 'id' points to.
+  EdgeRange nodeEdges(std::uint32_t id) const
+  {
+    return EdgeRange{m_edges + m_nodeEdgeStart[id],
+                     m_edges + m_nodeEdgeStart[id+1]};
+  }
+};
+
+
+#endif // PCA_NODE_BINARY_DUMP_READER_H
@@ -0,0 +1,404 @@
+// node-binary-dump-test.cc
+// Tests for `node-binary-dump` and `node-binary-dump-reader`.
+
+#include "node-binary-dump.h"                    // module under test
+#include "node-binary-dump-reader.h"             // module under test
+
+#include "clang-ast.h"                           // ClangASTUtilTempFile
+#include "clang-util.h"                          // GlobalClangUtilInstance
+#include "node-record-diff.h"                    // splitNodeRecords, writeWithoutTrailingCommas
+#include "print-clang-ast-nodes.h"               // printClangASTNodes
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "llvm/Support/Error.h"                  // llvm::{consumeError, toString}
+#include "llvm/Support/JSON.h"                   // llvm::json::{Object, parse, Value}
+
+#include <cstdint>                               // std::uint32_t, etc.
+#include <cstring>                               // std::memcpy
+#include <sstream>                               // std::ostringstream
+#include <string>                                // std::string
+#include <string_view>                           // std::string_view
+#include <vector>                                // std::vector
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Output of `printClangASTNodes`, with each kind of value, a record out
+// of NodeID order, and a gap at NodeID 4.
+char const nodesText[] =
+  "{\n"
+  "\n"
+  "\"TranslationUnitDecl 1\": {\n"
+  "  \"Decl::Loc\": \"<invalid loc>\",\n"
+  "},\n"
+  "\n"
+  "\"VarDecl 2\": {\n"
+  "  \"Name\": \"x\\ty\\\"z\\\"\",\n"
+  "  \"Type\": { \"ptr\": \"BuiltinType 5\", \"preview\": \"int\" },\n"
+  "  \"Init\": { \"ptr\": \"IntegerLiteral 3\" },\n"
+  "  \"Def\": { \"ptr\": \"null\" },\n"
+  "  \"Offset\": -12,\n"
+  "  \"IsUsed\": true,\n"
+  "  \"Attrs\": null,\n"
+  "  \"Range\": [1, 2],\n"
+  "},\n"
+  "\n"
+  "\"BuiltinType 5\": {\n"
+  "},\n"
+  "\n"
+  "\"IntegerLiteral 3\": {\n"
+  "  \"Type\": { \"ptr\": \"BuiltinType 5\" },\n"
+  "},\n"
+  "}\n";
+
+
+// Copy 'bytes', a binary dump, to memory suitably aligned for the
+// reader.
+std::vector<std::uint64_t> alignDump(string const &bytes)
+{
+  EXPECT_EQ(bytes.size() % 8, (std::size_t)0);
+
+  std::vector<std::uint64_t> words(bytes.size() / 8);
+  std::memcpy(words.data(), bytes.data(), bytes.size());
+  return words;
+}
+
+
+// Return the binary dump of 'text', aligned for the reader.
+std::vector<std::uint64_t> dumpNodesText(char const *text)
+{
+  std::ostringstream oss;
+  EXPECT_EQ(writeNodeBinaryDump(oss, splitNodeRecords(text)), "");
+  return alignDump(oss.str());
+}
+
+
+void testUnquote()
+{
+  string s;
+  EXPECT_EQ(unquoteNodeString(s, "\"a\\\"b\\\\c\\n\\x41\\u00e9\\101\""),
+            true);
+  EXPECT_EQ(s, "a\"b\\c\nA\xC3\xA9" "A");
+
+  s.clear();
+  EXPECT_EQ(unquoteNodeString(s, "\"unterminated"), false);
+  EXPECT_EQ(unquoteNodeString(s, "\"a\" \"b\""), false);
+}
+
+
+// Check the contents of the dump of `nodesText`.
+void checkReader(NodeBinaryDumpReader const &reader)
+{
+  EXPECT_EQ(reader.isOpen(), true);
+  EXPECT_EQ(reader.numNodes(), (std::uint32_t)6);
+  EXPECT_EQ(reader.hasNode(0), false);
+  EXPECT_EQ(reader.hasNode(1), true);
+  EXPECT_EQ(reader.hasNode(4), false);
+  EXPECT_EQ(reader.hasNode(5), true);
+  EXPECT_EQ(reader.nodeIDString(3), "IntegerLiteral 3");
+  EXPECT_EQ(reader.nodeIDString(4), "");
+
+  EXPECT_EQ(reader.numNodeAttrs(1), (std::uint32_t)1);
+  EXPECT_EQ(reader.numNodeAttrs(2), (std::uint32_t)8);
+  EXPECT_EQ(reader.numNodeAttrs(4), (std::uint32_t)0);
+  EXPECT_EQ(reader.numNodeAttrs(5), (std::uint32_t)0);
+
+  NodeBinaryDumpReader::Attr attr = reader.nodeAttr(1, 0);
+  EXPECT_EQ(attr.m_key, "Decl::Loc");
+  EXPECT_EQ(attr.m_kind, NBVK_STRING);
+  EXPECT_EQ(attr.m_string, "<invalid loc>");
+
+  attr = reader.nodeAttr(2, 0);
+  EXPECT_EQ(attr.m_string, "x\ty\"z\"");
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "Type"), true);
+  EXPECT_EQ(attr.m_kind, NBVK_PTR);
+  EXPECT_EQ(attr.m_value, (std::uint64_t)5);
+  EXPECT_EQ(attr.m_preview, "int");
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "Init"), true);
+  EXPECT_EQ(attr.m_kind, NBVK_PTR);
+  EXPECT_EQ(attr.m_value, (std::uint64_t)3);
+  EXPECT_EQ(attr.m_preview, "");
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "Def"), true);
+  EXPECT_EQ(attr.m_kind, NBVK_PTR);
+  EXPECT_EQ(attr.m_value, (std::uint64_t)0);
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "Offset"), true);
+  EXPECT_EQ(attr.m_kind, NBVK_INT);
+  EXPECT_EQ(attr.intValue(), (std::int64_t)-12);
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "IsUsed"), true);
+  EXPECT_EQ(attr.m_kind, NBVK_BOOL);
+  EXPECT_EQ(attr.m_value, (std::uint64_t)1);
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "Attrs"), true);
+  EXPECT_EQ(attr.m_kind, NBVK_NULL);
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "Range"), true);
+  EXPECT_EQ(attr.m_kind, NBVK_JSON);
+  EXPECT_EQ(attr.m_string, "[1, 2]");
+
+  EXPECT_EQ(reader.findNodeAttr(attr, 2, "Missing"), false);
+
+  // Edges omit the null pointer.
+  std::vector<std::uint32_t> edges;
+  for (std::uint32_t target : reader.nodeEdges(2)) {
+    edges.push_back(target);
+  }
+  EXPECT_EQ(edges.size(), (std::size_t)2);
+  EXPECT_EQ(edges[0], (std::uint32_t)5);
+  EXPECT_EQ(edges[1], (std::uint32_t)3);
+  EXPECT_EQ(reader.nodeEdges(3).size(), (std::size_t)1);
+  EXPECT_EQ(reader.nodeEdges(1).size(), (std::size_t)0);
+}
+
+
+void testMemoryRoundTrip()
+{
+  std::vector<std::uint64_t> words = dumpNodesText(nodesText);
+
+  NodeBinaryDumpReader reader;
+  EXPECT_EQ(reader.openMemory(words.data(), words.size() * 8), "");
+  checkReader(reader);
+
+  // Corruption is detected.
+  std::vector<std::uint64_t> bad(words);
+  reinterpret_cast<char*>(bad.data())[0] = 'X';
+  EXPECT_EQ(reader.openMemory(bad.data(), bad.size() * 8),
+            "not a node dump");
+  EXPECT_EQ(reader.isOpen(), false);
+
+  EXPECT_EQ(reader.openMemory(words.data(), words.size() * 8 - 8),
+            "node dump header is inconsistent");
+
+  // A string with no room for its NUL, or whose NUL is missing, reads
+  // as empty.
+  bad = words;
+  EXPECT_EQ(reader.openMemory(bad.data(), bad.size() * 8), "");
+  EXPECT_EQ(reader.getString(1).empty(), false);
+  std::uint64_t *offsets = reinterpret_cast<std::uint64_t*>(
+    reinterpret_cast<char*>(bad.data()) +
+    reader.header().m_stringOffsetsOffset);
+  char *stringData = reinterpret_cast<char*>(bad.data()) +
+                     reader.header().m_stringDataOffset;
+  std::uint64_t end1 = offsets[2];
+  offsets[2] = offsets[1];
+  EXPECT_EQ(reader.getString(1), "");
+  offsets[2] = end1;
+  stringData[end1 - 1] = 'x';
+  EXPECT_EQ(reader.getString(1), "");
+}
+
+
+void testFileRoundTrip()
+{
+  NodeBinaryDumpWriter writer;
+  for (NodeRecord const &record : splitNodeRecords(nodesText)) {
+    writer.handleNodeRecord(record);
+  }
+
+  string fname = "out/node-binary-dump-test.bin";
+  EXPECT_EQ(writer.writeFile(fname), "");
+
+  NodeBinaryDumpReader reader;
+  EXPECT_EQ(reader.openFile(fname), "");
+  checkReader(reader);
+}
+
+
+void testListValue()
+{
+  std::vector<std::uint64_t> words = dumpNodesText(
+    "\"Fake_CXXRecordDecl_DefinitionData 1\": {\n"
+    "  \"flags\": [\n"
+    "    \"Aggregate\",\n"
+    "    \"HasODRHash\",\n"
+    "  ],\n"
+    "  \"Empty\": [\n"
+    "  ],\n"
+    "  \"Bases\": \"[]\",\n"
+    "},\n");
+
+  NodeBinaryDumpReader reader;
+  EXPECT_EQ(reader.openMemory(words.data(), words.size() * 8), "");
+  EXPECT_EQ(reader.numNodeAttrs(1), (std::uint32_t)3);
+
+  NodeBinaryDumpReader::Attr attr = reader.nodeAttr(1, 0);
+  EXPECT_EQ(attr.m_key, "flags");
+  EXPECT_EQ(attr.m_kind, NBVK_JSON);
+  EXPECT_EQ(attr.m_string,
+    "[\n"
+    "    \"Aggregate\",\n"
+    "    \"HasODRHash\"\n"
+    "  ]");
+
+  attr = reader.nodeAttr(1, 1);
+  EXPECT_EQ(attr.m_key, "Empty");
+  EXPECT_EQ(attr.m_string, "[\n  ]");
+
+  // Brackets in strings do not count.
+  attr = reader.nodeAttr(1, 2);
+  EXPECT_EQ(attr.m_kind, NBVK_STRING);
+  EXPECT_EQ(attr.m_string, "[]");
+}
+
+
+// True if 'attr', read from a dump, has the same value as 'json', the
+// value of the attribute in the JSON output.
+bool attrMatchesJSON(
+  NodeBinaryDumpReader const &reader,
+  NodeBinaryDumpReader::Attr const &attr,
+  llvm::json::Value const &json)
+{
+  switch (attr.m_kind) {
+    case NBVK_NULL:
+      return json.kind() == llvm::json::Value::Null;
+
+    case NBVK_BOOL: {
+      auto b = json.getAsBoolean();
+      return b && *b == (attr.m_value != 0);
+    }
+
+    case NBVK_INT: {
+      auto i = json.getAsInteger();
+      return i && *i == attr.intValue();
+    }
+
+    case NBVK_STRING: {
+      auto str = json.getAsString();
+      return str && str->str() == attr.m_string;
+    }
+
+    case NBVK_PTR: {
+      llvm::json::Object const *obj = json.getAsObject();
+      if (!obj) {
+        return false;
+      }
+      auto ptr = obj->getString("ptr");
+      auto preview = obj->getString("preview");
+      string target(attr.m_value? reader.nodeIDString(attr.m_value) :
+                                  "null");
+      return ptr && ptr->str() == target &&
+             (preview? preview->str() : "") == attr.m_preview;
+    }
+
+    case NBVK_JSON: {
+      llvm::Expected<llvm::json::Value> parsed =
+        llvm::json::parse(llvm::StringRef(attr.m_string.data(),
+                                          attr.m_string.size()));
+      if (!parsed) {
+        llvm::consumeError(parsed.takeError());
+        return false;
+      }
+      return *parsed == json;
+    }
+
+    default:
+      return false;
+  }
+}
+
+
+// Print a class, whose definition data has a list of flags, straight
+// into a dump, and check that it has the same attributes as the JSON
+// output.
+void testPrintedRoundTrip()
+{
+  ClangASTUtilTempFile ast(
+    "struct S {\n"
+    "  int m;\n"
+    "  S() : m(1) {}\n"
+    "  virtual ~S();\n"
+    "};\n");
+  GlobalClangUtilInstance gcui(ast.getASTContext());
+
+  PrintClangASTNodesConfiguration config;
+  NodeBinaryDumpWriter writer;
+  std::ostringstream oss;
+  EXPECT_EQ(printClangASTNodes(oss, ast.getASTContext(), config,
+                               nullptr /*nodeIndexOS*/, &writer), 0);
+
+  std::ostringstream dump;
+  EXPECT_EQ(writer.write(dump), "");
+  std::vector<std::uint64_t> words = alignDump(dump.str());
+  NodeBinaryDumpReader reader;
+  EXPECT_EQ(reader.openMemory(words.data(), words.size() * 8), "");
+
+  std::ostringstream strict;
+  writeWithoutTrailingCommas(strict, oss.str());
+  llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(strict.str());
+  if (!parsed) {
+    EXPECT_EQ(llvm::toString(parsed.takeError()), "");
+    return;
+  }
+  llvm::json::Object const *records = parsed->getAsObject();
+  EXPECT_EQ(records != nullptr, true);
+
+  int numRecords = 0;
+  int numFlagLists = 0;
+  for (std::uint32_t nodeID = 1; nodeID < reader.numNodes(); ++nodeID) {
+    if (!reader.hasNode(nodeID)) {
+      continue;
+    }
+    ++numRecords;
+
+    std::string_view id = reader.nodeIDString(nodeID);
+    llvm::json::Object const *record =
+      records->getObject(llvm::StringRef(id.data(), id.size()));
+    EXPECT_EQ(record != nullptr, true);
+    EXPECT_EQ(reader.numNodeAttrs(nodeID), (std::uint32_t)record->size());
+
+    for (std::uint32_t i = 0; i < reader.numNodeAttrs(nodeID); ++i) {
+      NodeBinaryDumpReader::Attr attr = reader.nodeAttr(nodeID, i);
+      llvm::json::Value const *value =
+        record->get(llvm::StringRef(attr.m_key.data(), attr.m_key.size()));
+      EXPECT_EQ(value != nullptr, true);
+      EXPECT_EQ(attrMatchesJSON(reader, attr, *value), true);
+
+      if (attr.m_key == "flags") {
+        ++numFlagLists;
+        EXPECT_EQ(attr.m_kind, NBVK_JSON);
+      }
+    }
+  }
+
+  EXPECT_EQ((std::size_t)numRecords, records->size());
+  EXPECT_EQ(numFlagLists, 1);
+}
+
+
+void testBadRecordID()
+{
+  std::ostringstream oss;
+  EXPECT_EQ(writeNodeBinaryDump(oss,
+              splitNodeRecords("\"Foo\": {\n},\n")),
+            "node record ID \"Foo\" does not end with a node number");
+  EXPECT_EQ(writeNodeBinaryDump(oss,
+              splitNodeRecords("\"A 1\": {\n},\n\"B 1\": {\n},\n")),
+            "node record ID \"B 1\" appears more than once");
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void node_binary_dump_unit_tests()
+{
+  testUnquote();
+  testMemoryRoundTrip();
+  testFileRoundTrip();
+  testListValue();
+  testPrintedRoundTrip();
+  testBadRecordID();
+}
+
+
+// EOF
@@ -0,0 +1,569 @@
+// node-binary-dump.cc
+// Code for `node-binary-dump.h`.
+
+#include "node-binary-dump.h"                    // this module
+
+#include "node-binary-dump-reader.h"             // NodeBinaryDumpHeader, NBVK_XXX
+#include "node-record-diff.h"                    // writeWithoutTrailingCommas
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/string-util.h"                  // doubleQuote
+#include "smbase/stringb.h"                      // stringb
+
+#include "llvm/ADT/StringMap.h"                  // llvm::StringMap
+
+#include <algorithm>                             // std::max
+#include <cstdint>                               // std::uint32_t, etc.
+#include <cstring>                               // std::{memcpy, memset}
+#include <fstream>                               // std::ofstream
+#include <ostream>                               // std::ostream
+#include <sstream>                               // std::ostringstream
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Pool of unique strings, numbered in the order they are added.
+class StringTable {
+public:      // data
+  // Map from string to its index.
+  llvm::StringMap<std::uint32_t> m_index;
+
+  // The strings, by index.  They point at the keys of 'm_index'.
+  std::vector<llvm::StringRef> m_strings;
+
+public:      // methods
+  StringTable()
+  {
+    // String 0 is the empty string.
+    add("");
+  }
+
+  std::uint32_t add(llvm::StringRef s)
+  {
+    auto inserted = m_index.try_emplace(s, (std::uint32_t)m_strings.size());
+    if (inserted.second) {
+      m_strings.push_back(inserted.first->getKey());
+    }
+    return inserted.first->getValue();
+  }
+};
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// The tables of the dump, before they are written.
+class NodeBinaryDumpTables {
+public:      // data
+  StringTable m_strings;
+
+  // Largest NodeID seen so far.
+  std::uint32_t m_maxNodeID = 0;
+
+  // Indexed by NodeID.
+  std::vector<std::uint32_t> m_nodeIDString;
+
+  // Attributes and edges of each node, in the order the records were
+  // processed.  Since records need not be in NodeID order, the
+  // per-node start arrays are computed when writing.
+  std::vector<std::uint32_t> m_recordNodeIDs;
+  std::vector<std::uint32_t> m_recordAttrEnd;
+  std::vector<std::uint32_t> m_recordEdgeEnd;
+
+  // Attribute columns.
+  std::vector<std::uint32_t> m_attrKey;
+  std::vector<std::uint8_t> m_attrKind;
+  std::vector<std::uint64_t> m_attrValue;
+  std::vector<std::uint32_t> m_attrPreview;
+
+  std::vector<std::uint32_t> m_edges;
+};
+
+
+// If 's' starts with a complete string literal, return its length,
+// including the quotes.  Otherwise return 0.
+static std::size_t quotedPrefixLength(llvm::StringRef s)
+{
+  if (!s.startswith("\"")) {
+    return 0;
+  }
+  for (std::size_t i = 1; i < s.size(); ++i) {
+    if (s[i] == '\\') {
+      ++i;
+    }
+    else if (s[i] == '"') {
+      return i+1;
+    }
+  }
+  return 0;
+}
+
+
+// Append the UTF-8 encoding of 'c' to 'dest'.
+static void appendUTF8(std::string &dest, std::uint32_t c)
+{
+  if (c < 0x80) {
+    dest.push_back((char)c);
+  }
+  else if (c < 0x800) {
+    dest.push_back((char)(0xC0 | (c >> 6)));
+    dest.push_back((char)(0x80 | (c & 0x3F)));
+  }
+  else {
+    dest.push_back((char)(0xE0 | (c >> 12)));
+    dest.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+    dest.push_back((char)(0x80 | (c & 0x3F)));
+  }
+}
+
+
+// Parse up to 'maxDigits' digits of 'radix' from 's' starting at 'i',
+// advancing 'i'.  Returns false if there are none.
+static bool parseDigits(std::uint32_t /*OUT*/ &value, llvm::StringRef s,
+                        std::size_t /*INOUT*/ &i, int maxDigits, int radix)
+{
+  value = 0;
+  int n = 0;
+  for (; n < maxDigits && i < s.size(); ++n, ++i) {
+    unsigned digit;
+    if (s.substr(i, 1).getAsInteger(radix, digit)) {
+      break;
+    }
+    value = value*radix + digit;
+  }
+  return n > 0;
+}
+
+
+bool unquoteNodeString(std::string /*INOUT*/ &dest, llvm::StringRef quoted)
+{
+  if (quotedPrefixLength(quoted) != quoted.size()) {
+    return false;
+  }
+  llvm::StringRef s = quoted.drop_front(1).drop_back(1);
+
+  for (std::size_t i = 0; i < s.size(); ) {
+    char c = s[i++];
+    if (c != '\\') {
+      dest.push_back(c);
+      continue;
+    }
+
+    // `quotedPrefixLength` ensures a character follows.
+    c = s[i++];
+    std::uint32_t value;
+    switch (c) {
+      case 'a': dest.push_back('\a'); break;
+      case 'b': dest.push_back('\b'); break;
+      case 'f': dest.push_back('\f'); break;
+      case 'n': dest.push_back('\n'); break;
+      case 'r': dest.push_back('\r'); break;
+      case 't': dest.push_back('\t'); break;
+      case 'v': dest.push_back('\v'); break;
+
+      case 'x':
+        if (!parseDigits(value, s, i, 2, 16)) {
+          return false;
+        }
+        dest.push_back((char)value);
+        break;
+
+      case 'u':
+        if (!parseDigits(value, s, i, 4, 16)) {
+          return false;
+        }
+        appendUTF8(dest, value);
+        break;
+
+      case '0': case '1': case '2': case '3':
+      case '4': case '5': case '6': case '7':
+        --i;
+        parseDigits(value, s, i, 3, 8);
+        dest.push_back((char)value);
+        break;
+
+      default:
+        // Includes `"`, `\`, and `/`.
+        dest.push_back(c);
+        break;
+    }
+  }
+
+  return true;
+}
+
+
+// Parse the value of a pointer attribute, `{ "ptr": "<id>" }`, possibly
+// with `, "preview": "<text>"` before the closing brace.  Returns false
+// if 'value' does not have that form.
+static bool parsePtrValue(
+  llvm::StringRef /*OUT*/ &id,
+  llvm::StringRef /*OUT*/ &preview,
+  llvm::StringRef value)
+{
+  if (!value.consume_front("{ \"ptr\": ") ||
+      !value.consume_back(" }")) {
+    return false;
+  }
+
+  std::size_t len = quotedPrefixLength(value);
+  if (len == 0) {
+    return false;
+  }
+  id = value.take_front(len);
+  value = value.drop_front(len);
+
+  preview = llvm::StringRef();
+  if (value.consume_front(", \"preview\": ")) {
+    if (quotedPrefixLength(value) != value.size()) {
+      return false;
+    }
+    preview = value;
+    return true;
+  }
+  return value.empty();
+}
+
+
+// Get the NodeID from an ID string like "CXXRecordDecl 17".  Returns
+// false if it does not end with a positive number.
+static bool nodeIDFromIDString(std::uint32_t /*OUT*/ &nodeID,
+                               llvm::StringRef idStr)
+{
+  llvm::StringRef number = idStr.rsplit(' ').second;
+  return !number.getAsInteger(10, nodeID) && nodeID != 0;
+}
+
+
+// If 's' starts with a value, return its length.  A value ends at the
+// first newline that is not inside a string or a bracketed list or
+// object, or at the end of 's'.  Returns 0 if the brackets are not
+// balanced by then.
+static std::size_t valuePrefixLength(llvm::StringRef s)
+{
+  int depth = 0;
+  bool inString = false;
+  std::size_t i = 0;
+  for (; i < s.size(); ++i) {
+    char c = s[i];
+    if (inString) {
+      if (c == '\\') {
+        ++i;
+      }
+      else if (c == '"') {
+        inString = false;
+      }
+    }
+    else if (c == '"') {
+      inString = true;
+    }
+    else if (c == '[' || c == '{') {
+      ++depth;
+    }
+    else if (c == ']' || c == '}') {
+      --depth;
+    }
+    else if (c == '\n' && depth == 0) {
+      break;
+    }
+  }
+  return (depth == 0 && !inString)? i : 0;
+}
+
+
+// If 'body' starts with an attribute, add it to 'tables'.  Then remove
+// it, or just the first line if there is no attribute, from 'body'.
+static void takeAttribute(NodeBinaryDumpTables &tables,
+                          llvm::StringRef /*INOUT*/ &body)
+{
+  // An attribute is `  "<key>": <value>,` and a newline.  The value is
+  // usually on one line, but lists, like the "flags" of a CXXRecordDecl
+  // definition, span several.
+  llvm::StringRef rest = body;
+  std::size_t keyLen = 0;
+  std::size_t valueLen = 0;
+  if (rest.consume_front("  ") &&
+      (keyLen = quotedPrefixLength(rest)) != 0 &&
+      rest.drop_front(keyLen).startswith(": ")) {
+    valueLen = valuePrefixLength(rest.drop_front(keyLen + 2));
+  }
+
+  llvm::StringRef value;
+  if (valueLen != 0) {
+    value = rest.drop_front(keyLen + 2).take_front(valueLen);
+  }
+  if (!value.consume_back(",")) {
+    // Not an attribute.  Skip the line.
+    body = body.split('\n').second;
+    return;
+  }
+  body = rest.drop_front(keyLen + 2 + valueLen);
+  body.consume_front("\n");
+
+  std::string key;
+  unquoteNodeString(key, rest.take_front(keyLen));
+
+  NodeBinaryValueKind kind = NBVK_JSON;
+  std::uint64_t bits = 0;
+  std::uint32_t preview = 0;
+
+  std::int64_t intValue;
+  llvm::StringRef ptrID, ptrPreview;
+  std::string unquoted;
+
+  if (value == "null") {
+    kind = NBVK_NULL;
+  }
+  else if (value == "true" || value == "false") {
+    kind = NBVK_BOOL;
+    bits = (value == "true");
+  }
+  else if (!value.getAsInteger(10, intValue)) {
+    kind = NBVK_INT;
+    bits = (std::uint64_t)intValue;
+  }
+  else if (unquoteNodeString(unquoted, value)) {
+    kind = NBVK_STRING;
+    bits = tables.m_strings.add(unquoted);
+  }
+  else if (parsePtrValue(ptrID, ptrPreview, value)) {
+    std::uint32_t target = 0;
+    if (ptrID != "\"null\"" &&
+        !nodeIDFromIDString(target, ptrID.drop_front(1).drop_back(1))) {
+      // Not something we can follow; keep it as text.
+      kind = NBVK_JSON;
+    }
+    else {
+      kind = NBVK_PTR;
+      bits = target;
+      if (target != 0) {
+        tables.m_edges.push_back(target);
+      }
+      if (!ptrPreview.empty()) {
+        std::string previewStr;
+        unquoteNodeString(previewStr, ptrPreview);
+        preview = tables.m_strings.add(previewStr);
+      }
+    }
+  }
+
+  if (kind == NBVK_JSON) {
+    // Store it as proper JSON.
+    std::ostringstream json;
+    writeWithoutTrailingCommas(json, value);
+    bits = tables.m_strings.add(json.str());
+  }
+
+  tables.m_attrKey.push_back(tables.m_strings.add(key));
+  tables.m_attrKind.push_back(kind);
+  tables.m_attrValue.push_back(bits);
+  tables.m_attrPreview.push_back(preview);
+}
+
+
+// Round 'n' up to a multiple of 8.
+static std::uint64_t align8(std::uint64_t n)
+{
+  return (n + 7) & ~(std::uint64_t)7;
+}
+
+
+// Write 'size' bytes at 'data' to 'os', then pad to a multiple of 8.
+static void writeSection(std::ostream &os, void const *data,
+                         std::uint64_t size)
+{
+  static char const zeroes[8] = {};
+  os.write(static_cast<char const *>(data), size);
+  os.write(zeroes, align8(size) - size);
+}
+
+
+NodeBinaryDumpWriter::NodeBinaryDumpWriter()
+  : m_tables(new NodeBinaryDumpTables),
+    m_error()
+{}
+
+
+NodeBinaryDumpWriter::~NodeBinaryDumpWriter()
+{}
+
+
+void NodeBinaryDumpWriter::handleNodeRecord(NodeRecord const &record)
+{
+  if (!m_error.empty()) {
+    return;
+  }
+  NodeBinaryDumpTables &tables = *m_tables;
+
+  std::uint32_t nodeID;
+  if (!nodeIDFromIDString(nodeID, record.m_id)) {
+    m_error = stringb("node record ID " << doubleQuote(record.m_id.str()) <<
+                      " does not end with a node number");
+    return;
+  }
+  if (nodeID >= tables.m_nodeIDString.size()) {
+    tables.m_nodeIDString.resize(nodeID+1, 0);
+  }
+  if (tables.m_nodeIDString[nodeID] != 0) {
+    m_error = stringb("node record ID " << doubleQuote(record.m_id.str()) <<
+                      " appears more than once");
+    return;
+  }
+  tables.m_nodeIDString[nodeID] = tables.m_strings.add(record.m_id);
+  tables.m_maxNodeID = std::max(tables.m_maxNodeID, nodeID);
+
+  llvm::StringRef body = record.m_body;
+  while (!body.empty()) {
+    takeAttribute(tables, body);
+  }
+
+  tables.m_recordNodeIDs.push_back(nodeID);
+  tables.m_recordAttrEnd.push_back(tables.m_attrKey.size());
+  tables.m_recordEdgeEnd.push_back(tables.m_edges.size());
+}
+
+
+std::string NodeBinaryDumpWriter::write(std::ostream &os) const
+{
+  if (!m_error.empty()) {
+    return m_error;
+  }
+  NodeBinaryDumpTables const &tables = *m_tables;
+
+  std::uint32_t const numNodes = tables.m_maxNodeID + 1;
+  std::vector<std::uint32_t> nodeIDString(tables.m_nodeIDString);
+  nodeIDString.resize(numNodes, 0);
+
+  // Reorder the attributes and edges by NodeID.  Records usually come
+  // in NodeID order already, in which case this is a copy.
+  std::vector<std::uint32_t> recordOfNode(numNodes, ~(std::uint32_t)0);
+  for (std::uint32_t r = 0; r < tables.m_recordNodeIDs.size(); ++r) {
+    recordOfNode[tables.m_recordNodeIDs[r]] = r;
+  }
+
+  std::vector<std::uint32_t> nodeAttrStart, nodeEdgeStart;
+  std::vector<std::uint32_t> attrKey, attrPreview, edges;
+  std::vector<std::uint8_t> attrKind;
+  std::vector<std::uint64_t> attrValue;
+  attrKey.reserve(tables.m_attrKey.size());
+  attrKind.reserve(tables.m_attrKey.size());
+  attrValue.reserve(tables.m_attrKey.size());
+  attrPreview.reserve(tables.m_attrKey.size());
+  edges.reserve(tables.m_edges.size());
+
+  for (std::uint32_t nodeID = 0; nodeID < numNodes; ++nodeID) {
+    nodeAttrStart.push_back(attrKey.size());
+    nodeEdgeStart.push_back(edges.size());
+
+    std::uint32_t r = recordOfNode[nodeID];
+    if (r == ~(std::uint32_t)0) {
+      continue;
+    }
+
+    std::uint32_t attrBegin = r? tables.m_recordAttrEnd[r-1] : 0;
+    for (std::uint32_t a = attrBegin; a < tables.m_recordAttrEnd[r]; ++a) {
+      attrKey.push_back(tables.m_attrKey[a]);
+      attrKind.push_back(tables.m_attrKind[a]);
+      attrValue.push_back(tables.m_attrValue[a]);
+      attrPreview.push_back(tables.m_attrPreview[a]);
+    }
+
+    std::uint32_t edgeBegin = r? tables.m_recordEdgeEnd[r-1] : 0;
+    edges.insert(edges.end(),
+                 tables.m_edges.begin() + edgeBegin,
+                 tables.m_edges.begin() + tables.m_recordEdgeEnd[r]);
+  }
+  nodeAttrStart.push_back(attrKey.size());
+  nodeEdgeStart.push_back(edges.size());
+
+  // Lay out the string data.
+  std::vector<llvm::StringRef> const &strings = tables.m_strings.m_strings;
+  std::vector<std::uint64_t> stringOffsets;
+  std::string stringData;
+  for (llvm::StringRef s : strings) {
+    stringOffsets.push_back(stringData.size());
+    stringData.append(s.data(), s.size());
+    stringData.push_back('\0');
+  }
+  stringOffsets.push_back(stringData.size());
+
+  // Build the header, assigning offsets in the order the sections are
+  // written below.
+  NodeBinaryDumpHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.m_magic, NODE_BINARY_DUMP_MAGIC, 8);
+  header.m_version = NODE_BINARY_DUMP_VERSION;
+  header.m_byteOrderMark = NODE_BINARY_DUMP_BYTE_ORDER_MARK;
+  header.m_numNodes = numNodes;
+  header.m_numAttrs = attrKey.size();
+  header.m_numEdges = edges.size();
+  header.m_numStrings = strings.size();
+
+  std::uint64_t offset = align8(sizeof(header));
+  auto place = [&offset](std::uint64_t &field, std::uint64_t size) {
+    field = offset;
+    offset += align8(size);
+  };
+
+  #define VECTOR_BYTES(vec) ((vec).size() * sizeof((vec)[0]))
+
+  place(header.m_stringOffsetsOffset, VECTOR_BYTES(stringOffsets));
+  place(header.m_stringDataOffset,    stringData.size());
+  place(header.m_nodeIDStringOffset,  VECTOR_BYTES(nodeIDString));
+  place(header.m_nodeAttrStartOffset, VECTOR_BYTES(nodeAttrStart));
+  place(header.m_nodeEdgeStartOffset, VECTOR_BYTES(nodeEdgeStart));
+  place(header.m_attrKeyOffset,       VECTOR_BYTES(attrKey));
+  place(header.m_attrKindOffset,      VECTOR_BYTES(attrKind));
+  place(header.m_attrValueOffset,     VECTOR_BYTES(attrValue));
+  place(header.m_attrPreviewOffset,   VECTOR_BYTES(attrPreview));
+  place(header.m_edgeOffset,          VECTOR_BYTES(edges));
+  header.m_fileSize = offset;
+
+  writeSection(os, &header, sizeof(header));
+  writeSection(os, stringOffsets.data(), VECTOR_BYTES(stringOffsets));
+  writeSection(os, stringData.data(), stringData.size());
+  writeSection(os, nodeIDString.data(), VECTOR_BYTES(nodeIDString));
+  writeSection(os, nodeAttrStart.data(), VECTOR_BYTES(nodeAttrStart));
+  writeSection(os, nodeEdgeStart.data(), VECTOR_BYTES(nodeEdgeStart));
+  writeSection(os, attrKey.data(), VECTOR_BYTES(attrKey));
+  writeSection(os, attrKind.data(), VECTOR_BYTES(attrKind));
+  writeSection(os, attrValue.data(), VECTOR_BYTES(attrValue));
+  writeSection(os, attrPreview.data(), VECTOR_BYTES(attrPreview));
+  writeSection(os, edges.data(), VECTOR_BYTES(edges));
+
+  #undef VECTOR_BYTES
+
+  return "";
+}
+
+
+std::string NodeBinaryDumpWriter::writeFile(std::string const &fname) const
+{
+  std::ofstream out(fname, std::ios::binary);
+  std::string err = write(out);
+  if (!err.empty()) {
+    return err;
+  }
+
+  out.close();
+  if (!out) {
+    return stringb("error writing " << doubleQuote(fname));
+  }
+  return "";
+}
+
+
+std::string writeNodeBinaryDump(
+  std::ostream &os,
+  std::vector<NodeRecord> const &records)
+{
+  NodeBinaryDumpWriter writer;
+  for (NodeRecord const &record : records) {
+    writer.handleNodeRecord(record);
+  }
+  return writer.write(os);
+}
+
+
+// EOF
@@ -0,0 +1,70 @@
+// node-binary-dump.h
+// Write --print-ast-nodes records in the binary dump format.
+
+// The format, and a reader for it, are in node-binary-dump-reader.h.
+
+#ifndef PCA_NODE_BINARY_DUMP_H
+#define PCA_NODE_BINARY_DUMP_H
+
+#include "node-record-diff.h"                    // NodeRecord, NodeRecordSink
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <iosfwd>                                // std::ostream
+#include <memory>                                // std::unique_ptr
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+class NodeBinaryDumpTables;
+
+
+// Collects node records, as they are printed by `printClangASTNodes`,
+// and writes them as a binary dump.  Body lines that are not
+// attributes, such as the messages of failed assertions, are not
+// carried over.
+class NodeBinaryDumpWriter : public NodeRecordSink {
+  NO_OBJECT_COPIES(NodeBinaryDumpWriter);
+
+private:     // data
+  // What has been collected so far.
+  std::unique_ptr<NodeBinaryDumpTables> m_tables;
+
+  // The first problem found with the records, or "".
+  std::string m_error;
+
+public:      // methods
+  NodeBinaryDumpWriter();
+  ~NodeBinaryDumpWriter();
+
+  virtual void handleNodeRecord(NodeRecord const &record) override;
+
+  // Write the dump of the records handled so far to 'os'.  Returns ""
+  // or an error message, for example if a record ID did not end with a
+  // NodeID.
+  std::string write(std::ostream &os) const;
+
+  // Same, but write to the file 'fname'.
+  std::string writeFile(std::string const &fname) const;
+};
+
+
+// Write 'records', split from the output of `printClangASTNodes`, to
+// 'os' with a `NodeBinaryDumpWriter`.  Returns "" or an error message.
+std::string writeNodeBinaryDump(
+  std::ostream &os,
+  std::vector<NodeRecord> const &records);
+
+// Remove the quotes and escapes from 'quoted', a string literal as
+// printed by `doubleQuote`, appending the result to 'dest'.  Returns
+// false if 'quoted' is not a well-formed literal.
+bool unquoteNodeString(std::string /*INOUT*/ &dest, llvm::StringRef quoted);
+
+
+// Unit tests, defined in node-binary-dump-test.cc.
+void node_binary_dump_unit_tests();
+
+
+#endif // PCA_NODE_BINARY_DUMP_H
@@ -0,0 +1,154 @@
+// node-offset-index-test.cc
+// Tests for `node-offset-index`.
+
+#include "node-offset-index.h"                   // module under test
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include <cstdint>                               // std::uint64_t
+#include <fstream>                               // std::ofstream
+#include <sstream>                               // std::{istringstream, ostringstream}
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+void testLines()
+{
+  std::ostringstream oss;
+  writeNodeOffsetIndexLine(oss, "FunctionDecl 4711", 100, 20);
+  writeNodeOffsetIndexLine(oss, "NoNumber", 1, 2);
+  EXPECT_EQ(oss.str(), "4711 100 20 FunctionDecl\n");
+
+  NodeOffsetIndexEntry entry;
+  EXPECT_EQ(parseNodeOffsetIndexLine(entry, "4711 100 20 FunctionDecl"),
+            true);
+  EXPECT_EQ(entry.m_nodeID, (std::uint64_t)4711);
+  EXPECT_EQ(entry.m_offset, (std::uint64_t)100);
+  EXPECT_EQ(entry.m_length, (std::uint64_t)20);
+  EXPECT_EQ(entry.m_typeName, "FunctionDecl");
+
+  EXPECT_EQ(parseNodeOffsetIndexLine(entry, "4711 100 20"), false);
+  EXPECT_EQ(parseNodeOffsetIndexLine(entry, "x 100 20 T"), false);
+
+  std::ostringstream rebased;
+  rebaseNodeOffsetIndexLines(rebased,
+    "1 0 5 A\n2 5 7 B\n", 1000);
+  EXPECT_EQ(rebased.str(), "1 1000 5 A\n2 1005 7 B\n");
+}
+
+
+// Build an index with entries for the odd NodeIDs below 'limit' and
+// check that every ID is found or not as expected.
+void testFind(int limit)
+{
+  std::ostringstream oss;
+  writeNodeOffsetIndexHeader(oss);
+  for (int id = 1; id < limit; id += 2) {
+    writeNodeOffsetIndexLine(oss, "Type " + std::to_string(id),
+                             id * 10, id);
+  }
+
+  std::istringstream iss(oss.str());
+  NodeOffsetIndexReader reader(iss, "idx");
+  EXPECT_EQ(reader.open(), "");
+
+  for (int id = 0; id <= limit; ++id) {
+    bool found;
+    NodeOffsetIndexEntry entry;
+    EXPECT_EQ(reader.find(found, entry, id), "");
+    EXPECT_EQ(found, id % 2 == 1 && id < limit);
+    if (found) {
+      EXPECT_EQ(entry.m_offset, (std::uint64_t)(id * 10));
+      EXPECT_EQ(entry.m_typeName, "Type");
+    }
+  }
+}
+
+
+void testBadHeader()
+{
+  std::istringstream iss("whatever\n");
+  NodeOffsetIndexReader reader(iss, "idx");
+  EXPECT_EQ(reader.open(), "\"idx\": not a node index file");
+}
+
+
+// Node output and its index, as `printClangASTNodes` would write them.
+char const nodesText[] =
+  "{\n"
+  "\n"
+  "\"TranslationUnitDecl 1\": {\n"
+  "  \"Decl::Loc\": \"<invalid loc>\",\n"
+  "},\n"
+  "\n"
+  "\"VarDecl 2\": {\n"
+  "  \"Name\": \"x\",\n"
+  "},\n"
+  "}\n";
+
+
+void testLookupNodeRecords()
+{
+  string text(nodesText);
+  std::size_t tuStart = text.find("\"TranslationUnitDecl");
+  std::size_t varStart = text.find("\"VarDecl");
+
+  std::ostringstream index;
+  writeNodeOffsetIndexHeader(index);
+  writeNodeOffsetIndexLine(index, "TranslationUnitDecl 1",
+                           tuStart, varStart - 1 - tuStart);
+  writeNodeOffsetIndexLine(index, "VarDecl 2",
+                           varStart, text.size() - 2 - varStart);
+
+  string nodesFname = "out/node-offset-index-test.nodes";
+  string indexFname = nodesFname + ".index";
+  std::ofstream(nodesFname, std::ios::binary) << text;
+  std::ofstream(indexFname, std::ios::binary) << index.str();
+
+  std::ostringstream oss;
+  EXPECT_EQ(lookupNodeRecords(oss, nodesFname, indexFname,
+              std::vector<string>{"VarDecl 2", "1"}), "");
+  EXPECT_EQ(oss.str(),
+    "{\n"
+    "\n"
+    "\"VarDecl 2\": {\n"
+    "  \"Name\": \"x\",\n"
+    "},\n"
+    "\n"
+    "\"TranslationUnitDecl 1\": {\n"
+    "  \"Decl::Loc\": \"<invalid loc>\",\n"
+    "},\n"
+    "}\n");
+
+  std::ostringstream oss2;
+  EXPECT_EQ(lookupNodeRecords(oss2, nodesFname, indexFname,
+              std::vector<string>{"FunctionDecl 2"}),
+            "node not found: \"FunctionDecl 2\"");
+  EXPECT_EQ(lookupNodeRecords(oss2, nodesFname, indexFname,
+              std::vector<string>{"3"}),
+            "node not found: \"3\"");
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void node_offset_index_unit_tests()
+{
+  testLines();
+  testFind(1);
+  testFind(2);
+  testFind(100);
+  testBadHeader();
+  testLookupNodeRecords();
+}
+
+
+// EOF
@@ -0,0 +1,252 @@
+// node-offset-index.cc
+// Code for `node-offset-index.h`.
+
+#include "node-offset-index.h"                   // this module
+
+#include "smbase/string-util.h"                  // doubleQuote
+#include "smbase/stringb.h"                      // stringb
+
+#include <fstream>                               // std::ifstream
+#include <istream>                               // std::istream
+#include <ostream>                               // std::ostream
+#include <tuple>                                 // std::tie
+#include <utility>                               // std::swap
+
+
+// First line of an index file.
+static char const indexHeader[] = "pca-node-index 1";
+
+
+void writeNodeOffsetIndexHeader(std::ostream &os)
+{
+  os << indexHeader << "\n";
+}
+
+
+void writeNodeOffsetIndexLine(
+  std::ostream &os,
+  llvm::StringRef recordID,
+  std::uint64_t offset,
+  std::uint64_t length)
+{
+  std::pair<llvm::StringRef, llvm::StringRef> typeAndNumber =
+    recordID.rsplit(' ');
+  std::uint64_t nodeID;
+  if (typeAndNumber.second.getAsInteger(10, nodeID /*OUT*/)) {
+    return;
+  }
+
+  os << nodeID << ' ' << offset << ' ' << length << ' '
+     << typeAndNumber.first.str() << "\n";
+}
+
+
+bool parseNodeOffsetIndexLine(
+  NodeOffsetIndexEntry /*OUT*/ &entry,
+  llvm::StringRef line)
+{
+  std::pair<llvm::StringRef, llvm::StringRef> split;
+
+  split = line.split(' ');
+  if (split.first.getAsInteger(10, entry.m_nodeID /*OUT*/)) {
+    return false;
+  }
+
+  split = split.second.split(' ');
+  if (split.first.getAsInteger(10, entry.m_offset /*OUT*/)) {
+    return false;
+  }
+
+  split = split.second.split(' ');
+  if (split.first.getAsInteger(10, entry.m_length /*OUT*/) ||
+      split.second.empty()) {
+    return false;
+  }
+
+  entry.m_typeName = split.second.str();
+  return true;
+}
+
+
+void rebaseNodeOffsetIndexLines(
+  std::ostream &os,
+  llvm::StringRef lines,
+  std::uint64_t base)
+{
+  while (!lines.empty()) {
+    std::pair<llvm::StringRef, llvm::StringRef> lineAndRest =
+      lines.split('\n');
+    lines = lineAndRest.second;
+
+    NodeOffsetIndexEntry entry;
+    if (parseNodeOffsetIndexLine(entry, lineAndRest.first)) {
+      os << entry.m_nodeID << ' ' << (base + entry.m_offset) << ' '
+         << entry.m_length << ' ' << entry.m_typeName << "\n";
+    }
+  }
+}
+
+
+// ------------------------ NodeOffsetIndexReader ------------------------
+NodeOffsetIndexReader::NodeOffsetIndexReader(
+  std::istream &is,
+  std::string const &fname)
+  : m_is(is),
+    m_fname(fname),
+    m_firstLine(0),
+    m_size(0)
+{}
+
+
+bool NodeOffsetIndexReader::readLineAt(
+  std::string /*OUT*/ &line,
+  std::uint64_t pos)
+{
+  m_is.clear();
+  m_is.seekg(pos);
+  return (bool)std::getline(m_is, line);
+}
+
+
+std::string NodeOffsetIndexReader::open()
+{
+  std::string line;
+  if (!readLineAt(line, 0) || line != indexHeader) {
+    return stringb(doubleQuote(m_fname) << ": not a node index file");
+  }
+  m_firstLine = line.size() + 1;
+
+  m_is.clear();
+  m_is.seekg(0, std::ios::end);
+  m_size = m_is.tellg();
+
+  return "";
+}
+
+
+std::string NodeOffsetIndexReader::find(
+  bool /*OUT*/ &found,
+  NodeOffsetIndexEntry /*OUT*/ &entry,
+  std::uint64_t nodeID)
+{
+  found = false;
+  std::string line;
+
+  // Lines starting in [lo,hi) remain to be searched.  Both are always
+  // at the start of a line, or 'hi' is the end of the file.
+  std::uint64_t lo = m_firstLine;
+  std::uint64_t hi = m_size;
+
+  while (lo < hi) {
+    // Find the first line starting after the midpoint.  If there is
+    // none before 'hi', fall back to the line at 'lo'.
+    std::uint64_t mid = lo + (hi - lo) / 2;
+    std::uint64_t lineStart = lo;
+    if (mid > lo) {
+      if (!readLineAt(line, mid-1)) {
+        break;
+      }
+      lineStart = mid + line.size();
+      if (lineStart >= hi) {
+        lineStart = lo;
+      }
+    }
+
+    if (!readLineAt(line, lineStart) ||
+        !parseNodeOffsetIndexLine(entry, line)) {
+      return stringb(doubleQuote(m_fname) <<
+                     ": malformed index line at offset " << lineStart);
+    }
+
+    if (entry.m_nodeID == nodeID) {
+      found = true;
+      return "";
+    }
+    else if (entry.m_nodeID < nodeID) {
+      lo = lineStart + line.size() + 1;
+    }
+    else {
+      hi = lineStart;
+    }
+  }
+
+  return "";
+}
+
+
+// -------------------------- lookupNodeRecords --------------------------
+std::string lookupNodeRecords(
+  std::ostream &os,
+  std::string const &nodesFname,
+  std::string const &indexFname,
+  std::vector<std::string> const &ids)
+{
+  std::ifstream indexStream(indexFname, std::ios::binary);
+  if (!indexStream) {
+    return stringb("cannot read " << doubleQuote(indexFname));
+  }
+  NodeOffsetIndexReader reader(indexStream, indexFname);
+  std::string err = reader.open();
+  if (!err.empty()) {
+    return err;
+  }
+
+  std::ifstream nodesStream(nodesFname, std::ios::binary);
+  if (!nodesStream) {
+    return stringb("cannot read " << doubleQuote(nodesFname));
+  }
+
+  os << "{\n";
+
+  for (std::string const &id : ids) {
+    // Accept "4711" or "FunctionDecl 4711".
+    llvm::StringRef typeName, number;
+    std::tie(typeName, number) = llvm::StringRef(id).trim().rsplit(' ');
+    if (number.empty()) {
+      std::swap(typeName, number);
+    }
+
+    std::uint64_t nodeID;
+    if (number.getAsInteger(10, nodeID /*OUT*/)) {
+      return stringb("malformed node ID: " << doubleQuote(id));
+    }
+
+    bool found;
+    NodeOffsetIndexEntry entry;
+    err = reader.find(found, entry, nodeID);
+    if (!err.empty()) {
+      return err;
+    }
+    if (!found ||
+        (!typeName.empty() && typeName != entry.m_typeName)) {
+      return stringb("node not found: " << doubleQuote(id));
+    }
+
+    std::string record(entry.m_length, '\0');
+    nodesStream.clear();
+    nodesStream.seekg(entry.m_offset);
+    nodesStream.read(&record[0], entry.m_length);
+
+    // Check that the index matches the output, since nothing ties the
+    // two files together.
+    std::string expectStart =
+      stringb('"' << entry.m_typeName << ' ' << nodeID << "\": {\n");
+    if (!nodesStream ||
+        !llvm::StringRef(record).startswith(expectStart) ||
+        !llvm::StringRef(record).endswith("},\n")) {
+      return stringb(doubleQuote(nodesFname) << " does not have the " <<
+                     "record at the location in " << doubleQuote(indexFname) <<
+                     " for " << doubleQuote(id));
+    }
+
+    os << "\n" << record;
+  }
+
+  os << "}\n";
+  os.flush();
+
+  return "";
+}
+
+
+// EOF
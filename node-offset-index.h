@@ -0,0 +1,125 @@
+// node-offset-index.h
+// Sidecar index giving the location of each --print-ast-nodes record.
+
+#ifndef PCA_NODE_OFFSET_INDEX_H
+#define PCA_NODE_OFFSET_INDEX_H
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <cstdint>                               // std::uint64_t
+#include <iosfwd>                                // std::{istream, ostream}
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+/*
+  The index is a text file.  Its first line is a fixed header, and each
+  following line describes one record:
+
+    <NodeID> <offset> <length> <type name>
+
+  For example, the record `"FunctionDecl 4711": {` ... `},` might be
+
+    4711 1234567 890 FunctionDecl
+
+  The offset is that of the opening quote, counting from the start of
+  the stream the records are printed to, so it includes any output
+  printed before them, and the length runs through the newline after the
+  closing `},`.  When compressing, the offsets are in the uncompressed
+  stream, the same as those in a frame index (see compressed-output.h).
+  If the stream's position cannot be found, as with a pipe, they count
+  from the `{` that begins the node output.  Lines are in increasing
+  NodeID order, which is the order the records are printed in, so a
+  lookup can binary search the file without reading all of it.
+*/
+
+
+// One line of the index.
+class NodeOffsetIndexEntry {
+public:      // data
+  // Number at the end of the record ID.
+  std::uint64_t m_nodeID = 0;
+
+  // Record ID without the number, e.g., "FunctionDecl".
+  std::string m_typeName;
+
+  // Location of the record in the output.
+  std::uint64_t m_offset = 0;
+  std::uint64_t m_length = 0;
+};
+
+
+// Write the first line of an index.
+void writeNodeOffsetIndexHeader(std::ostream &os);
+
+// Write the line for the record whose ID is 'recordID', like
+// "FunctionDecl 4711".  Does nothing if it does not end with a number.
+void writeNodeOffsetIndexLine(
+  std::ostream &os,
+  llvm::StringRef recordID,
+  std::uint64_t offset,
+  std::uint64_t length);
+
+// Parse one line written by `writeNodeOffsetIndexLine`.  Returns false
+// if it is malformed.
+bool parseNodeOffsetIndexLine(
+  NodeOffsetIndexEntry /*OUT*/ &entry,
+  llvm::StringRef line);
+
+// Copy to 'os' the index lines in 'lines', adding 'base' to each
+// offset.  This is used to combine indices of separately printed parts
+// of the output.
+void rebaseNodeOffsetIndexLines(
+  std::ostream &os,
+  llvm::StringRef lines,
+  std::uint64_t base);
+
+
+// Looks up entries in an index stored in a seekable stream, reading
+// only the lines a binary search visits.
+class NodeOffsetIndexReader {
+private:     // data
+  // The index and its name, for error messages.
+  std::istream &m_is;
+  std::string m_fname;
+
+  // Offset of the first entry line, and the size of the stream.
+  std::uint64_t m_firstLine;
+  std::uint64_t m_size;
+
+private:     // methods
+  // Read the line starting at 'pos' into 'line', without its newline.
+  bool readLineAt(std::string /*OUT*/ &line, std::uint64_t pos);
+
+public:      // methods
+  NodeOffsetIndexReader(std::istream &is, std::string const &fname);
+
+  // Check the header.  Returns "" or an error message.
+  std::string open();
+
+  // Find the entry for 'nodeID', setting 'found' accordingly.  Returns
+  // "" or an error message.
+  std::string find(
+    bool /*OUT*/ &found,
+    NodeOffsetIndexEntry /*OUT*/ &entry,
+    std::uint64_t nodeID);
+};
+
+
+// Print to 'os', in the format of --print-ast-nodes, the records of the
+// output in 'nodesFname' named by 'ids', using the index 'indexFname'.
+// Each ID is either a NodeID, like "4711", or a full record ID, like
+// "FunctionDecl 4711", in which case the type name must also match.
+// Returns "" or an error message.
+std::string lookupNodeRecords(
+  std::ostream &os,
+  std::string const &nodesFname,
+  std::string const &indexFname,
+  std::vector<std::string> const &ids);
+
+
+// Unit tests, defined in node-offset-index-test.cc.
+void node_offset_index_unit_tests();
+
+
+#endif // PCA_NODE_OFFSET_INDEX_H
@@ -0,0 +1,180 @@
+// node-query-test.cc
+// Tests for `node-query`.
+
+#include "node-query.h"                          // module under test
+
+#include "clang-ast.h"                           // ClangAST, ClangASTUtilTempFile
+#include "clang-util.h"                          // GlobalClangUtilInstance
+#include "print-clang-ast-nodes.h"               // printClangASTNodes
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "clang/AST/Decl.h"                      // clang::NamedDecl
+
+#include "llvm/Support/Casting.h"                // llvm::dyn_cast
+
+#include <cstddef>                               // std::size_t
+#include <sstream>                               // std::ostringstream
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+void testParseNodeQuery()
+{
+  std::vector<NodeQueryTerm> terms;
+  EXPECT_EQ(parseNodeQuery(terms,
+    "ns::f, name:kind::g,kind:FieldDecl, lines:dir/a.h:3-end,"
+    "lines:c:\\b.cc:7"), "");
+  EXPECT_EQ(terms.size(), (std::size_t)5);
+
+  EXPECT_EQ(terms[0].m_kind, NodeQueryTerm::QT_NAME);
+  EXPECT_EQ(terms[0].m_text, "ns::f");
+
+  // A namespace called "kind" is not a prefix.
+  EXPECT_EQ(terms[1].m_kind, NodeQueryTerm::QT_NAME);
+  EXPECT_EQ(terms[1].m_text, "kind::g");
+
+  EXPECT_EQ(terms[2].m_kind, NodeQueryTerm::QT_KIND);
+  EXPECT_EQ(terms[2].m_text, "FieldDecl");
+
+  EXPECT_EQ(terms[3].m_kind, NodeQueryTerm::QT_LINES);
+  EXPECT_EQ(terms[3].m_text, "dir/a.h");
+  EXPECT_EQ(terms[3].m_firstLine, "3");
+  EXPECT_EQ(terms[3].m_lastLine, "end");
+
+  EXPECT_EQ(terms[4].m_text, "c:\\b.cc");
+  EXPECT_EQ(terms[4].m_firstLine, "7");
+  EXPECT_EQ(terms[4].m_lastLine, "7");
+
+  EXPECT_EQ(parseNodeQuery(terms, " , "), "the query has no terms");
+  EXPECT_EQ(parseNodeQuery(terms, "kind:"),
+            "query term \"kind:\" is incomplete");
+  EXPECT_EQ(parseNodeQuery(terms, "lines:a.h"),
+            "query term \"lines:a.h\" has no line range");
+  EXPECT_EQ(parseNodeQuery(terms, "lines:a.h:-3"),
+            "query term \"lines:a.h:-3\" has no first line");
+  EXPECT_EQ(parseNodeQuery(terms, "lines:a.h:"),
+            "query term \"lines:a.h:\" has no first line");
+  EXPECT_EQ(parseNodeQuery(terms, "lines:a.h:5-3"),
+            "query term \"lines:a.h:5-3\" has its lines in reverse order");
+}
+
+
+// Return the qualified names of the declarations 'query' selects in
+// 'ast', separated by spaces.
+string findNames(ClangASTUtilTempFile &ast, char const *query)
+{
+  std::vector<NodeQueryTerm> terms;
+  EXPECT_EQ(parseNodeQuery(terms, query), "");
+
+  string ret;
+  for (clang::Decl *decl : findNodeQueryDecls(ast.getASTContext(), terms)) {
+    if (!ret.empty()) {
+      ret += " ";
+    }
+    if (auto namedDecl = llvm::dyn_cast<clang::NamedDecl>(decl)) {
+      ret += namedDecl->getQualifiedNameAsString();
+    }
+    else {
+      ret += decl->getDeclKindName();
+    }
+  }
+  return ret;
+}
+
+
+// Print the nodes of 'ast' with 'config', and return the output.
+string printNodes(
+  ClangASTUtilTempFile &ast,
+  PrintClangASTNodesConfiguration const &config)
+{
+  GlobalClangUtilInstance gcui(ast.getASTContext());
+  std::ostringstream oss;
+  EXPECT_EQ(printClangASTNodes(oss, ast.getASTContext(), config), 0);
+  return oss.str();
+}
+
+
+// True if 'haystack' contains 'needle'.
+bool contains(string const &haystack, char const *needle)
+{
+  return haystack.find(needle) != string::npos;
+}
+
+
+void testQuery()
+{
+  ClangAST::addInMemoryFile("/pca-in-memory/nq-test/a.h", R"(
+    namespace ns {
+      int helper(int x);          // SYMLINE(helperLine)
+    }
+  )");
+
+  ClangASTUtilTempFile ast(R"(
+    #include "/pca-in-memory/nq-test/a.h"
+    namespace ns {
+      struct S {
+        int m;
+        int f() { return helper(m); }
+      };
+    }
+    int unrelatedFunction() { return 2; }
+  )");
+
+  EXPECT_EQ(findNames(ast, "ns::S::f"), "ns::S::f");
+  EXPECT_EQ(findNames(ast, "name:ns::helper"), "ns::helper");
+  EXPECT_EQ(findNames(ast, "f"), "");
+
+  // Members of a selected declaration are not listed again.
+  EXPECT_EQ(findNames(ast, "ns::S,ns::S::f"), "ns::S");
+
+  // Implicit declarations can also be selected, so only look for the
+  // explicit one.
+  EXPECT_EQ(contains(findNames(ast, "kind:FieldDecl"), "ns::S::m"), true);
+
+  EXPECT_EQ(findNames(ast, "lines:nq-test/a.h:helperLine"), "ns::helper");
+  EXPECT_EQ(findNames(ast, "lines:a.h:1-3"), "ns");
+  EXPECT_EQ(findNames(ast, "lines:other/a.h:1-3"), "");
+
+  PrintClangASTNodesConfiguration config;
+  config.m_printAddresses = false;
+  string all = printNodes(ast, config);
+  EXPECT_EQ(contains(all, "unrelatedFunction"), true);
+  EXPECT_EQ(contains(all, "skipping beyond query depth"), false);
+
+  // Depth 0 prints 'f' but not 'helper', even though it is called.
+  EXPECT_EQ(parseNodeQuery(config.m_queryTerms, "ns::S::f"), "");
+  config.m_queryDepth = 0;
+  string depth0 = printNodes(ast, config);
+  EXPECT_EQ(contains(depth0, "unrelatedFunction"), false);
+  EXPECT_EQ(contains(depth0, "skipping beyond query depth"), true);
+  EXPECT_EQ(contains(depth0, "nq-test/a.h"), true);
+  EXPECT_EQ(depth0.size() < all.size(), true);
+
+  // Depth 1 also prints 'helper', which is outside the primary source
+  // file, but not its parameter.
+  config.m_queryDepth = 1;
+  string depth1 = printNodes(ast, config);
+  EXPECT_EQ(contains(depth1, "skipping outside primary file"), false);
+  EXPECT_EQ(depth0.size() < depth1.size(), true);
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void node_query_unit_tests()
+{
+  testParseNodeQuery();
+  testQuery();
+}
+
+
+// EOF
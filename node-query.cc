@@ -0,0 +1,300 @@
+// node-query.cc
+// Code for node-query.h.
+
+#include "node-query.h"                          // this module
+
+#include "decl-file-filter.h"                    // DeclFileFilter
+
+#include "smbase/stringb.h"                      // stringb
+#include "smbase/string-util.h"                  // doubleQuote
+
+#include "clang/AST/Decl.h"                      // clang::NamedDecl
+#include "clang/AST/DeclBase.h"                  // clang::Decl
+#include "clang/AST/RecursiveASTVisitor.h"       // clang::RecursiveASTVisitor
+#include "clang/Basic/SourceManager.h"           // clang::SourceManager
+#include "clang/Basic/Stack.h"                   // clang::isStackNearlyExhausted
+
+#include "llvm/ADT/SmallVector.h"                // llvm::SmallVector
+#include "llvm/Support/Casting.h"                // llvm::dyn_cast
+
+using clang::dyn_cast;
+
+using std::string;
+
+
+// If 'term' starts with 'prefix' followed by ":", but not "::" (which
+// would make it part of a qualified name), remove that and return
+// true.
+static bool removeTermPrefix(llvm::StringRef &term, llvm::StringRef prefix)
+{
+  if (term.size() > prefix.size() &&
+      term.startswith(prefix) &&
+      term[prefix.size()] == ':' &&
+      !term.drop_front(prefix.size()).startswith("::")) {
+    term = term.drop_front(prefix.size() + 1);
+    return true;
+  }
+  return false;
+}
+
+
+// True if 's' is a nonempty string of decimal digits.
+static bool isLineNumber(llvm::StringRef s)
+{
+  return !s.empty() &&
+         s.find_first_not_of("0123456789") == llvm::StringRef::npos;
+}
+
+
+std::string parseNodeQuery(
+  std::vector<NodeQueryTerm> /*OUT*/ &terms,
+  llvm::StringRef query)
+{
+  terms.clear();
+
+  llvm::SmallVector<llvm::StringRef, 4> termStrings;
+  query.split(termStrings, ',', -1 /*maxSplit*/, false /*keepEmpty*/);
+
+  for (llvm::StringRef orig : termStrings) {
+    orig = orig.trim();
+    if (orig.empty()) {
+      continue;
+    }
+    llvm::StringRef rest = orig;
+    NodeQueryTerm term;
+
+    if (removeTermPrefix(rest, "kind")) {
+      term.m_kind = NodeQueryTerm::QT_KIND;
+    }
+    else if (removeTermPrefix(rest, "lines")) {
+      term.m_kind = NodeQueryTerm::QT_LINES;
+
+      // The file name may itself contain ':', but the line range cannot.
+      if (rest.find(':') == llvm::StringRef::npos) {
+        return stringb("query term " << doubleQuote(orig.str()) <<
+                       " has no line range");
+      }
+      std::pair<llvm::StringRef, llvm::StringRef> fileAndRange =
+        rest.rsplit(':');
+      rest = fileAndRange.first;
+
+      std::pair<llvm::StringRef, llvm::StringRef> firstAndLast =
+        fileAndRange.second.split('-');
+      term.m_firstLine = firstAndLast.first.str();
+      term.m_lastLine = firstAndLast.second.empty()?
+        term.m_firstLine : firstAndLast.second.str();
+      if (term.m_firstLine.empty()) {
+        return stringb("query term " << doubleQuote(orig.str()) <<
+                       " has no first line");
+      }
+
+      unsigned first, last;
+      if (isLineNumber(term.m_firstLine) &&
+          isLineNumber(term.m_lastLine) &&
+          !llvm::StringRef(term.m_firstLine).getAsInteger(10, first) &&
+          !llvm::StringRef(term.m_lastLine).getAsInteger(10, last) &&
+          first > last) {
+        return stringb("query term " << doubleQuote(orig.str()) <<
+                       " has its lines in reverse order");
+      }
+    }
+    else {
+      removeTermPrefix(rest, "name");
+    }
+
+    term.m_text = rest.str();
+    if (term.m_text.empty()) {
+      return stringb("query term " << doubleQuote(orig.str()) <<
+                     " is incomplete");
+    }
+    terms.push_back(term);
+  }
+
+  if (terms.empty()) {
+    return "the query has no terms";
+  }
+  return "";
+}
+
+
+// -------------------------- NodeQueryMatcher --------------------------
+NodeQueryMatcher::NodeQueryMatcher(
+  clang::ASTContext &astContext,
+  std::vector<NodeQueryTerm> const &terms)
+  : ClangUtil(astContext),
+    m_terms(terms),
+    m_lineMapper(astContext),
+    m_lineRanges()
+{}
+
+
+NodeQueryMatcher::~NodeQueryMatcher()
+{}
+
+
+std::optional<int> NodeQueryMatcher::lineNumberOpt(
+  clang::FileID fileID,
+  std::string const &line) const
+{
+  if (isLineNumber(line)) {
+    int n;
+    if (llvm::StringRef(line).getAsInteger(10, n)) {
+      return std::nullopt;           // Too large.
+    }
+    return n;
+  }
+
+  return m_lineMapper.symLineNumberOpt(fileID, line);
+}
+
+
+std::pair<int, int> NodeQueryMatcher::lineRange(
+  std::size_t termIndex,
+  clang::FileID fileID)
+{
+  auto key = std::make_pair(termIndex, fileID);
+  auto it = m_lineRanges.find(key);
+  if (it != m_lineRanges.end()) {
+    return it->second;
+  }
+
+  NodeQueryTerm const &term = m_terms[termIndex];
+  std::pair<int, int> range(1, 0);
+
+  auto entry = m_srcMgr.getFileEntryRefForID(fileID);
+  if (entry &&
+      DeclFileFilter::fileNameMatches(fileEntryRefNameStr(*entry),
+                                      term.m_text)) {
+    std::optional<int> first = lineNumberOpt(fileID, term.m_firstLine);
+    std::optional<int> last = lineNumberOpt(fileID, term.m_lastLine);
+    if (first && last) {
+      range = std::make_pair(*first, *last);
+    }
+  }
+
+  m_lineRanges.insert({key, range});
+  return range;
+}
+
+
+bool NodeQueryMatcher::matches(clang::Decl const *decl)
+{
+  auto namedDecl = dyn_cast<clang::NamedDecl>(decl);
+
+  for (std::size_t i=0; i < m_terms.size(); ++i) {
+    NodeQueryTerm const &term = m_terms[i];
+
+    switch (term.m_kind) {
+      case NodeQueryTerm::QT_NAME: {
+        if (!namedDecl) {
+          break;
+        }
+
+        // Computing the qualified name is relatively expensive, so
+        // first compare the last component when that is easy.
+        clang::DeclarationName name = namedDecl->getDeclName();
+        if (name.isIdentifier()) {
+          llvm::StringRef text(term.m_text);
+          std::size_t colons = text.rfind("::");
+          llvm::StringRef last = (colons == llvm::StringRef::npos)?
+            text : text.drop_front(colons + 2);
+          if (namedDecl->getName() != last) {
+            break;
+          }
+        }
+
+        if (namedDecl->getQualifiedNameAsString() == term.m_text) {
+          return true;
+        }
+        break;
+      }
+
+      case NodeQueryTerm::QT_KIND:
+        if (term.m_text == string(decl->getDeclKindName()) + "Decl") {
+          return true;
+        }
+        break;
+
+      case NodeQueryTerm::QT_LINES: {
+        clang::SourceLocation loc = decl->getLocation();
+        if (loc.isInvalid()) {
+          break;
+        }
+
+        // Use the same notion of "line" as `SymbolicLineMapper`.
+        loc = m_srcMgr.getFileLoc(loc);
+        clang::FileID fileID = m_srcMgr.getFileID(loc);
+        if (fileID.isInvalid()) {
+          break;
+        }
+
+        std::pair<int, int> range = lineRange(i, fileID);
+        int line = m_srcMgr.getPresumedLineNumber(loc);
+        if (range.first <= line && line <= range.second) {
+          return true;
+        }
+        break;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+// ------------------------- findNodeQueryDecls -------------------------
+// Visitor to collect the declarations a query selects.
+class FindNodeQueryDecls
+  : public clang::RecursiveASTVisitor<FindNodeQueryDecls> {
+public:      // data
+  // Decides which declarations to collect.
+  NodeQueryMatcher m_matcher;
+
+  // The collected declarations.
+  std::vector<clang::Decl *> m_decls;
+
+public:      // methods
+  FindNodeQueryDecls(clang::ASTContext &astContext,
+                     std::vector<NodeQueryTerm> const &terms)
+    : m_matcher(astContext, terms),
+      m_decls()
+  {}
+
+  // Look everywhere `NumberClangASTNodes` does.
+  bool shouldVisitTemplateInstantiations() const
+    { return true; }
+  bool shouldVisitImplicitCode() const
+    { return true; }
+
+  bool TraverseDecl(clang::Decl *decl);
+};
+
+
+bool FindNodeQueryDecls::TraverseDecl(clang::Decl *decl)
+{
+  if (clang::isStackNearlyExhausted()) {
+    bool ret = true;
+    runOnFreshStack([&] { ret = TraverseDecl(decl); });
+    return ret;
+  }
+
+  if (decl && m_matcher.matches(decl)) {
+    // Everything inside will be numbered along with 'decl'.
+    m_decls.push_back(decl);
+    return true;
+  }
+  return RecursiveASTVisitor::TraverseDecl(decl);
+}
+
+
+std::vector<clang::Decl *> findNodeQueryDecls(
+  clang::ASTContext &astContext,
+  std::vector<NodeQueryTerm> const &terms)
+{
+  FindNodeQueryDecls finder(astContext, terms);
+  finder.TraverseDecl(astContext.getTranslationUnitDecl());
+  return finder.m_decls;
+}
+
+
+// EOF
@@ -0,0 +1,121 @@
+// node-query.h
+// Select the declarations around which --print-ast-nodes prints.
+
+#ifndef PCA_NODE_QUERY_H
+#define PCA_NODE_QUERY_H
+
+#include "clang-util.h"                          // ClangUtil
+#include "symbolic-line-mapper.h"                // SymbolicLineMapper
+
+#include "clang/AST/ASTFwd.h"                    // clang::Decl [n]
+#include "clang/Basic/SourceLocation.h"          // clang::FileID
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <cstddef>                               // std::size_t
+#include <map>                                   // std::map
+#include <optional>                              // std::optional
+#include <string>                                // std::string
+#include <utility>                               // std::pair
+#include <vector>                                // std::vector
+
+
+/*
+  A node query is a comma-separated list of terms, each of which
+  selects some declarations:
+
+    name:N          Those whose qualified name is N, such as "ns::C::f".
+                    For a template specialization, N does not include
+                    the template arguments.  "name:" can be omitted.
+
+    kind:K          Those whose node kind, as it appears in the node
+                    IDs, is K, such as "ClassTemplateSpecializationDecl".
+
+    lines:F:A-B     Those whose location is on lines A through B of file
+                    F.  F is matched as described at
+                    `DeclFileFilter::fileNameMatches`.  A and B are each
+                    either a line number or the name given to a line by
+                    "SYMLINE(name)" (see symbolic-line-mapper.h).  "-B"
+                    can be omitted to select just line A.
+
+  A declaration is selected if any of the terms selects it.
+*/
+
+
+// One term of a node query.
+class NodeQueryTerm {
+public:      // types
+  enum Kind {
+    QT_NAME,
+    QT_KIND,
+    QT_LINES,
+  };
+
+public:      // data
+  // Which kind of term this is.
+  Kind m_kind = QT_NAME;
+
+  // The qualified name, node kind, or file name, respectively.
+  std::string m_text;
+
+  // For 'QT_LINES', the first and last line, each a number or a
+  // symbolic line name.
+  std::string m_firstLine;
+  std::string m_lastLine;
+};
+
+// Parse 'query' into 'terms'.  Returns "" or an error message.
+std::string parseNodeQuery(
+  std::vector<NodeQueryTerm> /*OUT*/ &terms,
+  llvm::StringRef query);
+
+
+// Decides whether a query selects a declaration.
+class NodeQueryMatcher : public ClangUtil {
+private:     // data
+  // The query.
+  std::vector<NodeQueryTerm> m_terms;
+
+  // Resolves symbolic line names.
+  SymbolicLineMapper m_lineMapper;
+
+  // Map from the index in 'm_terms' of a 'QT_LINES' term, and a file,
+  // to the first and last line that term selects in that file.  The
+  // range is empty if the term does not apply to the file.
+  std::map<std::pair<std::size_t, clang::FileID>, std::pair<int, int>>
+    m_lineRanges;
+
+private:     // methods
+  // Return the line number in 'fileID' that 'line' denotes, if any.
+  std::optional<int> lineNumberOpt(
+    clang::FileID fileID,
+    std::string const &line) const;
+
+  // Get the range for 'termIndex' and 'fileID', using the cache.
+  std::pair<int, int> lineRange(std::size_t termIndex,
+                                clang::FileID fileID);
+
+public:      // methods
+  NodeQueryMatcher(clang::ASTContext &astContext,
+                   std::vector<NodeQueryTerm> const &terms);
+
+  ~NodeQueryMatcher();
+
+  // True if some term selects 'decl'.
+  bool matches(clang::Decl const *decl);
+};
+
+
+// Return the declarations in 'astContext' that 'terms' select, in the
+// order a traversal of the TU reaches them.  Declarations inside a
+// selected one are not listed separately.
+std::vector<clang::Decl *> findNodeQueryDecls(
+  clang::ASTContext &astContext,
+  std::vector<NodeQueryTerm> const &terms);
+
+
+// Unit tests, defined in node-query-test.cc.
+void node_query_unit_tests();
+
+
+#endif // PCA_NODE_QUERY_H
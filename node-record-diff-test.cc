@@ -0,0 +1,229 @@
+// node-record-diff-test.cc
+// Tests for `node-record-diff`.
+
+#include "node-record-diff.h"                    // module under test
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "llvm/Support/Error.h"                  // llvm::toString
+#include "llvm/Support/JSON.h"                   // llvm::json::{Array, parse, Value}
+
+#include <cstddef>                               // std::size_t
+#include <sstream>                               // std::ostringstream
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Output of a first run.
+char const oldText[] =
+  "{\n"
+  "\n"
+  "\"TranslationUnitDecl 1\": {\n"
+  "  \"Decl::Loc\": \"<invalid loc>\",\n"
+  "},\n"
+  "\n"
+  "\"VarDecl 2\": {\n"
+  "  \"Name\": \"x\",\n"
+  "  \"Init\": { \"ptr\": \"IntegerLiteral 3\" },\n"
+  "},\n"
+  "\n"
+  "\"IntegerLiteral 3\": {\n"
+  "  \"Value\": \"1\",\n"
+  "},\n"
+  "}\n";
+
+// Output after an edit: the literal changed and the declaration lost
+// its initializer, creating a new node.
+char const newText[] =
+  "{\n"
+  "\n"
+  "\"TranslationUnitDecl 1\": {\n"
+  "  \"Decl::Loc\": \"<invalid loc>\",\n"
+  "},\n"
+  "\n"
+  "\"VarDecl 2\": {\n"
+  "  \"Name\": \"x\",\n"
+  "  \"Init\": { \"ptr\": \"null\" },\n"
+  "},\n"
+  "\n"
+  "\"IntegerLiteral 4\": {\n"
+  "  \"Value\": \"2\",\n"
+  "},\n"
+  "}\n";
+
+
+void testSplitNodeRecords()
+{
+  std::vector<NodeRecord> records = splitNodeRecords(oldText);
+  EXPECT_EQ(records.size(), (std::size_t)3);
+
+  EXPECT_EQ(records[0].m_id.str(), "TranslationUnitDecl 1");
+  EXPECT_EQ(records[0].m_body.str(),
+    "  \"Decl::Loc\": \"<invalid loc>\",\n");
+
+  EXPECT_EQ(records[1].m_id.str(), "VarDecl 2");
+  EXPECT_EQ(records[2].m_id.str(), "IntegerLiteral 3");
+
+  // An empty record.
+  records = splitNodeRecords("\"X 1\": {\n},\n");
+  EXPECT_EQ(records.size(), (std::size_t)1);
+  EXPECT_EQ(records[0].m_body.str(), "");
+}
+
+
+void testFingerprint()
+{
+  // Known FNV-1a values.
+  EXPECT_EQ(fingerprintNodeRecord(""), 0xcbf29ce484222325ULL);
+  EXPECT_EQ(fingerprintNodeRecord("a"), 0xaf63dc4c8601ec8cULL);
+
+  EXPECT_EQ(fingerprintNodeRecord("x\n") == fingerprintNodeRecord("y\n"),
+            false);
+}
+
+
+void testFingerprintRoundTrip()
+{
+  std::vector<NodeRecord> records = splitNodeRecords(oldText);
+
+  std::ostringstream oss;
+  writeNodeFingerprints(oss, records);
+
+  NodeFingerprints fingerprints;
+  EXPECT_EQ(parseNodeFingerprints(fingerprints, "fp", oss.str()), "");
+  EXPECT_EQ(fingerprints.size(), (std::size_t)3);
+  EXPECT_EQ(fingerprints["VarDecl 2"],
+            fingerprintNodeRecord(records[1].m_body));
+
+  // The file format is checked.
+  NodeFingerprints bad;
+  EXPECT_EQ(parseNodeFingerprints(bad, "fp", "whatever\n"),
+    "\"fp\": not a node fingerprint file");
+
+  string text = oss.str() + "xyz VarDecl 9\n";
+  EXPECT_EQ(parseNodeFingerprints(bad, "fp", text),
+    "\"fp\":5: malformed fingerprint line");
+}
+
+
+// Parse 'text' as JSON, and return the operations it contains.
+llvm::json::Array parsePatch(string const &text)
+{
+  llvm::Expected<llvm::json::Value> value = llvm::json::parse(text);
+  if (!value) {
+    string msg = llvm::toString(value.takeError());
+    EXPECT_EQ(msg, "");
+    return llvm::json::Array();
+  }
+
+  llvm::json::Array const *ops = value->getAsArray();
+  EXPECT_EQ(ops != nullptr, true);
+  return ops? *ops : llvm::json::Array();
+}
+
+
+// Return member 'key' of 'op', which must be a string.
+string opString(llvm::json::Value const &op, char const *key)
+{
+  llvm::Optional<llvm::StringRef> str =
+    op.getAsObject()->getString(key);
+  EXPECT_EQ((bool)str, true);
+  return str? str->str() : "";
+}
+
+
+void testPatch()
+{
+  std::ostringstream fpStream;
+  writeNodeFingerprints(fpStream, splitNodeRecords(oldText));
+  NodeFingerprints oldFingerprints;
+  parseNodeFingerprints(oldFingerprints, "fp", fpStream.str());
+
+  std::ostringstream oss;
+  int numOps = writeNodeRecordPatch(oss, oldFingerprints,
+                                    splitNodeRecords(newText));
+  EXPECT_EQ(numOps, 3);
+  EXPECT_EQ(oss.str(),
+    "[\n"
+    "\n"
+    "{ \"op\": \"replace\", \"path\": \"/VarDecl 2\", \"value\": {\n"
+    "  \"Name\": \"x\",\n"
+    "  \"Init\": { \"ptr\": \"null\" }\n"
+    "} },\n"
+    "\n"
+    "{ \"op\": \"add\", \"path\": \"/IntegerLiteral 4\", \"value\": {\n"
+    "  \"Value\": \"2\"\n"
+    "} },\n"
+    "\n"
+    "{ \"op\": \"remove\", \"path\": \"/IntegerLiteral 3\" }\n"
+    "]\n");
+
+  // The patch is valid JSON.
+  llvm::json::Array ops = parsePatch(oss.str());
+  EXPECT_EQ(ops.size(), (std::size_t)3);
+  EXPECT_EQ(opString(ops[0], "op"), "replace");
+  EXPECT_EQ(opString(ops[0], "path"), "/VarDecl 2");
+  llvm::json::Object const *value =
+    ops[0].getAsObject()->getObject("value");
+  EXPECT_EQ(value != nullptr, true);
+  EXPECT_EQ(value->size(), (std::size_t)2);
+  EXPECT_EQ(value->getString("Name")->str(), "x");
+  EXPECT_EQ(opString(ops[1], "op"), "add");
+  EXPECT_EQ(opString(ops[2], "op"), "remove");
+  EXPECT_EQ(opString(ops[2], "path"), "/IntegerLiteral 3");
+
+  // No changes, empty patch.
+  std::ostringstream oss2;
+  EXPECT_EQ(writeNodeRecordPatch(oss2, oldFingerprints,
+                                 splitNodeRecords(oldText)), 0);
+  EXPECT_EQ(oss2.str(), "[]\n");
+  EXPECT_EQ(parsePatch(oss2.str()).size(), (std::size_t)0);
+}
+
+
+void testPatchNestedValues()
+{
+  // A record with a list, and commas inside strings, which must stay.
+  char const text[] =
+    "\"CXXRecordDecl 1\": {\n"
+    "  \"flags\": [\n"
+    "    \"Aggregate\",\n"
+    "    \"IsLambda\",\n"
+    "  ],\n"
+    "  \"Name\": \"a, }\\\"]\",\n"
+    "},\n";
+
+  NodeFingerprints none;
+  std::ostringstream oss;
+  EXPECT_EQ(writeNodeRecordPatch(oss, none, splitNodeRecords(text)), 1);
+
+  llvm::json::Array ops = parsePatch(oss.str());
+  EXPECT_EQ(ops.size(), (std::size_t)1);
+  llvm::json::Object const *value =
+    ops[0].getAsObject()->getObject("value");
+  EXPECT_EQ(value->getArray("flags")->size(), (std::size_t)2);
+  EXPECT_EQ(value->getString("Name")->str(), "a, }\"]");
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void node_record_diff_unit_tests()
+{
+  testSplitNodeRecords();
+  testFingerprint();
+  testFingerprintRoundTrip();
+  testPatch();
+  testPatchNestedValues();
+}
+
+
+// EOF
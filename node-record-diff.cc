@@ -0,0 +1,279 @@
+// node-record-diff.cc
+// Code for `node-record-diff.h`.
+
+#include "node-record-diff.h"                    // this module
+
+#include "smbase/string-util.h"                  // doubleQuote
+#include "smbase/stringb.h"                      // stringb
+
+#include <cstddef>                               // std::size_t
+#include <iomanip>                               // std::{hex, setw}
+#include <ostream>                               // std::ostream
+
+
+// First line of a fingerprint file.
+static char const fingerprintsHeader[] = "pca-node-fingerprints 1";
+
+
+// Remove the first line from 'text' and return it without its newline.
+static llvm::StringRef takeLine(llvm::StringRef /*INOUT*/ &text)
+{
+  std::pair<llvm::StringRef, llvm::StringRef> lineAndRest = text.split('\n');
+  text = lineAndRest.second;
+  return lineAndRest.first;
+}
+
+
+NodeRecordSink::~NodeRecordSink()
+{}
+
+
+void NodeRecordSinkFanout::handleNodeRecord(NodeRecord const &record)
+{
+  for (NodeRecordSink *sink : m_sinks) {
+    sink->handleNodeRecord(record);
+  }
+}
+
+
+std::vector<NodeRecord> splitNodeRecords(llvm::StringRef text)
+{
+  std::vector<NodeRecord> records;
+
+  while (!text.empty()) {
+    llvm::StringRef line = takeLine(text);
+
+    // An opening line is the quoted ID followed by `: {`.
+    if (!( line.startswith("\"") && line.endswith("\": {") )) {
+      continue;
+    }
+    llvm::StringRef id = line.drop_front(1).drop_back(4);
+
+    // The body runs up to the closing line.
+    char const *bodyStart = text.data();
+    char const *bodyEnd = bodyStart;
+    while (!text.empty()) {
+      if (takeLine(text) == "},") {
+        break;
+      }
+      bodyEnd = text.data();
+    }
+
+    records.push_back(NodeRecord(id,
+      llvm::StringRef(bodyStart, bodyEnd - bodyStart)));
+  }
+
+  return records;
+}
+
+
+std::uint64_t fingerprintNodeRecord(llvm::StringRef body)
+{
+  // 64-bit FNV-1a.
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char c : body) {
+    hash ^= (unsigned char)c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+
+void writeWithoutTrailingCommas(std::ostream &os, llvm::StringRef text)
+{
+  // Start of the text not yet written.
+  std::size_t start = 0;
+
+  bool inString = false;
+  for (std::size_t i=0; i < text.size(); ++i) {
+    char c = text[i];
+    if (inString) {
+      if (c == '\\') {
+        ++i;
+      }
+      else if (c == '"') {
+        inString = false;
+      }
+    }
+    else if (c == '"') {
+      inString = true;
+    }
+    else if (c == ',') {
+      std::size_t next = text.find_first_not_of(" \t\r\n", i+1);
+      if (next == llvm::StringRef::npos ||
+          text[next] == '}' || text[next] == ']') {
+        os.write(text.data() + start, i - start);
+        start = i+1;
+      }
+    }
+  }
+
+  os.write(text.data() + start, text.size() - start);
+}
+
+
+NodeFingerprintWriter::NodeFingerprintWriter(std::ostream &os)
+  : m_os(os)
+{
+  m_os << fingerprintsHeader << "\n";
+}
+
+
+void NodeFingerprintWriter::handleNodeRecord(NodeRecord const &record)
+{
+  std::ios_base::fmtflags origFlags = m_os.flags();
+  char origFill = m_os.fill('0');
+
+  m_os << std::hex << std::setw(16) << fingerprintNodeRecord(record.m_body)
+       << ' ';
+  m_os.write(record.m_id.data(), record.m_id.size());
+  m_os << "\n";
+
+  m_os.fill(origFill);
+  m_os.flags(origFlags);
+}
+
+
+void writeNodeFingerprints(
+  std::ostream &os,
+  std::vector<NodeRecord> const &records)
+{
+  NodeFingerprintWriter writer(os);
+  for (NodeRecord const &record : records) {
+    writer.handleNodeRecord(record);
+  }
+}
+
+
+std::string parseNodeFingerprints(
+  NodeFingerprints /*OUT*/ &fingerprints,
+  std::string const &fname,
+  llvm::StringRef text)
+{
+  if (takeLine(text) != fingerprintsHeader) {
+    return stringb(doubleQuote(fname) <<
+                   ": not a node fingerprint file");
+  }
+
+  int lineNumber = 1;
+  while (!text.empty()) {
+    llvm::StringRef line = takeLine(text);
+    ++lineNumber;
+
+    std::pair<llvm::StringRef, llvm::StringRef> hashAndID = line.split(' ');
+    std::uint64_t hash;
+    if (hashAndID.first.getAsInteger(16, hash /*OUT*/) ||
+        hashAndID.second.empty()) {
+      return stringb(doubleQuote(fname) << ":" << lineNumber <<
+                     ": malformed fingerprint line");
+    }
+
+    fingerprints[hashAndID.second.str()] = hash;
+  }
+
+  return "";
+}
+
+
+// Return 'id' as the quoted JSON Pointer (RFC 6901) of a member of the
+// top-level object.  'id' is already in its quoted form, so only the
+// pointer syntax needs escaping.
+static std::string idJsonPointer(llvm::StringRef id)
+{
+  std::string ret = "\"/";
+  for (char c : id) {
+    if (c == '~') {
+      ret += "~0";
+    }
+    else if (c == '/') {
+      ret += "~1";
+    }
+    else {
+      ret += c;
+    }
+  }
+  ret += '"';
+  return ret;
+}
+
+
+
+NodeRecordPatchWriter::NodeRecordPatchWriter(
+  std::ostream &os,
+  NodeFingerprints const &oldFingerprints)
+  : m_os(os),
+    m_oldFingerprints(oldFingerprints),
+    m_seenOldIDs(),
+    m_numOps(0)
+{
+  m_os << "[";
+}
+
+
+void NodeRecordPatchWriter::startOp(char const *op, llvm::StringRef id)
+{
+  if (m_numOps > 0) {
+    m_os << ",";
+  }
+  m_os << "\n\n{ \"op\": \"" << op << "\", \"path\": " << idJsonPointer(id);
+  ++m_numOps;
+}
+
+
+void NodeRecordPatchWriter::handleNodeRecord(NodeRecord const &record)
+{
+  char const *op;
+  std::string id = record.m_id.str();
+  auto it = m_oldFingerprints.find(id);
+  if (it == m_oldFingerprints.end()) {
+    op = "add";
+  }
+  else {
+    m_seenOldIDs.insert(id);
+    if (it->second != fingerprintNodeRecord(record.m_body)) {
+      op = "replace";
+    }
+    else {
+      return;
+    }
+  }
+
+  // The value is printed the same way as in the full output, other
+  // than the trailing commas.
+  startOp(op, record.m_id);
+  m_os << ", \"value\": {\n";
+  writeWithoutTrailingCommas(m_os, record.m_body);
+  m_os << "} }";
+}
+
+
+int NodeRecordPatchWriter::finish()
+{
+  for (auto const &kv : m_oldFingerprints) {
+    if (m_seenOldIDs.find(kv.first) == m_seenOldIDs.end()) {
+      startOp("remove", kv.first);
+      m_os << " }";
+    }
+  }
+
+  m_os << (m_numOps > 0? "\n]\n" : "]\n");
+  m_os.flush();
+
+  return m_numOps;
+}
+
+
+int writeNodeRecordPatch(
+  std::ostream &os,
+  NodeFingerprints const &oldFingerprints,
+  std::vector<NodeRecord> const &records)
+{
+  NodeRecordPatchWriter writer(os, oldFingerprints);
+  for (NodeRecord const &record : records) {
+    writer.handleNodeRecord(record);
+  }
+  return writer.finish();
+}
+
+
+// EOF
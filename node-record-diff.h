@@ -0,0 +1,170 @@
+// node-record-diff.h
+// Fingerprint the records of --print-ast-nodes output and diff them.
+
+#ifndef PCA_NODE_RECORD_DIFF_H
+#define PCA_NODE_RECORD_DIFF_H
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <cstdint>                               // std::uint64_t
+#include <iosfwd>                                // std::ostream
+#include <map>                                   // std::map
+#include <set>                                   // std::set
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+// One node record in the output of `printClangASTNodes`, which looks
+// like:
+//
+//   "TypedefDecl 2": {
+//     "skipping reserved": "\"__int128_t\"",
+//   },
+//
+// Both members point into text owned by whoever made the record.
+class NodeRecord {
+public:      // data
+  // The ID, as it appears between the quotes, e.g., `TypedefDecl 2`.
+  llvm::StringRef m_id;
+
+  // The lines between the opening and closing lines, including the
+  // final newline.
+  llvm::StringRef m_body;
+
+public:      // methods
+  NodeRecord(llvm::StringRef id, llvm::StringRef body)
+    : m_id(id),
+      m_body(body)
+  {}
+};
+
+
+// Receives the records of `printClangASTNodes` output as they are
+// printed, in order.
+class NodeRecordSink {
+public:      // methods
+  virtual ~NodeRecordSink();
+
+  // Handle 'record'.  Its members are only valid during the call.
+  virtual void handleNodeRecord(NodeRecord const &record) = 0;
+};
+
+
+// Passes each record to several sinks.
+class NodeRecordSinkFanout : public NodeRecordSink {
+public:      // data
+  // The sinks, in the order they are called.  Not owned.
+  std::vector<NodeRecordSink *> m_sinks;
+
+public:      // methods
+  virtual void handleNodeRecord(NodeRecord const &record) override;
+};
+
+
+// Map from record ID to the fingerprint of its body.
+typedef std::map<std::string, std::uint64_t> NodeFingerprints;
+
+
+// Split the output of `printClangASTNodes` into its records, in order.
+// Text outside of records is ignored.
+std::vector<NodeRecord> splitNodeRecords(llvm::StringRef text);
+
+// Compute a 64-bit fingerprint of 'body'.  It only depends on the
+// bytes, so it can be compared across runs and machines.
+std::uint64_t fingerprintNodeRecord(llvm::StringRef body);
+
+// Write 'text', which is JSON except that, as in the output of
+// `printClangASTNodes`, the last member of an object or array may be
+// followed by a comma, to 'os' without those commas.
+void writeWithoutTrailingCommas(std::ostream &os, llvm::StringRef text);
+
+// Writes the fingerprint of each record to a stream in a line-oriented
+// format that `parseNodeFingerprints` reads.
+class NodeFingerprintWriter : public NodeRecordSink {
+private:     // data
+  // Where to write.
+  std::ostream &m_os;
+
+public:      // methods
+  // Write the header line to 'os'.
+  explicit NodeFingerprintWriter(std::ostream &os);
+
+  virtual void handleNodeRecord(NodeRecord const &record) override;
+};
+
+// Write the fingerprint of each of 'records' to 'os' with a
+// `NodeFingerprintWriter`.
+void writeNodeFingerprints(
+  std::ostream &os,
+  std::vector<NodeRecord> const &records);
+
+// Parse 'text', written by `writeNodeFingerprints`, into 'fingerprints'.
+// On error, return an error message mentioning 'fname' (otherwise "").
+std::string parseNodeFingerprints(
+  NodeFingerprints /*OUT*/ &fingerprints,
+  std::string const &fname,
+  llvm::StringRef text);
+
+// Writes a JSON Patch (RFC 6902) that turns the output whose
+// fingerprints are given into the one made of the records handled.
+// Each record that is new or whose fingerprint changed yields an "add"
+// or "replace" operation, respectively, with the record as its value.
+// Then `finish` adds a "remove" operation for each old record that was
+// not seen.  Unchanged records are not mentioned.
+//
+// The output is strict JSON: the trailing commas that the node output
+// has after the last member of each object and array are left out of
+// the values.
+//
+// Since node IDs are assigned in discovery order, an edit that adds or
+// removes nodes renumbers the ones discovered after it, and those then
+// appear in the patch too.
+class NodeRecordPatchWriter : public NodeRecordSink {
+  NO_OBJECT_COPIES(NodeRecordPatchWriter);
+
+private:     // data
+  // Where to write.
+  std::ostream &m_os;
+
+  // Fingerprints of the old output.
+  NodeFingerprints const &m_oldFingerprints;
+
+  // IDs of the records handled that are also in 'm_oldFingerprints'.
+  std::set<std::string> m_seenOldIDs;
+
+  // Number of operations written so far.
+  int m_numOps;
+
+private:     // methods
+  // Write the start of an operation, preceded by a separator if it is
+  // not the first.
+  void startOp(char const *op, llvm::StringRef id);
+
+public:      // methods
+  // Write the opening bracket to 'os'.
+  NodeRecordPatchWriter(std::ostream &os,
+                        NodeFingerprints const &oldFingerprints);
+
+  virtual void handleNodeRecord(NodeRecord const &record) override;
+
+  // Write the removals and the closing bracket, and flush the stream.
+  // Returns the number of operations written.
+  int finish();
+};
+
+// Write to 'os' a patch, as described at `NodeRecordPatchWriter`, that
+// turns the output whose fingerprints are 'oldFingerprints' into the
+// one made of 'records'.  Returns the number of operations written.
+int writeNodeRecordPatch(
+  std::ostream &os,
+  NodeFingerprints const &oldFingerprints,
+  std::vector<NodeRecord> const &records);
+
+
+// Unit tests, defined in node-record-diff-test.cc.
+void node_record_diff_unit_tests();
+
+
+#endif // PCA_NODE_RECORD_DIFF_H
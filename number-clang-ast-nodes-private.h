@@ -7,6 +7,7 @@
 #include "number-clang-ast-nodes.h"              // public decls for this module
 
 #include "clang-util.h"                          // ClangUtil
+#include "decl-file-filter.h"                    // DeclFileFilter
 
 #include "clang/AST/RecursiveASTVisitor.h"       // clang::RecursiveASTVisitor
 
@@ -18,9 +19,13 @@ public:      // data
   // The numbering we are building.
   ClangASTNodeNumbering &m_numbering;
 
+  // If not null, top-level declarations it prunes are not traversed.
+  DeclFileFilter * NULLABLE m_filter;
+
 public:      // methods
   NumberClangASTNodes(clang::ASTContext &astContext,
-                      ClangASTNodeNumbering &numbering);
+                      ClangASTNodeNumbering &numbering,
+                      DeclFileFilter * NULLABLE filter);
 
   ~NumberClangASTNodes();
 
@@ -31,6 +36,7 @@ public:      // methods
     { return true; }
 
   // RecursiveASTVisitor methods.
+  bool TraverseDecl(clang::Decl *decl);
   bool VisitType(clang::Type *type);
   bool VisitDecl(clang::Decl *decl);
   bool VisitStmt(clang::Stmt *stmt);
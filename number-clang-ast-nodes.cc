@@ -3,13 +3,13 @@
 
 #include "number-clang-ast-nodes-private.h"      // private decls for this module
 
-#include "pca-util.h"                            // stringb
-
-#include "smbase/map-util.h"                     // mapInsertUnique
 #include "smbase/sm-trace.h"                     // INIT_TRACE
-#include "smbase/stringb.h"                      // stringb
 
 #include "clang/Basic/LLVM.h"                    // clang::isa
+#include "clang/Basic/Stack.h"                   // clang::isStackNearlyExhausted
+
+#include "llvm/ADT/SmallString.h"                // llvm::SmallString
+#include "llvm/ADT/StringExtras.h"               // llvm::utostr
 
 
 using clang::dyn_cast;
@@ -29,12 +29,13 @@ INIT_TRACE("number-clang-ast-nodes");
 template <class T>
 ClangASTNodeNumbering::NumberingMap<T>::NumberingMap(
   ClangASTNodeNumbering &numberingContainer,
+  NodeKind nodeKind,
   char const *defaultNodeTypeName)
 :
   m_numberingContainer(numberingContainer),
+  m_nodeKind(nodeKind),
   m_defaultNodeTypeName(defaultNodeTypeName),
-  m_map(),
-  m_inverseMap()
+  m_map()
 {}
 
 
@@ -47,10 +48,10 @@ template <class T>
 NodeID ClangASTNodeNumbering::NumberingMap<T>::insertUnique(
   T const *node)
 {
-  NodeID id = m_numberingContainer.getNextID();
+  NodeID id = m_numberingContainer.assignNextID(m_nodeKind, node,
+                                                nodeTypeName(node));
   TRACE2("insertUnique: " << node << " -> " << id);
-  mapInsertUnique(m_map, node, id);
-  mapInsertUnique(m_inverseMap, id, node);
+  m_map.insertUnique(node, id);
   return id;
 }
 
@@ -59,9 +60,9 @@ template <class T>
 NodeID ClangASTNodeNumbering::NumberingMap<T>::getExisting(
   T const *node) const
 {
-  auto it = m_map.find(node);
-  assert(it != m_map.end());
-  return (*it).second;
+  NodeID const *id = m_map.find(node);
+  assert(id);
+  return *id;
 }
 
 
@@ -72,15 +73,15 @@ NodeID ClangASTNodeNumbering::NumberingMap<T>::get(
   // I could make this a little more efficient by using insert and
   // checking its return value, but that would mean initially inserting
   // by peeking the next ID and then incrementing it if the insertion
-  // succeeded, which is just a little messy, and factor of two speed
-  // difference is irrelevant here.
+  // succeeded, which is just a little messy.  Since the common case is
+  // that the node is already present, a miss costing a second probe
+  // does not matter much.
 
-  auto it = m_map.find(node);
-  if (it == m_map.end()) {
-    return insertUnique(node);
+  if (NodeID const *id = m_map.find(node)) {
+    return *id;
   }
   else {
-    return (*it).second;
+    return insertUnique(node);
   }
 }
 
@@ -167,18 +168,12 @@ ClangASTNodeNumbering::NumberingMap<
 
 
 template <class T>
-std::string ClangASTNodeNumbering::NumberingMap<T>::getExistingIDStr(
+llvm::StringRef ClangASTNodeNumbering::NumberingMap<T>::getExistingIDStr(
   T const * NULLABLE node) const
 {
-  string prefix = nodeTypeName(node);
-
   if (node) {
     NodeID id = getExisting(node);
-
-    // Now that I'm outputting JSON, this string will be quoted, making
-    // adequately unique for search purposes.  This should also look
-    // better in the diagram editor.
-    return stringb(prefix << " " << id);
+    return m_numberingContainer.m_idToNode[id].m_idStr;
   }
   else {
     // Previously, I used "<prefix>_null" here, but that is needlessly
@@ -189,7 +184,7 @@ std::string ClangASTNodeNumbering::NumberingMap<T>::getExistingIDStr(
 
 
 template <class T>
-std::string ClangASTNodeNumbering::NumberingMap<T>::getIDStr(
+llvm::StringRef ClangASTNodeNumbering::NumberingMap<T>::getIDStr(
   T const * NULLABLE node)
 {
   // Ensure it exists first.
@@ -204,10 +199,14 @@ std::string ClangASTNodeNumbering::NumberingMap<T>::getIDStr(
 
 // ---------------------- ClangASTNodeNumbering ------------------------
 ClangASTNodeNumbering::ClangASTNodeNumbering()
-  : m_nextID(1)
+  : m_nextID(1),
+    m_idToNode(1, NodeEntry{NK_NONE, nullptr, llvm::StringRef()}),
+    m_stringArena(),
+    m_idStrings(m_stringArena),
+    m_internedStrings(m_stringArena)
 
     #define INIT_MAP_DATA(NodeType) \
-      , m_##NodeType##Map(*this, #NodeType)
+      , m_##NodeType##Map(*this, NK_##NodeType, #NodeType)
 
     SM_PP_MAP_LIST(INIT_MAP_DATA,
       CLANG_AST_NODE_NUMBERING_TRACKED_TYPES)
@@ -220,35 +219,54 @@ ClangASTNodeNumbering::~ClangASTNodeNumbering()
 {}
 
 
-NodeID ClangASTNodeNumbering::getNextID()
+NodeID ClangASTNodeNumbering::assignNextID(
+  NodeKind kind, void const *node, llvm::StringRef nodeTypeName)
 {
+  assert(m_idToNode.size() == m_nextID);
+
+  // Now that I'm outputting JSON, this string will be quoted, making
+  // adequately unique for search purposes.  This should also look
+  // better in the diagram editor.
+  llvm::SmallString<64> idStr(nodeTypeName);
+  idStr += ' ';
+  idStr += llvm::utostr(m_nextID);
+
+  m_idToNode.push_back(NodeEntry{kind, node, m_idStrings.save(idStr.str())});
   return m_nextID++;
 }
 
 
-#define DEFINE_MAP_METHODS(NodeType)                       \
-  NodeID ClangASTNodeNumbering::insertUnique##NodeType(    \
-    clang::NodeType const *node)                           \
-  {                                                        \
-    return m_##NodeType##Map.insertUnique(node);           \
-  }                                                        \
-                                                           \
-  NodeID ClangASTNodeNumbering::getExisting##NodeType(     \
-    clang::NodeType const *node) const                     \
-  {                                                        \
-    return m_##NodeType##Map.getExisting(node);            \
-  }                                                        \
-                                                           \
-  NodeID ClangASTNodeNumbering::get##NodeType(             \
-    clang::NodeType const *node)                           \
-  {                                                        \
-    return m_##NodeType##Map.get(node);                    \
-  }                                                        \
-                                                           \
-  std::string ClangASTNodeNumbering::get##NodeType##IDStr( \
-    clang::NodeType const * NULLABLE node)                 \
-  {                                                        \
-    return m_##NodeType##Map.getIDStr(node);               \
+ClangASTNodeNumbering::NodeEntry ClangASTNodeNumbering::getNodeEntry(
+  NodeID id) const
+{
+  assert(id < m_nextID);
+  return m_idToNode[id];
+}
+
+
+#define DEFINE_MAP_METHODS(NodeType)                           \
+  NodeID ClangASTNodeNumbering::insertUnique##NodeType(        \
+    clang::NodeType const *node)                               \
+  {                                                            \
+    return m_##NodeType##Map.insertUnique(node);               \
+  }                                                            \
+                                                               \
+  NodeID ClangASTNodeNumbering::getExisting##NodeType(         \
+    clang::NodeType const *node) const                         \
+  {                                                            \
+    return m_##NodeType##Map.getExisting(node);                \
+  }                                                            \
+                                                               \
+  NodeID ClangASTNodeNumbering::get##NodeType(                 \
+    clang::NodeType const *node)                               \
+  {                                                            \
+    return m_##NodeType##Map.get(node);                        \
+  }                                                            \
+                                                               \
+  llvm::StringRef ClangASTNodeNumbering::get##NodeType##IDStr( \
+    clang::NodeType const * NULLABLE node)                     \
+  {                                                            \
+    return m_##NodeType##Map.getIDStr(node);                   \
   }
 
 SM_PP_MAP_LIST(DEFINE_MAP_METHODS,
@@ -260,9 +278,11 @@ SM_PP_MAP_LIST(DEFINE_MAP_METHODS,
 // ----------------------- NumberClangASTNodes -------------------------
 NumberClangASTNodes::NumberClangASTNodes(
   clang::ASTContext &astContext,
-  ClangASTNodeNumbering &numbering)
+  ClangASTNodeNumbering &numbering,
+  DeclFileFilter * NULLABLE filter)
   : ClangUtil(astContext),
-    m_numbering(numbering)
+    m_numbering(numbering),
+    m_filter(filter)
 {}
 
 
@@ -270,6 +290,23 @@ NumberClangASTNodes::~NumberClangASTNodes()
 {}
 
 
+bool NumberClangASTNodes::TraverseDecl(clang::Decl *decl)
+{
+  // RAV already traverses Stmts without recursion, but a Decl nested in
+  // an expression can still lead to deep recursion.
+  if (clang::isStackNearlyExhausted()) {
+    bool ret = true;
+    runOnFreshStack([&] { ret = TraverseDecl(decl); });
+    return ret;
+  }
+
+  if (decl && m_filter && m_filter->isPrunedDecl(decl)) {
+    return true;
+  }
+  return RecursiveASTVisitor::TraverseDecl(decl);
+}
+
+
 bool NumberClangASTNodes::VisitType(clang::Type *type)
 {
   m_numbering.getType(type);
@@ -338,11 +375,24 @@ bool NumberClangASTNodes::VisitStmt(clang::Stmt *stmt)
 
 void numberClangASTNodes(
   clang::ASTContext &astContext,
-  ClangASTNodeNumbering &numbering)
+  ClangASTNodeNumbering &numbering,
+  DeclFileFilter * NULLABLE filter)
 {
-  NumberClangASTNodes numberer(astContext, numbering);
+  NumberClangASTNodes numberer(astContext, numbering, filter);
   numberer.TraverseDecl(astContext.getTranslationUnitDecl());
 }
 
 
+void numberClangASTNodesWithin(
+  clang::ASTContext &astContext,
+  ClangASTNodeNumbering &numbering,
+  std::vector<clang::Decl *> const &decls)
+{
+  NumberClangASTNodes numberer(astContext, numbering, nullptr /*filter*/);
+  for (clang::Decl *decl : decls) {
+    numberer.TraverseDecl(decl);
+  }
+}
+
+
 // EOF
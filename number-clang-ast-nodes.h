@@ -6,20 +6,28 @@
 
 #include "expose-template-common.h"              // clang::FunctionTemplateDecl_CommonBase
 #include "pca-util.h"                            // NULLABLE
+#include "pointer-hash-index.h"                  // PointerHashIndex
 
 #include "clang/AST/ASTContext.h"                // clang::ASTContext
 #include "clang/AST/ASTFwd.h"                    // clang::FunctionDecl [n]
 #include "clang/AST/Attr.h"                      // clang::Attr [n]
 
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+#include "llvm/Support/Allocator.h"              // llvm::BumpPtrAllocator
+#include "llvm/Support/StringSaver.h"            // llvm::{StringSaver, UniqueStringSaver}
+
 #include "smbase/sm-macros.h"                    // NULLABLE
 #include "smbase/sm-pp-util.h"                   // SM_PP_MAP_LIST
 
-#include <map>                                   // std::map
 #include <string>                                // std::string
+#include <vector>                                // std::vector
 
 #include <stdint.h>                              // uint64_t
 
 
+class DeclFileFilter;
+
+
 // I would like to have an accurate type here, but it is private.
 namespace clang {
   struct Fake_CXXRecordDecl_DefinitionData;
@@ -47,25 +55,53 @@ public:      // types
   // Type of an assigned node ID.
   typedef uint64_t NodeID;
 
+  // Identifies which of the tracked node types an ID was assigned to.
+  enum NodeKind {
+    // Used for ID 0, which is never assigned.
+    NK_NONE,
+
+    #define DECLARE_NODE_KIND(NodeType) \
+      NK_##NodeType,
+
+    SM_PP_MAP_LIST(DECLARE_NODE_KIND,
+      CLANG_AST_NODE_NUMBERING_TRACKED_TYPES)
+
+    #undef DECLARE_NODE_KIND
+
+    NUM_NODE_KINDS
+  };
+
+  // What an ID refers to: the node kind, which says how to interpret
+  // the pointer, and the node itself.  Also, the string that
+  // `getIDStr` returns for it, stored in 'm_stringArena'.
+  struct NodeEntry {
+    NodeKind m_kind;
+    void const * NULLABLE m_node;
+    llvm::StringRef m_idStr;
+  };
+
   // Map from 'T const *' to unique ID.
   template <class T>
   class NumberingMap {
   public:      // instance data
-    // Parent container, for access to 'm_nextID'.
+    // Parent container, for access to the ID table.
     ClangASTNodeNumbering &m_numberingContainer;
 
+    // The kind recorded in the container's ID table for nodes in this
+    // map.
+    NodeKind m_nodeKind;
+
     // Value to use for 'nodeTypeName' unless overridden with an
     // explicit specialization
     char const *m_defaultNodeTypeName;
 
-    // Map the node pointer to its ID.
-    std::map<T const *, NodeID> m_map;
-
-    // Inverse map, from ID to node.
-    std::map<NodeID, T const *> m_inverseMap;
+    // Map the node pointer to its ID.  The inverse is stored, for all
+    // maps together, in the container's 'm_idToNode'.
+    PointerHashIndex<T, NodeID> m_map;
 
   public:      // methods
     NumberingMap(ClangASTNodeNumbering &numberingContainer,
+                 NodeKind nodeKind,
                  char const *defaultNodeTypeName);
     ~NumberingMap();
 
@@ -81,13 +117,15 @@ public:      // types
     // The type name to use in 'getIDStr' to describe the node.
     std::string nodeTypeName(T const * NULLABLE node) const;
 
-    // Return a string like "<nodeTypeName>_123_" for 'node', which has
-    // already been numbered.  If 'node' is null, returns
-    // "<nodeTypeName>_null".
-    std::string getExistingIDStr(T const * NULLABLE node) const;
+    // Return a string like "<nodeTypeName> 123" for 'node', which has
+    // already been numbered.  If 'node' is null, returns "null".
+    //
+    // The string is built once, when the node is numbered, and lives
+    // as long as the container.
+    llvm::StringRef getExistingIDStr(T const * NULLABLE node) const;
 
     // Similar, but create the numbering for 'node' if needed.
-    std::string getIDStr(T const * NULLABLE node);
+    llvm::StringRef getIDStr(T const * NULLABLE node);
   };
 
 public:      // data
@@ -95,6 +133,27 @@ public:      // data
   // such that 0 can be used to mean "absent".
   NodeID m_nextID;
 
+  // Table, indexed by ID, of what each ID refers to.  Element 0 has
+  // kind 'NK_NONE'.  Its size is always 'm_nextID'.
+  //
+  // Having one contiguous table, rather than an inverse map per node
+  // type, means that finding the node for an ID is a single indexed
+  // load, which matters because 'printAllNodes' does it for every ID.
+  std::vector<NodeEntry> m_idToNode;
+
+  // Storage for the strings this object hands out as `StringRef`s,
+  // along with those its clients choose to keep here.  It is freed all
+  // at once when this object is destroyed.
+  llvm::BumpPtrAllocator m_stringArena;
+
+  // Copies strings into 'm_stringArena'.  The ID strings are unique,
+  // so they do not need to be looked up first.
+  llvm::StringSaver m_idStrings;
+
+  // Copies strings into 'm_stringArena', returning the existing copy
+  // when an equal string was saved before.
+  llvm::UniqueStringSaver m_internedStrings;
+
   // Maps for each type of node we track.  The idea is to track any AST
   // node that is potentially shared by multiple other nodes.
   #define DECLARE_MAP_DATA(NodeType) \
@@ -109,8 +168,19 @@ public:
   ClangASTNodeNumbering();
   ~ClangASTNodeNumbering();
 
-  // Get the next ID, incrementing the counter.
-  NodeID getNextID();
+  // Assign the next ID to 'node', which has 'kind', recording that in
+  // 'm_idToNode' along with an ID string that starts with
+  // 'nodeTypeName', and return the ID.
+  NodeID assignNextID(NodeKind kind, void const *node,
+                      llvm::StringRef nodeTypeName);
+
+  // Return a copy of 's' that lives as long as this object.  Equal
+  // strings share one copy.
+  llvm::StringRef internString(llvm::StringRef s)
+    { return m_internedStrings.save(s); }
+
+  // Get the entry for 'id', which must be less than 'm_nextID'.
+  NodeEntry getNodeEntry(NodeID id) const;
 
   // Declare the methods for numbering 'NodeType'.  These just relay to
   // those in 'NumberingMap', so see the comments there for semantics.
@@ -118,7 +188,8 @@ public:
     NodeID insertUnique##NodeType(clang::NodeType const *node);              \
     NodeID getExisting##NodeType(clang::NodeType const *node) const;         \
     NodeID get##NodeType(clang::NodeType const *node);                       \
-    std::string get##NodeType##IDStr(clang::NodeType const * NULLABLE node);
+    llvm::StringRef get##NodeType##IDStr(                                    \
+      clang::NodeType const * NULLABLE node);
 
   SM_PP_MAP_LIST(DECLARE_MAP_METHODS,
     CLANG_AST_NODE_NUMBERING_TRACKED_TYPES)
@@ -127,10 +198,21 @@ public:
 };
 
 
-// Populate 'numbering' with the nodes in 'astContext'.
+// Populate 'numbering' with the nodes in 'astContext'.  If 'filter' is
+// not null, the declarations it prunes, and everything inside them, are
+// skipped.  They can still be numbered later if something refers to
+// them.
 void numberClangASTNodes(
   clang::ASTContext &astContext,
-  ClangASTNodeNumbering &numbering);
+  ClangASTNodeNumbering &numbering,
+  DeclFileFilter * NULLABLE filter = nullptr);
+
+// Populate 'numbering' with each of 'decls' and the nodes inside them,
+// in order, rather than with the whole TU.
+void numberClangASTNodesWithin(
+  clang::ASTContext &astContext,
+  ClangASTNodeNumbering &numbering,
+  std::vector<clang::Decl *> const &decls);
 
 
 #endif // NUMBER_CLANG_AST_NODES_H
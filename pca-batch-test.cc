@@ -0,0 +1,145 @@
+// pca-batch-test.cc
+// Tests for `pca-batch`.
+
+#include "pca-batch.h"                 // module under test
+
+#include "pca-util.h"                  // commaSeparate
+
+#include "smbase/sm-macros.h"          // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"            // EXPECT_EQ
+
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::uint64_t
+#include <string>                      // std::string
+#include <vector>                      // std::vector
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+void testParseBatchFileLines()
+{
+  std::vector<BatchCompileCommand> commands = parseBatchFileLines(
+    "cmds.txt",
+    "# comment\n"
+    "a.cc -std=c++17\n"
+    "\n"
+    "   \t\n"
+    "  # indented comment\n"
+    "  b.cc   -DX=1\t-I inc  \n"
+    "c.cc");
+
+  EXPECT_EQ(commands.size(), (std::size_t)3);
+
+  EXPECT_EQ(commands[0].m_origin, "cmds.txt:2");
+  EXPECT_EQ(commands[0].m_directory, "");
+  EXPECT_EQ(commands[0].m_sourceFileName, "a.cc");
+  EXPECT_EQ(commaSeparate(commands[0].m_fnameAndArgs, " "),
+    "a.cc -std=c++17");
+
+  EXPECT_EQ(commands[1].m_origin, "cmds.txt:6");
+  EXPECT_EQ(commands[1].m_sourceFileName, "b.cc");
+  EXPECT_EQ(commaSeparate(commands[1].m_fnameAndArgs, " "),
+    "b.cc -DX=1 -I inc");
+
+  EXPECT_EQ(commands[2].m_origin, "cmds.txt:7");
+  EXPECT_EQ(commaSeparate(commands[2].m_fnameAndArgs, " "),
+    "c.cc");
+}
+
+
+void testParseCompilationDatabase()
+{
+  std::vector<BatchCompileCommand> commands = parseCompilationDatabase(
+    "compile_commands.json",
+    R"([
+      {
+        "directory": "/src",
+        "arguments": ["clang++", "-c", "-std=c++20", "a.cc"],
+        "file": "a.cc"
+      },
+      {
+        "directory": "/src/sub",
+        "command": "g++ -DY b.cc",
+        "file": "b.cc"
+      }
+    ])");
+
+  EXPECT_EQ(commands.size(), (std::size_t)2);
+
+  EXPECT_EQ(commands[0].m_origin, "a.cc");
+  EXPECT_EQ(commands[0].m_directory, "/src");
+  EXPECT_EQ(commands[0].m_sourceFileName, "a.cc");
+  EXPECT_EQ(commaSeparate(commands[0].m_fnameAndArgs, " "),
+    "-c -std=c++20 a.cc");
+
+  EXPECT_EQ(commands[1].m_origin, "b.cc");
+  EXPECT_EQ(commands[1].m_directory, "/src/sub");
+  EXPECT_EQ(commaSeparate(commands[1].m_fnameAndArgs, " "),
+    "-DY b.cc");
+}
+
+
+void testBatchOutputFileName()
+{
+  EXPECT_EQ(batchOutputFileName("", "a.cc"), "a.cc.out");
+  EXPECT_EQ(batchOutputFileName("out", "in/src/a.cc"),
+            "out/in_src_a.cc.out");
+  EXPECT_EQ(batchOutputFileName("/tmp", "/home/u/a.cc"),
+            "/tmp/_home_u_a.cc.out");
+  EXPECT_EQ(batchOutputFileName("", "c:\\src\\a.cc"),
+            "c__src_a.cc.out");
+}
+
+
+void testBatchOutputFileNames()
+{
+  std::vector<BatchCompileCommand> commands(4);
+  commands[0].m_sourceFileName = "a.cc";
+  commands[1].m_sourceFileName = "b.cc";
+  commands[2].m_sourceFileName = "a.cc";
+  commands[3].m_sourceFileName = "a.cc";
+
+  std::vector<string> names = batchOutputFileNames("out", commands);
+  EXPECT_EQ(commaSeparate(names, " "),
+    "out/a.cc.out out/b.cc.out out/a.cc.2.out out/a.cc.3.out");
+}
+
+
+void testEstimateSourceCost()
+{
+  EXPECT_EQ(estimateSourceCost(""), (std::uint64_t)0);
+  EXPECT_EQ(estimateSourceCost("int x;\n"), (std::uint64_t)7);
+
+  // Each #include adds a fixed amount beyond its own length,
+  // regardless of spacing, but other directives and mentions do not.
+  string one = "#include <a>\n";
+  std::uint64_t includeCost = estimateSourceCost(one) - one.size();
+  EXPECT_EQ(includeCost > 0, true);
+
+  string text =
+    "#include <a>\n"
+    "  #  include \"b\"\n"
+    "#define include\n"
+    "// #include <c>\n";
+  EXPECT_EQ(estimateSourceCost(text), text.size() + 2*includeCost);
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void pca_batch_unit_tests()
+{
+  testParseBatchFileLines();
+  testParseCompilationDatabase();
+  testBatchOutputFileName();
+  testBatchOutputFileNames();
+  testEstimateSourceCost();
+}
+
+
+// EOF
@@ -0,0 +1,942 @@
+// pca-batch.cc
+// Code for `pca-batch.h`.
+
+#include "pca-batch.h"                                     // this module
+
+#include "clang-ast.h"                                     // ClangAST
+#include "clang-util.h"                                    // GlobalClangUtilInstance
+#include "compressed-output.h"                             // parseCompressionFormat, compressionFormatExtension
+#include "file-util.h"                                     // readFile
+#include "pca-process-tu.h"                                // parseTUWithOptions, processParsedTU
+#include "pca-util.h"                                      // PCA_HAVE_FORK, writeAllToFD
+#include "stringref-parse.h"                               // StringRefParse
+
+#include "clang/Tooling/JSONCompilationDatabase.h"         // clang::tooling::JSONCompilationDatabase
+
+#include "llvm/ADT/SmallString.h"                          // llvm::SmallString
+#include "llvm/Support/CrashRecoveryContext.h"             // llvm::CrashRecoveryContext
+#include "llvm/Support/FileSystem.h"                       // llvm::sys::fs::{current_path, set_current_path, make_absolute}
+
+#include "smbase/exc.h"                                    // smbase::xmessage
+#include "smbase/sm-macros.h"                              // OPEN_ANONYMOUS_NAMESPACE, NO_OBJECT_COPIES
+#include "smbase/sm-trace.h"                               // INIT_TRACE
+#include "smbase/string-util.h"                            // doubleQuote, endsWith
+#include "smbase/stringb.h"                                // stringb
+
+#include <algorithm>                                       // std::{count_if, find_if, max, stable_sort}
+#include <chrono>                                          // std::chrono
+#include <cinttypes>                                       // SCNu64
+#include <cstdio>                                          // std::sscanf
+#include <cstdint>                                         // std::uint64_t
+#include <cstdlib>                                         // std::strtoul
+#include <exception>                                       // std::exception
+#include <fstream>                                         // std::{ifstream, ofstream}
+#include <iostream>                                        // std::{cout, cerr}
+#include <memory>                                          // std::unique_ptr
+#include <numeric>                                         // std::iota
+#include <set>                                             // std::set
+#include <sstream>                                         // std::istringstream
+#include <string>                                          // std::{string, getline}
+#include <vector>                                          // std::vector
+
+#include <errno.h>                                         // errno, EINTR
+
+#if PCA_HAVE_FORK
+  #include <poll.h>                                        // poll, pollfd, POLLIN
+  #include <signal.h>                                      // signal, SIGPIPE, SIG_IGN
+  #include <sys/wait.h>                                    // waitpid, WIFSIGNALED, WTERMSIG
+  #include <unistd.h>                                      // fork, pipe, read, close, _exit, sysconf
+#endif
+
+using namespace smbase;
+
+using std::cout;
+using std::string;
+
+
+INIT_TRACE("pca-batch");
+
+
+std::vector<BatchCompileCommand> parseBatchFileLines(
+  std::string const &fname,
+  std::string const &contents)
+{
+  std::vector<BatchCompileCommand> commands;
+
+  std::istringstream lines(contents);
+  string line;
+  for (int lineNumber = 1; std::getline(lines, line); ++lineNumber) {
+    BatchCompileCommand cmd;
+    cmd.m_origin = stringb(fname << ":" << lineNumber);
+
+    std::istringstream words(line);
+    string word;
+    while (words >> word) {
+      if (cmd.m_fnameAndArgs.empty() && word[0] == '#') {
+        // Comment line.
+        break;
+      }
+      cmd.m_fnameAndArgs.push_back(word);
+    }
+
+    if (!cmd.m_fnameAndArgs.empty()) {
+      cmd.m_sourceFileName = cmd.m_fnameAndArgs.front();
+      commands.push_back(cmd);
+    }
+  }
+
+  return commands;
+}
+
+
+std::vector<BatchCompileCommand> parseCompilationDatabase(
+  std::string const &fname,
+  std::string const &contents)
+{
+  string err;
+  std::unique_ptr<clang::tooling::JSONCompilationDatabase> db(
+    clang::tooling::JSONCompilationDatabase::loadFromBuffer(
+      contents, err, clang::tooling::JSONCommandLineSyntax::AutoDetect));
+  if (!db) {
+    xmessage(stringb(fname << ": " << err));
+  }
+
+  std::vector<BatchCompileCommand> commands;
+  for (clang::tooling::CompileCommand const &cc :
+         db->getAllCompileCommands()) {
+    BatchCompileCommand cmd;
+    cmd.m_origin = cc.Filename;
+    cmd.m_directory = cc.Directory;
+    cmd.m_sourceFileName = cc.Filename;
+
+    // Skip the compiler program name, since `ClangAST` supplies its
+    // own.
+    if (!cc.CommandLine.empty()) {
+      cmd.m_fnameAndArgs.assign(cc.CommandLine.begin() + 1,
+                                cc.CommandLine.end());
+    }
+
+    commands.push_back(cmd);
+  }
+
+  return commands;
+}
+
+
+std::vector<BatchCompileCommand> readBatchFile(std::string const &fname)
+{
+  string contents;
+  string err = readFile(contents, fname);
+  if (!err.empty()) {
+    xmessage(err);
+  }
+
+  if (endsWith(fname, ".json")) {
+    return parseCompilationDatabase(fname, contents);
+  }
+  else {
+    return parseBatchFileLines(fname, contents);
+  }
+}
+
+
+std::string batchOutputFileName(
+  std::string const &outputDir,
+  std::string const &sourceFileName)
+{
+  string name = sourceFileName;
+  for (char &c : name) {
+    if (c == '/' || c == '\\' || c == ':') {
+      c = '_';
+    }
+  }
+  name += ".out";
+
+  if (outputDir.empty()) {
+    return name;
+  }
+  else {
+    return stringb(outputDir << "/" << name);
+  }
+}
+
+
+std::vector<std::string> batchOutputFileNames(
+  std::string const &outputDir,
+  std::vector<BatchCompileCommand> const &commands)
+{
+  std::vector<string> names;
+  std::set<string> used;
+
+  for (BatchCompileCommand const &cmd : commands) {
+    string name = batchOutputFileName(outputDir, cmd.m_sourceFileName);
+    for (int n = 2; !used.insert(name).second; ++n) {
+      name = batchOutputFileName(outputDir,
+                                 stringb(cmd.m_sourceFileName << "." << n));
+    }
+    names.push_back(name);
+  }
+
+  return names;
+}
+
+
+std::uint64_t estimateSourceCost(std::string const &contents)
+{
+  // Rough cost of one #include, in the same units as a byte of the
+  // primary source file.  The right value varies wildly, but all that
+  // matters here is the order it induces.
+  std::uint64_t const includeCost = 32 * 1024;
+
+  std::uint64_t cost = contents.size();
+
+  std::istringstream lines(contents);
+  string line;
+  while (std::getline(lines, line)) {
+    StringRefParse cursor(line);
+    cursor.skipWS();
+    if (cursor.skipStringIf("#")) {
+      cursor.skipWS();
+      if (cursor.lookingAt("include")) {
+        cost += includeCost;
+      }
+    }
+  }
+
+  return cost;
+}
+
+
+std::uint64_t estimateBatchTUCost(BatchCompileCommand const &cmd)
+{
+  llvm::SmallString<256> path(cmd.m_sourceFileName);
+  if (!cmd.m_directory.empty()) {
+    // This does nothing if 'path' is already absolute.
+    llvm::sys::fs::make_absolute(cmd.m_directory, path);
+  }
+
+  string contents;
+  if (!readFile(contents, path.str().str()).empty()) {
+    return 0;
+  }
+  return estimateSourceCost(contents);
+}
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Outcome of processing one TU.
+struct BatchResult {
+  // Primary source file name if known, otherwise the command origin.
+  string m_label;
+
+  // Empty on success, otherwise a short explanation of the failure.
+  string m_reason;
+};
+
+
+// While this object exists, the process current directory is 'dir'.
+class ChangeCurrentDirectory {
+  NO_OBJECT_COPIES(ChangeCurrentDirectory);
+
+private:     // data
+  // Directory to restore, or empty if nothing to restore.
+  llvm::SmallString<256> m_origDir;
+
+public:      // methods
+  // Change to 'dir' unless it is empty.  Throw `XMessage` on failure.
+  explicit ChangeCurrentDirectory(std::string const &dir)
+    : m_origDir()
+  {
+    if (dir.empty()) {
+      return;
+    }
+
+    if (llvm::sys::fs::current_path(m_origDir)) {
+      xmessage("cannot get the current directory");
+    }
+    if (llvm::sys::fs::set_current_path(dir)) {
+      m_origDir.clear();
+      xmessage(stringb("cannot change directory to " << doubleQuote(dir)));
+    }
+  }
+
+  ~ChangeCurrentDirectory()
+  {
+    if (!m_origDir.empty()) {
+      // Failing to go back would leave later TUs in the wrong place,
+      // but there is nothing sensible to do about it here.
+      (void)llvm::sys::fs::set_current_path(m_origDir);
+    }
+  }
+};
+
+
+// Parse and process one TU from a batch, writing its output to
+// 'outputName'.  Update 'label' to the primary source file name once it
+// is known.
+//
+// Return "" on success, or a short explanation of the failure.
+string processBatchTU(
+  string /*IN/OUT*/ &label,
+  string const &outputName,
+  PCACommandLineOptions const &options,
+  BatchCompileCommand const &cmd,
+  std::vector<string> const &extraArgs)
+{
+  ChangeCurrentDirectory ccd(cmd.m_directory);
+
+  std::vector<string> fnameAndArgs(cmd.m_fnameAndArgs);
+  fnameAndArgs.insert(fnameAndArgs.end(),
+                      extraArgs.begin(), extraArgs.end());
+
+  // Each TU starts from the command line options, then adds those from
+  // its own primary source file.
+  PCACommandLineOptions tuOptions(options);
+
+  ClangAST ast;
+  bool parsed = parseTUWithOptions(ast, tuOptions, fnameAndArgs);
+  if (!ast.m_primarySourceFileName.empty()) {
+    label = ast.m_primarySourceFileName;
+  }
+  if (!parsed) {
+    return "parse failed";
+  }
+
+  TRACE1("writing " << outputName);
+  std::ofstream out(outputName, std::ios::binary);
+  if (!out) {
+    return stringb("cannot write " << doubleQuote(outputName));
+  }
+
+  GlobalClangUtilInstance gcui(ast.getASTContext());
+  int result = processParsedTU(out, tuOptions, ast);
+
+  out.close();
+  if (!out) {
+    return stringb("error writing " << doubleQuote(outputName));
+  }
+
+  if (result != 0) {
+    return "failed assertions";
+  }
+
+  return "";
+}
+
+
+// Run 'processBatchTU' in this process, turning exceptions and crashes
+// into failure results.
+BatchResult processBatchTUInProcess(
+  string const &outputName,
+  PCACommandLineOptions const &options,
+  BatchCompileCommand const &cmd,
+  std::vector<string> const &extraArgs)
+{
+  // Arrange for a crash inside Clang to be reported as the failure of
+  // one TU rather than ending the batch.
+  llvm::CrashRecoveryContext::Enable();
+
+  BatchResult result;
+  result.m_label = cmd.m_origin;
+
+  llvm::CrashRecoveryContext crc;
+  bool completed = crc.RunSafely([&]() {
+    try {
+      result.m_reason = processBatchTU(result.m_label, outputName,
+                                       options, cmd, extraArgs);
+    }
+    catch (std::exception &x) {
+      result.m_reason = x.what();
+    }
+  });
+  if (!completed) {
+    result.m_reason = "crashed";
+  }
+
+  return result;
+}
+
+
+#if PCA_HAVE_FORK
+// Value of `BatchWorker::m_index` for a worker with no TU.
+std::size_t const noBatchTU = static_cast<std::size_t>(-1);
+
+
+// A child process that processes TUs one after another as the parent
+// assigns them.  Since it keeps running, the file statuses and contents
+// the shared file system caches while one TU is parsed are reused for
+// the next, so a header common to many TUs is read once per worker.
+struct BatchWorker {
+  // Child process ID.
+  pid_t m_pid;
+
+  // Write end of the pipe on which the parent sends the index of each
+  // TU to process, one per line.
+  int m_commandFD;
+
+  // Read end of the pipe on which the child reports each result.
+  int m_resultFD;
+
+  // Index of the TU being processed, or `noBatchTU` if idle.
+  std::size_t m_index;
+
+  // Estimated cost of that TU, from `estimateBatchTUCost`, or 0 if
+  // idle.
+  std::uint64_t m_cost;
+
+  // Most memory the child has been seen to use, in bytes.  This is not
+  // reset between TUs, since the process seldom shrinks.
+  std::uint64_t m_peakBytes;
+
+  bool busy() const
+    { return m_index != noBatchTU; }
+};
+
+
+// How long to wait between samples of the children's memory usage when
+// there is a limit.
+std::chrono::milliseconds const batchMemorySampleInterval(100);
+
+
+// Return the number of bytes of memory attributable to process 'pid',
+// or 0 if that cannot be determined (including on systems without
+// "/proc").
+//
+// This is the proportional set size, in which a page shared by several
+// processes is divided among them, so the pages a child still shares
+// copy-on-write with the parent and its siblings are not counted once
+// per child.  Where that is not available, it is the resident set size.
+std::uint64_t processMemoryBytes(pid_t pid)
+{
+  {
+    std::ifstream rollup(stringb("/proc/" << pid << "/smaps_rollup"));
+    string line;
+    while (std::getline(rollup, line)) {
+      std::uint64_t kib = 0;
+      if (std::sscanf(line.c_str(), "Pss: %" SCNu64, &kib) == 1) {
+        return kib << 10;
+      }
+    }
+  }
+
+  std::ifstream statm(stringb("/proc/" << pid << "/statm"));
+  std::uint64_t totalPages = 0;
+  std::uint64_t residentPages = 0;
+  if (!(statm >> totalPages >> residentPages)) {
+    return 0;
+  }
+  return residentPages * ::sysconf(_SC_PAGESIZE);
+}
+
+
+// Tracks the memory used by the workers and decides whether another TU
+// can start under the limit.
+class BatchMemoryBudget {
+private:     // data
+  // The limit in bytes, or 0 for none.
+  std::uint64_t m_maxBytes;
+
+  // The highest ratio of memory to estimated cost seen in any child,
+  // used to reserve memory for a child that has not grown yet.
+  double m_bytesPerCost;
+
+  // Total charged for the workers at the last sample.
+  std::uint64_t m_chargedBytes;
+
+  // When 'sample' last ran.
+  std::chrono::steady_clock::time_point m_lastSample;
+
+  // True if a child has started since the last sample.
+  bool m_startedSinceSample;
+
+private:     // methods
+  // Bytes to charge for a worker processing a TU whose cost is 'cost',
+  // or 0 if idle, and that has used at most 'peakBytes' so far.
+  std::uint64_t charge(std::uint64_t cost, std::uint64_t peakBytes) const
+  {
+    return std::max(peakBytes,
+      static_cast<std::uint64_t>(m_bytesPerCost * cost));
+  }
+
+public:      // methods
+  explicit BatchMemoryBudget(std::uint64_t maxBytes)
+    : m_maxBytes(maxBytes),
+      m_bytesPerCost(0),
+      m_chargedBytes(0),
+      m_lastSample(),
+      m_startedSinceSample(false)
+  {}
+
+  bool limited() const
+    { return m_maxBytes != 0; }
+
+  // True if it is time to call 'sample' again.
+  bool sampleDue() const
+  {
+    return std::chrono::steady_clock::now() - m_lastSample >=
+           batchMemorySampleInterval;
+  }
+
+  // Measure each of 'workers', updating the charges.
+  void sample(std::vector<BatchWorker> /*IN/OUT*/ &workers)
+  {
+    m_chargedBytes = 0;
+    for (BatchWorker &r : workers) {
+      r.m_peakBytes = std::max(r.m_peakBytes, processMemoryBytes(r.m_pid));
+      if (r.m_cost) {
+        m_bytesPerCost = std::max(m_bytesPerCost,
+          static_cast<double>(r.m_peakBytes) / r.m_cost);
+      }
+      m_chargedBytes += charge(r.m_cost, r.m_peakBytes);
+    }
+    m_lastSample = std::chrono::steady_clock::now();
+    m_startedSinceSample = false;
+    TRACE2("workers: " << workers.size() <<
+           ", charged bytes: " << m_chargedBytes);
+  }
+
+  // True if a TU with 'cost' can start while 'numBusy' others are
+  // being processed.  At most one starts per sample, so that each new
+  // TU has been measured before the next is admitted.
+  bool allowsAnother(std::size_t numBusy, std::uint64_t cost) const
+  {
+    if (!limited() || numBusy == 0) {
+      return true;
+    }
+    return !m_startedSinceSample &&
+           m_chargedBytes + charge(cost, 0) < m_maxBytes;
+  }
+
+  // Record that a TU with 'cost' started.
+  void started(std::uint64_t cost)
+  {
+    m_chargedBytes += charge(cost, 0);
+    m_startedSinceSample = true;
+  }
+};
+
+
+// Read from 'fd' up to a newline, and set 'line' to what preceded it.
+// Return false on end of file or error.
+bool readLineFromFD(string /*OUT*/ &line, int fd)
+{
+  line.clear();
+  while (true) {
+    char c;
+    ssize_t n = ::read(fd, &c, 1);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    if (c == '\n') {
+      return true;
+    }
+    line += c;
+  }
+}
+
+
+// Read from 'fd' up to a NUL, and set 'msg' to what preceded it.
+// Return false on end of file or error.  The writer must send nothing
+// after the NUL until it gets a reply.
+bool readNulTerminatedFromFD(string /*OUT*/ &msg, int fd)
+{
+  msg.clear();
+  char buf[4096];
+  while (true) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    msg.append(buf, n);
+    if (msg.back() == '\0') {
+      msg.pop_back();
+      return true;
+    }
+  }
+}
+
+
+// Body of a worker process.  Process each TU whose index arrives on
+// 'commandFD', and report "<label>\n<reason>" and a NUL for it on
+// 'resultFD', until 'commandFD' is closed.  A crash ends the process,
+// which the parent detects from the exit status.
+void runBatchWorker(
+  int commandFD,
+  int resultFD,
+  std::vector<BatchCompileCommand> const &commands,
+  std::vector<string> const &outputNames,
+  PCACommandLineOptions const &options,
+  std::vector<string> const &extraArgs)
+{
+  string line;
+  while (readLineFromFD(line, commandFD)) {
+    std::size_t index = std::strtoul(line.c_str(), nullptr, 10);
+    if (index >= commands.size()) {
+      return;
+    }
+
+    BatchCompileCommand const &cmd = commands[index];
+    string label = cmd.m_origin;
+    string reason;
+    try {
+      reason = processBatchTU(label, outputNames[index], options, cmd,
+                              extraArgs);
+    }
+    catch (std::exception &x) {
+      reason = x.what();
+    }
+
+    // Anything the TU printed goes out before the next one starts.
+    cout.flush();
+    std::cerr.flush();
+
+    string msg = stringb(label << "\n" << reason).substr(0, 2048);
+    msg += '\0';
+    if (!writeAllToFD(resultFD, msg.data(), msg.size())) {
+      return;
+    }
+  }
+}
+
+
+// Start an idle worker and add it to 'workers'.  Return false if that
+// could not be done.
+bool startBatchWorker(
+  std::vector<BatchWorker> /*IN/OUT*/ &workers,
+  std::vector<BatchCompileCommand> const &commands,
+  std::vector<string> const &outputNames,
+  PCACommandLineOptions const &options,
+  std::vector<string> const &extraArgs)
+{
+  int commandFDs[2];
+  if (::pipe(commandFDs) != 0) {
+    return false;
+  }
+  int resultFDs[2];
+  if (::pipe(resultFDs) != 0) {
+    ::close(commandFDs[0]);
+    ::close(commandFDs[1]);
+    return false;
+  }
+
+  pid_t pid = ::fork();
+  if (pid < 0) {
+    for (int fd : {commandFDs[0], commandFDs[1],
+                   resultFDs[0], resultFDs[1]}) {
+      ::close(fd);
+    }
+    return false;
+  }
+
+  if (pid == 0) {
+    // Child.  Close the other workers' pipes, since holding one open
+    // would keep that worker from seeing the end of its commands.
+    for (BatchWorker const &w : workers) {
+      ::close(w.m_commandFD);
+      ::close(w.m_resultFD);
+    }
+    ::close(commandFDs[1]);
+    ::close(resultFDs[0]);
+
+    runBatchWorker(commandFDs[0], resultFDs[1], commands, outputNames,
+                   options, extraArgs);
+
+    cout.flush();
+    std::cerr.flush();
+    ::_exit(0);
+  }
+
+  ::close(commandFDs[0]);
+  ::close(resultFDs[1]);
+  workers.push_back(BatchWorker{pid, commandFDs[1], resultFDs[0],
+                                noBatchTU, 0, 0});
+  return true;
+}
+
+
+// Close the pipes of the worker at 'it', wait for it to exit, and
+// remove it from 'workers'.  Return its exit status.
+int retireBatchWorker(
+  std::vector<BatchWorker> /*IN/OUT*/ &workers,
+  std::vector<BatchWorker>::iterator it)
+{
+  ::close(it->m_commandFD);
+  ::close(it->m_resultFD);
+
+  int status = 0;
+  while (::waitpid(it->m_pid, &status, 0) < 0 && errno == EINTR) {
+    // Interrupted; try again.
+  }
+
+  workers.erase(it);
+  return status;
+}
+
+
+// Send TU 'index', whose cost is 'cost', to idle 'worker'.  Return
+// false if that could not be done.
+bool assignBatchTU(
+  BatchWorker &worker,
+  std::size_t index,
+  std::uint64_t cost)
+{
+  string line = stringb(index << "\n");
+  if (!writeAllToFD(worker.m_commandFD, line.data(), line.size())) {
+    return false;
+  }
+
+  worker.m_index = index;
+  worker.m_cost = cost;
+  return true;
+}
+
+
+// The result pipe of the busy worker at 'it' is readable.  Record the
+// result of its TU in 'results'.  If instead of reporting one the
+// worker exited, remove it from 'workers'.
+void finishBatchTU(
+  std::vector<BatchResult> /*OUT*/ &results,
+  std::vector<BatchWorker> /*IN/OUT*/ &workers,
+  std::vector<BatchWorker>::iterator it,
+  std::vector<BatchCompileCommand> const &commands)
+{
+  BatchResult &result = results[it->m_index];
+  result.m_label = commands[it->m_index].m_origin;
+  it->m_index = noBatchTU;
+  it->m_cost = 0;
+
+  string msg;
+  if (readNulTerminatedFromFD(msg, it->m_resultFD)) {
+    std::size_t nl = msg.find('\n');
+    if (nl != string::npos) {
+      result.m_label = msg.substr(0, nl);
+      result.m_reason = msg.substr(nl+1);
+      return;
+    }
+  }
+
+  int status = retireBatchWorker(workers, it);
+  if (WIFSIGNALED(status)) {
+    result.m_reason = stringb("crashed (signal " << WTERMSIG(status) << ")");
+  }
+  else {
+    result.m_reason = "worker failed";
+  }
+}
+
+
+// Process 'commands' using up to 'options.m_batchJobs' workers, filling
+// in 'results'.
+void processBatchParallel(
+  std::vector<BatchResult> /*OUT*/ &results,
+  std::vector<BatchCompileCommand> const &commands,
+  std::vector<string> const &outputNames,
+  PCACommandLineOptions const &options,
+  std::vector<string> const &extraArgs)
+{
+  // Start the most expensive TUs first so the cheap ones fill in the
+  // gaps at the end rather than a big one starting last.  Each worker
+  // takes the next TU when it finishes one, so no worker sits idle
+  // while work remains.
+  std::vector<std::uint64_t> costs;
+  for (BatchCompileCommand const &cmd : commands) {
+    costs.push_back(estimateBatchTUCost(cmd));
+  }
+  std::vector<std::size_t> order(commands.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+    [&costs](std::size_t a, std::size_t b) {
+      return costs[a] > costs[b];
+    });
+
+  std::size_t const maxJobs = options.m_batchJobs;
+  BatchMemoryBudget budget(
+    static_cast<std::uint64_t>(options.m_batchMaxRSSMB) << 20);
+
+  // Do not let the workers inherit unwritten output.
+  cout.flush();
+  std::cerr.flush();
+
+  // Sending a TU to a worker that has died should fail rather than end
+  // this process.
+  ::signal(SIGPIPE, SIG_IGN);
+
+  std::vector<BatchWorker> workers;
+  std::size_t next = 0;
+
+  auto countBusy = [&workers]() -> std::size_t {
+    return std::count_if(workers.begin(), workers.end(),
+      [](BatchWorker const &w) { return w.busy(); });
+  };
+
+  while (next < order.size() || countBusy() > 0) {
+    if (budget.limited() && budget.sampleDue()) {
+      budget.sample(workers);
+    }
+
+    // Assign as many TUs as the limits allow, starting workers as
+    // needed.
+    while (next < order.size() &&
+           budget.allowsAnother(countBusy(), costs[order[next]])) {
+      std::size_t index = order[next];
+
+      auto idle = std::find_if(workers.begin(), workers.end(),
+        [](BatchWorker const &w) { return !w.busy(); });
+      if (idle == workers.end() &&
+          workers.size() < maxJobs &&
+          startBatchWorker(workers, commands, outputNames,
+                           options, extraArgs)) {
+        idle = workers.end() - 1;
+      }
+
+      if (idle == workers.end()) {
+        if (!workers.empty()) {
+          // Wait for a worker to become free.
+          break;
+        }
+
+        // Cannot fork at all; make progress in this process.
+        results[index] = processBatchTUInProcess(
+          outputNames[index], options, commands[index], extraArgs);
+        ++next;
+      }
+      else if (assignBatchTU(*idle, index, costs[index])) {
+        budget.started(costs[index]);
+        ++next;
+      }
+      else {
+        // The worker is gone; let another take the TU.
+        retireBatchWorker(workers, idle);
+      }
+    }
+
+    // Wait for results.  While TUs are waiting on the memory limit,
+    // wake up to keep sampling, since the workers' usage changes as
+    // they run.
+    std::vector<pollfd> fds;
+    std::vector<pid_t> pids;
+    for (BatchWorker const &w : workers) {
+      if (w.busy()) {
+        fds.push_back(pollfd{w.m_resultFD, POLLIN, 0});
+        pids.push_back(w.m_pid);
+      }
+    }
+    if (fds.empty()) {
+      continue;
+    }
+
+    bool sampling = budget.limited() && next < order.size();
+    int timeout = sampling?
+      static_cast<int>(batchMemorySampleInterval.count()) : -1;
+    if (::poll(fds.data(), fds.size(), timeout) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      xmessage("batch: poll failed");
+    }
+
+    // Look workers up by process ID, since finishing one can remove it.
+    for (std::size_t i=0; i < fds.size(); ++i) {
+      if (fds[i].revents) {
+        pid_t pid = pids[i];
+        auto it = std::find_if(workers.begin(), workers.end(),
+          [pid](BatchWorker const &w) { return w.m_pid == pid; });
+        finishBatchTU(results, workers, it, commands);
+      }
+    }
+  }
+
+  // Closing the command pipes tells the workers to exit.
+  for (BatchWorker const &w : workers) {
+    ::close(w.m_commandFD);
+  }
+  while (!workers.empty()) {
+    retireBatchWorker(workers, workers.end() - 1);
+  }
+}
+#endif // PCA_HAVE_FORK
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+int runBatch(
+  PCACommandLineOptions const &options,
+  std::vector<std::string> const &extraArgs)
+{
+  std::vector<BatchCompileCommand> commands =
+    readBatchFile(options.m_batchFile);
+
+  // Since a TU may change the current directory, make the output
+  // directory absolute first.
+  string outputDir;
+  if (!options.m_batchOutputDir.empty()) {
+    llvm::SmallString<256> dir(options.m_batchOutputDir);
+    if (llvm::sys::fs::make_absolute(dir)) {
+      xmessage(stringb("cannot make " <<
+                       doubleQuote(options.m_batchOutputDir) <<
+                       " absolute"));
+    }
+    outputDir = dir.str().str();
+  }
+
+  std::vector<string> outputNames =
+    batchOutputFileNames(outputDir, commands);
+
+  // With --compress-output, name the files for their format.
+  CompressionFormat format;
+  string err = parseCompressionFormat(format, options.m_compressOutput);
+  if (!err.empty()) {
+    xmessage(err);
+  }
+  for (string &name : outputNames) {
+    name += compressionFormatExtension(format);
+  }
+
+  std::vector<BatchResult> results(commands.size());
+
+#if PCA_HAVE_FORK
+  if (options.m_batchJobs > 1) {
+    processBatchParallel(results, commands, outputNames,
+                         options, extraArgs);
+  }
+  else
+#endif // PCA_HAVE_FORK
+  {
+    for (std::size_t i=0; i < commands.size(); ++i) {
+      results[i] = processBatchTUInProcess(
+        outputNames[i], options, commands[i], extraArgs);
+    }
+  }
+
+  // Report in command order, regardless of completion order.
+  std::vector<string> failures;
+  for (BatchResult const &result : results) {
+    if (!result.m_reason.empty()) {
+      std::cerr << "batch: " << result.m_label << ": "
+                << result.m_reason << "\n";
+      failures.push_back(stringb(result.m_label << ": " <<
+                                 result.m_reason));
+    }
+  }
+
+  cout << "batch: " << commands.size() << " translation units, "
+       << (commands.size() - failures.size()) << " succeeded, "
+       << failures.size() << " failed\n";
+  for (string const &f : failures) {
+    cout << "  failed: " << f << "\n";
+  }
+
+  return failures.empty()? 0 : 2;
+}
+
+
+// EOF
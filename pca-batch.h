@@ -0,0 +1,108 @@
+// pca-batch.h
+// Batch mode: parse and process many translation units in one process.
+
+#ifndef PCA_BATCH_H
+#define PCA_BATCH_H
+
+#include "pca-command-line-options.h"            // PCACommandLineOptions
+
+#include <cstdint>                               // std::uint64_t
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+// One translation unit to process in batch mode.
+class BatchCompileCommand {
+public:      // data
+  // Short description of where this command came from, like
+  // "cmds.txt:3", for use in the summary when the command fails before
+  // the primary source file name is known.
+  std::string m_origin;
+
+  // Directory to make current while processing this TU, or "" to stay
+  // in the current directory.
+  std::string m_directory;
+
+  // Name of the primary source file as written in the batch file,
+  // relative to 'm_directory'.  This is used to name the output file
+  // and to estimate the cost of the TU, before the command is parsed.
+  std::string m_sourceFileName;
+
+  // Primary source file name and compiler options, as accepted by
+  // `ClangAST::parseCommandLine`.  This does not include the compiler
+  // program name.
+  std::vector<std::string> m_fnameAndArgs;
+};
+
+
+// Parse the contents of a line-oriented batch file, 'contents', which
+// was read from 'fname'.  Each non-blank line that does not start with
+// '#' (after leading whitespace) has whitespace-separated arguments for
+// one TU, the first being the source file name.  There is no quoting
+// mechanism.
+std::vector<BatchCompileCommand> parseBatchFileLines(
+  std::string const &fname,
+  std::string const &contents);
+
+// Parse 'contents', the text of a "compile_commands.json" file, which
+// was read from 'fname'.  Each entry's "directory" becomes the
+// command's 'm_directory'.  Throw `XMessage` on error.
+std::vector<BatchCompileCommand> parseCompilationDatabase(
+  std::string const &fname,
+  std::string const &contents);
+
+// Read 'fname' and parse it with one of the above, depending on whether
+// it ends in ".json".  Throw `XMessage` on error.
+std::vector<BatchCompileCommand> readBatchFile(std::string const &fname);
+
+// Return the name of the file in 'outputDir' that receives the output
+// for 'sourceFileName'.  Directory separators (and drive letter colons)
+// in the source name become underscores so that the result is a single
+// path component.  An empty 'outputDir' means the current directory.
+std::string batchOutputFileName(
+  std::string const &outputDir,
+  std::string const &sourceFileName);
+
+// Return, for each element of 'commands', the name of the file that
+// receives its output.  This is normally 'batchOutputFileName' of the
+// source file name, but when that name was already used by an earlier
+// command, ".2", ".3", etc. is added to the source name first.
+std::vector<std::string> batchOutputFileNames(
+  std::string const &outputDir,
+  std::vector<BatchCompileCommand> const &commands);
+
+// Estimate the relative cost of parsing a TU whose primary source file
+// has 'contents'.  The estimate is the size in bytes plus a fixed
+// amount for each "#include" line, since the headers usually dominate.
+std::uint64_t estimateSourceCost(std::string const &contents);
+
+// Estimate the cost of 'cmd' by reading its source file.  Return 0 if
+// the file cannot be read.
+std::uint64_t estimateBatchTUCost(BatchCompileCommand const &cmd);
+
+// Process every TU listed in 'options.m_batchFile', appending
+// 'extraArgs' to each one's compiler options.  Each TU's output goes to
+// its own file in 'options.m_batchOutputDir'.  A TU that fails, whether
+// by a parse error, an exception, or a crash inside Clang, is recorded
+// and does not prevent the others from being processed.  Finally, print
+// a summary to stdout.
+//
+// If 'options.m_batchJobs' is more than 1, TUs are processed, most
+// expensive first, by up to that many worker child processes, subject
+// to the memory limit in 'options.m_batchMaxRSSMB'.  Each worker
+// processes TUs one after another, reusing the file contents it has
+// cached, so files are assumed not to change during the batch, just as
+// when there is one job.  The output files and summary do not depend
+// on the number of jobs.
+//
+// Return 0 if all TUs succeeded, 2 otherwise.
+int runBatch(
+  PCACommandLineOptions const &options,
+  std::vector<std::string> const &extraArgs);
+
+
+// Unit tests, defined in pca-batch-test.cc.
+void pca_batch_unit_tests();
+
+
+#endif // PCA_BATCH_H
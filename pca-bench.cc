@@ -0,0 +1,611 @@
+// pca-bench.cc
+// Entry point for pca-bench.exe, which times AST traversals.
+
+/*
+  Usage: pca-bench.exe [--iterations=N] [file.cc ...] [-- clang-options]
+
+  Each translation unit is parsed once, then each of several traversals
+  is run over it 'N' times (default 5).  The result is one JSON object
+  per line on stdout, first for the parse, then for each traversal:
+
+    {"tu": "<label>", "traversal": "<name>", "iterations": N,
+     "nodes": <count>, "visited": <count or null>,
+     "best_ns": <fastest run>, "mean_ns": <average run>,
+     "nodes_per_sec": <nodes / fastest run>,
+     "allocations": <operator new calls in one run>,
+     "allocated_bytes": <bytes requested by them>,
+     "peak_rss_kb": <process peak RSS afterward>}
+
+  'nodes' is the number of Decl, Stmt, and TypeLoc nodes that
+  `ClangASTVisitor` visits in the TU, and serves as the common measure
+  of TU size, so 'nodes_per_sec' is comparable across traversals.
+  'visited' is what a counting traversal itself saw, which is useful
+  for confirming that the visitor flavors agree; it is null for
+  traversals that print instead of counting.
+
+  Without any files, a built-in set is used: a synthetic TU with many
+  template instantiations, two of the template tests in in/src, and a
+  TU that includes a handful of standard library headers.
+
+  Allocations are counted by replacing the global `operator new` in
+  this program, so they include those made by Clang, but not those
+  that go directly to `malloc` (which includes most of what the AST
+  itself uses).
+*/
+
+#include "clang-ast-visitor-impl.h"                        // ClangASTVisitorT method definitions
+#include "clang-ast-visitor-nc.h"                          // ClangASTVisitorNC
+#include "clang-ast-visitor.h"                             // ClangASTVisitor, ClangASTVisitorT
+#include "clang-ast.h"                                     // ClangAST, ClangASTUtilTempFile
+#include "clang-util.h"                                    // GlobalClangUtilInstance
+#include "number-clang-ast-nodes.h"                        // ClangASTNodeNumbering, numberClangASTNodes
+#include "print-clang-ast-nodes.h"                         // printClangASTNodes
+#include "printer-visitor.h"                               // printerVisitorTU
+#include "rav-printer-visitor.h"                           // ravPrinterVisitorTU
+
+#include "clang/AST/RecursiveASTVisitor.h"                 // clang::RecursiveASTVisitor
+#include "clang/Basic/Stack.h"                             // clang::noteBottomOfStack
+
+#include "smbase/string-util.h"                            // doubleQuote
+
+#include <atomic>                                          // std::atomic
+#include <chrono>                                          // std::chrono
+#include <cstdint>                                         // std::uint64_t
+#include <cstdlib>                                         // std::{malloc, free, atoi}
+#include <exception>                                       // std::exception
+#include <iostream>                                        // std::{cout, cerr, ostream}
+#include <new>                                             // std::bad_alloc
+#include <sstream>                                         // std::ostringstream
+#include <streambuf>                                       // std::streambuf
+#include <string>                                          // std::string
+#include <vector>                                          // std::vector
+
+#if defined(__unix__) || defined(__APPLE__)
+  #include <sys/resource.h>                                // getrusage
+  #define PCA_BENCH_HAVE_GETRUSAGE 1
+#else
+  #define PCA_BENCH_HAVE_GETRUSAGE 0
+#endif
+
+using std::cerr;
+using std::cout;
+using std::string;
+
+
+// ------------------------ Allocation counting -------------------------
+// Number of calls to the global `operator new`, and the total number of
+// bytes they requested.  These are atomic because they are also
+// updated by the threads that traversals running low on stack continue
+// on (see `runOnFreshStack`), and by any other thread Clang starts.
+static std::atomic<std::uint64_t> s_numAllocations(0);
+static std::atomic<std::uint64_t> s_allocatedBytes(0);
+
+
+void *operator new(std::size_t size)
+{
+  s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+  s_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+  if (void *p = std::malloc(size? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+
+// Return the peak resident set size of this process in kilobytes, or 0
+// if that is not available.
+static long peakRSSKB()
+{
+#if PCA_BENCH_HAVE_GETRUSAGE
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+  #ifdef __APPLE__
+    // macOS reports bytes.
+    return usage.ru_maxrss / 1024;
+  #else
+    return usage.ru_maxrss;
+  #endif
+  }
+#endif
+  return 0;
+}
+
+
+// ------------------------- Counting visitors --------------------------
+// Count the nodes visited by `ClangASTVisitor`.
+class CountingVisitor : public ClangASTVisitor {
+public:      // data
+  // Number of Decl, Stmt, and TypeLoc nodes visited.
+  std::uint64_t m_count = 0;
+
+public:      // methods
+  // ClangASTVisitor methods.
+  virtual void visitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl) override
+  {
+    ++m_count;
+    ClangASTVisitor::visitDecl(context, decl);
+  }
+
+  virtual void visitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt) override
+  {
+    ++m_count;
+    ClangASTVisitor::visitStmt(context, stmt);
+  }
+
+  virtual void visitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc) override
+  {
+    ++m_count;
+    ClangASTVisitor::visitTypeLoc(context, typeLoc);
+  }
+};
+
+
+// Same, using `ClangASTVisitorNC`.
+class CountingVisitorNC : public ClangASTVisitorNC {
+public:      // data
+  std::uint64_t m_count = 0;
+
+public:      // methods
+  // ClangASTVisitorNC methods.
+  virtual void visitDeclNC(
+    VisitDeclContext context,
+    clang::Decl *decl) override
+  {
+    ++m_count;
+    ClangASTVisitorNC::visitDeclNC(context, decl);
+  }
+
+  virtual void visitStmtNC(
+    VisitStmtContext context,
+    clang::Stmt *stmt) override
+  {
+    ++m_count;
+    ClangASTVisitorNC::visitStmtNC(context, stmt);
+  }
+
+  virtual void visitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc) override
+  {
+    ++m_count;
+    ClangASTVisitorNC::visitTypeLoc(context, typeLoc);
+  }
+};
+
+
+// Same, using `ClangASTVisitorT`.
+class CountingVisitorT : public ClangASTVisitorT<CountingVisitorT> {
+public:      // data
+  std::uint64_t m_count = 0;
+
+public:      // methods
+  // ClangASTVisitorT methods.
+  void visitDecl(
+    VisitDeclContext context,
+    clang::Decl const *decl)
+  {
+    ++m_count;
+    ClangASTVisitorT::visitDecl(context, decl);
+  }
+
+  void visitStmt(
+    VisitStmtContext context,
+    clang::Stmt const *stmt)
+  {
+    ++m_count;
+    ClangASTVisitorT::visitStmt(context, stmt);
+  }
+
+  void visitTypeLoc(
+    VisitTypeContext context,
+    clang::TypeLoc typeLoc)
+  {
+    ++m_count;
+    ClangASTVisitorT::visitTypeLoc(context, typeLoc);
+  }
+};
+
+
+// Same, using `RecursiveASTVisitor` configured the way
+// `RAVPrinterVisitor` is.
+class CountingRAV : public clang::RecursiveASTVisitor<CountingRAV> {
+public:      // data
+  std::uint64_t m_count = 0;
+
+public:      // methods
+  // RecursiveASTVisitor customization.
+  bool shouldVisitTemplateInstantiations() const { return true; }
+  bool shouldVisitImplicitCode() const { return true; }
+
+  // RecursiveASTVisitor methods.
+  bool VisitDecl(clang::Decl *)     { ++m_count; return true; }
+  bool VisitStmt(clang::Stmt *)     { ++m_count; return true; }
+  bool VisitTypeLoc(clang::TypeLoc) { ++m_count; return true; }
+};
+
+
+// A `streambuf` that discards everything written to it.
+class NullStreamBuf : public std::streambuf {
+protected:   // methods
+  // std::streambuf methods.
+  virtual int_type overflow(int_type c) override
+    { return traits_type::not_eof(c); }
+  virtual std::streamsize xsputn(char const *, std::streamsize n) override
+    { return n; }
+};
+
+
+// ----------------------------- Traversals -----------------------------
+// Run one traversal over 'astContext'.  Return the number of nodes it
+// counted, or -1 if it does not count them.
+typedef long long (*TraversalFunction)(clang::ASTContext &astContext);
+
+
+static long long runVisitor(clang::ASTContext &astContext)
+{
+  CountingVisitor visitor;
+  visitor.scanTU(astContext);
+  return visitor.m_count;
+}
+
+
+static long long runVisitorNC(clang::ASTContext &astContext)
+{
+  CountingVisitorNC visitor;
+  visitor.scanTU(astContext);
+  return visitor.m_count;
+}
+
+
+static long long runVisitorT(clang::ASTContext &astContext)
+{
+  CountingVisitorT visitor;
+  visitor.scanTU(astContext);
+  return visitor.m_count;
+}
+
+
+static long long runRAV(clang::ASTContext &astContext)
+{
+  CountingRAV visitor;
+  visitor.TraverseDecl(astContext.getTranslationUnitDecl());
+  return visitor.m_count;
+}
+
+
+static long long runNumberNodes(clang::ASTContext &astContext)
+{
+  ClangASTNodeNumbering numbering;
+  numberClangASTNodes(astContext, numbering);
+
+  // The first ID is never assigned.
+  return numbering.m_nextID - 1;
+}
+
+
+static long long runPrinterVisitor(clang::ASTContext &astContext)
+{
+  NullStreamBuf nullBuf;
+  std::ostream os(&nullBuf);
+  printerVisitorTU(os, astContext, PrinterVisitor::F_NONE);
+  return -1;
+}
+
+
+static long long runRAVPrinterVisitor(clang::ASTContext &astContext)
+{
+  NullStreamBuf nullBuf;
+  std::ostream os(&nullBuf);
+  ravPrinterVisitorTU(os, astContext);
+  return -1;
+}
+
+
+static long long runPrintASTNodes(clang::ASTContext &astContext)
+{
+  NullStreamBuf nullBuf;
+  std::ostream os(&nullBuf);
+  PrintClangASTNodesConfiguration config;
+  config.m_printNonPSFFileEntities = true;
+  printClangASTNodes(os, astContext, config);
+  return -1;
+}
+
+
+// The traversals to time, in the order they are reported.
+static struct {
+  char const *m_name;
+  TraversalFunction m_function;
+} const traversals[] = {
+  { "visitor",             runVisitor },
+  { "visitor-nc",          runVisitorNC },
+  { "visitor-t",           runVisitorT },
+  { "rav",                 runRAV },
+  { "number-nodes",        runNumberNodes },
+  { "printer-visitor",     runPrinterVisitor },
+  { "rav-printer-visitor", runRAVPrinterVisitor },
+  { "print-ast-nodes",     runPrintASTNodes },
+};
+
+
+// -------------------------- Benchmark inputs --------------------------
+// A TU to benchmark.
+struct BenchInput {
+  // Name to report it under.
+  string m_label;
+
+  // Name of the file to parse.
+  string m_fname;
+};
+
+
+// Return source code that instantiates class and function templates
+// 'n' times each, with a few expressions in each instantiation.
+static string syntheticTemplateSource(int n)
+{
+  std::ostringstream oss;
+  oss << "template <class T, int N>\n"
+         "struct Box {\n"
+         "  T m_v[N];\n"
+         "  T get(int i) const { return m_v[i % N]; }\n"
+         "  template <class U>\n"
+         "  U conv() const { return static_cast<U>(get(0) + N); }\n"
+         "};\n"
+         "\n"
+         "template <class T>\n"
+         "T combine(T a, T b) { return a < b? b - a : a * b + 1; }\n"
+         "\n";
+
+  for (int i = 0; i < n; ++i) {
+    oss << "int f" << i << "(int x) {\n"
+        << "  Box<int, " << i+1 << "> b{};\n"
+        << "  Box<double, " << i+1 << "> d{};\n"
+        << "  for (int j = 0; j < x; ++j) {\n"
+        << "    x = combine(x, b.get(j)) + (int)d.conv<long>();\n"
+        << "  }\n"
+        << "  return x;\n"
+        << "}\n";
+  }
+
+  return oss.str();
+}
+
+
+// Source code that includes some commonly used library headers.
+static char const stdlibSource[] =
+  "#include <algorithm>\n"
+  "#include <iostream>\n"
+  "#include <map>\n"
+  "#include <memory>\n"
+  "#include <string>\n"
+  "#include <vector>\n"
+  "\n"
+  "int main()\n"
+  "{\n"
+  "  std::map<std::string, std::vector<int>> m;\n"
+  "  m[\"a\"].push_back(1);\n"
+  "  auto p = std::make_unique<std::string>(\"b\");\n"
+  "  std::vector<int> &v = m[*p];\n"
+  "  std::sort(v.begin(), v.end());\n"
+  "  std::cout << v.size() << m.size() << \"\\n\";\n"
+  "  return 0;\n"
+  "}\n";
+
+
+// The inputs used when none are specified on the command line.
+static std::vector<BenchInput> defaultInputs()
+{
+  return std::vector<BenchInput>{
+    { "synthetic-templates",
+      ClangASTUtilTempFile::makeInMemoryFile(syntheticTemplateSource(200)) },
+    { "in/src/ct-cont-ct-emspec-of-cspspec.cc",
+      "in/src/ct-cont-ct-emspec-of-cspspec.cc" },
+    { "in/src/deduction-guide-in-ns.cc",
+      "in/src/deduction-guide-in-ns.cc" },
+    { "stdlib-includes",
+      ClangASTUtilTempFile::makeInMemoryFile(stdlibSource) },
+  };
+}
+
+
+// --------------------------- Measurement ------------------------------
+// Nanoseconds elapsed since 'start'.
+static long long nanosecondsSince(
+  std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+
+// Write one JSON result line.  'visited' of -1 is written as null.
+static void writeResult(
+  std::ostream &os,
+  string const &label,
+  char const *traversal,
+  int iterations,
+  long long nodes,
+  long long visited,
+  long long bestNS,
+  long long meanNS,
+  std::uint64_t allocations,
+  std::uint64_t allocatedBytes)
+{
+  os << "{\"tu\": " << doubleQuote(label)
+     << ", \"traversal\": " << doubleQuote(traversal)
+     << ", \"iterations\": " << iterations
+     << ", \"nodes\": " << nodes
+     << ", \"visited\": ";
+  if (visited < 0) {
+    os << "null";
+  }
+  else {
+    os << visited;
+  }
+  os << ", \"best_ns\": " << bestNS
+     << ", \"mean_ns\": " << meanNS
+     << ", \"nodes_per_sec\": "
+     << (bestNS > 0? (long long)(nodes * 1e9 / bestNS) : 0)
+     << ", \"allocations\": " << allocations
+     << ", \"allocated_bytes\": " << allocatedBytes
+     << ", \"peak_rss_kb\": " << peakRSSKB()
+     << "}" << std::endl;
+}
+
+
+// Parse 'input' and time each traversal on it.
+static void benchOneTU(
+  std::ostream &os,
+  BenchInput const &input,
+  std::vector<string> const &clangOptions,
+  int iterations)
+{
+  std::vector<string> fnameAndArgs{input.m_fname};
+  fnameAndArgs.insert(fnameAndArgs.end(),
+                      clangOptions.begin(), clangOptions.end());
+
+  std::uint64_t allocsBefore = s_numAllocations;
+  std::uint64_t bytesBefore = s_allocatedBytes;
+  auto start = std::chrono::steady_clock::now();
+
+  // Throws on failure.
+  ClangAST ast(fnameAndArgs);
+
+  long long parseNS = nanosecondsSince(start);
+  clang::ASTContext &astContext = ast.getASTContext();
+  GlobalClangUtilInstance gcui(astContext);
+
+  long long nodes = runVisitor(astContext);
+  writeResult(os, input.m_label, "parse", 1, nodes, -1,
+              parseNS, parseNS,
+              s_numAllocations - allocsBefore,
+              s_allocatedBytes - bytesBefore);
+
+  for (auto const &traversal : traversals) {
+    long long visited = -1;
+    long long bestNS = 0;
+    long long totalNS = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocatedBytes = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+      allocsBefore = s_numAllocations;
+      bytesBefore = s_allocatedBytes;
+      start = std::chrono::steady_clock::now();
+
+      visited = traversal.m_function(astContext);
+
+      long long ns = nanosecondsSince(start);
+      totalNS += ns;
+      if (i == 0 || ns < bestNS) {
+        bestNS = ns;
+      }
+
+      // Every run does the same work, so report the first.
+      if (i == 0) {
+        allocations = s_numAllocations - allocsBefore;
+        allocatedBytes = s_allocatedBytes - bytesBefore;
+      }
+    }
+
+    writeResult(os, input.m_label, traversal.m_name, iterations,
+                nodes, visited, bestNS, totalNS / iterations,
+                allocations, allocatedBytes);
+  }
+}
+
+
+static int innerMain(int argc, char const **argv)
+{
+  int iterations = 5;
+  std::vector<BenchInput> inputs;
+  std::vector<string> clangOptions;
+
+  for (int i = 1; i < argc; ++i) {
+    string arg(argv[i]);
+
+    if (arg == "--") {
+      clangOptions.assign(argv+i+1, argv+argc);
+      break;
+    }
+    else if (arg.compare(0, 13, "--iterations=") == 0) {
+      iterations = std::atoi(arg.c_str() + 13);
+      if (iterations < 1) {
+        cerr << "invalid iteration count: " << doubleQuote(arg) << "\n";
+        return 2;
+      }
+    }
+    else if (arg == "--help") {
+      cout << "usage: " << argv[0]
+           << " [--iterations=N] [file.cc ...] [-- clang-options]\n";
+      return 0;
+    }
+    else if (arg.compare(0, 2, "--") == 0) {
+      cerr << "unknown option: " << doubleQuote(arg) << "\n";
+      return 2;
+    }
+    else {
+      inputs.push_back(BenchInput{arg, arg});
+    }
+  }
+
+  if (inputs.empty()) {
+    inputs = defaultInputs();
+  }
+
+  for (BenchInput const &input : inputs) {
+    benchOneTU(cout, input, clangOptions, iterations);
+  }
+
+  return 0;
+}
+
+
+int main(int argc, char const **argv)
+{
+  // Let deep traversals detect when they should switch stacks.
+  clang::noteBottomOfStack();
+
+  try {
+    return innerMain(argc, argv);
+  }
+  catch (std::exception &x) {
+    std::cerr << x.what() << "\n";
+    return 2;
+  }
+}
+
+
+// EOF
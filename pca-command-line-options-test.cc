@@ -37,6 +37,48 @@ static void test_parseCommandLine()
 }
 
 
+static void test_parseCommandLine_int()
+{
+  PCACommandLineOptions options;
+  assert(options.m_jobs == 1);
+
+  char const *argv[] = {
+    "prog",
+    "--jobs=12",
+    "--jobs=x",
+  };
+  int argIndex = 1;
+  string err = options.parseCommandLine(argIndex, 3, argv);
+
+  // The malformed value stops option processing.
+  assert(err.empty());
+  assert(argIndex == 2);
+  assert(options.m_jobs == 12);
+}
+
+
+static void test_parseCommandLine_string()
+{
+  PCACommandLineOptions options;
+  assert(options.m_batchFile == "");
+  assert(options.m_batchOutputDir == ".");
+
+  char const *argv[] = {
+    "prog",
+    "--batch=cmds.json",
+    "--batch-output-dir=",
+    "--batch",
+  };
+  int argIndex = 1;
+  string err = options.parseCommandLine(argIndex, 4, argv);
+
+  // "--batch" without "=" is not recognized.
+  assert(err.empty());
+  assert(argIndex == 3);
+  assert(options.m_batchFile == "cmds.json");
+  assert(options.m_batchOutputDir == "");
+}
+
 
 static void tppsfc1(
   char const *contents,
@@ -86,12 +128,23 @@ static void test_parsePrimarySourceFileContents()
 
   tppsfc1("\nPRINT_CLANG_AST_OPTIONS: --unrecog",
           "file:2:26: unrecognized argument: \"--unrecog\"", "");
+
+  tppsfc1("PRINT_CLANG_AST_OPTIONS: --jobs=3 --print-ast-nodes",
+          "", "--print-ast-nodes --jobs=3");
+
+  tppsfc1("PRINT_CLANG_AST_OPTIONS: --jobs=",
+          "file:1:26: unrecognized argument: \"--jobs=\"", "");
+
+  tppsfc1("PRINT_CLANG_AST_OPTIONS: --batch-output-dir=out --batch=.",
+          "", "--batch=. --batch-output-dir=out");
 }
 
 
 void pca_command_line_options_unit_tests()
 {
   test_parseCommandLine();
+  test_parseCommandLine_int();
+  test_parseCommandLine_string();
   test_parsePrimarySourceFileContents();
 }
 
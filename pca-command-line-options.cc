@@ -7,9 +7,10 @@
 #include "pca-util.h"                            // startsWith, commaSeparate
 #include "stringref-parse.h"                     // StringRefParse
 
-#include "smbase/string-util.h"                  // doubleQuote
+#include "smbase/string-util.h"                  // doubleQuote, beginsWith
 #include "smbase/stringb.h"                      // stringb
 
+#include <climits>                               // INT_MAX
 #include <cstdlib>                               // std::exit
 #include <iostream>                              // std::cout, etc.
 #include <string>                                // std::string
@@ -23,6 +24,10 @@ PCACommandLineOptions::PCACommandLineOptions()
     // Use the def file to specify default values.
     #define BOOL_OPTION(fieldName, defaultValue, optionName, helpText) \
       fieldName(defaultValue),
+    #define INT_OPTION(fieldName, defaultValue, optionName, helpText) \
+      fieldName(defaultValue),
+    #define STRING_OPTION(fieldName, defaultValue, optionName, helpText) \
+      fieldName(defaultValue),
     #include "pca-command-line-options.def"
 
     m_dummy(0)
@@ -49,6 +54,12 @@ by compiling a single source file.
   #define BOOL_OPTION(fieldName, defaultValue, optionName, helpText) \
     cout << "  " << optionName << "\n\n"                             \
          << "    " << helpText << "\n\n";
+  #define INT_OPTION(fieldName, defaultValue, optionName, helpText)  \
+    cout << "  " << optionName << "=<n>\n\n"                         \
+         << "    " << helpText << "\n\n";
+  #define STRING_OPTION(fieldName, defaultValue, optionName, helpText) \
+    cout << "  " << optionName << "=<value>\n\n"                       \
+         << "    " << helpText << "\n\n";
   #include "pca-command-line-options.def"
 
   cout << R"""(Any option that is not among those listed above will be interpreted as
@@ -57,6 +68,52 @@ the first <compiler-option>.
 }
 
 
+// If 'arg' is "<optionName>=<n>" where 'n' is a non-negative decimal
+// integer, set 'value' to 'n' and return true.  Otherwise return false.
+static bool parseIntOption(
+  int /*OUT*/ &value,
+  std::string const &arg,
+  char const *optionName)
+{
+  string prefix = stringb(optionName << "=");
+  if (!beginsWith(arg, prefix) || arg.size() == prefix.size()) {
+    return false;
+  }
+
+  long n = 0;
+  for (std::size_t i = prefix.size(); i < arg.size(); ++i) {
+    char c = arg[i];
+    if (!( '0' <= c && c <= '9' )) {
+      return false;
+    }
+    n = n*10 + (c - '0');
+    if (n > INT_MAX) {
+      return false;
+    }
+  }
+
+  value = (int)n;
+  return true;
+}
+
+
+// If 'arg' is "<optionName>=<s>", set 'value' to 's' and return true.
+// Otherwise return false.
+static bool parseStringOption(
+  std::string /*OUT*/ &value,
+  std::string const &arg,
+  char const *optionName)
+{
+  string prefix = stringb(optionName << "=");
+  if (!beginsWith(arg, prefix)) {
+    return false;
+  }
+
+  value = arg.substr(prefix.size());
+  return true;
+}
+
+
 bool PCACommandLineOptions::processArgument(std::string const &arg)
 {
   // Allow all cases to begin with 'else'.
@@ -67,6 +124,10 @@ bool PCACommandLineOptions::processArgument(std::string const &arg)
     else if (arg == (optionName)) {                                  \
       fieldName = !(defaultValue);                                   \
     }
+  #define INT_OPTION(fieldName, defaultValue, optionName, helpText)  \
+    else if (parseIntOption(fieldName, arg, optionName)) {}
+  #define STRING_OPTION(fieldName, defaultValue, optionName, helpText) \
+    else if (parseStringOption(fieldName, arg, optionName)) {}
   #include "pca-command-line-options.def"
 
   else {
@@ -160,6 +221,14 @@ std::vector<std::string> PCACommandLineOptions::getAsArguments() const
     if (fieldName != (defaultValue)) {                               \
       args.push_back(optionName);                                    \
     }
+  #define INT_OPTION(fieldName, defaultValue, optionName, helpText)  \
+    if (fieldName != (defaultValue)) {                               \
+      args.push_back(stringb(optionName << "=" << fieldName));       \
+    }
+  #define STRING_OPTION(fieldName, defaultValue, optionName, helpText) \
+    if (fieldName != (defaultValue)) {                                 \
+      args.push_back(stringb(optionName << "=" << fieldName));         \
+    }
   #include "pca-command-line-options.def"
 
   return args;
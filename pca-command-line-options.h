@@ -16,6 +16,10 @@ public:      // data
   // Use the def file to declare the fields.
   #define BOOL_OPTION(fieldName, defaultValue, optionName, helpText) \
     bool fieldName;
+  #define INT_OPTION(fieldName, defaultValue, optionName, helpText) \
+    int fieldName;
+  #define STRING_OPTION(fieldName, defaultValue, optionName, helpText) \
+    std::string fieldName;
   #include "pca-command-line-options.def"
 
   // This only exists to be initialized by the ctor after everything
@@ -30,7 +34,8 @@ public:      // methods
   static void printUsage(char const *progName);
 
   // Process a single command line argument.  Return false if it is not
-  // recognized.
+  // recognized.  An integer option whose value is not a non-negative
+  // decimal integer is treated as unrecognized.
   bool processArgument(std::string const &arg);
 
   // Parse options out of 'argv' and into 'this', updating 'argIndex' to
@@ -0,0 +1,630 @@
+// pca-process-tu.cc
+// Code for `pca-process-tu.h`.
+
+#include "pca-process-tu.h"                                // this module
+
+#include "ast-cache.h"                                     // ASTCache
+#include "clang-ast-visitor-fanout.h"                      // ClangASTVisitorFanOut
+#include "clang-util.h"                                    // GlobalClangUtilInstance
+#include "compressed-output.h"                             // CompressingStreamBuf, parseCompressionFormat, etc.
+#include "decl-implicit.h"                                 // declareImplicitThings
+#include "file-util.h"                                     // readFile
+#include "node-binary-dump.h"                              // NodeBinaryDumpWriter
+#include "node-query.h"                                    // parseNodeQuery
+#include "node-record-diff.h"                              // NodeRecordPatchWriter, NodeFingerprintWriter, etc.
+#include "print-clang-ast-nodes.h"                         // printClangASTNodes
+#include "print-method-comments.h"                         // printMethodComments, makeMethodCommentsSink
+#include "printer-visitor.h"                               // printerVisitorTU, PrinterVisitorSink
+#include "rav-printer-visitor.h"                           // ravPrinterVisitorTU
+
+#include "smbase/sm-macros.h"                              // NO_OBJECT_COPIES, NULLABLE
+#include "smbase/sm-trace.h"                               // INIT_TRACE
+#include "smbase/string-util.h"                            // doubleQuote
+
+#include "llvm/ADT/SmallVector.h"                          // llvm::SmallVector
+#include "llvm/ADT/StringRef.h"                            // llvm::StringRef
+#include "llvm/Support/FileSystem.h"                       // llvm::sys::fs::create_directories
+
+#include <array>                                           // std::array
+#include <cstddef>                                         // std::size_t
+#include <fstream>                                         // std::ofstream
+#include <iostream>                                        // std::{cerr, istream, ostream, getline, streamoff}
+#include <memory>                                          // std::unique_ptr
+#include <string>                                          // std::string
+#include <vector>                                          // std::vector
+
+using std::cerr;
+using std::string;
+
+
+INIT_TRACE("pca-process-tu");
+
+
+bool parseTUWithOptions(
+  ClangAST &ast,
+  PCACommandLineOptions /*IN/OUT*/ &options,
+  std::vector<std::string> const &fnameAndArgs)
+{
+  // This checks that there is exactly one input.
+  if (!ast.parseCommandLine(fnameAndArgs)) {
+    return false;
+  }
+  TRACE1("primarySourceFileName: " << ast.m_primarySourceFileName);
+
+  // Scan the file for additional options.
+  string err = options.parsePrimarySourceFile(ast.m_primarySourceFileName);
+  if (!err.empty()) {
+    cerr << err << "\n";
+    return false;
+  }
+  TRACE1("options: " << options.getAsArgumentsString());
+
+  if (options.m_persistent) {
+    // Build the preamble on the first parse so every re-parse can use
+    // it.
+    ast.m_precompilePreambleAfterNParses = 1;
+  }
+
+  // A loaded AST has no `Sema`, which re-parsing and declaring implicit
+  // members both need.
+  if (!options.m_astCacheDir.empty() &&
+      !options.m_persistent &&
+      !options.m_forceImplicit) {
+    ASTCache cache(options.m_astCacheDir);
+    bool ok = cache.parseSourceCode(ast);
+    TRACE1("AST cache " << (cache.m_hits? "hit" : "miss"));
+    return ok;
+  }
+
+  return ast.parseSourceCode();
+}
+
+
+// The consumers of the node records for --node-diff-against,
+// --node-fingerprints-out, and --print-ast-nodes-binary.
+class NodeRecordOutputs {
+  NO_OBJECT_COPIES(NodeRecordOutputs);
+
+private:     // data
+  // Fingerprints read from the --node-diff-against file.
+  NodeFingerprints m_oldFingerprints;
+
+  // Writer of the patch, when diffing.
+  std::unique_ptr<NodeRecordPatchWriter> m_patchWriter;
+
+  // The --node-fingerprints-out file and its writer.  The writer is
+  // declared second since it writes to the file when created.
+  std::ofstream m_fingerprintsFile;
+  std::unique_ptr<NodeFingerprintWriter> m_fingerprintWriter;
+
+  // Collects the records for the --print-ast-nodes-binary file, which
+  // is written once they are all in.
+  std::unique_ptr<NodeBinaryDumpWriter> m_binaryDumpWriter;
+
+public:      // data
+  // Passes the records to each of the above that is in use.
+  NodeRecordSinkFanout m_sinks;
+
+public:      // methods
+  NodeRecordOutputs()
+    : m_oldFingerprints(),
+      m_patchWriter(),
+      m_fingerprintsFile(),
+      m_fingerprintWriter(),
+      m_binaryDumpWriter(),
+      m_sinks()
+  {}
+
+  // Set up what 'options' calls for, with the patch going to 'os'.
+  // Return false after printing an error message if a file could not
+  // be read.
+  bool open(std::ostream &os, PCACommandLineOptions const &options)
+  {
+    if (!options.m_nodeDiffAgainst.empty()) {
+      string fpText;
+      string err = readFile(fpText, options.m_nodeDiffAgainst);
+      if (err.empty()) {
+        err = parseNodeFingerprints(m_oldFingerprints,
+                                    options.m_nodeDiffAgainst, fpText);
+      }
+      if (!err.empty()) {
+        cerr << err << "\n";
+        return false;
+      }
+
+      m_patchWriter.reset(new NodeRecordPatchWriter(os, m_oldFingerprints));
+      m_sinks.m_sinks.push_back(m_patchWriter.get());
+    }
+
+    if (!options.m_nodeFingerprintsOut.empty()) {
+      m_fingerprintsFile.open(options.m_nodeFingerprintsOut,
+                              std::ios::binary);
+      m_fingerprintWriter.reset(new NodeFingerprintWriter(m_fingerprintsFile));
+      m_sinks.m_sinks.push_back(m_fingerprintWriter.get());
+    }
+
+    if (!options.m_printASTNodesBinary.empty()) {
+      m_binaryDumpWriter.reset(new NodeBinaryDumpWriter);
+      m_sinks.m_sinks.push_back(m_binaryDumpWriter.get());
+    }
+
+    return true;
+  }
+
+  // Finish the outputs once all records have been handled.  Return
+  // false after printing an error message if a file could not be
+  // written.
+  bool close(PCACommandLineOptions const &options)
+  {
+    if (m_patchWriter) {
+      int numOps = m_patchWriter->finish();
+      TRACE1("patch operations: " << numOps);
+    }
+
+    if (m_fingerprintWriter) {
+      m_fingerprintsFile.close();
+      if (!m_fingerprintsFile) {
+        cerr << "error writing "
+             << doubleQuote(options.m_nodeFingerprintsOut) << "\n";
+        return false;
+      }
+    }
+
+    if (m_binaryDumpWriter) {
+      string err =
+        m_binaryDumpWriter->writeFile(options.m_printASTNodesBinary);
+      if (!err.empty()) {
+        cerr << err << "\n";
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+
+// Kinds of output that --split-output-dir sends to separate files.
+enum OutputKind {
+  OUT_DUMP_AST,
+  OUT_AST_JSON,
+  OUT_PRINTER_VISITOR,
+  OUT_RAV_PRINTER_VISITOR,
+  OUT_METHOD_COMMENTS,
+  OUT_AST_NODES,
+
+  NUM_OUTPUT_KINDS
+};
+
+// Name of the file, in the --split-output-dir directory, that receives
+// each kind of output.
+static char const * const splitOutputFileNames[NUM_OUTPUT_KINDS] = {
+  "dump-ast.txt",
+  "ast.json",
+  "printer-visitor.txt",
+  "rav-printer-visitor.txt",
+  "method-comments.txt",
+  "ast-nodes.json",
+};
+
+// True if 'options' call for output of 'kind'.
+static bool outputEnabled(
+  PCACommandLineOptions const &options,
+  OutputKind kind)
+{
+  switch (kind) {
+    case OUT_DUMP_AST:             return options.m_dumpAST;
+    case OUT_AST_JSON:             return options.m_printAST_JSON;
+    case OUT_PRINTER_VISITOR:      return options.m_printerVisitor;
+    case OUT_RAV_PRINTER_VISITOR:  return options.m_ravPrinterVisitor;
+    case OUT_METHOD_COMMENTS:      return options.m_printMethodComments;
+    case OUT_AST_NODES:            return options.m_printASTNodes;
+    default:                      return false;
+  }
+}
+
+// Stream that receives each kind of output, or nullptr if that output
+// is not enabled.
+typedef std::array<std::ostream * NULLABLE, NUM_OUTPUT_KINDS> OutputStreams;
+
+
+// Return the `PrinterVisitor` flags selected by 'options'.
+static PrinterVisitor::Flags printerVisitorFlags(
+  PCACommandLineOptions const &options)
+{
+  PrinterVisitor::Flags flags = PrinterVisitor::F_NONE;
+  if (options.m_printVisitContext) {
+    flags |= PrinterVisitor::F_PRINT_VISIT_CONTEXT;
+  }
+  if (options.m_printImplicitQualTypes) {
+    flags |= PrinterVisitor::F_PRINT_IMPLICIT_QUAL_TYPES;
+  }
+  if (options.m_omit_CTPSD_TAW) {
+    flags |= PrinterVisitor::F_OMIT_CTPSD_TAW;
+  }
+  if (options.m_printDefaultArgExprs) {
+    flags |= PrinterVisitor::F_PRINT_DEFAULT_ARG_EXPRS;
+  }
+  if (options.m_ravCompat) {
+    flags |= PrinterVisitor::F_RAV_COMPAT;
+  }
+  return flags;
+}
+
+
+// Run the printing actions, writing each kind of output to its stream
+// in 'outs'.
+static int runPrintingActions(
+  OutputStreams const &outs,
+  PCACommandLineOptions const &options,
+  ClangAST &ast)
+{
+  if (options.m_forceImplicit) {
+    declareImplicitThings(ast.getASTUnit(), true /*defineAlso*/);
+  }
+
+  if (options.m_dumpAST) {
+    dumpClangAST(*outs[OUT_DUMP_AST], ast.getASTContext());
+  }
+
+  if (options.m_printAST_JSON) {
+    printClangAST_JSON(*outs[OUT_AST_JSON], ast.getASTContext());
+  }
+
+  // When the printer visitor and the method comments go to different
+  // places, so their output need not be sequential, let one traversal
+  // feed both.  With --jobs, the printer visitor is better off running
+  // in parallel on its own.
+  bool const fuseVisitors =
+    options.m_printerVisitor &&
+    options.m_printMethodComments &&
+    outs[OUT_PRINTER_VISITOR] != outs[OUT_METHOD_COMMENTS] &&
+    options.m_jobs < 2;
+
+  if (fuseVisitors) {
+    PrinterVisitorSink printerSink(*outs[OUT_PRINTER_VISITOR],
+                                   ast.getASTContext());
+    printerSink.m_printer.m_flags = printerVisitorFlags(options);
+
+    std::unique_ptr<ClangASTVisitorSink> pmcSink =
+      makeMethodCommentsSink(*outs[OUT_METHOD_COMMENTS],
+                             ast.getASTContext());
+
+    ClangASTVisitorFanOut fanOut;
+    fanOut.addSink(&printerSink);
+    fanOut.addSink(pmcSink.get());
+    fanOut.scanTU(ast.getASTContext());
+  }
+
+  if (options.m_printerVisitor && !fuseVisitors) {
+    printerVisitorTU(*outs[OUT_PRINTER_VISITOR],
+                     ast.getASTContext(),
+                     printerVisitorFlags(options),
+                     options.m_jobs);
+  }
+
+  if (options.m_ravPrinterVisitor) {
+    ravPrinterVisitorTU(*outs[OUT_RAV_PRINTER_VISITOR], ast.getASTContext());
+  }
+
+  if (options.m_printMethodComments && !fuseVisitors) {
+    printMethodComments(*outs[OUT_METHOD_COMMENTS], ast.getASTContext());
+  }
+
+  if (options.m_printASTNodes) {
+    std::ostream &os = *outs[OUT_AST_NODES];
+
+    PrintClangASTNodesConfiguration config;
+    config.m_printNonPSFFileEntities = options.m_fullTU;
+    // Addresses differ from run to run, so records that include them
+    // would never match their fingerprints from an earlier run.
+    config.m_printAddresses = !options.m_suppressAddresses &&
+                              options.m_nodeFingerprintsOut.empty() &&
+                              options.m_nodeDiffAgainst.empty();
+    config.m_printQualifiers = !options.m_noASTFieldQualifiers;
+    config.m_jobs = options.m_jobs;
+    config.m_printTokenEndLocs = options.m_printTokenEndLocs;
+
+    llvm::SmallVector<llvm::StringRef, 4> entityFiles;
+    llvm::StringRef(options.m_entityFiles).split(entityFiles, ',',
+      -1 /*maxSplit*/, false /*keepEmpty*/);
+    for (llvm::StringRef fname : entityFiles) {
+      config.m_entityFileNames.push_back(fname.trim().str());
+    }
+
+    if (!options.m_queryDecls.empty()) {
+      string err = parseNodeQuery(config.m_queryTerms, options.m_queryDecls);
+      if (!err.empty()) {
+        cerr << "--query-decls: " << err << "\n";
+        return 2;
+      }
+      config.m_queryDepth = options.m_queryDepth;
+    }
+
+    std::ofstream nodeIndexStream;
+    if (!options.m_nodeIndexOut.empty()) {
+      if (!options.m_nodeDiffAgainst.empty()) {
+        cerr << "--node-index-out cannot be used with --node-diff-against.\n";
+        return 2;
+      }
+      nodeIndexStream.open(options.m_nodeIndexOut, std::ios::binary);
+    }
+    std::ostream *nodeIndexOS =
+      options.m_nodeIndexOut.empty()? nullptr : &nodeIndexStream;
+
+    NodeRecordOutputs recordOutputs;
+    if (!recordOutputs.open(os, options)) {
+      return 2;
+    }
+    NodeRecordSink *recordSink =
+      recordOutputs.m_sinks.m_sinks.empty()? nullptr : &recordOutputs.m_sinks;
+
+    // When printing a patch, it takes the place of the node text.
+    std::ostream nullStream(nullptr);
+    std::ostream &nodesOS =
+      options.m_nodeDiffAgainst.empty()? os : nullStream;
+
+    // Index offsets count from the start of the output stream, like
+    // the frame offsets of --compress-frame-index-out, so other outputs
+    // printed first are counted.  If the stream cannot say where it is,
+    // as with a pipe, count from the start of the node output.
+    std::streamoff nodeIndexBase = 0;
+    if (nodeIndexOS) {
+      nodeIndexBase = nodesOS.tellp();
+      if (nodeIndexBase < 0) {
+        nodeIndexBase = 0;
+      }
+    }
+
+    int failedAssertions = printClangASTNodes(nodesOS, ast.getASTContext(),
+      config, nodeIndexOS, recordSink, nodeIndexBase);
+
+    if (!recordOutputs.close(options)) {
+      return 2;
+    }
+
+    if (nodeIndexOS) {
+      nodeIndexStream.close();
+      if (!nodeIndexStream) {
+        cerr << "error writing " << doubleQuote(options.m_nodeIndexOut)
+             << "\n";
+        return 2;
+      }
+    }
+
+    if (failedAssertions) {
+      cerr << "Failed assertions: " << failedAssertions << "\n";
+      return 2;
+    }
+  }
+
+  return 0;
+}
+
+
+// One destination for output: either a stream supplied by the caller or
+// a file, optionally compressed on the way.
+class OutputChannel {
+  NO_OBJECT_COPIES(OutputChannel);
+
+private:     // data
+  // File being written, when writing to a file.
+  std::ofstream m_file;
+
+  // Name of 'm_file', or "" when writing to the caller's stream.
+  std::string m_fname;
+
+  // Compressor and the stream that writes to it, or nullptr when not
+  // compressing.  They are declared after 'm_file' because they write
+  // to it when destroyed.
+  std::unique_ptr<CompressingStreamBuf> m_compressor;
+  std::unique_ptr<std::ostream> m_compressedOS;
+
+  // Where the output goes: the caller's stream, 'm_file', or
+  // 'm_compressedOS'.
+  std::ostream *m_os;
+
+  // Set up compression into 'dest' if 'format' calls for it.
+  void startCompressing(
+    std::ostream &dest,
+    CompressionFormat format,
+    std::size_t frameSize)
+  {
+    if (format != CF_NONE) {
+      m_compressor.reset(new CompressingStreamBuf(dest, format, frameSize));
+      m_compressedOS.reset(new std::ostream(m_compressor.get()));
+      m_os = m_compressedOS.get();
+    }
+  }
+
+public:      // methods
+  // Write to 'os'.
+  OutputChannel(
+    std::ostream &os,
+    CompressionFormat format,
+    std::size_t frameSize)
+    : m_file(),
+      m_fname(),
+      m_compressor(),
+      m_compressedOS(),
+      m_os(&os)
+  {
+    startCompressing(os, format, frameSize);
+  }
+
+  // Write to the file 'fname'.  Check `isOpen` afterward.
+  OutputChannel(
+    std::string const &fname,
+    CompressionFormat format,
+    std::size_t frameSize)
+    : m_file(fname, std::ios::binary),
+      m_fname(fname),
+      m_compressor(),
+      m_compressedOS(),
+      m_os(&m_file)
+  {
+    if (m_file) {
+      startCompressing(m_file, format, frameSize);
+    }
+  }
+
+  // False if the file could not be opened.
+  bool isOpen() const
+    { return m_fname.empty() || m_file.is_open(); }
+
+  // Stream to write the output to.
+  std::ostream &stream()
+    { return *m_os; }
+
+  // Finish compressing, if applicable, and flush or close the
+  // destination.  Put the compressed frame locations into 'frames'.
+  // Return "" or an error message.
+  std::string finish(std::vector<CompressedFrame> /*OUT*/ &frames)
+  {
+    if (m_compressor) {
+      std::string err = m_compressor->finish();
+      if (!err.empty()) {
+        return err;
+      }
+      frames = m_compressor->frames();
+    }
+
+    if (m_fname.empty()) {
+      m_os->flush();
+      return "";
+    }
+
+    m_file.close();
+    if (!m_file) {
+      return "error writing " + doubleQuote(m_fname);
+    }
+    return "";
+  }
+};
+
+
+int processParsedTU(
+  std::ostream &os,
+  PCACommandLineOptions const &options,
+  ClangAST &ast)
+{
+  CompressionFormat format;
+  string err = parseCompressionFormat(format, options.m_compressOutput);
+  if (!err.empty()) {
+    cerr << err << "\n";
+    return 2;
+  }
+  std::size_t frameSize = options.m_compressFrameSize;
+
+  std::vector<std::unique_ptr<OutputChannel>> channels;
+  OutputStreams outs;
+  outs.fill(nullptr);
+
+  if (options.m_splitOutputDir.empty()) {
+    // Everything goes, in sequence, to 'os'.
+    channels.push_back(std::unique_ptr<OutputChannel>(
+      new OutputChannel(os, format, frameSize)));
+    outs.fill(&channels.back()->stream());
+  }
+  else {
+    if (!options.m_compressFrameIndexOut.empty()) {
+      cerr << "--compress-frame-index-out cannot be used with "
+              "--split-output-dir.\n";
+      return 2;
+    }
+    if (llvm::sys::fs::create_directories(options.m_splitOutputDir)) {
+      cerr << "cannot create " << doubleQuote(options.m_splitOutputDir)
+           << "\n";
+      return 2;
+    }
+
+    for (int i=0; i < NUM_OUTPUT_KINDS; ++i) {
+      OutputKind kind = static_cast<OutputKind>(i);
+      if (!outputEnabled(options, kind)) {
+        continue;
+      }
+
+      string fname = options.m_splitOutputDir + "/" +
+                     splitOutputFileNames[kind] +
+                     compressionFormatExtension(format);
+      TRACE1("writing " << fname);
+      channels.push_back(std::unique_ptr<OutputChannel>(
+        new OutputChannel(fname, format, frameSize)));
+      if (!channels.back()->isOpen()) {
+        cerr << "cannot write " << doubleQuote(fname) << "\n";
+        return 2;
+      }
+      outs[kind] = &channels.back()->stream();
+    }
+  }
+
+  int result = runPrintingActions(outs, options, ast);
+
+  std::vector<CompressedFrame> frames;
+  for (std::unique_ptr<OutputChannel> &channel : channels) {
+    err = channel->finish(frames);
+    if (!err.empty()) {
+      cerr << err << "\n";
+      result = 2;
+    }
+  }
+
+  if (format != CF_NONE && !options.m_compressFrameIndexOut.empty()) {
+    // There is only one channel here, so 'frames' is its.
+    std::ofstream out(options.m_compressFrameIndexOut, std::ios::binary);
+    writeCompressedFrameIndex(out, frames);
+    out.close();
+    if (!out) {
+      cerr << "error writing " << doubleQuote(options.m_compressFrameIndexOut)
+           << "\n";
+      return 2;
+    }
+  }
+
+  return result;
+}
+
+
+char const * const PCA_END_OF_OUTPUT_MARKER = "PCA_END_OF_OUTPUT";
+
+
+int runPersistentLoop(
+  std::istream &is,
+  std::ostream &os,
+  PCACommandLineOptions const &options,
+  ClangAST &ast)
+{
+  int result = 0;
+  os << PCA_END_OF_OUTPUT_MARKER << std::endl;
+
+  string line;
+  while (std::getline(is, line)) {
+    // Let the re-parse see changes to the headers.  This also lets the
+    // preamble reuse check notice them.
+    ClangAST::clearSharedFileSystemCache();
+
+    // Pass the main file contents explicitly so the re-parse does not
+    // depend on what the `FileManager` has cached about it.
+    string contents;
+    string err = readFile(contents, ast.m_primarySourceFileName);
+    if (!err.empty()) {
+      cerr << err << "\n";
+      result = 2;
+    }
+    else if (!ast.reparse({{ast.m_primarySourceFileName, contents}})) {
+      cerr << "Failed to re-parse " << ast.m_primarySourceFileName << ".\n";
+      result = 2;
+    }
+    else {
+      GlobalClangUtilInstance gcui(ast.getASTContext());
+      result = processParsedTU(os, options, ast);
+    }
+
+    os << PCA_END_OF_OUTPUT_MARKER << std::endl;
+  }
+
+  return result;
+}
+
+
+// EOF
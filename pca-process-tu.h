@@ -0,0 +1,61 @@
+// pca-process-tu.h
+// Parse one translation unit and run the actions chosen by the options.
+
+#ifndef PCA_PROCESS_TU_H
+#define PCA_PROCESS_TU_H
+
+#include "clang-ast.h"                           // ClangAST
+#include "pca-command-line-options.h"            // PCACommandLineOptions
+
+#include <iosfwd>                                // std::{istream, ostream}
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+// Parse 'fnameAndArgs' (a primary source file name and compiler
+// options) into 'ast'.  In between parsing the command line and parsing
+// the source code, scan the primary source file for additional options
+// and add them to 'options'.
+//
+// Return true on success.  On failure, return false after printing
+// error messages to stderr.
+bool parseTUWithOptions(
+  ClangAST &ast,
+  PCACommandLineOptions /*IN/OUT*/ &options,
+  std::vector<std::string> const &fnameAndArgs);
+
+// Run the printing actions selected by 'options' on the parsed 'ast',
+// writing the results to 'os'.  Return 0 on success, or 2 if the
+// printed AST node details had failed assertions.
+//
+// With --split-output-dir, each kind of output goes to its own file
+// instead of 'os'.  With --compress-output, the output is compressed,
+// on another thread, as it is produced.
+//
+// This does not set `ClangUtil::s_instance`; the caller should do that
+// if desired.
+int processParsedTU(
+  std::ostream &os,
+  PCACommandLineOptions const &options,
+  ClangAST &ast);
+
+// Line written after each output in `runPersistentLoop`.
+extern char const * const PCA_END_OF_OUTPUT_MARKER;
+
+// Implement --persistent: after the first output (already written by
+// the caller), write the end marker, then for each line read from
+// 'is', re-parse the primary source file of 'ast', run
+// `processParsedTU`, and write the end marker again.  Return when 'is'
+// reaches EOF.
+//
+// A failure to re-parse is reported on stderr and does not end the
+// loop.  The return value is that of the last `processParsedTU`, or 2
+// if the last re-parse failed.
+int runPersistentLoop(
+  std::istream &is,
+  std::ostream &os,
+  PCACommandLineOptions const &options,
+  ClangAST &ast);
+
+
+#endif // PCA_PROCESS_TU_H
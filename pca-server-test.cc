@@ -0,0 +1,211 @@
+// pca-server-test.cc
+// Tests for `pca-server`.
+
+#include "pca-server.h"                // module under test
+
+#include "clang-ast.h"                 // ClangAST
+#include "file-util.h"                 // writeFile
+
+#include "smbase/sm-macros.h"          // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"            // EXPECT_EQ
+
+#include "llvm/Support/FileSystem.h"   // llvm::sys::fs::{create_directories, remove_directories}
+#include "llvm/Support/JSON.h"         // llvm::json
+
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::int64_t
+#include <sstream>                     // std::{istringstream, ostringstream}
+#include <string>                      // std::string
+
+using std::string;
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+void testParseServerRequest()
+{
+  ServerRequest request;
+  EXPECT_EQ(parseServerRequest(request,
+    R"({"id": "x", "command": ["a.cc", "-DX"],)"
+    R"( "options": ["--print-ast-nodes"]})"), "");
+  EXPECT_EQ(request.m_id.getAsString()->str(), "x");
+  EXPECT_EQ(request.m_fnameAndArgs.size(), (std::size_t)2);
+  EXPECT_EQ(request.m_fnameAndArgs[1], "-DX");
+  EXPECT_EQ(request.m_options.size(), (std::size_t)1);
+
+  EXPECT_EQ(parseServerRequest(request, R"({"command": ["a.cc"]})"), "");
+  EXPECT_EQ(request.m_id.kind() == llvm::json::Value::Null, true);
+  EXPECT_EQ(request.m_options.empty(), true);
+
+  EXPECT_EQ(parseServerRequest(request, "[1]"),
+            "request is not a JSON object");
+  EXPECT_EQ(parseServerRequest(request, R"({"options": []})"),
+            "request has no \"command\"");
+  EXPECT_EQ(parseServerRequest(request, R"({"command": "a.cc"})"),
+            "\"command\" is not an array");
+  EXPECT_EQ(parseServerRequest(request, R"({"command": [1]})"),
+            "\"command\" has an element that is not a string");
+  EXPECT_EQ(parseServerRequest(request, R"({"command": ["a"], "x": 1})"),
+            "unknown request member \"x\"");
+  EXPECT_EQ(parseServerRequest(request, "{").empty(), false);
+}
+
+
+void testCheckServerRequestOption()
+{
+  EXPECT_EQ(checkServerRequestOption("--print-ast-nodes"), "");
+  EXPECT_EQ(checkServerRequestOption("--jobs=4"), "");
+  EXPECT_EQ(checkServerRequestOption("--persistent"),
+            "--persistent cannot be used in a server request");
+  EXPECT_EQ(checkServerRequestOption("--split-output-dir=d"),
+            "--split-output-dir cannot be used in a server request");
+
+  // Options that write or read files besides the output.
+  EXPECT_EQ(checkServerRequestOption("--node-index-out=f"),
+            "--node-index-out cannot be used in a server request");
+  EXPECT_EQ(checkServerRequestOption("--node-fingerprints-out=f"),
+            "--node-fingerprints-out cannot be used in a server request");
+  EXPECT_EQ(checkServerRequestOption("--print-ast-nodes-binary=f"),
+            "--print-ast-nodes-binary cannot be used in a server request");
+  EXPECT_EQ(checkServerRequestOption("--node-diff-against=f"),
+            "--node-diff-against cannot be used in a server request");
+
+  // A name that only starts like an excluded one is allowed.
+  EXPECT_EQ(checkServerRequestOption("--node-index-outx=f"), "");
+}
+
+
+// Send 'line' to the server and return the parsed response.
+llvm::json::Object request(
+  PCACommandLineOptions const &options,
+  ParsedASTLRU &asts,
+  string const &line)
+{
+  std::ostringstream oss;
+  handleServerRequest(oss, options, asts, line);
+
+  string text = oss.str();
+  EXPECT_EQ(text.back(), '\n');
+
+  llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(text);
+  EXPECT_EQ((bool)parsed, true);
+  return *parsed->getAsObject();
+}
+
+
+void testRequests()
+{
+  string dir = "out/pca-server-test";
+  llvm::sys::fs::remove_directories(dir);
+  llvm::sys::fs::create_directories(dir);
+  string source = dir + "/a.cc";
+  EXPECT_EQ(writeFile(source,
+    "struct S {\n"
+    "  /// Comment.\n"
+    "  void f();\n"
+    "};\n"), "");
+
+  PCACommandLineOptions options;
+  ParsedASTLRU asts(0 /*maxSize*/);
+  string req = R"({"id": 7, "command": [")" + source + R"("],)"
+               R"( "options": ["--print-method-comments"]})";
+
+  // The first request parses.
+  llvm::json::Object first = request(options, asts, req);
+  EXPECT_EQ(*first.getInteger("id"), (std::int64_t)7);
+  EXPECT_EQ(*first.getInteger("status"), (std::int64_t)0);
+  EXPECT_EQ(*first.getBoolean("cached"), false);
+  string output = first.getString("output")->str();
+  EXPECT_EQ(output.find("Comment.") != string::npos, true);
+
+  // The second uses the same AST and gets the same output.
+  llvm::json::Object second = request(options, asts, req);
+  EXPECT_EQ(*second.getBoolean("cached"), true);
+  EXPECT_EQ(second.getString("output")->str(), output);
+  EXPECT_EQ(asts.size(), (std::size_t)1);
+
+  // Changing the file makes it parse again.
+  EXPECT_EQ(writeFile(source,
+    "struct S {\n"
+    "  /// Changed.\n"
+    "  void f();\n"
+    "};\n"), "");
+  llvm::json::Object third = request(options, asts, req);
+  EXPECT_EQ(*third.getBoolean("cached"), false);
+  EXPECT_EQ(third.getString("output")->str().find("Changed.") !=
+              string::npos, true);
+
+  // Errors are reported in the response.
+  llvm::json::Object bad = request(options, asts,
+    R"({"id": 8, "command": ["a.cc"], "options": ["--batch=x"]})");
+  EXPECT_EQ(*bad.getInteger("id"), (std::int64_t)8);
+  EXPECT_EQ(bad.getString("error")->str(),
+            "--batch cannot be used in a server request");
+  EXPECT_EQ(bad.get("output") == nullptr, true);
+
+  // With a budget too small for even one AST, only the most recent is
+  // kept.
+  asts.m_maxSize = 1;
+  request(options, asts,
+    R"({"command": [")" + source + R"(", "-DX"]})");
+  EXPECT_EQ(asts.size(), (std::size_t)1);
+  EXPECT_EQ(asts.m_evictions, 1u);
+  EXPECT_EQ(*request(options, asts, req).getBoolean("cached"), false);
+}
+
+
+void testEvictionReleasesContents()
+{
+  string dir = "out/pca-server-test";
+  llvm::sys::fs::create_directories(dir);
+  string big = dir + "/big.cc";
+  EXPECT_EQ(writeFile(big,
+                      "// " + string(100000, 'x') + "\nint big;\n"), "");
+  string small = dir + "/small.cc";
+  EXPECT_EQ(writeFile(small, "int small;\n"), "");
+
+  PCACommandLineOptions options;
+  ParsedASTLRU asts(0 /*maxSize*/);
+
+  // The contents of 'big' count toward the size while its AST is kept.
+  request(options, asts, R"({"command": [")" + big + R"("]})");
+  EXPECT_EQ(ClangAST::getSharedFileSystemContentsSize() > 100000, true);
+  EXPECT_EQ(asts.totalSize() > 100000, true);
+
+  // Evicting that AST lets go of them.
+  asts.m_maxSize = 1;
+  request(options, asts, R"({"command": [")" + small + R"("]})");
+  EXPECT_EQ(asts.m_evictions, 1u);
+  EXPECT_EQ(ClangAST::getSharedFileSystemContentsSize() < 100000, true);
+}
+
+
+void testRunServer()
+{
+  // Blank lines are skipped, and each request gets one line.
+  std::istringstream is("\n{}\n  \n[]\n");
+  std::ostringstream os;
+  PCACommandLineOptions options;
+  EXPECT_EQ(runServer(is, os, options), 0);
+  EXPECT_EQ(os.str(),
+    "{\"error\":\"request has no \\\"command\\\"\",\"id\":null}\n"
+    "{\"error\":\"request is not a JSON object\",\"id\":null}\n");
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void pca_server_unit_tests()
+{
+  testParseServerRequest();
+  testCheckServerRequestOption();
+  testRequests();
+  testEvictionReleasesContents();
+  testRunServer();
+}
+
+
+// EOF
@@ -0,0 +1,334 @@
+// pca-server.cc
+// Code for `pca-server.h`.
+
+#include "pca-server.h"                                    // this module
+
+#include "clang-util.h"                                    // GlobalClangUtilInstance
+#include "pca-process-tu.h"                                // parseTUWithOptions, processParsedTU
+
+#include "smbase/sm-trace.h"                               // INIT_TRACE
+#include "smbase/string-util.h"                            // doubleQuote
+#include "smbase/stringb.h"                                // stringb
+
+#include "llvm/Support/Error.h"                            // llvm::toString
+#include "llvm/Support/raw_ostream.h"                      // llvm::raw_string_ostream
+
+#include <exception>                                       // std::exception
+#include <iostream>                                        // std::{istream, ostream, getline}
+#include <sstream>                                         // std::ostringstream
+#include <utility>                                         // std::move
+
+using std::string;
+
+
+INIT_TRACE("pca-server");
+
+
+// Set 'dest' to the strings in the array member 'name' of 'obj'.  If
+// there is no such member, set it to empty.  Returns "" or an error
+// message.
+static string getStringArray(
+  std::vector<string> /*OUT*/ &dest,
+  llvm::json::Object const &obj,
+  char const *name)
+{
+  dest.clear();
+
+  llvm::json::Value const *value = obj.get(name);
+  if (!value) {
+    return "";
+  }
+
+  llvm::json::Array const *array = value->getAsArray();
+  if (!array) {
+    return stringb(doubleQuote(name) << " is not an array");
+  }
+
+  for (llvm::json::Value const &element : *array) {
+    auto str = element.getAsString();
+    if (!str) {
+      return stringb(doubleQuote(name) << " has an element that is not a "
+                     "string");
+    }
+    dest.push_back(str->str());
+  }
+  return "";
+}
+
+
+std::string parseServerRequest(
+  ServerRequest /*OUT*/ &request,
+  llvm::StringRef line)
+{
+  request = ServerRequest();
+
+  llvm::Expected<llvm::json::Value> parsed = llvm::json::parse(line);
+  if (!parsed) {
+    return "malformed request: " + llvm::toString(parsed.takeError());
+  }
+
+  llvm::json::Object const *obj = parsed->getAsObject();
+  if (!obj) {
+    return "request is not a JSON object";
+  }
+
+  for (auto const &member : *obj) {
+    llvm::StringRef key = member.first;
+    if (key == "id") {
+      request.m_id = member.second;
+    }
+    else if (key != "command" && key != "options") {
+      return stringb("unknown request member " << doubleQuote(key.str()));
+    }
+  }
+
+  string err = getStringArray(request.m_fnameAndArgs, *obj, "command");
+  if (err.empty() && request.m_fnameAndArgs.empty()) {
+    err = "request has no \"command\"";
+  }
+  if (err.empty()) {
+    err = getStringArray(request.m_options, *obj, "options");
+  }
+  return err;
+}
+
+
+std::string checkServerRequestOption(std::string const &option)
+{
+  // Use the def file to list the excluded options.
+  static char const * const excluded[] = {
+    #define BOOL_OPTION(fieldName, defaultValue, optionName, helpText)
+    #define INT_OPTION(fieldName, defaultValue, optionName, helpText)
+    #define STRING_OPTION(fieldName, defaultValue, optionName, helpText)
+    #define SERVER_EXCLUDED(optionName) optionName,
+    #include "pca-command-line-options.def"
+  };
+
+  string name = option.substr(0, option.find('='));
+  for (char const *ex : excluded) {
+    if (name == ex) {
+      return stringb(name << " cannot be used in a server request");
+    }
+  }
+  return "";
+}
+
+
+// ---------------------------- ParsedASTLRU ----------------------------
+ParsedASTLRU::ParsedASTLRU(std::uint64_t maxSize)
+  : m_entries(),
+    m_index(),
+    m_astsSize(0),
+    m_maxSize(maxSize),
+    m_evictions(0)
+{}
+
+
+ParsedASTLRU::~ParsedASTLRU()
+{}
+
+
+std::uint64_t ParsedASTLRU::totalSize() const
+{
+  return m_astsSize + ClangAST::getSharedFileSystemContentsSize();
+}
+
+
+ClangAST * NULLABLE ParsedASTLRU::find(Key const &key)
+{
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    return nullptr;
+  }
+  EntryList::iterator entry = it->second;
+
+  string changed = entry->m_inputs.empty()?
+    string("(unknown)") : findChangedASTInputFile(entry->m_inputs);
+  if (!changed.empty()) {
+    TRACE1("input changed: " << changed);
+    remove(key);
+    return nullptr;
+  }
+
+  // Move it to the front.  This does not invalidate 'entry'.
+  m_entries.splice(m_entries.begin(), m_entries, entry);
+  return entry->m_ast.get();
+}
+
+
+ClangAST *ParsedASTLRU::insert(Key const &key, std::unique_ptr<ClangAST> ast)
+{
+  remove(key);
+
+  Entry entry;
+  entry.m_key = key;
+  entry.m_ast = std::move(ast);
+  string err = hashASTInputFiles(entry.m_inputs, *entry.m_ast);
+  if (!err.empty()) {
+    TRACE1(err);
+    entry.m_inputs.clear();
+  }
+  entry.m_size = entry.m_ast->getMemoryUsage();
+  TRACE1("AST size: " << entry.m_size);
+
+  m_astsSize += entry.m_size;
+  m_entries.push_front(std::move(entry));
+  m_index[key] = m_entries.begin();
+  ClangAST *ret = m_entries.front().m_ast.get();
+
+  // Do not count files only read by parses whose ASTs are gone, such
+  // as failed ones.
+  ClangAST::releaseUnusedSharedFileSystemContents();
+
+  while (m_maxSize != 0 &&
+         totalSize() > m_maxSize &&
+         m_entries.size() > 1) {
+    Key victim = m_entries.back().m_key;
+    TRACE1("evicting: " << victim.front());
+    remove(victim);
+    ++m_evictions;
+  }
+
+  return ret;
+}
+
+
+void ParsedASTLRU::remove(Key const &key)
+{
+  auto it = m_index.find(key);
+  if (it == m_index.end()) {
+    return;
+  }
+
+  m_astsSize -= it->second->m_size;
+  m_entries.erase(it->second);
+  m_index.erase(it);
+
+  // Drop the contents of files that only the discarded AST used.
+  ClangAST::releaseUnusedSharedFileSystemContents();
+}
+
+
+// ------------------------------ Serving -------------------------------
+// Carry out 'request', adding the results to 'response'.  Returns "" or
+// an error message.
+static string serveRequest(
+  llvm::json::Object /*OUT*/ &response,
+  PCACommandLineOptions const &options,
+  ParsedASTLRU &asts,
+  ServerRequest const &request)
+{
+  PCACommandLineOptions requestOptions(options);
+  for (string const &option : request.m_options) {
+    string err = checkServerRequestOption(option);
+    if (!err.empty()) {
+      return err;
+    }
+    if (!requestOptions.processArgument(option)) {
+      return stringb("unrecognized option " << doubleQuote(option));
+    }
+  }
+
+  // See the changes made on disk since the last request, both to decide
+  // whether a parsed AST is still current and when parsing anew.
+  ClangAST::clearSharedFileSystemCache();
+
+  ClangAST *ast = asts.find(request.m_fnameAndArgs);
+  bool cached = (ast != nullptr);
+  if (cached) {
+    // Apply the options in the primary source file, as parsing would.
+    string err = requestOptions.parsePrimarySourceFile(
+      ast->m_primarySourceFileName);
+    if (!err.empty()) {
+      return err;
+    }
+  }
+  else {
+    std::unique_ptr<ClangAST> newAST(new ClangAST);
+    if (!parseTUWithOptions(*newAST, requestOptions,
+                            request.m_fnameAndArgs)) {
+      // The details went to stderr.
+      return "parse failed";
+    }
+    ast = asts.insert(request.m_fnameAndArgs, std::move(newAST));
+  }
+
+  std::ostringstream oss;
+  int status;
+  {
+    GlobalClangUtilInstance gcui(ast->getASTContext());
+    status = processParsedTU(oss, requestOptions, *ast);
+  }
+
+  string output = oss.str();
+  if (!llvm::json::isUTF8(output)) {
+    output = llvm::json::fixUTF8(output);
+  }
+
+  response["status"] = status;
+  response["cached"] = cached;
+  response["output"] = std::move(output);
+  return "";
+}
+
+
+void handleServerRequest(
+  std::ostream &os,
+  PCACommandLineOptions const &options,
+  ParsedASTLRU &asts,
+  std::string const &line)
+{
+  ServerRequest request;
+  llvm::json::Object response;
+
+  string err = parseServerRequest(request, line);
+  if (err.empty()) {
+    try {
+      err = serveRequest(response, options, asts, request);
+    }
+    catch (std::exception &x) {
+      // The server keeps going for the sake of other requests.
+      err = x.what();
+    }
+  }
+
+  if (!err.empty()) {
+    response = llvm::json::Object();
+    response["error"] = err;
+  }
+  response["id"] = request.m_id;
+
+  string text;
+  llvm::raw_string_ostream rso(text);
+  rso << llvm::json::Value(std::move(response));
+  rso.flush();
+  os << text << "\n";
+}
+
+
+int runServer(
+  std::istream &is,
+  std::ostream &os,
+  PCACommandLineOptions const &options)
+{
+  ParsedASTLRU asts(
+    static_cast<std::uint64_t>(options.m_serverMaxMemoryMB) << 20);
+
+  string line;
+  while (std::getline(is, line)) {
+    if (line.find_first_not_of(" \t\r") == string::npos) {
+      continue;
+    }
+
+    handleServerRequest(os, options, asts, line);
+    os.flush();
+
+    TRACE1("ASTs: " << asts.size() << ", size: " << asts.totalSize() <<
+           ", evictions: " << asts.m_evictions);
+  }
+
+  return 0;
+}
+
+
+// EOF
@@ -0,0 +1,169 @@
+// pca-server.h
+// Server mode: answer requests about TUs, keeping recent ASTs parsed.
+
+#ifndef PCA_SERVER_H
+#define PCA_SERVER_H
+
+#include "ast-cache.h"                           // ASTInputHashes
+#include "clang-ast.h"                           // ClangAST
+#include "pca-command-line-options.h"            // PCACommandLineOptions
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES, NULLABLE
+
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+#include "llvm/Support/JSON.h"                   // llvm::json::Value
+
+#include <cstddef>                               // std::size_t
+#include <cstdint>                               // std::uint64_t
+#include <iosfwd>                                // std::{istream, ostream}
+#include <list>                                  // std::list
+#include <map>                                   // std::map
+#include <memory>                                // std::unique_ptr
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+/*
+  The server reads requests, one JSON object per line, like:
+
+    {"id": 1,
+     "command": ["foo.cc", "-std=c++17"],
+     "options": ["--print-ast-nodes", "--suppress-addresses"]}
+
+  "command" is the primary source file name and compiler options, as
+  they would appear after the <pca-options> on the command line.
+  "options" are <pca-options> that apply to this request, in addition
+  to those given when the server was started.  "id" is optional and can
+  be any JSON value.
+
+  For each request it writes one line with a JSON object:
+
+    {"id": 1, "status": 0, "cached": true, "output": "..."}
+
+  "status" is what the exit code would have been, "cached" says whether
+  an already parsed AST was used, and "output" is what would have been
+  written to stdout.  If the request cannot be carried out, the object
+  instead has "error", a message.  Compiler diagnostics still go to
+  stderr.
+*/
+
+
+// One parsed request line.
+class ServerRequest {
+public:      // data
+  // The "id", or null if there was none.
+  llvm::json::Value m_id = nullptr;
+
+  // The "command".
+  std::vector<std::string> m_fnameAndArgs;
+
+  // The "options".
+  std::vector<std::string> m_options;
+};
+
+// Parse 'line' into 'request'.  Returns "" or an error message.
+std::string parseServerRequest(
+  ServerRequest /*OUT*/ &request,
+  llvm::StringRef line);
+
+// Return "" if 'option' may be used in a request's "options", or an
+// error message if not.  The excluded options are those marked with
+// SERVER_EXCLUDED in pca-command-line-options.def.
+std::string checkServerRequestOption(std::string const &option);
+
+
+// Parsed ASTs, keyed by command, that are discarded least recently used
+// first when their estimated size exceeds a budget.  The file contents
+// the ASTs were parsed from, which the shared file system holds, count
+// toward the budget, and those no remaining AST uses are released as
+// entries are added and discarded.
+class ParsedASTLRU {
+  NO_OBJECT_COPIES(ParsedASTLRU);
+
+public:      // types
+  typedef std::vector<std::string> Key;
+
+private:     // types
+  struct Entry {
+    // The command that was parsed.
+    Key m_key;
+
+    // The AST.
+    std::unique_ptr<ClangAST> m_ast;
+
+    // The files it was made from.  This is empty if they could not all
+    // be read, in which case the entry is never reused.
+    ASTInputHashes m_inputs;
+
+    // Estimated size in bytes.
+    std::uint64_t m_size;
+  };
+
+  typedef std::list<Entry> EntryList;
+
+private:     // data
+  // Entries, most recently used first.
+  EntryList m_entries;
+
+  // Map from key to entry.
+  std::map<Key, EntryList::iterator> m_index;
+
+  // Sum of the entries' `m_size`.
+  std::uint64_t m_astsSize;
+
+public:      // data
+  // Budget in bytes.  The most recently used AST is kept even if it is
+  // larger than this by itself.  0 means no limit.
+  std::uint64_t m_maxSize;
+
+  // Number of entries discarded to stay within 'm_maxSize'.
+  unsigned m_evictions;
+
+public:      // methods
+  explicit ParsedASTLRU(std::uint64_t maxSize);
+  ~ParsedASTLRU();
+
+  // Number of entries.
+  std::size_t size() const { return m_entries.size(); }
+
+  // Estimated size of all of them, including the file contents held
+  // by the shared file system.
+  std::uint64_t totalSize() const;
+
+  // If there is an AST for 'key' and none of its input files have
+  // changed, mark it most recently used and return it.  If there is one
+  // but its inputs have changed, discard it.  Otherwise return nullptr.
+  ClangAST * NULLABLE find(Key const &key);
+
+  // Add 'ast', which has been parsed from 'key', replacing any AST
+  // already there, and evict others as needed.  Return 'ast'.
+  ClangAST *insert(Key const &key, std::unique_ptr<ClangAST> ast);
+
+  // Discard the entry for 'key' if there is one.
+  void remove(Key const &key);
+};
+
+
+// Carry out the request in 'line', which asks about a TU to be
+// processed with 'options' plus the request's own options, writing the
+// response line to 'os'.  'asts' holds the ASTs parsed so far.
+void handleServerRequest(
+  std::ostream &os,
+  PCACommandLineOptions const &options,
+  ParsedASTLRU &asts,
+  std::string const &line);
+
+// Implement --server: call `handleServerRequest` for each non-blank
+// line of 'is', flushing 'os' after each response, until EOF.
+// Returns 0.
+int runServer(
+  std::istream &is,
+  std::ostream &os,
+  PCACommandLineOptions const &options);
+
+
+// Unit tests, defined in pca-server-test.cc.
+void pca_server_unit_tests();
+
+
+#endif // PCA_SERVER_H
@@ -3,24 +3,58 @@
 
 #include "pca-unit-tests.h"            // this module
 
+#include "ast-cache.h"                 // ast_cache_unit_tests
+#include "caching-file-system.h"       // caching_file_system_unit_tests
 #include "clang-util.h"                // clang_util_unit_tests
+#include "compressed-output.h"         // compressed_output_unit_tests
 #include "file-util.h"                 // file_util_unit_tests
+#include "json-stream-writer.h"        // json_stream_writer_unit_tests
+#include "node-binary-dump.h"          // node_binary_dump_unit_tests
+#include "node-offset-index.h"         // node_offset_index_unit_tests
+#include "node-query.h"                // node_query_unit_tests
+#include "node-record-diff.h"          // node_record_diff_unit_tests
+#include "pca-batch.h"                 // pca_batch_unit_tests
 #include "pca-command-line-options.h"  // pca_command_line_options_unit_tests
+#include "pca-server.h"                // pca_server_unit_tests
 #include "pca-util.h"                  // pca_util_unit_tests
+#include "pointer-hash-index.h"        // pointer_hash_index_unit_tests
+#include "source-location-cache.h"     // source_location_cache_unit_tests
+#include "source-token-index.h"        // source_token_index_unit_tests
 #include "stringref-parse.h"           // stringref_parse_unit_tests
 #include "symbolic-line-mapper.h"      // symbolic_line_mapper_unit_tests
 
 
+void clang_ast_visitor_fanout_unit_tests();      // clang-ast-visitor-fanout-test.cc
 void clang_ast_visitor_nc_unit_tests();          // clang-ast-visitor-nc.test.cc
+void clang_ast_visitor_parallel_unit_tests();    // clang-ast-visitor-parallel-test.cc
+void clang_ast_visitor_t_unit_tests();           // clang-ast-visitor-t-test.cc
+void decl_file_filter_unit_tests();              // decl-file-filter-test.cc
 
 
 void pca_unit_tests()
 {
+  ast_cache_unit_tests();
+  caching_file_system_unit_tests();
   clang_util_unit_tests();
+  clang_ast_visitor_fanout_unit_tests();
   clang_ast_visitor_nc_unit_tests();
+  clang_ast_visitor_parallel_unit_tests();
+  clang_ast_visitor_t_unit_tests();
+  compressed_output_unit_tests();
+  decl_file_filter_unit_tests();
   file_util_unit_tests();
+  json_stream_writer_unit_tests();
+  node_binary_dump_unit_tests();
+  node_offset_index_unit_tests();
+  node_query_unit_tests();
+  node_record_diff_unit_tests();
+  pca_batch_unit_tests();
   pca_command_line_options_unit_tests();
+  pca_server_unit_tests();
   pca_util_unit_tests();
+  pointer_hash_index_unit_tests();
+  source_location_cache_unit_tests();
+  source_token_index_unit_tests();
   stringref_parse_unit_tests();
   symbolic_line_mapper_unit_tests();
 }
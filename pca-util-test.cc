@@ -13,6 +13,10 @@
 // libc
 #include <assert.h>                    // assert
 
+#if PCA_HAVE_FORK
+  #include <unistd.h>                  // pipe, close
+#endif
+
 
 using std::cerr;
 using std::string;
@@ -314,6 +318,25 @@ static void test_joinWithPrefixes()
 }
 
 
+#if PCA_HAVE_FORK
+static void test_readWriteAllFD()
+{
+  int fds[2];
+  assert(::pipe(fds) == 0);
+
+  string text = "hello\n";
+  assert(writeAllToFD(fds[1], text.data(), text.size()));
+  ::close(fds[1]);
+
+  string dest = "prefix:";
+  assert(readAllFromFD(dest, fds[0]));
+  ::close(fds[0]);
+
+  assert(dest == "prefix:hello\n");
+}
+#endif // PCA_HAVE_FORK
+
+
 void pca_util_unit_tests()
 {
   test_trimWhitespace();
@@ -326,6 +349,9 @@ void pca_util_unit_tests()
   test_trimCCommentText();
   test_addIndentation();
   test_joinWithPrefixes();
+#if PCA_HAVE_FORK
+  test_readWriteAllFD();
+#endif
 }
 
 
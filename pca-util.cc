@@ -12,6 +12,11 @@
 #include <iostream>                    // std::{cerr, endl}
 
 #include <assert.h>                    // assert
+#include <errno.h>                     // errno, EINTR
+
+#if PCA_HAVE_FORK
+  #include <unistd.h>                  // read, write
+#endif
 
 using std::string;
 
@@ -355,4 +360,42 @@ string bracesSetIfMultiple(std::set<string> const &strings)
 }
 
 
+#if PCA_HAVE_FORK
+bool writeAllToFD(int fd, char const *data, std::size_t len)
+{
+  while (len > 0) {
+    ssize_t n = ::write(fd, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+
+bool readAllFromFD(std::string /*IN/OUT*/ &dest, int fd)
+{
+  char buf[4096];
+  while (true) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      return true;
+    }
+    dest.append(buf, n);
+  }
+}
+#endif // PCA_HAVE_FORK
+
+
 // EOF
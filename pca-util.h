@@ -144,6 +144,26 @@ T &assertDeref(T *p)
 }
 
 
+// True if the platform has POSIX 'fork', which is used to do work in
+// parallel child processes.
+#if defined(__unix__) || defined(__APPLE__)
+  #define PCA_HAVE_FORK 1
+#else
+  #define PCA_HAVE_FORK 0
+#endif
+
+
+#if PCA_HAVE_FORK
+// Write all 'len' bytes at 'data' to file descriptor 'fd', retrying
+// after partial writes and interruptions.  Return false on error.
+bool writeAllToFD(int fd, char const *data, std::size_t len);
+
+// Read from 'fd' until end of file, appending to 'dest'.  Return false
+// on error.
+bool readAllFromFD(std::string /*IN/OUT*/ &dest, int fd);
+#endif // PCA_HAVE_FORK
+
+
 // Unit tests, defined in pca-util-test.cc.  Aborts on failure.
 void pca_util_unit_tests();
 
@@ -0,0 +1,91 @@
+// pointer-hash-index-test.cc
+// Tests for `pointer-hash-index`.
+
+#include "pointer-hash-index.h"        // module under test
+
+#include "smbase/sm-macros.h"          // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"            // EXPECT_EQ
+
+#include <cstddef>                     // std::size_t
+#include <map>                         // std::map
+#include <vector>                      // std::vector
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+void testEmpty()
+{
+  PointerHashIndex<int, int> index;
+  EXPECT_EQ(index.size(), (std::size_t)0);
+  EXPECT_EQ(index.empty(), true);
+
+  int x = 0;
+  EXPECT_EQ(index.find(&x) == nullptr, true);
+  EXPECT_EQ(index.contains(&x), false);
+}
+
+
+void testInsertFind()
+{
+  PointerHashIndex<int, int> index;
+
+  int a = 0, b = 0;
+  EXPECT_EQ(index.insert(&a, 1), true);
+  EXPECT_EQ(index.insert(&b, 2), true);
+
+  // Re-inserting does not replace the value.
+  EXPECT_EQ(index.insert(&a, 3), false);
+
+  EXPECT_EQ(index.size(), (std::size_t)2);
+  EXPECT_EQ(*index.find(&a), 1);
+  EXPECT_EQ(*index.find(&b), 2);
+
+  index.clear();
+  EXPECT_EQ(index.empty(), true);
+  EXPECT_EQ(index.contains(&a), false);
+}
+
+
+// Insert enough entries to force several rehashes, and compare against
+// `std::map` as the reference.
+void testManyEntries()
+{
+  std::vector<long> storage(10000);
+
+  PointerHashIndex<long, std::size_t> index;
+  std::map<long const *, std::size_t> reference;
+
+  for (std::size_t i=0; i < storage.size(); i += 2) {
+    index.insertUnique(&storage[i], i);
+    reference[&storage[i]] = i;
+  }
+
+  EXPECT_EQ(index.size(), reference.size());
+
+  for (std::size_t i=0; i < storage.size(); ++i) {
+    std::size_t const *actual = index.find(&storage[i]);
+    if (i % 2 == 0) {
+      EXPECT_EQ(actual != nullptr, true);
+      EXPECT_EQ(*actual, reference.at(&storage[i]));
+    }
+    else {
+      EXPECT_EQ(actual == nullptr, true);
+    }
+  }
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void pointer_hash_index_unit_tests()
+{
+  testEmpty();
+  testInsertFind();
+  testManyEntries();
+}
+
+
+// EOF
@@ -0,0 +1,196 @@
+// pointer-hash-index.h
+// `PointerHashIndex`, an open-addressing hash table keyed by pointer.
+
+#ifndef PCA_POINTER_HASH_INDEX_H
+#define PCA_POINTER_HASH_INDEX_H
+
+#include "smbase/sm-macros.h"          // NULLABLE
+
+#include <cassert>                     // assert
+#include <cstddef>                     // std::size_t
+#include <cstdint>                     // std::uintptr_t
+#include <vector>                      // std::vector
+
+
+/*
+  Map from `K const *` to `V`, using open addressing with linear
+  probing in a single contiguous array.
+
+  This exists because `std::map` (and, to a lesser extent,
+  `std::unordered_map`) allocates one heap node per entry, and when
+  numbering millions of AST nodes that allocation, plus the pointer
+  chasing during lookup, dominates the cost.  Here, an insertion is
+  amortized O(1) with no per-entry allocation, and a lookup is usually
+  one or two adjacent cache lines.
+
+  Restrictions that make the implementation simple:
+
+  * The null pointer cannot be used as a key; it marks an empty slot.
+
+  * Entries cannot be removed.
+
+  * `V` must be default-constructible and cheap to copy.
+
+  Iteration order is unspecified, so clients that need a deterministic
+  order must arrange for it separately (the numbering, for example,
+  orders by assigned ID, not by table position).
+*/
+template <class K, class V>
+class PointerHashIndex {
+private:     // types
+  // One slot in the table.
+  struct Entry {
+    // Key, or nullptr if the slot is empty.
+    K const * NULLABLE m_key;
+
+    // Associated value, meaningful only when `m_key` is not null.
+    V m_value;
+
+    Entry()
+      : m_key(nullptr),
+        m_value()
+    {}
+  };
+
+private:     // data
+  // Slots.  The size is always zero or a power of two.
+  std::vector<Entry> m_table;
+
+  // Number of occupied slots.
+  std::size_t m_size;
+
+private:     // methods
+  // Map `key` to its preferred slot index.  Requires a non-empty table.
+  std::size_t homeSlot(K const *key) const
+  {
+    // Node pointers are at least 8-byte aligned, so the low bits carry
+    // no information.  Fibonacci hashing then spreads what remains
+    // across the whole word before masking.
+    std::uintptr_t bits = reinterpret_cast<std::uintptr_t>(key) >> 3;
+    bits *= static_cast<std::uintptr_t>(0x9E3779B97F4A7C15ull);
+    return static_cast<std::size_t>(bits >> 16) & (m_table.size() - 1);
+  }
+
+  // Return the slot holding `key`, or the empty slot where it would be
+  // inserted.  Requires a non-empty table with at least one empty slot.
+  Entry &findSlot(K const *key)
+  {
+    std::size_t mask = m_table.size() - 1;
+    for (std::size_t i = homeSlot(key); ; i = (i+1) & mask) {
+      Entry &e = m_table[i];
+      if (e.m_key == key || e.m_key == nullptr) {
+        return e;
+      }
+    }
+  }
+
+  Entry const &findSlot(K const *key) const
+  {
+    return const_cast<PointerHashIndex*>(this)->findSlot(key);
+  }
+
+  // Replace the table with one having `newCapacity` slots, re-inserting
+  // all existing entries.
+  void rehash(std::size_t newCapacity)
+  {
+    std::vector<Entry> oldTable;
+    oldTable.swap(m_table);
+    m_table.resize(newCapacity);
+
+    for (Entry const &e : oldTable) {
+      if (e.m_key) {
+        findSlot(e.m_key) = e;
+      }
+    }
+  }
+
+public:      // methods
+  PointerHashIndex()
+    : m_table(),
+      m_size(0)
+  {}
+
+  // Number of entries.
+  std::size_t size() const
+  {
+    return m_size;
+  }
+
+  bool empty() const
+  {
+    return m_size == 0;
+  }
+
+  // Ensure that `n` entries can be held without rehashing.
+  void reserve(std::size_t n)
+  {
+    // Keep the load factor at or below 1/2 so probe sequences stay
+    // short even with clustered pointer values.
+    std::size_t needed = 16;
+    while (needed < n*2) {
+      needed *= 2;
+    }
+    if (needed > m_table.size()) {
+      rehash(needed);
+    }
+  }
+
+  // Return a pointer to the value associated with `key`, or nullptr if
+  // there is none.  The pointer is invalidated by the next insertion.
+  V const * NULLABLE find(K const *key) const
+  {
+    assert(key);
+    if (m_table.empty()) {
+      return nullptr;
+    }
+
+    Entry const &e = findSlot(key);
+    return e.m_key? &e.m_value : nullptr;
+  }
+
+  // True if `key` is present.
+  bool contains(K const *key) const
+  {
+    return find(key) != nullptr;
+  }
+
+  // Insert `key -> value` if `key` is not already present, returning
+  // true.  Otherwise, leave the existing value alone and return false.
+  bool insert(K const *key, V const &value)
+  {
+    assert(key);
+    reserve(m_size + 1);
+
+    Entry &e = findSlot(key);
+    if (e.m_key) {
+      return false;
+    }
+
+    e.m_key = key;
+    e.m_value = value;
+    ++m_size;
+    return true;
+  }
+
+  // Insert `key -> value`, asserting that `key` was not already present.
+  void insertUnique(K const *key, V const &value)
+  {
+    bool inserted = insert(key, value);
+    assert(inserted);
+    (void)inserted;
+  }
+
+  // Remove all entries and release the table.
+  void clear()
+  {
+    std::vector<Entry>().swap(m_table);
+    m_size = 0;
+  }
+};
+
+
+// Unit tests, defined in pointer-hash-index-test.cc.
+void pointer_hash_index_unit_tests();
+
+
+#endif // PCA_POINTER_HASH_INDEX_H
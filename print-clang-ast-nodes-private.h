@@ -7,7 +7,19 @@
 #include "print-clang-ast-nodes.h"               // public decls for this module
 
 #include "clang-util.h"                          // ClangUtil
+#include "decl-file-filter.h"                    // DeclFileFilter
+#include "json-stream-writer.h"                  // JSONStreamWriter
 #include "number-clang-ast-nodes.h"              // ClangASTNodeNumbering
+#include "source-token-index.h"                  // SourceTokenIndex
+
+#include "llvm/ADT/DenseMap.h"                   // llvm::DenseMap
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <map>                                   // std::map
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+#include <stdint.h>                              // uint64_t
 
 
 /*
@@ -43,7 +55,12 @@ public:      // types
   typedef ClangASTNodeNumbering::NodeID NodeID;
 
 public:      // data
-  // Stream to write output to.
+  // Buffer for the output, which it passes on to the stream given to
+  // the constructor.
+  JSONStreamWriter m_writer;
+
+  // Stream that writes into 'm_writer'.  Flushing this flushes the
+  // writer.
   std::ostream &m_os;
 
   // Printing options.
@@ -76,6 +93,43 @@ public:      // data
   // True if there is an open object in the output produced so far.
   bool m_objectIsOpen;
 
+  // If not null, each object written gets a line here saying where it
+  // is in the output; see node-offset-index.h.  The offsets are those
+  // of 'm_writer', plus 'm_nodeIndexBase'.
+  std::ostream * NULLABLE m_nodeIndexOS;
+  uint64_t m_nodeIndexBase;
+
+  // If not null, each object written is passed here as a `NodeRecord`.
+  NodeRecordSink * NULLABLE m_recordSink;
+
+  // When 'm_objectIsOpen' and 'm_nodeIndexOS' or 'm_recordSink', the
+  // ID of the open object and the 'm_writer' offsets of its opening
+  // line and of the line after it.
+  std::string m_openObjectID;
+  uint64_t m_openObjectOffset;
+  uint64_t m_openObjectBodyOffset;
+
+  // When true, this printer is only being used to discover all of the
+  // reachable nodes (see 'printClangASTNodes' with 'm_jobs > 1'), and
+  // its output is discarded.  Then, the attribute printers only number
+  // the nodes that attributes refer to, and skip all formatting.
+  bool m_discoveryOnly;
+
+  // Map from `QualType::getAsOpaquePtr()` to `qualTypePreview`.
+  llvm::DenseMap<void *, llvm::StringRef> m_qualTypePreviews;
+
+  // Decides which declarations are outside the files whose entities we
+  // print.  Unused if 'm_config.m_printNonPSFFileEntities'.
+  DeclFileFilter m_declFileFilter;
+
+  // When 'm_config.querying()', the reference depth of each node,
+  // indexed by ID: 0 for those numbered before printing began, and
+  // otherwise one more than the node whose printing numbered it.
+  std::vector<int> m_nodeDepths;
+
+  // The tokens of the files, for looking beyond what the AST records.
+  SourceTokenIndex m_tokenIndex;
+
 public:      // methods
   PrintClangASTNodes(std::ostream &os,
                      clang::ASTContext &astContext,
@@ -85,7 +139,7 @@ public:      // methods
   ~PrintClangASTNodes();
 
   // Write the opening of a new output object.
-  void openNewObject(std::string const &id);
+  void openNewObject(llvm::StringRef id);
 
   // Print the closing-brace of an object, if one is open.
   void closeOpenObjectIf();
@@ -104,7 +158,7 @@ public:      // methods
   // numbering if needed.  The method here just delegates to
   // 'm_numbering'.
   #define DEFINE_GET_IDSTR_METHODS(NodeType)               \
-    std::string get##NodeType##IDStr(                      \
+    llvm::StringRef get##NodeType##IDStr(                  \
       clang::NodeType const * NULLABLE node)               \
         { return m_numbering.get##NodeType##IDStr(node); }
 
@@ -200,15 +254,28 @@ public:      // methods
   //
   // This double-quotes and escapes 'ptrVal' and 'previewVal', so they
   // should not already be quoted/escaped.
-  std::string ptrAndPreview(std::string const &ptrVal,
-                            std::string const &previewVal);
+  std::string ptrAndPreview(llvm::StringRef ptrVal,
+                            llvm::StringRef previewVal);
+
+  // Write the same thing as 'ptrAndPreview' to 'm_writer'.
+  void writePtrAndPreview(llvm::StringRef ptrVal,
+                          llvm::StringRef previewVal);
+
+  // Return the syntax of 'qualType', as printed in a preview.  It is
+  // computed once per distinct 'qualType' and then kept in
+  // 'm_numbering', since popular types are referenced many times.
+  llvm::StringRef qualTypePreview(clang::QualType qualType);
 
   // Get JSON for pointer to 'type' along with a preview of its syntax.
   std::string typeIDSyntaxJson(clang::Type const * NULLABLE type);
   std::string qualTypeIDSyntaxJson(clang::QualType qualType);
 
-  // Get ptr/preview for 'nns'.
-  std::string nestedNameSpecifierIDSyntaxJson(
+  // Write the same things to 'm_writer'.
+  void writeTypeIDSyntax(clang::Type const * NULLABLE type);
+  void writeQualTypeIDSyntax(clang::QualType qualType);
+
+  // Write ptr/preview for 'nns' to 'm_writer'.
+  void writeNestedNameSpecifierIDSyntax(
     clang::NestedNameSpecifier const * NULLABLE nns);
 
   // Search forward in the source code for the next token, starting at
@@ -220,7 +287,7 @@ public:      // methods
   // Note: This doesn't really work if there are preprocessor
   // directives, although it does skip comments.
   std::string getNextToken(
-    clang::SourceLocation /*IN/OUT*/ &loc) const;
+    clang::SourceLocation /*IN/OUT*/ &loc);
 
   // Attempt to search forward to the end of the "=delete" that we have
   // already determined should be there.  Returns an invalid location if
@@ -258,11 +325,23 @@ public:      // methods
   // Print the details of 'type'.
   void printType(clang::Type const *type);
 
+  // Print the record for a node that is beyond the query depth.
+  void printBeyondQueryDepth(ClangASTNodeNumbering::NodeEntry entry);
+
+  // Print the node with 'id', which must already be numbered.
+  void printNode(NodeID id);
+
   // Print all the nodes that have been collected into the maps.  As
   // they are printed, new nodes will be added, so print those too,
   // until everything reachable has been printed.
   void printAllNodes();
 
+  // Print the nodes with IDs in [beginID,endID), closing the last
+  // object, but without the enclosing braces that 'printAllNodes'
+  // adds.  This is meant to be used after the numbering is complete,
+  // so that printing does not discover new nodes.
+  void printNodeRange(NodeID beginID, NodeID endID);
+
   // Print the 'Redeclarable' fields.
   template <class T>
   void printRedeclarable(clang::Redeclarable<T> const *decl);
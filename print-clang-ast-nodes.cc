@@ -6,11 +6,13 @@
 // this dir
 #include "enum-util.h"                           // ENUM_TABLE_LOOKUP
 #include "expose-template-common.h"              // clang::FunctionTemplateDecl_Common
+#include "node-offset-index.h"                   // writeNodeOffsetIndexLine, etc.
+#include "node-query.h"                          // findNodeQueryDecls
 #include "spy-private.h"                         // ACCESS_PRIVATE_FIELD
-#include "pca-util.h"                            // stringb
+#include "pca-util.h"                            // PCA_HAVE_FORK
 
 // smbase
-#include "smbase/map-util.h"                     // mapFindOpt
+#include "smbase/exc.h"                          // smbase::xmessage
 #include "smbase/optional-util.h"                // optionalToString
 #include "smbase/sm-trace.h"                     // INIT_TRACE
 #include "smbase/string-util.h"                  // doubleQuote
@@ -21,24 +23,38 @@
 #include "clang/AST/DeclFriend.h"                // clang::FriendDecl
 #include "clang/AST/ExprCXX.h"                   // clang::CXXDependentScopeMemberExpr
 #include "clang/Basic/Version.h"                 // CLANG_VERSION_MAJOR
-#include "clang/Lex/Lexer.h"                     // clang::Lexer
 
 // llvm
 #include "llvm/Support/raw_os_ostream.h"         // llvm::raw_os_ostream
 #include "llvm/Support/raw_ostream.h"            // llvm::raw_string_ostream
 
 // libc++
+#include <algorithm>                             // std::{min, max}
+#include <cstring>                               // std::memcpy
+#include <exception>                             // std::exception
 #include <iterator>                              // std::distance
 #include <iostream>                              // std::ostream
+#include <optional>                              // std::optional
+#include <sstream>                               // std::ostringstream
 #include <string>                                // std::string
+#include <vector>                                // std::vector
 
 // libc
 #include <assert.h>                              // assert
+#include <errno.h>                               // errno, EINTR
+#include <stdint.h>                              // int64_t
+
+#if PCA_HAVE_FORK
+  #include <sys/wait.h>                          // waitpid
+  #include <unistd.h>                            // fork, pipe, read, write, close, _exit
+#endif
 
 
 using clang::isa;
 using clang::dyn_cast;
 
+using smbase::xmessage;
+
 using std::string;
 
 
@@ -74,17 +90,6 @@ INIT_TRACE("print-clang-ast-nodes");
   }
 
 
-// Return JSON for an object with one key and value.
-static std::string jsonObject1(
-  std::string const &key1,
-  std::string const &jsonValue1)
-{
-  return stringb("{ " <<
-           doubleQuote(key1) << ": " << jsonValue1 <<
-         " }");
-}
-
-
 // Return JSON for an object with two keys and values.
 static std::string jsonObject2(
   std::string const &key1,
@@ -99,26 +104,93 @@ static std::string jsonObject2(
 }
 
 
+// The attribute printers below write directly into 'm_writer', using
+// its scratch buffer for values that need to be formatted and then
+// quoted, so they do not create temporary strings of their own.
+//
+// In a discovery pass ('m_discoveryOnly'), they do nothing except
+// number the nodes an attribute refers to.  In particular, the value
+// given to OUT_QATTR_JSON or OUT_QATTR_STRING is not evaluated then,
+// so a reference to a node must be printed with OUT_QATTR_PTR or one
+// of the other printers that take the node itself.
+
+// Print the indentation, quoted key, and separator of an attribute.
+#define OUT_QATTR_KEY(qualifier, key) do {      \
+  m_writer.write("  ");                         \
+  std::size_t keyMark = m_writer.scratchMark(); \
+  if (m_config.m_printQualifiers) {             \
+    m_writer.scratch() << qualifier;            \
+  }                                             \
+  m_writer.scratch() << key;                    \
+  m_writer.writeQuotedScratch(keyMark);         \
+  m_writer.write(": ");                         \
+} while (0)
+
+// Print the terminator of an attribute.
+#define OUT_ATTR_END() \
+  m_writer.write(",\n")
+
 // Print an attribute that has a value already expressed as JSON.
-#define OUT_QATTR_JSON(qualifier, key, json)      \
-  m_os << "  " << doubleQuote(stringb(ifLongForm( \
-                    stringb(qualifier)) << key))  \
-       << ": " << json << ",\n" /* user ; */
+#define OUT_QATTR_JSON(qualifier, key, json) do { \
+  if (!m_discoveryOnly) {                         \
+    OUT_QATTR_KEY(qualifier, key);                \
+    m_os << json;                                 \
+    OUT_ATTR_END();                               \
+  }                                               \
+} while (0)
+
+// Print an attribute whose value is the string formed by streaming
+// 'value', optionally with surrounding whitespace removed.
+#define OUT_QATTR_STRING_TRIM(qualifier, key, value, trim) do { \
+  if (!m_discoveryOnly) {                                       \
+    OUT_QATTR_KEY(qualifier, key);                              \
+    std::size_t valueMark = m_writer.scratchMark();             \
+    m_writer.scratch() << value;                                \
+    m_writer.writeQuotedScratch(valueMark, trim);               \
+    OUT_ATTR_END();                                             \
+  }                                                             \
+} while (0)
 
 // Print an attribute that has a string value.
-#define OUT_QATTR_STRING(qualifier, key, value)               \
-  OUT_QATTR_JSON(qualifier, key, doubleQuote(stringb(value)))
+#define OUT_QATTR_STRING(qualifier, key, value) \
+  OUT_QATTR_STRING_TRIM(qualifier, key, value, false)
 
 // Print an attribute that has a pointer value.
 //
 // TODO: There are many of these that should instead be using
 // OUT_QATTR_STMT or OUT_QATTR_DECL.
-#define OUT_QATTR_PTR(qualifier, key, id)                             \
-  OUT_QATTR_JSON(qualifier, key, jsonObject1("ptr", doubleQuote(id)))
+#define OUT_QATTR_PTR(qualifier, key, id) do { \
+  auto const &idValue = (id);                  \
+  if (!m_discoveryOnly) {                      \
+    OUT_QATTR_KEY(qualifier, key);             \
+    m_writer.write("{ \"ptr\": ");             \
+    m_writer.writeQuoted(idValue);             \
+    m_writer.write(" }");                      \
+    OUT_ATTR_END();                            \
+  }                                            \
+} while (0)
 
 // Print an attribute that is a pointer to a Type.
-#define OUT_QATTR_TYPE(qualifier, key, type) \
-  OUT_QATTR_JSON(qualifier, key, typeIDSyntaxJson(type))
+#define OUT_QATTR_TYPE(qualifier, key, type) do { \
+  if (!m_discoveryOnly) {                         \
+    OUT_QATTR_KEY(qualifier, key);                \
+  }                                               \
+  writeTypeIDSyntax(type);                        \
+  if (!m_discoveryOnly) {                         \
+    OUT_ATTR_END();                               \
+  }                                               \
+} while (0)
+
+// Print an attribute that is a pointer to a NestedNameSpecifier.
+#define OUT_QATTR_NNS(qualifier, key, nns) do { \
+  if (!m_discoveryOnly) {                       \
+    OUT_QATTR_KEY(qualifier, key);              \
+  }                                             \
+  writeNestedNameSpecifierIDSyntax(nns);        \
+  if (!m_discoveryOnly) {                       \
+    OUT_ATTR_END();                             \
+  }                                             \
+} while (0)
 
 // Print an attribute that is a pointer to a statement.
 #define OUT_QATTR_STMT(qualifier, key, stmt) \
@@ -145,8 +217,15 @@ static std::string jsonObject2(
   OUT_QATTR_STRING(qualifier, key, locStr(loc))
 
 // Print an attribute that is a QualType.
-#define OUT_QATTR_QUALTYPE(qualifier, key, qt)             \
-  OUT_QATTR_JSON(qualifier, key, qualTypeIDSyntaxJson(qt))
+#define OUT_QATTR_QUALTYPE(qualifier, key, qt) do { \
+  if (!m_discoveryOnly) {                           \
+    OUT_QATTR_KEY(qualifier, key);                  \
+  }                                                 \
+  writeQualTypeIDSyntax(qt);                        \
+  if (!m_discoveryOnly) {                           \
+    OUT_ATTR_END();                                 \
+  }                                                 \
+} while (0)
 
 // Print an attribute that is a `TypeSourceInfo`.
 #define OUT_QATTR_TYPE_SOURCE_INFO(qualifier, key, tsi) \
@@ -158,10 +237,10 @@ static std::string jsonObject2(
   OUT_QATTR_STRING(qualifier, key, "TODO")
 
 // Print an attribute whose value is a bit set, expressed as a
-// space-prefixed sequence of words.  'trimWhitespace' removes the
-// leading space when the value is not empty.
+// space-prefixed sequence of words.  Trimming removes the leading
+// space when the value is not empty.
 #define OUT_QATTR_BITSET(qualifier, key, value) \
-  OUT_QATTR_STRING(qualifier, key, trimWhitespace(stringb(value)))
+  OUT_QATTR_STRING_TRIM(qualifier, key, value, true)
 
 
 // Variants that do not take a qualifier parameter, and instead use an
@@ -170,6 +249,7 @@ static std::string jsonObject2(
 #define OUT_ATTR_STRING(key, value) OUT_QATTR_STRING("", key, value)
 #define OUT_ATTR_PTR(key, id)       OUT_QATTR_PTR("", key, id)
 #define OUT_ATTR_TYPE(key, type)    OUT_QATTR_TYPE("", key, type)
+#define OUT_ATTR_NNS(key, nns)      OUT_QATTR_NNS("", key, nns)
 #define OUT_ATTR_STMT(key, stmt)    OUT_QATTR_STMT("", key, stmt)
 #define OUT_ATTR_DECL(key, decl)    OUT_QATTR_DECL("", key, decl)
 #define OUT_ATTR_INT(key, value)    OUT_QATTR_INT("", key, value)
@@ -195,14 +275,26 @@ PrintClangASTNodes::PrintClangASTNodes(
   ClangASTNodeNumbering &numbering)
 
   : ClangUtil(astContext),
-    m_os(os),
+    m_writer(os),
+    m_os(m_writer.out()),
     m_config(config),
     m_numbering(numbering),
     m_mapCommonToFunctionTemplateDecl(),
     m_mapCommonToClassTemplateDecl(),
     m_passedAssertions(0),
     m_failedAssertions(0),
-    m_objectIsOpen(false)
+    m_objectIsOpen(false),
+    m_nodeIndexOS(nullptr),
+    m_nodeIndexBase(0),
+    m_recordSink(nullptr),
+    m_openObjectID(),
+    m_openObjectOffset(0),
+    m_openObjectBodyOffset(0),
+    m_discoveryOnly(false),
+    m_qualTypePreviews(),
+    m_declFileFilter(astContext, config.m_entityFileNames),
+    m_nodeDepths(),
+    m_tokenIndex(m_srcMgr, getLangOptions())
 {}
 
 
@@ -210,18 +302,49 @@ PrintClangASTNodes::~PrintClangASTNodes()
 {}
 
 
-void PrintClangASTNodes::openNewObject(string const &id)
+void PrintClangASTNodes::openNewObject(llvm::StringRef id)
 {
-  m_os << "\n" << doubleQuote(id) << ": {\n";
+  if (m_discoveryOnly) {
+    m_objectIsOpen = true;
+    return;
+  }
+
+  m_writer.write("\n");
+  if (m_nodeIndexOS || m_recordSink) {
+    m_openObjectID.assign(id.data(), id.size());
+    m_openObjectOffset = m_writer.bytesWritten();
+  }
+  m_writer.writeQuoted(id);
+  m_writer.write(": {\n");
+  m_openObjectBodyOffset = m_writer.bytesWritten();
   m_objectIsOpen = true;
 }
 
 
 void PrintClangASTNodes::closeOpenObjectIf()
 {
-  if (m_objectIsOpen) {
-    m_os << "},\n";
+  if (m_objectIsOpen && m_discoveryOnly) {
+    m_objectIsOpen = false;
+  }
+  else if (m_objectIsOpen) {
+    if (m_recordSink) {
+      // The whole object is still in the writer's buffer, since it is
+      // only passed along between objects.
+      m_recordSink->handleNodeRecord(NodeRecord(m_openObjectID,
+        m_writer.writtenSince(m_openObjectBodyOffset)));
+    }
+
+    m_writer.write("},\n");
     m_objectIsOpen = false;
+
+    if (m_nodeIndexOS) {
+      writeNodeOffsetIndexLine(*m_nodeIndexOS, m_openObjectID,
+        m_nodeIndexBase + m_openObjectOffset,
+        m_writer.bytesWritten() - m_openObjectOffset);
+    }
+
+    // Between objects is a convenient place to pass along a chunk.
+    m_writer.flushIfFull();
   }
 }
 
@@ -1223,23 +1346,52 @@ void PrintClangASTNodes::printTypeLoc(
 
 
 std::string PrintClangASTNodes::ptrAndPreview(
-  std::string const &ptrVal,
-  std::string const &previewVal)
+  llvm::StringRef ptrVal,
+  llvm::StringRef previewVal)
 {
   return jsonObject2(
-    "ptr", doubleQuote(ptrVal),
-    "preview", doubleQuote(previewVal)
+    "ptr", doubleQuote(ptrVal.str()),
+    "preview", doubleQuote(previewVal.str())
   );
 }
 
 
+void PrintClangASTNodes::writePtrAndPreview(
+  llvm::StringRef ptrVal,
+  llvm::StringRef previewVal)
+{
+  m_writer.write("{ \"ptr\": ");
+  m_writer.writeQuoted(ptrVal);
+  m_writer.write(", \"preview\": ");
+  m_writer.writeQuoted(previewVal);
+  m_writer.write(" }");
+}
+
+
+llvm::StringRef PrintClangASTNodes::qualTypePreview(
+  clang::QualType qualType)
+{
+  void *key = qualType.getAsOpaquePtr();
+
+  auto it = m_qualTypePreviews.find(key);
+  if (it != m_qualTypePreviews.end()) {
+    return it->second;
+  }
+
+  llvm::StringRef preview = m_numbering.internString(qualTypeStr(qualType));
+  m_qualTypePreviews.insert(std::make_pair(key, preview));
+  return preview;
+}
+
+
 std::string PrintClangASTNodes::typeIDSyntaxJson(
   clang::Type const * NULLABLE type)
 {
   if (type) {
     return ptrAndPreview(
       getTypeIDStr(type),
-      typeStr(type)
+      m_discoveryOnly? llvm::StringRef() :
+        qualTypePreview(clang::QualType(type, 0 /*Quals*/))
     );
   }
   else {
@@ -1260,46 +1412,86 @@ std::string PrintClangASTNodes::qualTypeIDSyntaxJson(
 
     return ptrAndPreview(
       getTypeIDStr(type),
-      qualTypeStr(qualType)
+      m_discoveryOnly? llvm::StringRef() : qualTypePreview(qualType)
+    );
+  }
+}
+
+
+void PrintClangASTNodes::writeTypeIDSyntax(
+  clang::Type const * NULLABLE type)
+{
+  if (m_discoveryOnly) {
+    getTypeIDStr(type);
+  }
+  else if (type) {
+    writePtrAndPreview(
+      getTypeIDStr(type),
+      qualTypePreview(clang::QualType(type, 0 /*Quals*/))
     );
   }
+  else {
+    m_writer.write("null");
+  }
 }
 
 
-std::string PrintClangASTNodes::nestedNameSpecifierIDSyntaxJson(
+void PrintClangASTNodes::writeQualTypeIDSyntax(
+  clang::QualType qualType)
+{
+  if (qualType.isNull()) {
+    if (!m_discoveryOnly) {
+      m_writer.write("null");
+    }
+  }
+  else if (m_discoveryOnly) {
+    getTypeIDStr(qualType.getTypePtr());
+  }
+  else {
+    clang::Type const *type = qualType.getTypePtr();
+    assert(type);
+
+    writePtrAndPreview(
+      getTypeIDStr(type),
+      qualTypePreview(qualType)
+    );
+  }
+}
+
+
+void PrintClangASTNodes::writeNestedNameSpecifierIDSyntax(
   clang::NestedNameSpecifier const * NULLABLE nns)
 {
-  if (nns) {
-    return ptrAndPreview(
+  if (m_discoveryOnly) {
+    getNestedNameSpecifierIDStr(nns);
+  }
+  else if (nns) {
+    writePtrAndPreview(
       getNestedNameSpecifierIDStr(nns),
       nestedNameSpecifierStr_nq(nns)
     );
   }
   else {
-    return "null";
+    m_writer.write("null");
   }
 }
 
 
 std::string PrintClangASTNodes::getNextToken(
-  clang::SourceLocation /*IN/OUT*/ &loc) const
+  clang::SourceLocation /*IN/OUT*/ &loc)
 {
-  std::optional<clang::Token> tok =
-    clang::Lexer::findNextToken(loc, m_srcMgr, getLangOptions());
+  std::optional<IndexedToken> tok = m_tokenIndex.nextToken(loc);
   if (tok) {
-    std::string spelling =
-      clang::Lexer::getSpelling(*tok, m_srcMgr, getLangOptions());
-
     TRACE3("getNextToken:"
-           " loc=" << locStr(tok->getLocation()) <<
-           " len=" << tok->getLength() <<
-           " spelling=" << doubleQuote(spelling) <<
+           " loc=" << locStr(tok->m_loc) <<
+           " len=" << tok->m_length <<
+           " spelling=" << doubleQuote(tok->m_spelling) <<
            "");
 
-    assert(tok->getLocation() != loc);
-    assert(tok->getLength() >= 1);
-    loc = tok->getLocation().getLocWithOffset(tok->getLength() - 1);
-    return spelling;
+    assert(tok->m_loc != loc);
+    assert(tok->m_length >= 1);
+    loc = tok->lastCharLoc();
+    return tok->m_spelling;
   }
   else {
     return "";
@@ -1315,9 +1507,9 @@ clang::SourceLocation PrintClangASTNodes::getEndOfEqDelete(
     return cursor;
   }
 
-  // We cannot use clang::Lexer::findLocationAfterToken to recognize
-  // 'kw_delete' because the lexer is being used in "raw" mode, so it
-  // always returns 'raw_identifier' as the token kind for identifiers.
+  // We cannot recognize 'kw_delete' by its token kind because the
+  // tokens come from the lexer in "raw" mode, so the kind is always
+  // 'raw_identifier' for identifiers.
 
   if (getNextToken(cursor /*IN/OUT*/) != "=") {
     return clang::SourceLocation();
@@ -1378,6 +1570,16 @@ void PrintClangASTNodes::printDecl(clang::Decl const *decl)
     }
   }
 
+  // Similarly, only say where a declaration outside the files of
+  // interest is, since it is only here because something refers to it.
+  if (!m_config.m_printNonPSFFileEntities &&
+      !m_config.querying() &&
+      m_declFileFilter.isPrunedDecl(decl)) {
+    OUT_QATTR_STRING("", "skipping outside primary file",
+      locStr(decl->getLocation()));
+    return;
+  }
+
   OUT_QATTR_DECL("Decl::", "NextInContext",
     decl->getNextDeclInContext());
 
@@ -1399,6 +1601,15 @@ void PrintClangASTNodes::printDecl(clang::Decl const *decl)
   OUT_QATTR_STRING("Decl::", "getSourceRange()",
     sourceRangeStr(decl->getSourceRange()));
 
+  if (m_config.m_printTokenEndLocs) {
+    // The end of the source range is the start of the last token, so
+    // also say where that token ends.
+    std::optional<IndexedToken> lastToken =
+      m_tokenIndex.tokenAt(decl->getEndLoc());
+    OUT_QATTR_STRING("Decl::", "tokenEndLoc (computed)",
+      locStr(lastToken? lastToken->endLoc() : clang::SourceLocation()));
+  }
+
   // The qualifier here is unconditional because just "flags" is not
   // specific enough.
   OUT_QATTR_BITSET("", "Decl::flags",
@@ -2514,8 +2725,9 @@ void PrintClangASTNodes::printClassTemplateDecl(
     else {
       PRINT_ASSERT_FAILED_NOPREFIX(
         "\n  C->ICNT->TD == canonicalTemplateDecl invariant failed:"
-        "\n    C->ICNT->TD: " << getDeclIDStr(td) <<
-        "\n    canonicalTemplateDecl: " << getDeclIDStr(canonicalTemplateDecl));
+        "\n    C->ICNT->TD: " << getDeclIDStr(td).str() <<
+        "\n    canonicalTemplateDecl: " <<
+          getDeclIDStr(canonicalTemplateDecl).str());
     }
   }
   else {
@@ -2568,8 +2780,9 @@ void PrintClangASTNodes::printClassTemplateDecl(
     else {
       PRINT_ASSERT_FAILED_NOPREFIX(
         "\n  TD->TFD->D == canonicalRecordDecl invariant failed:"
-        "\n    TD->TFD->D: " << getDeclIDStr(icntDecl) <<
-        "\n    canonicalRecordDecl: " << getDeclIDStr(canonicalRecordDecl));
+        "\n    TD->TFD->D: " << getDeclIDStr(icntDecl).str() <<
+        "\n    canonicalRecordDecl: " <<
+          getDeclIDStr(canonicalRecordDecl).str());
     }
 
     /*
@@ -2601,9 +2814,9 @@ void PrintClangASTNodes::printClassTemplateDecl(
         else {
           PRINT_ASSERT_FAILED_NOPREFIX(
             "\n  TD->TFD->D == TD->TFD->IT->T.TD->TD invariant failed: "
-            "TD->TFD->D=" << getDeclIDStr(icntDecl) <<
+            "TD->TFD->D=" << getDeclIDStr(icntDecl).str() <<
             " TD->TFD->IT->T.TD->TD=" <<
-            getDeclIDStr(tdecl->getTemplatedDecl()));
+            getDeclIDStr(tdecl->getTemplatedDecl()).str());
         }
       }
       else {
@@ -3342,8 +3555,8 @@ void PrintClangASTNodes::printNestedNameSpecifier(
   // Note that the prefix can be nullptr even if the kind is not
   // 'Global' because it describes the *syntax* of a nested name, which
   // need not be absolute.
-  OUT_ATTR_JSON("Prefix" << ifLongForm(".ptr"),
-    nestedNameSpecifierIDSyntaxJson(nns->getPrefix()));
+  OUT_ATTR_NNS("Prefix" << ifLongForm(".ptr"),
+    nns->getPrefix());
 
   switch (nns->getKind()) {
     case clang::NestedNameSpecifier::Identifier:
@@ -3662,29 +3875,31 @@ void PrintClangASTNodes::printFake_CXXRecordDecl_DefinitionData(
 
   OUT_OBJECT(getFake_CXXRecordDecl_DefinitionDataIDStr(fakeData));
 
-  m_os << "  \"flags\": [\n" <<
+  if (!m_discoveryOnly) {
+    m_os << "  \"flags\": [\n" <<
 
-    // Flags (Width==1) from the Bits.def file.
-    #define FIELD(Name, Width, Merge)                     \
-      ((Width==1 && defData->Name)?                       \
-         stringb("    " << doubleQuote(#Name) << ",\n") : \
-         string("")) <<
-    #include "clang/AST/CXXRecordDeclDefinitionBits.def"
+      // Flags (Width==1) from the Bits.def file.
+      #define FIELD(Name, Width, Merge)                     \
+        ((Width==1 && defData->Name)?                       \
+           stringb("    " << doubleQuote(#Name) << ",\n") : \
+           string("")) <<
+      #include "clang/AST/CXXRecordDeclDefinitionBits.def"
 
-    // Other flags that are not in that file for some reason.
-    #define PR_FLAG(Name)                                 \
-      (defData->Name?                                     \
-         stringb("    " << doubleQuote(#Name) << ",\n") : \
-         string("")) <<
+      // Other flags that are not in that file for some reason.
+      #define PR_FLAG(Name)                                 \
+        (defData->Name?                                     \
+           stringb("    " << doubleQuote(#Name) << ",\n") : \
+           string("")) <<
 
-    PR_FLAG(IsLambda)
-    PR_FLAG(IsParsingBaseSpecifiers)
-    PR_FLAG(ComputedVisibleConversions)
-    PR_FLAG(HasODRHash)
+      PR_FLAG(IsLambda)
+      PR_FLAG(IsParsingBaseSpecifiers)
+      PR_FLAG(ComputedVisibleConversions)
+      PR_FLAG(HasODRHash)
 
-    #undef PR_FLAG
+      #undef PR_FLAG
 
-    "  ],\n";
+      "  ],\n";
+  }
 
   // The bitfield also has six bit set fields that indicate which of
   // several special member functions have some property.  This
@@ -3777,7 +3992,7 @@ void PrintClangASTNodes::printType(clang::Type const *type)
   }
 
   OUT_ATTR_STRING("syntax",
-    doubleQuote(typeStr(type)));
+    doubleQuote(qualTypePreview(clang::QualType(type, 0 /*Quals*/)).str()));
 
   {
     // I want to get Type::BaseType, but that is private.  So, use a dirty
@@ -3927,8 +4142,8 @@ void PrintClangASTNodes::printType(clang::Type const *type)
     OUT_ATTR_STRING("Keyword",
       elaboratedTypeKeywordStr(elabType->getKeyword()));
 
-    OUT_ATTR_JSON("NNS",
-      nestedNameSpecifierIDSyntaxJson(elabType->getQualifier()));
+    OUT_ATTR_NNS("NNS",
+      elabType->getQualifier());
 
     OUT_ATTR_QUALTYPE("NamedType",
       elabType->getNamedType());
@@ -3956,41 +4171,78 @@ void PrintClangASTNodes::printType(clang::Type const *type)
 }
 
 
+void PrintClangASTNodes::printBeyondQueryDepth(
+  ClangASTNodeNumbering::NodeEntry entry)
+{
+  OUT_OBJECT(entry.m_idStr);
+
+  // Say where a declaration is, like for one outside the files of
+  // interest.  Other nodes are described well enough by the preview
+  // where they are referenced.
+  if (entry.m_kind == ClangASTNodeNumbering::NK_Decl) {
+    auto decl = static_cast<clang::Decl const *>(entry.m_node);
+    OUT_QATTR_STRING("", "skipping beyond query depth",
+      locStr(decl->getLocation()));
+  }
+  else {
+    OUT_QATTR_NULL("", "skipping beyond query depth");
+  }
+}
+
+
+void PrintClangASTNodes::printNode(NodeID id)
+{
+  // Copy the entry, since printing can add IDs and thereby reallocate
+  // the table.
+  ClangASTNodeNumbering::NodeEntry entry = m_numbering.getNodeEntry(id);
+
+  // Printing this without following any references ensures that the
+  // exploration stops here.
+  if (!m_nodeDepths.empty() && m_nodeDepths[id] > m_config.m_queryDepth) {
+    printBeyondQueryDepth(entry);
+    return;
+  }
+
+  // Print the node according to its kind.
+  switch (entry.m_kind) {
+    #define PRINT_IF_KIND_IS(ClassName)                         \
+      case ClangASTNodeNumbering::NK_##ClassName:               \
+        print##ClassName(                                       \
+          static_cast<clang::ClassName const *>(entry.m_node)); \
+        break;
+
+    SM_PP_MAP_LIST(PRINT_IF_KIND_IS,
+      CLANG_AST_NODE_NUMBERING_TRACKED_TYPES)
+
+    #undef PRINT_IF_KIND_IS
+
+    default:
+      PRINT_ASSERT_FAIL("node kind was " << (int)entry.m_kind <<
+                        " for node ID: " << id);
+      break;
+  }
+}
+
+
 void PrintClangASTNodes::printAllNodes()
 {
   // Put the entire output into a JSON object wrapper.
   m_os << "{\n";
 
+  // With a query, the nodes numbered so far are the selected ones.
+  if (m_config.querying()) {
+    m_nodeDepths.assign(m_numbering.m_nextID, 0);
+  }
+
   // Each time we print a node, we may discover and number new nodes,
   // which causes the loop to continue.  It only stops once all nodes
   // have been discovered and printed.
   for (NodeID id = 1; id < m_numbering.m_nextID; ++id) {
-    // How many nodes did we print this time?
-    int numPrinted = 0;
-
-    // If 'id' is in the domain of the map for 'ClassName', print it as
-    // that kind of object.
-    #define PRINT_IF_ID_IS(ClassName)                           \
-      if (auto itOpt = mapFindOpt(                              \
-            m_numbering.m_##ClassName##Map.m_inverseMap, id)) { \
-        clang::ClassName const *node = (**itOpt).second;        \
-        print##ClassName(node);                                 \
-        ++numPrinted;                                           \
-      }
+    printNode(id);
 
-    // Check all of the maps.
-    SM_PP_MAP_LIST(PRINT_IF_ID_IS,
-      CLANG_AST_NODE_NUMBERING_TRACKED_TYPES);
-
-    #undef PRINT_IF_ID_IS
-
-    if (numPrinted == 1) {
-      // Don't bother bumping the number of passed assertions here, this
-      // is very trivial and not related to the structure of the AST.
-    }
-    else {
-      PRINT_ASSERT_FAIL("numPrinted was " << numPrinted <<
-                        " (should be 1) for node ID: " << id);
+    if (m_config.querying()) {
+      // What printing 'id' found is one reference further out.
+      m_nodeDepths.resize(m_numbering.m_nextID, m_nodeDepths[id] + 1);
     }
   }
 
@@ -4001,6 +4253,25 @@ void PrintClangASTNodes::printAllNodes()
 }
 
 
+void PrintClangASTNodes::printNodeRange(NodeID beginID, NodeID endID)
+{
+  NodeID const origNextID = m_numbering.m_nextID;
+
+  for (NodeID id = beginID; id < endID; ++id) {
+    printNode(id);
+  }
+
+  closeOpenObjectIf();
+
+  // If this fails, then the discovery pass did not actually find
+  // everything, and the IDs assigned here would not agree with a
+  // serial run.
+  PRINT_ASSERT(m_numbering.m_nextID == origNextID);
+
+  m_os.flush();
+}
+
+
 // ------------------------- global functions --------------------------
 void dumpClangAST(
   std::ostream &os,
@@ -4041,15 +4312,340 @@ void printClangAST_JSON(
 }
 
 
+#if PCA_HAVE_FORK
+// Header a shard worker writes to its pipe ahead of its output text.
+// After the text come the shard's node index lines, if requested.
+struct ShardHeader {
+  int64_t m_passedAssertions;
+  int64_t m_failedAssertions;
+
+  // Size of the output text.
+  int64_t m_textBytes;
+};
+
+
+// One contiguous range of node IDs, formatted by one worker.
+struct Shard {
+  // Range of IDs to print: [m_beginID,m_endID).
+  ClangASTNodeNumbering::NodeID m_beginID;
+  ClangASTNodeNumbering::NodeID m_endID;
+
+  // Worker process ID, or -1 if the worker could not be started, in
+  // which case the parent prints the range itself.
+  pid_t m_pid;
+
+  // Read end of the pipe carrying the worker's output, or -1.
+  int m_readFD;
+};
+
+
+// Read 'fd' until EOF, first filling in 'header', then copying the
+// output text to 'os', and also to 'text' if it is not null, and
+// anything after it to 'trailer'.  Return false if there was a read
+// error or the header was incomplete.
+static bool readShardFromFD(
+  std::ostream &os,
+  ShardHeader /*OUT*/ &header,
+  std::string * NULLABLE /*OUT*/ text,
+  std::string /*OUT*/ &trailer,
+  int fd)
+{
+  char buf[0x10000];
+  std::size_t headerBytes = 0;
+  uint64_t textBytes = 0;
+
+  while (true) {
+    ssize_t n = ::read(fd, buf, sizeof(buf));
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (n == 0) {
+      break;
+    }
+
+    char const *p = buf;
+    std::size_t len = n;
+    if (headerBytes < sizeof(header)) {
+      std::size_t take = std::min(len, sizeof(header) - headerBytes);
+      std::memcpy(reinterpret_cast<char*>(&header) + headerBytes, p, take);
+      headerBytes += take;
+      p += take;
+      len -= take;
+    }
+    if (headerBytes < sizeof(header)) {
+      continue;
+    }
+
+    std::size_t textLen =
+      std::min<uint64_t>(len, header.m_textBytes - textBytes);
+    os.write(p, textLen);
+    if (text) {
+      text->append(p, textLen);
+    }
+    textBytes += textLen;
+    trailer.append(p + textLen, len - textLen);
+  }
+
+  return headerBytes == sizeof(header);
+}
+
+
+// Pass to 'sink' the records of 'text', the output of one shard, as
+// located by 'indexLines', the shard's index.
+static void passShardRecordsToSink(
+  NodeRecordSink &sink,
+  llvm::StringRef text,
+  llvm::StringRef indexLines)
+{
+  while (!indexLines.empty()) {
+    std::pair<llvm::StringRef, llvm::StringRef> lineAndRest =
+      indexLines.split('\n');
+    indexLines = lineAndRest.second;
+
+    NodeOffsetIndexEntry entry;
+    if (!parseNodeOffsetIndexLine(entry, lineAndRest.first)) {
+      xmessage(stringb("printClangASTNodes: malformed shard index line: " <<
+                       doubleQuote(lineAndRest.first.str())));
+    }
+
+    // The body is between the opening line and the closing "},\n".
+    llvm::StringRef record = text.substr(entry.m_offset, entry.m_length);
+    llvm::StringRef body = record.split('\n').second.drop_back(3);
+
+    std::string id = stringb(entry.m_typeName << ' ' << entry.m_nodeID);
+    sink.handleNodeRecord(NodeRecord(id, body));
+  }
+}
+
+
+/*
+  Print the nodes using 'config.m_jobs' workers.
+
+  First, we run the printer with its output discarded, which numbers
+  every reachable node in the same order as a serial run would.  After
+  that, the numbering is fixed, so disjoint ID ranges can be formatted
+  independently and concatenated in ID order, yielding the same bytes as
+  the serial run.
+
+  The workers are forked processes rather than threads because Clang's
+  SourceManager (consulted when rendering locations, and by the type
+  printer) updates internal lookup caches without synchronization.  A
+  forked worker gets its own copy-on-write copy of the AST, so no such
+  sharing occurs.
+*/
+static int printClangASTNodesParallel(
+  std::ostream &os,
+  clang::ASTContext &astContext,
+  PrintClangASTNodesConfiguration const &config,
+  ClangASTNodeNumbering &numbering,
+  std::ostream * NULLABLE nodeIndexOS,
+  NodeRecordSink * NULLABLE recordSink,
+  uint64_t nodeIndexBase)
+{
+  typedef ClangASTNodeNumbering::NodeID NodeID;
+
+  // Discovery pass.
+  std::ostream nullStream(nullptr);
+  PrintClangASTNodes discoverer(nullStream, astContext, config, numbering);
+  discoverer.m_discoveryOnly = true;
+  discoverer.printAllNodes();
+
+  NodeID const numNodes = numbering.m_nextID - 1;
+  NodeID const numShards =
+    std::min<NodeID>(config.m_jobs, std::max<NodeID>(numNodes, 1));
+  TRACE1("parallel print: numNodes=" << numNodes <<
+         " numShards=" << numShards);
+
+  // Give a shard printer the state the discovery pass accumulated.
+  auto initShardPrinter = [&discoverer](PrintClangASTNodes &printer) {
+    printer.m_mapCommonToFunctionTemplateDecl =
+      discoverer.m_mapCommonToFunctionTemplateDecl;
+    printer.m_mapCommonToClassTemplateDecl =
+      discoverer.m_mapCommonToClassTemplateDecl;
+    printer.m_nodeDepths = discoverer.m_nodeDepths;
+  };
+
+  // Anything buffered now would otherwise be at risk of being written
+  // by both the parent and a worker.
+  os.flush();
+
+  // Start the workers.
+  std::vector<Shard> shards;
+  for (NodeID i=0; i < numShards; ++i) {
+    Shard shard;
+    shard.m_beginID = 1 + numNodes * i / numShards;
+    shard.m_endID   = 1 + numNodes * (i+1) / numShards;
+    shard.m_pid = -1;
+    shard.m_readFD = -1;
+
+    int fds[2];
+    if (::pipe(fds) == 0) {
+      shard.m_pid = ::fork();
+      if (shard.m_pid == 0) {
+        // Worker.
+        ::close(fds[0]);
+        bool ok = false;
+        try {
+          std::ostringstream shardOS;
+          std::ostringstream shardIndexOS;
+          PrintClangASTNodes printer(shardOS, astContext, config, numbering);
+          initShardPrinter(printer);
+          if (nodeIndexOS || recordSink) {
+            // Offsets are relative to the start of the shard; the
+            // parent rebases them, or uses them to find the records
+            // to pass to the sink.
+            printer.m_nodeIndexOS = &shardIndexOS;
+          }
+          printer.printNodeRange(shard.m_beginID, shard.m_endID);
+
+          std::string text = shardOS.str();
+          std::string indexLines = shardIndexOS.str();
+
+          ShardHeader header;
+          header.m_passedAssertions = printer.m_passedAssertions;
+          header.m_failedAssertions = printer.m_failedAssertions;
+          header.m_textBytes = text.size();
+
+          ok = writeAllToFD(fds[1],
+                 reinterpret_cast<char const *>(&header), sizeof(header)) &&
+               writeAllToFD(fds[1], text.data(), text.size()) &&
+               writeAllToFD(fds[1], indexLines.data(), indexLines.size());
+        }
+        catch (std::exception &x) {
+          std::cerr << x.what() << "\n";
+        }
+
+        // Do not run destructors or 'atexit' handlers that belong to
+        // the parent.
+        ::_exit(ok? 0 : 1);
+      }
+
+      ::close(fds[1]);
+      if (shard.m_pid > 0) {
+        shard.m_readFD = fds[0];
+      }
+      else {
+        ::close(fds[0]);
+      }
+    }
+
+    if (shard.m_pid < 0) {
+      TRACE1("could not start worker for shard " << i <<
+             ", will print it serially");
+    }
+    shards.push_back(shard);
+  }
+
+  // Gather the results in ID order.
+  int passedAssertions = 0;
+  int failedAssertions = 0;
+  std::string errors;
+
+  // Position of 'os', as the index counts it, which is where the next
+  // shard's index offsets start.
+  uint64_t outputBytes = nodeIndexBase;
+
+  os << "{\n";
+  outputBytes += 2;
+
+  for (Shard const &shard : shards) {
+    if (shard.m_pid < 0) {
+      PrintClangASTNodes printer(os, astContext, config, numbering);
+      initShardPrinter(printer);
+      printer.m_nodeIndexOS = nodeIndexOS;
+      printer.m_nodeIndexBase = outputBytes;
+      printer.m_recordSink = recordSink;
+      printer.printNodeRange(shard.m_beginID, shard.m_endID);
+      passedAssertions += printer.m_passedAssertions;
+      failedAssertions += printer.m_failedAssertions;
+      outputBytes += printer.m_writer.bytesWritten();
+      continue;
+    }
+
+    ShardHeader header;
+    std::string text;
+    std::string indexLines;
+    if (readShardFromFD(os, header /*OUT*/,
+                        recordSink? &text : nullptr /*OUT*/,
+                        indexLines /*OUT*/, shard.m_readFD)) {
+      passedAssertions += header.m_passedAssertions;
+      failedAssertions += header.m_failedAssertions;
+      if (nodeIndexOS) {
+        rebaseNodeOffsetIndexLines(*nodeIndexOS, indexLines, outputBytes);
+      }
+      if (recordSink) {
+        passShardRecordsToSink(*recordSink, text, indexLines);
+      }
+      outputBytes += header.m_textBytes;
+    }
+    else {
+      errors += stringb("failed to read output of worker " <<
+                        shard.m_pid << "; ");
+    }
+    ::close(shard.m_readFD);
+
+    int status = 0;
+    if (::waitpid(shard.m_pid, &status, 0) != shard.m_pid ||
+        !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+      errors += stringb("worker " << shard.m_pid << " failed; ");
+    }
+  }
+
+  os << "}\n";
+  os.flush();
+
+  if (!errors.empty()) {
+    xmessage(stringb("printClangASTNodes: " << errors));
+  }
+
+  TRACE1("Passed assertions: " << passedAssertions);
+
+  return failedAssertions;
+}
+#endif // PCA_HAVE_FORK
+
+
 int printClangASTNodes(
   std::ostream &os,
   clang::ASTContext &astContext,
-  PrintClangASTNodesConfiguration const &config)
+  PrintClangASTNodesConfiguration const &config,
+  std::ostream * NULLABLE nodeIndexOS,
+  NodeRecordSink * NULLABLE recordSink,
+  std::uint64_t nodeIndexBase)
 {
   ClangASTNodeNumbering numberer;
-  numberClangASTNodes(astContext, numberer);
+  if (config.querying()) {
+    numberClangASTNodesWithin(astContext, numberer,
+      findNodeQueryDecls(astContext, config.m_queryTerms));
+  }
+  else if (config.m_printNonPSFFileEntities) {
+    numberClangASTNodes(astContext, numberer);
+  }
+  else {
+    DeclFileFilter filter(astContext, config.m_entityFileNames);
+    numberClangASTNodes(astContext, numberer, &filter);
+  }
+
+  if (nodeIndexOS) {
+    writeNodeOffsetIndexHeader(*nodeIndexOS);
+  }
+
+#if PCA_HAVE_FORK
+  if (config.m_jobs > 1) {
+    return printClangASTNodesParallel(os, astContext, config, numberer,
+                                      nodeIndexOS, recordSink,
+                                      nodeIndexBase);
+  }
+#endif // PCA_HAVE_FORK
 
   PrintClangASTNodes printer(os, astContext, config, numberer);
+  printer.m_nodeIndexOS = nodeIndexOS;
+  printer.m_nodeIndexBase = nodeIndexBase;
+  printer.m_recordSink = recordSink;
   printer.printAllNodes();
 
   TRACE1("Passed assertions: " << printer.m_passedAssertions);
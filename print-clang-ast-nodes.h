@@ -4,26 +4,64 @@
 #ifndef PRINT_CLANG_AST_NODES_H
 #define PRINT_CLANG_AST_NODES_H
 
+#include "node-query.h"                          // NodeQueryTerm
+#include "node-record-diff.h"                    // NodeRecordSink
+
+#include "smbase/sm-macros.h"                    // NULLABLE
+
 #include "clang/AST/ASTContext.h"                // clang::ASTContext
 #include "clang/AST/ASTFwd.h"                    // clang::FunctionDecl [n]
 
+#include <cstdint>                               // std::uint64_t
 #include <iosfwd>                                // std::ostream
+#include <string>                                // std::string
+#include <vector>                                // std::vector
 
 
 // Configuration for AST printing.
 class PrintClangASTNodesConfiguration {
 public:
   // True to print entities that are not in the primary source file.
-  //
-  // TODO: This currently does not do anything.
+  // When false, top-level declarations from other files (other than
+  // those named in 'm_entityFileNames') are not traversed, and if they
+  // are referenced, only their location is printed.
   bool m_printNonPSFFileEntities = false;
 
+  // Names of additional files whose entities are printed, matched as
+  // described at `DeclFileFilter::m_extraFileNames`.
+  std::vector<std::string> m_entityFileNames;
+
   // True to print the numeric addresses of nodes.
   bool m_printAddresses = true;
 
   // True to print qualifiers in front of field names to clarify which
   // class declares them.
   bool m_printQualifiers = true;
+
+  // Number of parallel workers to use when formatting node details.
+  // Values less than 2 mean everything is done serially.  The output
+  // does not depend on this value.
+  int m_jobs = 1;
+
+  // True to print, for each declaration, where the last token of its
+  // source range ends.
+  bool m_printTokenEndLocs = false;
+
+  // If not empty, then rather than the whole TU, print the declarations
+  // these select, the nodes inside them, and what can be reached from
+  // those by following up to 'm_queryDepth' references.  Nodes one more
+  // reference away get a record that only says where they are, so that
+  // every reference in the output still leads to a record.  The
+  // file-based options above do not apply to a query.
+  std::vector<NodeQueryTerm> m_queryTerms;
+
+  // See 'm_queryTerms'.
+  int m_queryDepth = 1;
+
+public:      // methods
+  // True if 'm_queryTerms' is in use.
+  bool querying() const
+    { return !m_queryTerms.empty(); }
 };
 
 
@@ -49,12 +87,23 @@ void printClangAST_JSON(
 // ('astContext.getExternalSource()' is not null), printing the AST will
 // also load the parts that are printed.
 //
+// If 'nodeIndexOS' is not null, also write to it an index of where
+// each node's record is in the output, as described in
+// node-offset-index.h.  The offsets in it start at 'nodeIndexBase',
+// which is meant to be the position of 'os' when printing starts.
+//
+// If 'recordSink' is not null, also pass each node's record to it as
+// it is printed.
+//
 // Returns the number of invariant checks that failed.
 //
 int printClangASTNodes(
   std::ostream &os,
   clang::ASTContext &astContext,
-  PrintClangASTNodesConfiguration const &config);
+  PrintClangASTNodesConfiguration const &config,
+  std::ostream * NULLABLE nodeIndexOS = nullptr,
+  NodeRecordSink * NULLABLE recordSink = nullptr,
+  std::uint64_t nodeIndexBase = 0);
 
 
 #endif // PRINT_CLANG_AST_NODES_H
@@ -4,20 +4,22 @@
 #include "clang-ast-visitor.h"                             // clangASTVisitorTest
 #include "clang-ast.h"                                     // ClangAST
 #include "clang-util.h"                                    // GlobalClangUtilInstance
-#include "decl-implicit.h"                                 // declareImplicitThings
+#include "node-offset-index.h"                             // lookupNodeRecords
+#include "pca-batch.h"                                     // runBatch
 #include "pca-command-line-options.h"                      // PCACommandLineOptions
+#include "pca-process-tu.h"                                // parseTUWithOptions, processParsedTU, runPersistentLoop
+#include "pca-server.h"                                    // runServer
 #include "pca-unit-tests.h"                                // pca_unit_tests
-#include "print-clang-ast-nodes.h"                         // printClangASTNodes
-#include "print-method-comments.h"                         // printMethodComments
-#include "printer-visitor.h"                               // printerVisitorTU
-#include "rav-printer-visitor.h"                           // ravPrinterVisitorTU
 
 #include "smbase/gdvalue.h"                                // gdv::GDValue
 #include "smbase/map-util.h"                               // mapInsertAll
 #include "smbase/sm-trace.h"                               // INIT_TRACE
 #include "smbase/string-util.h"                            // stringVectorFromPointerArray
 
+#include "clang/Basic/Stack.h"                             // clang::noteBottomOfStack
+
 #include <exception>                                       // std::exception
+#include <iostream>                                        // std::cin
 #include <string>                                          // std::string
 #include <vector>                                          // std::vector
 
@@ -57,110 +59,99 @@ static int innerMain(int argc, char const **argv)
     return 0;
   }
 
-  ClangAST ast;
-  if (!ast.parseCommandLine(
-         stringVectorFromPointerArray(argc - firstClangArg,
-                                      argv + firstClangArg))) {
-    return 2;
-  }
+  std::vector<string> clangArgs =
+    stringVectorFromPointerArray(argc - firstClangArg,
+                                 argv + firstClangArg);
 
-  // Get the name of the primary source file.
-  clang::FrontendOptions const &feOpts =
-    ast.m_compilerInvocation->getFrontendOpts();
-  if (feOpts.Inputs.size() != 1) {
-    // Unfortunately, this message is never seen because
-    // createInvocation will choke first (and in the multiple input
-    // case, spew a huge error message).
-    cerr << "print-clang-ast: expected exactly 1 input file, not "
-         << feOpts.Inputs.size()
-         << "\n";
-    return 2;
-  }
-  string primarySourceFileName = feOpts.Inputs[0].getFile().str();
-  TRACE1("primarySourceFileName: " << primarySourceFileName);
-
-  // Scan the file for additional options.
-  err = options.parsePrimarySourceFile(primarySourceFileName);
-  if (!err.empty()) {
-    cerr << err << "\n";
-    return 2;
+  if (!options.m_lookupNodes.empty()) {
+    // The remaining arguments are node IDs.
+    string indexFname = options.m_nodeIndex.empty()?
+      options.m_lookupNodes + ".index" : options.m_nodeIndex;
+    err = lookupNodeRecords(cout, options.m_lookupNodes, indexFname,
+                            clangArgs);
+    if (!err.empty()) {
+      cerr << err << "\n";
+      return 2;
+    }
+    return 0;
   }
-  TRACE1("options: " << options.getAsArgumentsString());
 
-  if (!ast.parseSourceCode()) {
+  if (options.m_jobs > 1 && !options.m_compressOutput.empty()) {
+    // The workers are forked while the compression thread runs, and a
+    // lock it held at that moment would stay held in them.
+    cerr << "--jobs cannot be more than 1 with --compress-output.\n";
     return 2;
   }
 
-  // Set `ClangUtil::s_instance`, which I don't like using, but
-  // occasionally is needed to enable tracing in weird spots.
-  GlobalClangUtilInstance gcui(ast.getASTContext());
-
-  if (options.m_forceImplicit) {
-    declareImplicitThings(ast.getASTUnit(), true /*defineAlso*/);
-  }
-
-  if (options.m_dumpAST) {
-    dumpClangAST(cout, ast.getASTContext());
+  if (options.m_server) {
+    if (options.m_persistent || !options.m_batchFile.empty()) {
+      cerr << "--server cannot be used with --persistent or --batch.\n";
+      return 2;
+    }
+    if (!clangArgs.empty()) {
+      // Each request has its own.
+      cerr << "--server does not take compiler options.\n";
+      return 2;
+    }
+    return runServer(std::cin, cout, options);
   }
 
-  if (options.m_printAST_JSON) {
-    printClangAST_JSON(cout, ast.getASTContext());
+  if (options.m_persistent && !options.m_compressOutput.empty()) {
+    // The end-of-output markers would be buried in the compressed data.
+    cerr << "--persistent cannot be used with --compress-output.\n";
+    return 2;
   }
 
-  if (options.m_printerVisitor) {
-    PrinterVisitor::Flags flags = PrinterVisitor::F_NONE;
-    if (options.m_printVisitContext) {
-      flags |= PrinterVisitor::F_PRINT_VISIT_CONTEXT;
-    }
-    if (options.m_printImplicitQualTypes) {
-      flags |= PrinterVisitor::F_PRINT_IMPLICIT_QUAL_TYPES;
-    }
-    if (options.m_omit_CTPSD_TAW) {
-      flags |= PrinterVisitor::F_OMIT_CTPSD_TAW;
+  if (!options.m_batchFile.empty()) {
+    if (options.m_persistent) {
+      cerr << "--persistent cannot be used with --batch.\n";
+      return 2;
     }
-    if (options.m_printDefaultArgExprs) {
-      flags |= PrinterVisitor::F_PRINT_DEFAULT_ARG_EXPRS;
+    if (!options.m_compressFrameIndexOut.empty()) {
+      // Every TU would overwrite the same index.
+      cerr << "--compress-frame-index-out cannot be used with --batch.\n";
+      return 2;
     }
-    if (options.m_ravCompat) {
-      flags |= PrinterVisitor::F_RAV_COMPAT;
+    if (!options.m_splitOutputDir.empty()) {
+      // Likewise for the split outputs.
+      cerr << "--split-output-dir cannot be used with --batch.\n";
+      return 2;
     }
 
-    printerVisitorTU(cout,
-                     ast.getASTContext(),
-                     flags);
-  }
-
-  if (options.m_ravPrinterVisitor) {
-    ravPrinterVisitorTU(cout, ast.getASTContext());
+    // The remaining arguments are appended to each TU's options.
+    return runBatch(options, clangArgs);
   }
 
-  if (options.m_printMethodComments) {
-    printMethodComments(cout, ast.getASTContext());
+  ClangAST ast;
+  if (!parseTUWithOptions(ast, options, clangArgs)) {
+    return 2;
   }
 
-  if (options.m_printASTNodes) {
-    PrintClangASTNodesConfiguration config;
-    config.m_printNonPSFFileEntities = options.m_fullTU;
-    config.m_printAddresses = !options.m_suppressAddresses;
-    config.m_printQualifiers = !options.m_noASTFieldQualifiers;
+  // Set `ClangUtil::s_instance`, which I don't like using, but
+  // occasionally is needed to enable tracing in weird spots.
+  GlobalClangUtilInstance gcui(ast.getASTContext());
 
-    if (int failedAssertions =
-          printClangASTNodes(cout, ast.getASTContext(), config)) {
-      cerr << "Failed assertions: " << failedAssertions << "\n";
-      return 2;
-    }
+  if (int result = processParsedTU(cout, options, ast)) {
+    return result;
   }
 
   // Exercise the visitor.  Do this last so we can use the above
   // printing mechanisms to help debug any failures.
   clangASTVisitorTest(ast.getASTContext());
 
+  if (options.m_persistent) {
+    return runPersistentLoop(std::cin, cout, options, ast);
+  }
+
   return 0;
 }
 
 
 int main(int argc, char const **argv)
 {
+  // Let deep traversals detect when they should switch stacks.
+  clang::noteBottomOfStack();
+
   try {
     return innerMain(argc, argv);
   }
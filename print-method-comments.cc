@@ -3,6 +3,7 @@
 
 #include "print-method-comments.h"     // this module
 
+#include "clang-ast-visitor-fanout.h"  // ClangASTVisitorSink
 #include "clang-util-ast-visitor.h"    // ClangUtilASTVisitor
 
 #include "smbase/sm-env.h"             // smbase::envAsBool
@@ -11,6 +12,7 @@
 #include "clang/AST/ASTContext.h"      // clang::ASTContext
 
 #include <iostream>                    // std::ostream
+#include <memory>                      // std::unique_ptr
 
 using clang::dyn_cast;
 
@@ -25,10 +27,21 @@ public:      // methods
              clang::ASTContext &astContext)
     : ClangUtilASTVisitor(astContext),
       m_os(os)
-  {}
+  {
+    // Only declarations are of interest.  This means methods of local
+    // classes, which are inside function bodies, are not reported.
+    m_visitInterest = VI_ALL & ~(VI_FUNCTION_BODIES |
+                                 VI_DECL_EXPRS |
+                                 VI_TYPE_LOCS |
+                                 VI_NESTED_NAME_SPECIFIER_LOCS);
+  }
 
   void printBases(clang::CXXRecordDecl const *crd);
 
+  // Print what 'visitDecl' prints for 'decl', without visiting its
+  // children.
+  void printDecl(clang::Decl const *decl);
+
   // ClangASTVisitor methods.
   virtual void visitDecl(VisitDeclContext context, clang::Decl const *decl) override;
 };
@@ -98,7 +111,7 @@ void PMCVisitor::printBases(clang::CXXRecordDecl const *crd)
 }
 
 
-void PMCVisitor::visitDecl(VisitDeclContext context, clang::Decl const *decl)
+void PMCVisitor::printDecl(clang::Decl const *decl)
 {
   if (auto *md = dyn_cast<clang::CXXMethodDecl>(decl)) {
     m_os << "Method: " << declKindAtLocStr(decl) << "\n";
@@ -136,11 +149,63 @@ void PMCVisitor::visitDecl(VisitDeclContext context, clang::Decl const *decl)
       printBases(crd);
     }
   }
+}
+
+
+void PMCVisitor::visitDecl(VisitDeclContext context, clang::Decl const *decl)
+{
+  printDecl(decl);
 
   ClangUtilASTVisitor::visitDecl(context, decl);
 }
 
 
+// Sink that prints what `PMCVisitor` does while sharing a traversal.
+//
+// The shared traversal does not narrow its interest the way
+// `PMCVisitor` does, so this ignores declarations found inside
+// statements, types, template arguments, and name qualifiers, which is
+// where the parts `PMCVisitor` skips lead.
+class PMCSink : public ClangASTVisitorSink {
+public:      // data
+  // Visitor whose printing is used.  Its traversal is not.
+  PMCVisitor m_visitor;
+
+  // Number of enclosing nodes that are not declarations.
+  int m_nonDeclDepth;
+
+public:      // methods
+  PMCSink(std::ostream &os,
+          clang::ASTContext &astContext)
+    : m_visitor(os, astContext),
+      m_nonDeclDepth(0)
+  {}
+
+  // ClangASTVisitorSink methods.
+  virtual void preVisitDecl(VisitDeclContext, clang::Decl const *decl) override
+  {
+    if (m_nonDeclDepth == 0) {
+      m_visitor.printDecl(decl);
+    }
+  }
+
+  #define NON_DECL_NODE(Node, ContextType, NodeType)                   \
+    virtual void preVisit##Node(ContextType, NodeType) override        \
+      { ++m_nonDeclDepth; }                                            \
+    virtual void postVisit##Node(ContextType, NodeType) override       \
+      { --m_nonDeclDepth; }
+
+  NON_DECL_NODE(Stmt, VisitStmtContext, clang::Stmt const *)
+  NON_DECL_NODE(TypeLoc, VisitTypeContext, clang::TypeLoc)
+  NON_DECL_NODE(TemplateArgumentLoc, VisitTemplateArgumentContext,
+                clang::TemplateArgumentLoc)
+  NON_DECL_NODE(NestedNameSpecifierLoc, VisitNestedNameSpecifierContext,
+                clang::NestedNameSpecifierLoc)
+
+  #undef NON_DECL_NODE
+};
+
+
 void printMethodComments(
   std::ostream &os,
   clang::ASTContext &astContext)
@@ -150,4 +215,12 @@ void printMethodComments(
 }
 
 
+std::unique_ptr<ClangASTVisitorSink> makeMethodCommentsSink(
+  std::ostream &os,
+  clang::ASTContext &astContext)
+{
+  return std::unique_ptr<ClangASTVisitorSink>(new PMCSink(os, astContext));
+}
+
+
 // EOF
@@ -4,9 +4,12 @@
 #ifndef PRINT_CLANG_AST_PRINT_METHOD_COMMENTS_H
 #define PRINT_CLANG_AST_PRINT_METHOD_COMMENTS_H
 
+#include "clang-ast-visitor-fanout.h"  // ClangASTVisitorSink
+
 #include "clang/AST/ASTContext.h"      // clang::ASTContext
 
 #include <iosfwd>                      // std::ostream
+#include <memory>                      // std::unique_ptr
 
 
 // Find and print comments on method declarations.
@@ -14,5 +17,11 @@ void printMethodComments(
   std::ostream &os,
   clang::ASTContext &astContext);
 
+// Return a sink that prints the same thing when added to a
+// `ClangASTVisitorFanOut` that scans the TU in 'astContext'.
+std::unique_ptr<ClangASTVisitorSink> makeMethodCommentsSink(
+  std::ostream &os,
+  clang::ASTContext &astContext);
+
 
 #endif // PRINT_CLANG_AST_PRINT_METHOD_COMMENTS_H
@@ -3,6 +3,9 @@
 
 #include "printer-visitor.h"                     // this module
 
+// this dir
+#include "clang-ast-visitor-parallel.h"          // scanTUParallel, visitScanTUUnits
+
 // smbase
 #include "smbase/gdvalue.h"                      // operator<<(gdv::GDValue)
 #include "smbase/save-restore.h"                 // SET_RESTORE
@@ -49,8 +52,8 @@ std::string PrinterVisitor::indentString() const
   SET_RESTORE(m_indentLevel, m_indentLevel+1)
 
 
-void PrinterVisitor::visitDecl(VisitDeclContext context,
-                               clang::Decl const *decl)
+void PrinterVisitor::printDeclLine(VisitDeclContext context,
+                                   clang::Decl const *decl)
 {
   PRINT_INDENT_AND_CONTEXT();
   if (auto nd = dyn_cast<clang::NamedDecl>(decl)) {
@@ -60,6 +63,13 @@ void PrinterVisitor::visitDecl(VisitDeclContext context,
     m_os << decl->getDeclKindName()
          << "Decl at " << declLocStr(decl) << "\n";
   }
+}
+
+
+void PrinterVisitor::visitDecl(VisitDeclContext context,
+                               clang::Decl const *decl)
+{
+  printDeclLine(context, decl);
 
   INCREMENT_INDENT_LEVEL();
 
@@ -67,16 +77,16 @@ void PrinterVisitor::visitDecl(VisitDeclContext context,
 }
 
 
-void PrinterVisitor::visitStmt(VisitStmtContext context,
-                               clang::Stmt const *stmt)
+void PrinterVisitor::printStmtLine(VisitStmtContext context,
+                                   clang::Stmt const *stmt)
 {
   PRINT_INDENT_AND_CONTEXT();
   m_os << stmtKindLocStr(stmt) << "\n";
+}
 
-  INCREMENT_INDENT_LEVEL();
-
-  ClangASTVisitor::visitStmt(context, stmt);
 
+void PrinterVisitor::printDefaultArgExpr(clang::Stmt const *stmt)
+{
   if (m_flags & F_PRINT_DEFAULT_ARG_EXPRS) {
     if (auto cdae = dyn_cast<clang::CXXDefaultArgExpr>(stmt)) {
       visitStmt(VSC_NONE, cdae->getExpr());
@@ -85,23 +95,49 @@ void PrinterVisitor::visitStmt(VisitStmtContext context,
 }
 
 
+void PrinterVisitor::visitStmt(VisitStmtContext context,
+                               clang::Stmt const *stmt)
+{
+  printStmtLine(context, stmt);
+
+  INCREMENT_INDENT_LEVEL();
+
+  ClangASTVisitor::visitStmt(context, stmt);
+
+  printDefaultArgExpr(stmt);
+}
+
+
+bool PrinterVisitor::omitsTypeLoc(VisitTypeContext context) const
+{
+  // This TypeLoc would not be visited by RAV due to a bug:
+  //
+  //   https://github.com/llvm/llvm-project/issues/90586
+  //
+  // So, skip printing the node, but print its children, so our output
+  // matches that of rav-printer-visitor.
+  return (m_flags & F_OMIT_CTPSD_TAW) &&
+         context == VTC_CLASS_TEMPLATE_PARTIAL_SPECIALIZATION_DECL;
+}
+
+
+void PrinterVisitor::printTypeLocLine(VisitTypeContext context,
+                                      clang::TypeLoc typeLoc)
+{
+  PRINT_INDENT_AND_CONTEXT();
+  m_os << typeLocStr(typeLoc) << "\n";
+}
+
+
 void PrinterVisitor::visitTypeLoc(VisitTypeContext context,
                                   clang::TypeLoc typeLoc)
 {
-  if ((m_flags & F_OMIT_CTPSD_TAW) &&
-      context == VTC_CLASS_TEMPLATE_PARTIAL_SPECIALIZATION_DECL) {
-    // This TypeLoc would not be visited by RAV due to a bug:
-    //
-    //   https://github.com/llvm/llvm-project/issues/90586
-    //
-    // So, skip printing the node, but print its children, so our
-    // output matches that of rav-printer-visitor.
+  if (omitsTypeLoc(context)) {
     ClangASTVisitor::visitTypeLoc(context, typeLoc);
     return;
   }
 
-  PRINT_INDENT_AND_CONTEXT();
-  m_os << typeLocStr(typeLoc) << "\n";
+  printTypeLocLine(context, typeLoc);
 
   INCREMENT_INDENT_LEVEL();
 
@@ -109,12 +145,20 @@ void PrinterVisitor::visitTypeLoc(VisitTypeContext context,
 }
 
 
-void PrinterVisitor::visitTemplateArgumentLoc(
+void PrinterVisitor::printTemplateArgumentLocLine(
   VisitTemplateArgumentContext context,
   clang::TemplateArgumentLoc tal)
 {
   PRINT_INDENT_AND_CONTEXT();
   m_os << "TArg " << templateArgumentLocStr(tal) << "\n";
+}
+
+
+void PrinterVisitor::visitTemplateArgumentLoc(
+  VisitTemplateArgumentContext context,
+  clang::TemplateArgumentLoc tal)
+{
+  printTemplateArgumentLocLine(context, tal);
 
   INCREMENT_INDENT_LEVEL();
 
@@ -135,12 +179,20 @@ void PrinterVisitor::visitImplicitQualType(VisitTypeContext context,
 }
 
 
-void PrinterVisitor::visitNestedNameSpecifierLoc(
+void PrinterVisitor::printNestedNameSpecifierLocLine(
   VisitNestedNameSpecifierContext context,
   clang::NestedNameSpecifierLoc nnsl)
 {
   PRINT_INDENT_AND_CONTEXT();
   m_os << "NNS " << nestedNameSpecifierLocStr(nnsl) << "\n";
+}
+
+
+void PrinterVisitor::visitNestedNameSpecifierLoc(
+  VisitNestedNameSpecifierContext context,
+  clang::NestedNameSpecifierLoc nnsl)
+{
+  printNestedNameSpecifierLocLine(context, nnsl);
 
   INCREMENT_INDENT_LEVEL();
 
@@ -148,27 +200,168 @@ void PrinterVisitor::visitNestedNameSpecifierLoc(
 }
 
 
-void PrinterVisitor::visitCXXDefaultInitExpr(
-  clang::CXXDefaultInitExpr const *cdie)
+bool PrinterVisitor::printsCXXDefaultInitExprChildren() const
 {
   if (m_flags & F_RAV_COMPAT) {
     if (CLANG_VERSION_MAJOR < 18) {
       // Versions before 18 did not print the children.
-      return;
+      return false;
     }
   }
 
-  ClangASTVisitor::visitCXXDefaultInitExpr(cdie);
+  return true;
+}
+
+
+void PrinterVisitor::visitCXXDefaultInitExpr(
+  clang::CXXDefaultInitExpr const *cdie)
+{
+  if (printsCXXDefaultInitExprChildren()) {
+    ClangASTVisitor::visitCXXDefaultInitExpr(cdie);
+  }
 }
 
 
+// --------------------------- PrinterVisitorSink ---------------------------
+PrinterVisitorSink::PrinterVisitorSink(std::ostream &os,
+                                       clang::ASTContext &astContext)
+  : m_printer(os, astContext)
+{}
+
+
+void PrinterVisitorSink::preVisitDecl(VisitDeclContext context,
+                                      clang::Decl const *decl)
+{
+  m_printer.printDeclLine(context, decl);
+  ++m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::postVisitDecl(VisitDeclContext,
+                                       clang::Decl const *)
+{
+  --m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::preVisitStmt(VisitStmtContext context,
+                                      clang::Stmt const *stmt)
+{
+  m_printer.printStmtLine(context, stmt);
+  ++m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::postVisitStmt(VisitStmtContext,
+                                       clang::Stmt const *stmt)
+{
+  // The default argument is not a child, so the fan-out traversal does
+  // not reach it; print it with a traversal of its own, as the
+  // standalone visitor does.
+  m_printer.printDefaultArgExpr(stmt);
+  --m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::preVisitTypeLoc(VisitTypeContext context,
+                                         clang::TypeLoc typeLoc)
+{
+  if (!m_printer.omitsTypeLoc(context)) {
+    m_printer.printTypeLocLine(context, typeLoc);
+    ++m_printer.m_indentLevel;
+  }
+}
+
+
+void PrinterVisitorSink::postVisitTypeLoc(VisitTypeContext context,
+                                          clang::TypeLoc)
+{
+  if (!m_printer.omitsTypeLoc(context)) {
+    --m_printer.m_indentLevel;
+  }
+}
+
+
+void PrinterVisitorSink::preVisitTemplateArgumentLoc(
+  VisitTemplateArgumentContext context,
+  clang::TemplateArgumentLoc tal)
+{
+  m_printer.printTemplateArgumentLocLine(context, tal);
+  ++m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::postVisitTemplateArgumentLoc(
+  VisitTemplateArgumentContext,
+  clang::TemplateArgumentLoc)
+{
+  --m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::preVisitNestedNameSpecifierLoc(
+  VisitNestedNameSpecifierContext context,
+  clang::NestedNameSpecifierLoc nnsl)
+{
+  m_printer.printNestedNameSpecifierLocLine(context, nnsl);
+  ++m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::postVisitNestedNameSpecifierLoc(
+  VisitNestedNameSpecifierContext,
+  clang::NestedNameSpecifierLoc)
+{
+  --m_printer.m_indentLevel;
+}
+
+
+void PrinterVisitorSink::visitImplicitQualType(VisitTypeContext context,
+                                               clang::QualType qualType)
+{
+  m_printer.visitImplicitQualType(context, qualType);
+}
+
+
+bool PrinterVisitorSink::wantCXXDefaultInitExprChildren(
+  clang::CXXDefaultInitExpr const *)
+{
+  return m_printer.printsCXXDefaultInitExprChildren();
+}
+
+
+// --------------------------- printerVisitorTU ---------------------------
+
+
 void printerVisitorTU(std::ostream &os,
                       clang::ASTContext &astContext,
-                      PrinterVisitor::Flags flags)
+                      PrinterVisitor::Flags flags,
+                      int jobs)
 {
   PrinterVisitor pv(os, astContext);
   pv.m_flags = flags;
-  pv.scanTU();
+
+  if (jobs < 2) {
+    pv.scanTU();
+    return;
+  }
+
+  // Print the TU line here, and its children in the workers, one level
+  // deeper, just as 'scanTU' would.
+  pv.printDeclLine(VDC_NONE, astContext.getTranslationUnitDecl());
+
+  scanTUParallel(astContext, jobs,
+    [&astContext, flags](std::vector<ScanTUUnit> const &units) {
+      std::ostringstream oss;
+      PrinterVisitor worker(oss, astContext);
+      worker.m_flags = flags;
+      worker.m_indentLevel = 1;
+      visitScanTUUnits(worker, units);
+      return oss.str();
+    },
+    [&os](std::string const &result) {
+      os << result;
+    });
 }
 
 
@@ -5,6 +5,7 @@
 #define PRINTER_VISITOR_H
 
 // this dir
+#include "clang-ast-visitor-fanout.h"            // ClangASTVisitorSink
 #include "clang-util-ast-visitor.h"              // ClangUtilASTVisitor
 
 // smbase
@@ -68,6 +69,32 @@ public:      // methods
   // Indentation string corresponding to 'm_indentLevel'.
   std::string indentString() const;
 
+  // Print the line that 'visitDecl' prints for 'decl', without
+  // visiting its children.
+  void printDeclLine(VisitDeclContext context, clang::Decl const *decl);
+
+  // Likewise for the other kinds of node.
+  void printStmtLine(VisitStmtContext context, clang::Stmt const *stmt);
+  void printTypeLocLine(VisitTypeContext context, clang::TypeLoc typeLoc);
+  void printTemplateArgumentLocLine(
+    VisitTemplateArgumentContext context,
+    clang::TemplateArgumentLoc tal);
+  void printNestedNameSpecifierLocLine(
+    VisitNestedNameSpecifierContext context,
+    clang::NestedNameSpecifierLoc nnsl);
+
+  // With F_PRINT_DEFAULT_ARG_EXPRS, if 'stmt' is a CXXDefaultArgExpr,
+  // print its default argument, which 'visitStmt' does after the
+  // children of 'stmt'.
+  void printDefaultArgExpr(clang::Stmt const *stmt);
+
+  // True if a TypeLoc in 'context' is not printed, although its
+  // children are.
+  bool omitsTypeLoc(VisitTypeContext context) const;
+
+  // True if the children of a CXXDefaultInitExpr are printed.
+  bool printsCXXDefaultInitExprChildren() const;
+
   // ClangASTVisitor methods.
   virtual void visitDecl(VisitDeclContext context, clang::Decl const *decl) override;
   virtual void visitStmt(VisitStmtContext context, clang::Stmt const *stmt) override;
@@ -89,10 +116,52 @@ public:      // methods
 ENUM_BITWISE_OPS(PrinterVisitor::Flags, PrinterVisitor::F_ALL)
 
 
-// Print the entire TU in 'astContext'.
+// Sink for `ClangASTVisitorFanOut` that prints the same thing as
+// `PrinterVisitor`, so it can share a traversal with other sinks.
+class PrinterVisitorSink : public ClangASTVisitorSink {
+public:      // data
+  // Printer whose settings and output are used.  Its traversal is only
+  // used to print default arguments, which are not children.
+  PrinterVisitor m_printer;
+
+public:      // methods
+  PrinterVisitorSink(std::ostream &os,
+                     clang::ASTContext &astContext);
+
+  // ClangASTVisitorSink methods.
+  virtual void preVisitDecl(VisitDeclContext context, clang::Decl const *decl) override;
+  virtual void postVisitDecl(VisitDeclContext context, clang::Decl const *decl) override;
+  virtual void preVisitStmt(VisitStmtContext context, clang::Stmt const *stmt) override;
+  virtual void postVisitStmt(VisitStmtContext context, clang::Stmt const *stmt) override;
+  virtual void preVisitTypeLoc(VisitTypeContext context, clang::TypeLoc typeLoc) override;
+  virtual void postVisitTypeLoc(VisitTypeContext context, clang::TypeLoc typeLoc) override;
+  virtual void preVisitTemplateArgumentLoc(
+    VisitTemplateArgumentContext context,
+    clang::TemplateArgumentLoc tal) override;
+  virtual void postVisitTemplateArgumentLoc(
+    VisitTemplateArgumentContext context,
+    clang::TemplateArgumentLoc tal) override;
+  virtual void preVisitNestedNameSpecifierLoc(
+    VisitNestedNameSpecifierContext context,
+    clang::NestedNameSpecifierLoc nnsl) override;
+  virtual void postVisitNestedNameSpecifierLoc(
+    VisitNestedNameSpecifierContext context,
+    clang::NestedNameSpecifierLoc nnsl) override;
+  virtual void visitImplicitQualType(
+    VisitTypeContext context,
+    clang::QualType qualType) override;
+  virtual bool wantCXXDefaultInitExprChildren(
+    clang::CXXDefaultInitExpr const *cdie) override;
+};
+
+
+// Print the entire TU in 'astContext'.  If 'jobs' is at least 2, the
+// top-level declarations are printed by that many parallel workers.
+// The output is the same either way.
 void printerVisitorTU(std::ostream &os,
                       clang::ASTContext &astContext,
-                      PrinterVisitor::Flags flags);
+                      PrinterVisitor::Flags flags,
+                      int jobs = 1);
 
 
 #endif // PRINTER_VISITOR_H
@@ -0,0 +1,157 @@
+// source-location-cache-test.cc
+// Tests for `source-location-cache`.
+
+#include "source-location-cache.h"               // module under test
+
+#include "clang-ast.h"                           // ClangAST, ClangASTUtilTempFile
+#include "clang-util.h"                          // ClangUtil
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+
+#include "clang/AST/RecursiveASTVisitor.h"       // clang::RecursiveASTVisitor
+#include "clang/Basic/SourceManager.h"           // clang::SourceManager
+
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Collect the locations of declarations and statements, which include
+// some in macro expansions.
+class CollectLocations
+  : public clang::RecursiveASTVisitor<CollectLocations> {
+public:      // data
+  std::vector<clang::SourceLocation> m_locs;
+
+public:      // methods
+  bool VisitDecl(clang::Decl *decl)
+  {
+    m_locs.push_back(decl->getLocation());
+    return true;
+  }
+
+  bool VisitStmt(clang::Stmt *stmt)
+  {
+    m_locs.push_back(stmt->getBeginLoc());
+    m_locs.push_back(stmt->getEndLoc());
+    return true;
+  }
+};
+
+
+// Check that 'cache' decodes 'loc' the same way 'srcMgr' does.
+void checkLoc(
+  SourceLocationCache &cache,
+  clang::SourceManager &srcMgr,
+  clang::SourceLocation loc)
+{
+  EXPECT_EQ(cache.locStr(loc), loc.printToString(srcMgr));
+
+  unsigned line, col;
+  cache.locLineCol(loc, line, col);
+  EXPECT_EQ(line, srcMgr.getPresumedLineNumber(loc));
+  EXPECT_EQ(col, srcMgr.getPresumedColumnNumber(loc));
+}
+
+
+// Check every offset of 'fileID', including the one just past the end.
+void checkEveryOffset(
+  SourceLocationCache &cache,
+  clang::SourceManager &srcMgr,
+  clang::FileID fileID)
+{
+  clang::SourceLocation start = srcMgr.getLocForStartOfFile(fileID);
+  unsigned size = srcMgr.getBufferData(fileID).size();
+  for (unsigned offset=0; offset <= size; ++offset) {
+    checkLoc(cache, srcMgr, start.getLocWithOffset(offset));
+  }
+}
+
+
+void testAgreesWithSourceManager()
+{
+  // This has both kinds of line ending, and a lone "\r".
+  ClangAST::addInMemoryFile("/pca-in-memory/slc-test/b.h",
+    "int inB;\r\n"
+    "\r\n"
+    "int alsoInB;\r"
+    "#define ADD(a, b) ((a) + (b))\n");
+  ClangAST::addInMemoryFile("/pca-in-memory/slc-test/a.h",
+    "#include \"/pca-in-memory/slc-test/b.h\"\n"
+    "int inA;\n");
+
+  ClangASTUtilTempFile ast(
+    "#include \"/pca-in-memory/slc-test/a.h\"\n"
+    "int f(int x)\n"
+    "{\n"
+    "  return ADD(x,\n"
+    "             inA);\n"
+    "}\n"
+    "#line 100 \"renamed.cc\"\n"
+    "int afterLine = ADD(1, 2);\n");
+
+  clang::SourceManager &srcMgr = ast.m_srcMgr;
+  SourceLocationCache cache(srcMgr);
+
+  checkLoc(cache, srcMgr, clang::SourceLocation());
+
+  // Every offset of every file: the main file, the two headers, and the
+  // predefines buffer.
+  clang::FileID bFileID;
+  for (unsigned i=0; i < srcMgr.local_sloc_entry_size(); ++i) {
+    clang::SrcMgr::SLocEntry const &entry = srcMgr.getLocalSLocEntry(i);
+    if (!entry.isFile()) {
+      continue;
+    }
+
+    clang::FileID fileID = srcMgr.getFileID(
+      clang::SourceLocation::getFromRawEncoding(entry.getOffset()));
+    if (fileID.isValid()) {
+      checkEveryOffset(cache, srcMgr, fileID);
+      auto entryRef = srcMgr.getFileEntryRefForID(fileID);
+      if (entryRef && ClangUtil::fileEntryRefNameStr(*entryRef) ==
+                        "/pca-in-memory/slc-test/b.h") {
+        bFileID = fileID;
+      }
+    }
+  }
+  EXPECT_EQ(bFileID.isValid(), true);
+
+  CollectLocations collector;
+  collector.TraverseDecl(ast.getASTContext().getTranslationUnitDecl());
+  for (clang::SourceLocation loc : collector.m_locs) {
+    checkLoc(cache, srcMgr, loc);
+  }
+
+  // The top-level include of a location in "b.h" is "a.h", which is
+  // computed once for "b.h".
+  clang::SourceLocation bLoc = srcMgr.getLocForStartOfFile(bFileID);
+  int calls = 0;
+  auto compute = [&calls](clang::SourceLocation) {
+    ++calls;
+    return std::string("/pca-in-memory/slc-test/a.h");
+  };
+  EXPECT_EQ(cache.topLevelIncludeForLoc(bLoc, compute),
+            "/pca-in-memory/slc-test/a.h");
+  EXPECT_EQ(cache.topLevelIncludeForLoc(bLoc.getLocWithOffset(3), compute),
+            "/pca-in-memory/slc-test/a.h");
+  EXPECT_EQ(calls, 1);
+  EXPECT_EQ(ast.getTopLevelIncludeForLoc(bLoc),
+            "/pca-in-memory/slc-test/a.h");
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void source_location_cache_unit_tests()
+{
+  testAgreesWithSourceManager();
+}
+
+
+// EOF
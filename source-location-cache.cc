@@ -0,0 +1,184 @@
+// source-location-cache.cc
+// Code for source-location-cache.h.
+
+#include "source-location-cache.h"               // this module
+
+#include "clang/Basic/SourceManager.h"           // clang::SourceManager
+
+#include <algorithm>                             // std::upper_bound
+#include <string>                                // std::to_string
+#include <utility>                               // std::pair
+
+
+SourceLocationCache::SourceLocationCache(
+  clang::SourceManager const &srcMgr)
+  : m_srcMgr(srcMgr),
+    m_files(),
+    m_lastFileID(),
+    m_lastFileInfo(nullptr)
+{}
+
+
+SourceLocationCache::~SourceLocationCache()
+{}
+
+
+SourceLocationCache::FileInfo &SourceLocationCache::getFileInfo(
+  clang::FileID fileID)
+{
+  if (m_lastFileInfo && fileID == m_lastFileID) {
+    return *m_lastFileInfo;
+  }
+
+  std::unique_ptr<FileInfo> &slot = m_files[fileID];
+  if (!slot) {
+    slot.reset(new FileInfo);
+    FileInfo &info = *slot;
+
+    bool invalid = false;
+    clang::SrcMgr::SLocEntry const &entry =
+      m_srcMgr.getSLocEntry(fileID, &invalid);
+    if (!invalid &&
+        entry.isFile() &&
+        !entry.getFile().hasLineDirectives()) {
+      // Let `SourceManager` say what the name is, since which name it
+      // uses depends on how the file was entered.
+      auto bufferOpt = m_srcMgr.getBufferOrNone(fileID);
+      clang::PresumedLoc presumedLoc =
+        m_srcMgr.getPresumedLoc(m_srcMgr.getLocForStartOfFile(fileID));
+      if (bufferOpt && presumedLoc.isValid()) {
+        info.m_cached = true;
+        info.m_name = presumedLoc.getFilename();
+        info.m_buffer = bufferOpt->getBuffer();
+
+        // This is how `SourceManager` divides the lines: each of "\n",
+        // "\r\n", and a lone "\r" ends one.
+        llvm::StringRef buf = info.m_buffer;
+        info.m_lineOffsets.push_back(0);
+        for (unsigned i=0; i < buf.size(); ++i) {
+          if (buf[i] == '\r' && i+1 < buf.size() && buf[i+1] == '\n') {
+            ++i;
+          }
+          if (buf[i] == '\n' || buf[i] == '\r') {
+            info.m_lineOffsets.push_back(i+1);
+          }
+        }
+      }
+    }
+  }
+
+  m_lastFileID = fileID;
+  m_lastFileInfo = slot.get();
+  return *m_lastFileInfo;
+}
+
+
+bool SourceLocationCache::decodeFileLoc(
+  clang::SourceLocation loc,
+  FileInfo * NULLABLE /*OUT*/ &info,
+  unsigned /*OUT*/ &line,
+  unsigned /*OUT*/ &col)
+{
+  std::pair<clang::FileID, unsigned> decomposed =
+    m_srcMgr.getDecomposedLoc(loc);
+  info = &getFileInfo(decomposed.first);
+
+  // A location just past the end is allowed.
+  unsigned offset = decomposed.second;
+  if (!info->m_cached || offset > info->m_buffer.size()) {
+    return false;
+  }
+
+  std::vector<unsigned> const &starts = info->m_lineOffsets;
+  line = std::upper_bound(starts.begin(), starts.end(), offset) -
+         starts.begin();
+  unsigned lineStart = starts[line-1];
+  col = offset - lineStart + 1;
+
+  // `SourceManager` reports the "\n" of a "\r\n" as being in the same
+  // column as the "\r".
+  if (offset > lineStart && info->m_buffer[offset-1] == '\r') {
+    --col;
+  }
+
+  return true;
+}
+
+
+std::string SourceLocationCache::locStr(clang::SourceLocation loc)
+{
+  // This follows `SourceLocation::print`.
+  if (loc.isInvalid()) {
+    return "<invalid loc>";
+  }
+
+  if (loc.isMacroID()) {
+    return locStr(m_srcMgr.getExpansionLoc(loc)) +
+           " <Spelling=" + locStr(m_srcMgr.getSpellingLoc(loc)) + ">";
+  }
+
+  FileInfo *info;
+  unsigned line, col;
+  if (!decodeFileLoc(loc, info, line, col)) {
+    return loc.printToString(m_srcMgr);
+  }
+
+  std::string ret(info->m_name.str());
+  ret += ':';
+  ret += std::to_string(line);
+  ret += ':';
+  ret += std::to_string(col);
+  return ret;
+}
+
+
+void SourceLocationCache::locLineCol(
+  clang::SourceLocation loc,
+  unsigned /*OUT*/ &line,
+  unsigned /*OUT*/ &col)
+{
+  line = col = 0;
+  if (loc.isInvalid()) {
+    return;
+  }
+
+  // Presumed locations are for expansion points.
+  if (loc.isMacroID()) {
+    loc = m_srcMgr.getExpansionLoc(loc);
+  }
+
+  FileInfo *info;
+  if (!decodeFileLoc(loc, info, line, col)) {
+    clang::PresumedLoc presumedLoc = m_srcMgr.getPresumedLoc(loc);
+    if (presumedLoc.isValid()) {
+      line = presumedLoc.getLine();
+      col = presumedLoc.getColumn();
+    }
+    else {
+      line = col = 0;
+    }
+  }
+}
+
+
+std::string SourceLocationCache::topLevelIncludeForLoc(
+  clang::SourceLocation loc,
+  llvm::function_ref<std::string (clang::SourceLocation)> compute)
+{
+  if (loc.isValid()) {
+    FileInfo &info =
+      getFileInfo(m_srcMgr.getDecomposedExpansionLoc(loc).first);
+    if (info.m_cached) {
+      if (!info.m_haveTopLevelInclude) {
+        info.m_topLevelInclude = compute(loc);
+        info.m_haveTopLevelInclude = true;
+      }
+      return info.m_topLevelInclude;
+    }
+  }
+
+  return compute(loc);
+}
+
+
+// EOF
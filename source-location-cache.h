@@ -0,0 +1,110 @@
+// source-location-cache.h
+// `SourceLocationCache`, memoized decoding of source locations.
+
+#ifndef PCA_SOURCE_LOCATION_CACHE_H
+#define PCA_SOURCE_LOCATION_CACHE_H
+
+#include "clang-source-manager-fwd.h"            // clang::SourceManager
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES, NULLABLE
+
+#include "clang/Basic/SourceLocation.h"          // clang::{FileID, SourceLocation}
+
+#include "llvm/ADT/DenseMap.h"                   // llvm::DenseMap
+#include "llvm/ADT/STLFunctionalExtras.h"        // llvm::function_ref
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <memory>                                // std::unique_ptr
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+// Decodes source locations into file name, line, and column the same
+// way `clang::SourceManager` does, but remembers, for each file, its
+// name and where its lines start, so that decoding a location only
+// costs the `FileID` lookup and a binary search of that file's lines.
+//
+// `SourceManager` keeps line tables too, but reaching them goes through
+// the `FileID` lookup separately for the line and the column, and
+// rendering a location with `printToString` does it once more.
+//
+// Files with #line directives, and files whose contents cannot be
+// read, are left to `SourceManager`.
+class SourceLocationCache {
+  NO_OBJECT_COPIES(SourceLocationCache);
+
+private:     // types
+  // What is known about one file.
+  struct FileInfo {
+    // False if locations in this file are decoded by `SourceManager`.
+    bool m_cached = false;
+
+    // The name that `PresumedLoc::getFilename` reports for the file.
+    llvm::StringRef m_name;
+
+    // The contents.
+    llvm::StringRef m_buffer;
+
+    // Offset of the start of each line.  Element 0 is 0.
+    std::vector<unsigned> m_lineOffsets;
+
+    // True once 'm_topLevelInclude' has been computed.
+    bool m_haveTopLevelInclude = false;
+
+    // Memoized result of `ClangUtil::getTopLevelIncludeForLoc`.
+    std::string m_topLevelInclude;
+  };
+
+private:     // data
+  // The source manager whose locations are decoded.
+  clang::SourceManager const &m_srcMgr;
+
+  // Map from file to what is known about it.
+  llvm::DenseMap<clang::FileID, std::unique_ptr<FileInfo>> m_files;
+
+  // The most recently used entry of 'm_files', since consecutive
+  // queries are usually in the same file.
+  clang::FileID m_lastFileID;
+  FileInfo * NULLABLE m_lastFileInfo;
+
+private:     // methods
+  // Get the info for 'fileID', computing it if needed.
+  FileInfo &getFileInfo(clang::FileID fileID);
+
+  // Decode 'loc', which must be a valid file location.  Return false if
+  // `SourceManager` has to do it instead.
+  bool decodeFileLoc(
+    clang::SourceLocation loc,
+    FileInfo * NULLABLE /*OUT*/ &info,
+    unsigned /*OUT*/ &line,
+    unsigned /*OUT*/ &col);
+
+public:      // methods
+  explicit SourceLocationCache(clang::SourceManager const &srcMgr);
+  ~SourceLocationCache();
+
+  // Same as `loc.printToString(m_srcMgr)`.
+  std::string locStr(clang::SourceLocation loc);
+
+  // Set 'line' and 'col' to the same as `getPresumedLineNumber` and
+  // `getPresumedColumnNumber` would return for 'loc'.
+  void locLineCol(
+    clang::SourceLocation loc,
+    unsigned /*OUT*/ &line,
+    unsigned /*OUT*/ &col);
+
+  // Return the top-level include for 'loc', as computed by 'compute'
+  // the first time a location in the same file is asked about.  Every
+  // location in a file without #line directives has the same include
+  // chain, and thus the same answer.
+  std::string topLevelIncludeForLoc(
+    clang::SourceLocation loc,
+    llvm::function_ref<std::string (clang::SourceLocation)> compute);
+};
+
+
+// Unit tests, defined in source-location-cache-test.cc.
+void source_location_cache_unit_tests();
+
+
+#endif // PCA_SOURCE_LOCATION_CACHE_H
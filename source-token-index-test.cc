@@ -0,0 +1,138 @@
+// source-token-index-test.cc
+// Tests for `source-token-index`.
+
+#include "source-token-index.h"                  // module under test
+
+#include "clang-ast.h"                           // ClangASTUtilTempFile
+
+#include "smbase/sm-macros.h"                    // OPEN_ANONYMOUS_NAMESPACE
+#include "smbase/sm-test.h"                      // EXPECT_EQ
+#include "smbase/xassert.h"                      // xfailure_stringbc
+
+#include "clang/AST/Decl.h"                      // clang::NamedDecl
+#include "clang/Basic/SourceManager.h"           // clang::SourceManager
+#include "clang/Lex/Lexer.h"                     // clang::Lexer
+
+#include "llvm/Support/Casting.h"                // llvm::dyn_cast
+
+#include <optional>                              // std::optional
+#include <string>                                // std::string
+
+
+OPEN_ANONYMOUS_NAMESPACE
+
+
+// Return the declaration in the TU of 'ast' called 'name'.
+clang::Decl const *findDecl(ClangASTUtilTempFile &ast, char const *name)
+{
+  for (clang::Decl const *decl :
+         ast.getASTContext().getTranslationUnitDecl()->decls()) {
+    if (auto namedDecl = llvm::dyn_cast<clang::NamedDecl>(decl)) {
+      if (namedDecl->getNameAsString() == name) {
+        return decl;
+      }
+    }
+  }
+  xfailure_stringbc("no decl called " << name);
+}
+
+
+// Return the spelling of the token that ends the declaration called
+// 'name', and the spelling of the one after it, separated by a space.
+std::string lastAndNext(
+  SourceTokenIndex &index,
+  ClangASTUtilTempFile &ast,
+  char const *name)
+{
+  clang::SourceLocation endLoc = findDecl(ast, name)->getEndLoc();
+
+  std::optional<IndexedToken> last = index.tokenAt(endLoc);
+  std::optional<IndexedToken> next = index.nextToken(endLoc);
+  return (last? last->m_spelling : "-") + " " +
+         (next? next->m_spelling : "-");
+}
+
+
+void testTokens()
+{
+  ClangASTUtilTempFile ast(
+    "#define SEVEN 7\n"
+    "void deleted(int) = delete;\n"
+    "/* comment */ int ab\\\n"
+    "cd = SEVEN;\n"
+    "int last = 0 // comment\n"
+    ";");
+
+  clang::SourceManager &srcMgr = ast.m_srcMgr;
+  clang::LangOptions const &langOpts = ast.getLangOptions();
+  SourceTokenIndex index(srcMgr, langOpts);
+
+  // Walk through every token, comparing each with what the lexer finds
+  // by searching from the previous one.
+  clang::SourceLocation startLoc =
+    srcMgr.getLocForStartOfFile(ast.m_mainFileID);
+  std::optional<IndexedToken> tok = index.tokenAt(startLoc);
+  EXPECT_EQ((bool)tok, true);
+  EXPECT_EQ(tok->m_spelling, "#");
+  int count = 1;
+  while (true) {
+    std::optional<IndexedToken> next = index.nextToken(tok->m_loc);
+    auto expect = clang::Lexer::findNextToken(tok->m_loc, srcMgr, langOpts);
+    EXPECT_EQ((bool)expect, true);
+    if (!next) {
+      EXPECT_EQ(expect->is(clang::tok::eof), true);
+      break;
+    }
+    EXPECT_EQ(next->m_loc == expect->getLocation(), true);
+    EXPECT_EQ(next->m_length, expect->getLength());
+    EXPECT_EQ(next->m_kind, expect->getKind());
+    EXPECT_EQ(next->m_spelling,
+              clang::Lexer::getSpelling(*expect, srcMgr, langOpts));
+
+    // Searching from the last character finds the same token.
+    std::optional<IndexedToken> again =
+      index.nextToken(tok->lastCharLoc());
+    EXPECT_EQ((bool)again, true);
+    EXPECT_EQ(again->m_loc == next->m_loc, true);
+
+    tok = next;
+    ++count;
+  }
+  EXPECT_EQ(count, 22);
+
+  // Whitespace and comments are not in any token.
+  EXPECT_EQ(index.tokenAt(startLoc.getLocWithOffset(1)).has_value(), true);
+  EXPECT_EQ(index.tokenAt(startLoc.getLocWithOffset(7)).has_value(), false);
+  EXPECT_EQ(index.tokenAt(startLoc.getLocWithOffset(46)).has_value(), false);
+
+  std::optional<IndexedToken> deleted =
+    index.tokenAt(findDecl(ast, "deleted")->getLocation());
+  EXPECT_EQ(deleted->m_spelling, "deleted");
+  EXPECT_EQ(index.nextToken(deleted->lastCharLoc())->m_spelling, "(");
+
+  // 'abcd' ends in the expansion of "SEVEN", so its last token is the
+  // macro name.  The escaped newline is not part of the spelling.
+  EXPECT_EQ(lastAndNext(index, ast, "abcd"), "SEVEN ;");
+  std::optional<IndexedToken> abcd =
+    index.tokenAt(findDecl(ast, "abcd")->getLocation());
+  EXPECT_EQ(abcd->m_spelling, "abcd");
+  EXPECT_EQ(abcd->m_length, 6u);
+
+  EXPECT_EQ(lastAndNext(index, ast, "last"), "0 ;");
+
+  // There is nothing after the last token.
+  EXPECT_EQ(index.nextToken(tok->m_loc).has_value(), false);
+}
+
+
+CLOSE_ANONYMOUS_NAMESPACE
+
+
+// Called from pca-unit-tests.cc.
+void source_token_index_unit_tests()
+{
+  testTokens();
+}
+
+
+// EOF
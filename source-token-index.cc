@@ -0,0 +1,206 @@
+// source-token-index.cc
+// Code for source-token-index.h.
+
+#include "source-token-index.h"                  // this module
+
+#include "clang/Basic/SourceManager.h"           // clang::SourceManager
+#include "clang/Lex/Lexer.h"                     // clang::Lexer
+#include "clang/Lex/Token.h"                     // clang::Token
+
+#include "llvm/ADT/SmallString.h"                // llvm::SmallString
+
+#include <algorithm>                             // std::upper_bound
+#include <utility>                               // std::pair
+
+
+SourceTokenIndex::SourceTokenIndex(
+  clang::SourceManager const &srcMgr,
+  clang::LangOptions const &langOpts)
+  : m_srcMgr(srcMgr),
+    m_langOpts(langOpts),
+    m_files(),
+    m_lastFile(nullptr),
+    m_lastTokenIndex(0)
+{}
+
+
+SourceTokenIndex::~SourceTokenIndex()
+{}
+
+
+SourceTokenIndex::FileTokens const &SourceTokenIndex::getFileTokens(
+  clang::FileID fileID)
+{
+  std::unique_ptr<FileTokens> &slot = m_files[fileID];
+  if (slot) {
+    return *slot;
+  }
+
+  slot.reset(new FileTokens);
+  FileTokens &file = *slot;
+
+  bool invalid = false;
+  clang::SrcMgr::SLocEntry const &entry =
+    m_srcMgr.getSLocEntry(fileID, &invalid);
+  if (invalid || !entry.isFile()) {
+    return file;
+  }
+
+  auto bufferOpt = m_srcMgr.getBufferOrNone(fileID);
+  if (!bufferOpt) {
+    return file;
+  }
+
+  file.m_valid = true;
+  file.m_startLoc = m_srcMgr.getLocForStartOfFile(fileID);
+  file.m_buffer = bufferOpt->getBuffer();
+
+  // This is the same lexer configuration `findNextToken` uses, except
+  // that it starts at the beginning.
+  char const *begin = file.m_buffer.data();
+  clang::Lexer lexer(file.m_startLoc, m_langOpts,
+    begin, begin, begin + file.m_buffer.size());
+  lexer.SetCommentRetentionState(false);
+
+  clang::Token tok;
+  bool atEnd = false;
+  while (!atEnd) {
+    // This returns true when the token it lexed is the last one.
+    atEnd = lexer.LexFromRawLexer(tok);
+    if (tok.is(clang::tok::eof)) {
+      break;
+    }
+
+    RawToken raw;
+    raw.m_offset = m_srcMgr.getFileOffset(tok.getLocation());
+    raw.m_length = tok.getLength();
+    raw.m_needsCleaning = tok.needsCleaning();
+    raw.m_kind = tok.getKind();
+    file.m_tokens.push_back(raw);
+  }
+
+  return file;
+}
+
+
+SourceTokenIndex::FileTokens const * NULLABLE
+SourceTokenIndex::getFileTokensForLoc(
+  clang::SourceLocation loc,
+  unsigned /*OUT*/ &offset)
+{
+  if (loc.isInvalid()) {
+    return nullptr;
+  }
+
+  // This also moves 'loc' to the last token of the expansion.
+  if (loc.isMacroID() &&
+      !clang::Lexer::isAtEndOfMacroExpansion(loc, m_srcMgr, m_langOpts,
+                                             &loc)) {
+    return nullptr;
+  }
+
+  std::pair<clang::FileID, unsigned> decomposed =
+    m_srcMgr.getDecomposedLoc(loc);
+  FileTokens const &file = getFileTokens(decomposed.first);
+  if (!file.m_valid) {
+    return nullptr;
+  }
+
+  offset = decomposed.second;
+  return &file;
+}
+
+
+IndexedToken SourceTokenIndex::makeIndexedToken(
+  FileTokens const &file, std::size_t index) const
+{
+  RawToken const &raw = file.m_tokens[index];
+
+  IndexedToken ret;
+  ret.m_loc = file.m_startLoc.getLocWithOffset(raw.m_offset);
+  ret.m_length = raw.m_length;
+  ret.m_kind = raw.m_kind;
+
+  if (raw.m_needsCleaning) {
+    llvm::SmallString<32> buffer;
+    ret.m_spelling =
+      clang::Lexer::getSpelling(ret.m_loc, buffer, m_srcMgr, m_langOpts)
+        .str();
+  }
+  else {
+    ret.m_spelling = file.m_buffer.substr(raw.m_offset, raw.m_length).str();
+  }
+
+  return ret;
+}
+
+
+/*static*/ std::size_t SourceTokenIndex::firstTokenAfter(
+  std::vector<RawToken> const &tokens,
+  unsigned offset)
+{
+  return std::upper_bound(tokens.begin(), tokens.end(), offset,
+    [](unsigned offset, RawToken const &tok) {
+      return offset < tok.m_offset;
+    }) - tokens.begin();
+}
+
+
+std::optional<IndexedToken> SourceTokenIndex::nextToken(
+  clang::SourceLocation loc)
+{
+  unsigned offset;
+  FileTokens const *file = getFileTokensForLoc(loc, offset /*OUT*/);
+  if (!file) {
+    return std::nullopt;
+  }
+  std::vector<RawToken> const &tokens = file->m_tokens;
+
+  std::size_t index;
+  if (file == m_lastFile &&
+      tokens[m_lastTokenIndex].m_offset <= offset &&
+      (m_lastTokenIndex+1 == tokens.size() ||
+       offset < tokens[m_lastTokenIndex+1].m_offset)) {
+    // The search resumes from the token returned last time, which is
+    // what a walk forward through the tokens does.
+    index = m_lastTokenIndex + 1;
+  }
+  else {
+    index = firstTokenAfter(tokens, offset);
+  }
+
+  if (index >= tokens.size()) {
+    return std::nullopt;
+  }
+
+  m_lastFile = file;
+  m_lastTokenIndex = index;
+  return makeIndexedToken(*file, index);
+}
+
+
+std::optional<IndexedToken> SourceTokenIndex::tokenAt(
+  clang::SourceLocation loc)
+{
+  unsigned offset;
+  FileTokens const *file = getFileTokensForLoc(loc, offset /*OUT*/);
+  if (!file) {
+    return std::nullopt;
+  }
+  std::vector<RawToken> const &tokens = file->m_tokens;
+
+  // The candidate is the last token that starts at or before 'offset'.
+  std::size_t after = firstTokenAfter(tokens, offset);
+  if (after == 0) {
+    return std::nullopt;
+  }
+  RawToken const &raw = tokens[after-1];
+  if (offset >= raw.m_offset + raw.m_length) {
+    return std::nullopt;
+  }
+
+  return makeIndexedToken(*file, after-1);
+}
+
+
+// EOF
@@ -0,0 +1,156 @@
+// source-token-index.h
+// `SourceTokenIndex`, the raw tokens of each source file.
+
+#ifndef PCA_SOURCE_TOKEN_INDEX_H
+#define PCA_SOURCE_TOKEN_INDEX_H
+
+#include "clang-source-manager-fwd.h"            // clang::SourceManager
+
+#include "smbase/sm-macros.h"                    // NO_OBJECT_COPIES, NULLABLE
+
+#include "clang/Basic/LangOptions.h"             // clang::LangOptions
+#include "clang/Basic/SourceLocation.h"          // clang::{FileID, SourceLocation}
+#include "clang/Basic/TokenKinds.h"              // clang::tok::TokenKind
+
+#include "llvm/ADT/DenseMap.h"                   // llvm::DenseMap
+#include "llvm/ADT/StringRef.h"                  // llvm::StringRef
+
+#include <cstddef>                               // std::size_t
+#include <memory>                                // std::unique_ptr
+#include <optional>                              // std::optional
+#include <string>                                // std::string
+#include <vector>                                // std::vector
+
+
+// A token found by `SourceTokenIndex`.
+class IndexedToken {
+public:      // data
+  // Location of the first character.
+  clang::SourceLocation m_loc;
+
+  // Number of characters in the source.
+  unsigned m_length = 0;
+
+  // The kind, as the raw lexer sees it.  In particular, identifiers and
+  // keywords are all `raw_identifier`.
+  clang::tok::TokenKind m_kind = clang::tok::unknown;
+
+  // The spelling, with any escaped newlines and trigraphs resolved.
+  std::string m_spelling;
+
+public:      // methods
+  // Location of the last character.
+  clang::SourceLocation lastCharLoc() const
+    { return m_loc.getLocWithOffset(m_length - 1); }
+
+  // Location just past the last character.
+  clang::SourceLocation endLoc() const
+    { return m_loc.getLocWithOffset(m_length); }
+};
+
+
+// Lexes each file in raw mode, the way `clang::Lexer::findNextToken`
+// does, but only once, the first time a location in it is asked about.
+// `findNextToken` instead re-lexes from the given location every time,
+// and first re-lexes the token there to find where it ends.
+//
+// Like `findNextToken`, this does not skip anything in a preprocessor
+// directive or a skipped conditional block, but it does skip comments.
+class SourceTokenIndex {
+  NO_OBJECT_COPIES(SourceTokenIndex);
+
+private:     // types
+  // One token of a file.
+  struct RawToken {
+    // Offset of the first character in the file.
+    unsigned m_offset;
+
+    // Number of characters.
+    unsigned m_length;
+
+    // True if the spelling differs from the source text because it
+    // contains an escaped newline or trigraph.
+    bool m_needsCleaning;
+
+    // The kind.
+    clang::tok::TokenKind m_kind;
+  };
+
+  // The tokens of one file.
+  struct FileTokens {
+    // False if the file's contents cannot be read, or it is not a
+    // file.  Then there are no tokens.
+    bool m_valid = false;
+
+    // Location of the start of the file.
+    clang::SourceLocation m_startLoc;
+
+    // The contents.
+    llvm::StringRef m_buffer;
+
+    // The tokens, in order.
+    std::vector<RawToken> m_tokens;
+  };
+
+private:     // data
+  // The source manager whose files are lexed.
+  clang::SourceManager const &m_srcMgr;
+
+  // The language options to lex with.
+  clang::LangOptions const &m_langOpts;
+
+  // Map from file to its tokens.
+  llvm::DenseMap<clang::FileID, std::unique_ptr<FileTokens>> m_files;
+
+  // The file and index of the token most recently returned by
+  // 'nextToken', since a search often resumes from there.
+  FileTokens const * NULLABLE m_lastFile;
+  std::size_t m_lastTokenIndex;
+
+private:     // methods
+  // Get the tokens of 'fileID', lexing it if needed.
+  FileTokens const &getFileTokens(clang::FileID fileID);
+
+  // Get the tokens of the file containing 'loc', and set 'offset' to
+  // where 'loc' is in it.  Macro locations are treated as described at
+  // 'nextToken'.  Returns null if there are none.
+  FileTokens const * NULLABLE getFileTokensForLoc(
+    clang::SourceLocation loc,
+    unsigned /*OUT*/ &offset);
+
+  // Return the index of the first element of 'tokens' that starts
+  // after 'offset', or the size if there is none.
+  static std::size_t firstTokenAfter(
+    std::vector<RawToken> const &tokens,
+    unsigned offset);
+
+  // Build an `IndexedToken` from element 'index' of 'file'.
+  IndexedToken makeIndexedToken(
+    FileTokens const &file, std::size_t index) const;
+
+public:      // methods
+  SourceTokenIndex(clang::SourceManager const &srcMgr,
+                   clang::LangOptions const &langOpts);
+  ~SourceTokenIndex();
+
+  // Return the first token that starts after 'loc'.  If 'loc' is in a
+  // macro expansion, the search starts after the expansion, but only
+  // if 'loc' is at its end.  Returns nothing if there is no such token
+  // in the file, or the file cannot be read.
+  //
+  // When 'loc' is the start or last character of a token, this finds
+  // the same token as `clang::Lexer::findNextToken`.
+  std::optional<IndexedToken> nextToken(clang::SourceLocation loc);
+
+  // Return the token that contains 'loc', or nothing if 'loc' is in
+  // whitespace or a comment.  If 'loc' is in a macro expansion, this is
+  // the last token of the expansion, but only if 'loc' is at its end.
+  std::optional<IndexedToken> tokenAt(clang::SourceLocation loc);
+};
+
+
+// Unit tests, defined in source-token-index-test.cc.
+void source_token_index_unit_tests();
+
+
+#endif // PCA_SOURCE_TOKEN_INDEX_H
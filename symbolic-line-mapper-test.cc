@@ -58,6 +58,12 @@ void testSymLineColStr()
   testOneSymLineColStr(slm, 4, "4:1",     "4");
   testOneSymLineColStr(slm, 5, "five:1",  "five");
   testOneSymLineColStr(slm, 6, "6:1",     "6");
+
+  // symLineNumberOpt
+  EXPECT_EQ(slm.symLineNumberOpt(slm.m_mainFileID, "three").value(), 3);
+  EXPECT_EQ(slm.symLineNumberOpt(slm.m_mainFileID, "five").value(), 5);
+  EXPECT_EQ(slm.symLineNumberOpt(slm.m_mainFileID, "six").has_value(),
+            false);
 }
 
 
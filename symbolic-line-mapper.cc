@@ -150,4 +150,18 @@ std::optional<std::string> SymbolicLineMapper::symLineStrOpt(
 }
 
 
+std::optional<int> SymbolicLineMapper::symLineNumberOpt(
+  clang::FileID fileID,
+  std::string const &name) const
+{
+  for (auto const &kv : getLineToNameMap(fileID)) {
+    if (kv.second == name) {
+      return kv.first;
+    }
+  }
+
+  return std::nullopt;
+}
+
+
 // EOF
@@ -70,6 +70,13 @@ public:      // methods
   // number name, return that name.  Otherwise return `nullopt`.
   std::optional<std::string> symLineStrOpt(
     clang::SourceLocation loc) const;
+
+  // If some line of `fileID` has the symbolic name `name`, return its
+  // line number.  Otherwise return `nullopt`.  If more than one line
+  // has that name, this returns the first.
+  std::optional<int> symLineNumberOpt(
+    clang::FileID fileID,
+    std::string const &name) const;
 };
 
 